@@ -0,0 +1,55 @@
+#ifndef ATOMICSNAPSHOT_H
+#define ATOMICSNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Sequence lock around a small struct with one writer task and any number
+// of reader tasks. The writer never blocks; readers retry while a publish
+// is in progress. The struct is copied word by word through atomics, so a
+// torn read is detected instead of being undefined behavior.
+template <typename T>
+class AtomicSnapshot {
+  static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+public:
+  AtomicSnapshot() {
+    for (size_t i = 0; i < WORDS; i++) words[i].store(0, std::memory_order_relaxed);
+  }
+
+  // Writer side
+  void publish(const T& value) {
+    uint32_t buffer[WORDS] = {};
+    memcpy(buffer, &value, sizeof(T));
+
+    uint32_t version = sequence.load(std::memory_order_relaxed);
+    sequence.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) words[i].store(buffer[i], std::memory_order_relaxed);
+    sequence.store(version + 2, std::memory_order_release);
+  }
+
+  // Reader side, always returns a consistent copy
+  T read() const {
+    uint32_t buffer[WORDS];
+    uint32_t before, after;
+    do {
+      before = sequence.load(std::memory_order_acquire);
+      for (size_t i = 0; i < WORDS; i++) buffer[i] = words[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+
+    T value;
+    memcpy(&value, buffer, sizeof(T));
+    return value;
+  }
+
+private:
+  std::atomic<uint32_t> sequence{0};
+  std::atomic<uint32_t> words[WORDS];
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef CYCLEHISTOGRAM_H
+#define CYCLEHISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Four buckets per power of two, so a bucket is at most a quarter of its
+// lower bound wide. 0 to 3 get a bucket each; every 32 bit count fits.
+const size_t CYCLE_HISTOGRAM_SUB_BUCKETS = 4;
+const size_t CYCLE_HISTOGRAM_BUCKETS = 4 + 30 * CYCLE_HISTOGRAM_SUB_BUCKETS;
+
+// Log-bucketed distribution of CPU cycle counts, or of the times they
+// convert to. Recording is a count leading zeros, a shift and three
+// compares; plain data like JitterStats, so a copy can be handed to other
+// tasks through an AtomicSnapshot.
+struct CycleHistogram {
+  uint32_t samples;
+  uint32_t minCycles;
+  uint32_t maxCycles;
+  uint32_t buckets[CYCLE_HISTOGRAM_BUCKETS];
+
+  void reset() {
+    samples = 0;
+    minCycles = UINT32_MAX;
+    maxCycles = 0;
+    for (size_t i = 0; i < CYCLE_HISTOGRAM_BUCKETS; i++) buckets[i] = 0;
+  }
+
+  static size_t bucketOf(uint32_t cycles) {
+    if (cycles < 4) return cycles;
+    uint32_t exponent = 31 - __builtin_clz(cycles);
+    return 4 + (exponent - 2) * CYCLE_HISTOGRAM_SUB_BUCKETS + ((cycles >> (exponent - 2)) & 3);
+  }
+
+  // Largest count that falls into the bucket
+  static uint32_t bucketUpper(size_t bucket) {
+    if (bucket < 4) return bucket;
+    uint32_t shift = (bucket - 4) / CYCLE_HISTOGRAM_SUB_BUCKETS;
+    uint64_t lower = (uint64_t)(4 + (bucket - 4) % CYCLE_HISTOGRAM_SUB_BUCKETS) << shift;
+    return (uint32_t)(lower + (1ULL << shift) - 1);
+  }
+
+  void record(uint32_t cycles) {
+    samples++;
+    if (cycles < minCycles) minCycles = cycles;
+    if (cycles > maxCycles) maxCycles = cycles;
+    buckets[bucketOf(cycles)]++;
+  }
+
+  // Upper end of the bucket holding the given share of the samples, kept
+  // within min and max, so at most 25% above the exact percentile
+  uint32_t percentile(uint32_t permille) const {
+    if (samples == 0) return 0;
+    uint64_t rank = ((uint64_t)samples * permille + 999) / 1000;
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < CYCLE_HISTOGRAM_BUCKETS; bucket++) {
+      seen += buckets[bucket];
+      if (seen < rank) continue;
+      uint32_t upper = bucketUpper(bucket);
+      if (upper > maxCycles) upper = maxCycles;
+      if (upper < minCycles) upper = minCycles;
+      return upper;
+    }
+    return maxCycles;
+  }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef JITTERSTATS_H
+#define JITTERSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Upper bounds of the deviation histogram, the last bucket takes the rest
+const size_t JITTER_BUCKETS = 6;
+const uint32_t JITTER_BUCKET_LIMITS_US[JITTER_BUCKETS - 1] = { 20, 100, 500, 1000, 5000 };
+
+// Period statistics of a task that should run at a fixed interval. Fed
+// with a timestamp on every wake-up by the task itself; plain data, so a
+// copy can be handed to other tasks through an AtomicSnapshot.
+struct JitterStats {
+  uint32_t nominalUs;
+  uint32_t samples;
+  uint32_t minPeriodUs;
+  uint32_t maxPeriodUs;
+  uint64_t totalPeriodUs;
+  uint32_t maxDeviationUs;
+  uint32_t buckets[JITTER_BUCKETS];
+
+  void reset(uint32_t nominal) {
+    nominalUs = nominal;
+    samples = 0;
+    minPeriodUs = UINT32_MAX;
+    maxPeriodUs = 0;
+    totalPeriodUs = 0;
+    maxDeviationUs = 0;
+    for (size_t i = 0; i < JITTER_BUCKETS; i++) buckets[i] = 0;
+  }
+
+  void record(uint32_t periodUs) {
+    samples++;
+    totalPeriodUs += periodUs;
+    if (periodUs < minPeriodUs) minPeriodUs = periodUs;
+    if (periodUs > maxPeriodUs) maxPeriodUs = periodUs;
+
+    uint32_t deviation = periodUs > nominalUs ? periodUs - nominalUs : nominalUs - periodUs;
+    if (deviation > maxDeviationUs) maxDeviationUs = deviation;
+
+    size_t bucket = 0;
+    while (bucket < JITTER_BUCKETS - 1 && deviation >= JITTER_BUCKET_LIMITS_US[bucket]) bucket++;
+    buckets[bucket]++;
+  }
+
+  uint32_t meanPeriodUs() const { return samples > 0 ? (uint32_t)(totalPeriodUs / samples) : 0; }
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free queue for exactly one producer task and one consumer task.
+// Each index is only written by one side: the producer advances head, the
+// consumer advances tail. Release/acquire ordering on the indices makes the
+// slot contents visible before the index that publishes them.
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+  // Producer side, returns false if the queue is full. With reserve the
+  // item is only queued while more than reserve slots are free, which keeps
+  // those slots for items pushed without one.
+  bool push(const T& item, size_t reserve = 0) {
+    uint32_t head = headIndex.load(std::memory_order_relaxed);
+    uint32_t tail = tailIndex.load(std::memory_order_acquire);
+    if (head - tail + reserve >= Capacity) {
+      droppedItems.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    items[head & (Capacity - 1)] = item;
+    headIndex.store(head + 1, std::memory_order_release);
+
+    uint32_t depth = head + 1 - tail;
+    if (depth > highWater.load(std::memory_order_relaxed)) {
+      highWater.store(depth, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // Consumer side, returns false if the queue is empty
+  bool pop(T& item) {
+    uint32_t tail = tailIndex.load(std::memory_order_relaxed);
+    uint32_t head = headIndex.load(std::memory_order_acquire);
+    if (tail == head) return false;
+
+    item = items[tail & (Capacity - 1)];
+    tailIndex.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return headIndex.load(std::memory_order_acquire) - tailIndex.load(std::memory_order_acquire);
+  }
+
+  // Deepest the queue has been, as seen by the producer
+  uint32_t maxDepth() const { return highWater.load(std::memory_order_relaxed); }
+  uint32_t dropped() const { return droppedItems.load(std::memory_order_relaxed); }
+
+private:
+  T items[Capacity];
+  std::atomic<uint32_t> headIndex{0};
+  std::atomic<uint32_t> tailIndex{0};
+  std::atomic<uint32_t> highWater{0};
+  std::atomic<uint32_t> droppedItems{0};
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "BandRenderer.h"
+#include "RoundClip.h"
+#include <string.h>
+
+BandRenderer::BandRenderer(TFT_eSPI& tft) : tft(tft), bandA(&tft), bandB(&tft) {
+  bands[0] = &bandA;
+  bands[1] = &bandB;
+  bandHeight = 0;
+  nextBand = 0;
+  transferring = false;
+  memset(&bandStats, 0, sizeof(bandStats));
+}
+
+bool BandRenderer::begin(int16_t height) {
+  for (int i = 0; i < 2; i++) {
+    if (bands[i]->createSprite(tft.width(), height) == nullptr) {
+      bandA.deleteSprite();
+      return false;
+    }
+  }
+  if (!tft.initDMA()) {
+    bandA.deleteSprite();
+    bandB.deleteSprite();
+    return false;
+  }
+  bandHeight = height;
+  return true;
+}
+
+void BandRenderer::render(TextElement* elements, size_t count, uint16_t background) {
+  ElementBox dirty;
+  if (bandHeight == 0 || !dirtyArea(elements, count, dirty)) return;
+
+  if (!transferring) {
+    tft.startWrite();
+    transferring = true;
+  }
+
+  // pushImageDMA waits for the previous transfer before queuing the next
+  // one, so the band being composed is never the one on the bus
+  ElementBox clip;
+  int16_t row = dirty.y;
+  while (nextClipBand(dirty, row, bandHeight, clip)) {
+    TFT_eSprite& band = *bands[nextBand];
+    uint16_t* pixels = (uint16_t*)band.getPointer();
+    drawElementsInArea(band, elements, count, clip, clip.y, background);
+
+    // DMA needs the visible span as one contiguous block, pack the rows
+    if (clip.w < band.width()) {
+      for (int16_t r = 0; r < clip.h; r++) {
+        memmove(pixels + r * clip.w, pixels + r * band.width() + clip.x, clip.w * sizeof(uint16_t));
+      }
+    }
+    tft.pushImageDMA(clip.x, clip.y, clip.w, clip.h, pixels);
+
+    nextBand ^= 1;
+    bandStats.bands++;
+    bandStats.pixels += clip.w * clip.h;
+  }
+
+  commitElements(elements, count);
+  bandStats.frames++;
+}
+
+bool BandRenderer::busy() {
+  if (transferring && !tft.dmaBusy()) {
+    tft.endWrite();
+    transferring = false;
+  }
+  return transferring;
+}
+
+void BandRenderer::finish() {
+  if (!transferring) return;
+  tft.dmaWait();
+  tft.endWrite();
+  transferring = false;
+}
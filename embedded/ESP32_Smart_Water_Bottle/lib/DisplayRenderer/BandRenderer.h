@@ -0,0 +1,48 @@
+#ifndef BANDRENDERER_H
+#define BANDRENDERER_H
+
+#include "DirtyRenderer.h"
+
+// Rows per band buffer, two full-width bands take 2 * 240 * 40 * 2 = 38.4 KB
+const int16_t BAND_HEIGHT = 40;
+
+struct BandStats {
+  uint32_t frames;
+  uint32_t bands;
+  uint32_t pixels;
+};
+
+// Double-buffered renderer: the rows touched by dirty elements are composed
+// into two alternating sprite bands and pushed to the panel by DMA, so the
+// CPU composes the next band while the previous one is on the SPI bus.
+class BandRenderer {
+public:
+  explicit BandRenderer(TFT_eSPI& tft);
+
+  // Allocates both band buffers and the DMA channel, false if either fails
+  bool begin(int16_t bandHeight = BAND_HEIGHT);
+
+  // Composes and queues the dirty rows. Returns once the last band is
+  // queued, without waiting for its transfer.
+  void render(TextElement* elements, size_t count, uint16_t background);
+
+  // True while a transfer is still running, ends the SPI transaction once done
+  bool busy();
+
+  // Waits for the last transfer, needed before drawing to the panel directly
+  void finish();
+
+  const BandStats& stats() const { return bandStats; }
+
+private:
+  TFT_eSPI& tft;
+  TFT_eSprite bandA;
+  TFT_eSprite bandB;
+  TFT_eSprite* bands[2];
+  int16_t bandHeight;
+  uint8_t nextBand;
+  bool transferring;
+  BandStats bandStats;
+};
+
+#endif
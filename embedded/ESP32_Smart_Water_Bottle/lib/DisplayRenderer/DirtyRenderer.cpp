@@ -0,0 +1,210 @@
+#include "DirtyRenderer.h"
+#include "RoundClip.h"
+#include <string.h>
+#ifdef UI_FONT_SUBSET
+// Generated at build time by scripts/font_subset.py
+#include <UiFont.h>
+#endif
+
+static ElementBox textBox(const TextElement& element) {
+  ElementBox box;
+  box.w = elementTextWidth(element.text, element.textSize);
+  box.h = box.w > 0 ? 8 * element.textSize : 0;
+  box.x = element.centerX - box.w / 2;
+  box.y = element.y;
+  return box;
+}
+
+#ifdef UI_FONT_SUBSET
+// Column bits of a character, empty for characters outside the subset
+static const uint8_t* glyphColumns(char c) {
+  static const uint8_t EMPTY[5] = { 0, 0, 0, 0, 0 };
+  uint8_t code = (uint8_t)c;
+  if (code < 0x20 || code > 0x7E || UI_FONT_INDEX[code - 0x20] == 0xFF) return EMPTY;
+  return UI_FONT_GLYPHS[UI_FONT_INDEX[code - 0x20]];
+}
+
+// Pixel of the 6x8 character cell, the sixth column is the gap
+static bool glyphPixel(const uint8_t* columns, int col, int row) {
+  return col < 5 && (columns[col] >> row) & 1;
+}
+#endif
+
+// Draws text on the panel. With the font subset the whole box goes out as
+// one address window, row by row, instead of one fillRect per font pixel.
+static void drawTextDirect(TFT_eSPI& tft, const TextElement& element, const ElementBox& box, uint16_t background) {
+#ifdef UI_FONT_SUBSET
+  static uint16_t row[ELEMENT_TEXT_SIZE * 6 * 4];
+  int16_t cellWidth = 6 * element.textSize;
+  if (box.w > (int16_t)(sizeof(row) / sizeof(row[0]))) return;
+
+  tft.startWrite();
+  tft.setAddrWindow(box.x, box.y, box.w, box.h);
+  for (int16_t y = 0; y < box.h; y++) {
+    int fontRow = y / element.textSize;
+    for (int16_t x = 0; x < box.w; x++) {
+      const uint8_t* columns = glyphColumns(element.text[x / cellWidth]);
+      row[x] = glyphPixel(columns, (x % cellWidth) / element.textSize, fontRow) ? element.color : background;
+    }
+    tft.pushColors(row, box.w, true);
+  }
+  tft.endWrite();
+#else
+  tft.setTextSize(element.textSize);
+  tft.setTextColor(element.color, background);
+  tft.setCursor(box.x, box.y);
+  tft.print(element.text);
+#endif
+}
+
+// Draws text into an off-screen canvas, where per pixel fills only cost RAM
+static void drawTextCanvas(TFT_eSPI& canvas, const TextElement& element, int16_t x, int16_t y, uint16_t color, uint16_t background) {
+#ifdef UI_FONT_SUBSET
+  uint8_t size = element.textSize;
+  canvas.fillRect(x, y, elementTextWidth(element.text, size), 8 * size, background);
+  for (const char* c = element.text; *c != '\0'; c++, x += 6 * size) {
+    const uint8_t* columns = glyphColumns(*c);
+    for (int col = 0; col < 5; col++) {
+      for (int fontRow = 0; fontRow < 8; fontRow++) {
+        if (glyphPixel(columns, col, fontRow)) canvas.fillRect(x + col * size, y + fontRow * size, size, size, color);
+      }
+    }
+  }
+#else
+  canvas.setTextSize(element.textSize);
+  canvas.setTextColor(color, background);
+  canvas.setCursor(x, y);
+  canvas.print(element.text);
+#endif
+}
+
+static bool intersects(const ElementBox& a, const ElementBox& b) {
+  if (a.w == 0 || b.w == 0) return false;
+  return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+// Fills rect and marks clean elements overlapping it for a redraw
+static void clearRect(TFT_eSPI& tft, const ElementBox& rect, TextElement* elements, size_t count, uint16_t background) {
+  if (rect.w <= 0 || rect.h <= 0) return;
+  fillClipped(tft, rect, background);
+
+  for (size_t i = 0; i < count; i++) {
+    if (!elements[i].dirty && intersects(rect, elements[i].painted)) {
+      elements[i].dirty = true;
+    }
+  }
+}
+
+void initElement(TextElement& element, int16_t centerX, int16_t y, uint8_t textSize) {
+  element.centerX = centerX;
+  element.y = y;
+  element.textSize = textSize;
+  element.text[0] = '\0';
+  element.color = 0;
+  element.painted = { 0, 0, 0, 0 };
+  element.dirty = false;
+}
+
+void setElementText(TextElement& element, const char* text, uint16_t color) {
+  if (strncmp(element.text, text, ELEMENT_TEXT_SIZE) == 0 && element.color == color) return;
+
+  strncpy(element.text, text, ELEMENT_TEXT_SIZE - 1);
+  element.text[ELEMENT_TEXT_SIZE - 1] = '\0';
+  element.color = color;
+  element.dirty = true;
+}
+
+int16_t elementTextWidth(const char* text, uint8_t textSize) {
+  return strlen(text) * 6 * textSize;
+}
+
+void renderElements(TFT_eSPI& tft, TextElement* elements, size_t count, uint16_t background) {
+  // Pass 1: clear what the new text will not paint over. Elements have a
+  // fixed row, so only the strips left and right of the new box remain.
+  for (size_t i = 0; i < count; i++) {
+    TextElement& element = elements[i];
+    if (!element.dirty || element.painted.w == 0) continue;
+
+    ElementBox old = element.painted;
+    ElementBox next = textBox(element);
+    if (next.w == 0) {
+      clearRect(tft, old, elements, count, background);
+    } else {
+      ElementBox left = { old.x, old.y, (int16_t)(next.x - old.x), old.h };
+      ElementBox right = { (int16_t)(next.x + next.w), old.y, (int16_t)(old.x + old.w - next.x - next.w), old.h };
+      clearRect(tft, left, elements, count, background);
+      clearRect(tft, right, elements, count, background);
+    }
+    element.painted.w = 0;
+  }
+
+  // Pass 2: draw the new text, the background color fills the whole box
+  for (size_t i = 0; i < count; i++) {
+    TextElement& element = elements[i];
+    if (!element.dirty) continue;
+
+    ElementBox box = textBox(element);
+    if (box.w > 0) {
+      drawTextDirect(tft, element, box, background);
+    }
+    element.painted = box;
+    element.dirty = false;
+  }
+}
+
+bool dirtyArea(const TextElement* elements, size_t count, ElementBox& area) {
+  int16_t left = 0, top = 0, right = 0, bottom = 0;
+  bool found = false;
+  for (size_t i = 0; i < count; i++) {
+    if (!elements[i].dirty) continue;
+
+    ElementBox boxes[2] = { elements[i].painted, textBox(elements[i]) };
+    for (int b = 0; b < 2; b++) {
+      if (boxes[b].w == 0) continue;
+      if (!found || boxes[b].x < left) left = boxes[b].x;
+      if (!found || boxes[b].y < top) top = boxes[b].y;
+      if (!found || boxes[b].x + boxes[b].w > right) right = boxes[b].x + boxes[b].w;
+      if (!found || boxes[b].y + boxes[b].h > bottom) bottom = boxes[b].y + boxes[b].h;
+      found = true;
+    }
+  }
+  area = { left, top, (int16_t)(right - left), (int16_t)(bottom - top) };
+  return found;
+}
+
+void drawElementsInArea(TFT_eSPI& canvas, const TextElement* elements, size_t count,
+                        const ElementBox& area, int16_t originY, uint16_t background,
+                        const uint16_t* palette, uint8_t paletteSize) {
+  uint16_t fill = palette != nullptr ? paletteIndex(background, palette, paletteSize) : background;
+  canvas.fillRect(area.x, area.y - originY, area.w, area.h, fill);
+
+  for (size_t i = 0; i < count; i++) {
+    ElementBox box = textBox(elements[i]);
+    if (!intersects(box, area)) continue;
+
+    uint16_t color = palette != nullptr ? paletteIndex(elements[i].color, palette, paletteSize) : elements[i].color;
+    drawTextCanvas(canvas, elements[i], box.x, box.y - originY, color, fill);
+  }
+}
+
+uint8_t paletteIndex(uint16_t color, const uint16_t* palette, uint8_t paletteSize) {
+  for (uint8_t i = 0; i < paletteSize; i++) {
+    if (palette[i] == color) return i;
+  }
+  return 0;
+}
+
+void commitElements(TextElement* elements, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (!elements[i].dirty) continue;
+    elements[i].painted = textBox(elements[i]);
+    elements[i].dirty = false;
+  }
+}
+
+void invalidateElements(TextElement* elements, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    elements[i].painted.w = 0;
+    elements[i].dirty = elements[i].text[0] != '\0';
+  }
+}
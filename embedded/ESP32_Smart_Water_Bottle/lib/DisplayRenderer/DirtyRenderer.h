@@ -0,0 +1,62 @@
+#ifndef DIRTYRENDERER_H
+#define DIRTYRENDERER_H
+
+#include <TFT_eSPI.h>
+
+const size_t ELEMENT_TEXT_SIZE = 24;
+
+// Bounding box on the panel, an empty box has a width of 0
+struct ElementBox {
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+};
+
+// One line of centered text on the display. Each element remembers the
+// box it last painted, so a change only repaints that box and the new one.
+struct TextElement {
+  int16_t centerX;
+  int16_t y;
+  uint8_t textSize;
+  char text[ELEMENT_TEXT_SIZE];
+  uint16_t color;
+  ElementBox painted;
+  bool dirty;
+};
+
+void initElement(TextElement& element, int16_t centerX, int16_t y, uint8_t textSize);
+
+// Updates text and color, marks the element dirty only if something changed
+void setElementText(TextElement& element, const char* text, uint16_t color);
+
+// Width of a text in the built-in 6x8 font, 12 px per character at size 2
+int16_t elementTextWidth(const char* text, uint8_t textSize);
+
+// Repaints dirty elements: first clears the parts of their old boxes the new
+// text will not cover, then draws the new text with a solid background.
+// Clean elements touched by a cleared area are redrawn as well.
+void renderElements(TFT_eSPI& tft, TextElement* elements, size_t count, uint16_t background);
+
+// Bounding box of the old and new boxes of dirty elements, returns false
+// if nothing is dirty
+bool dirtyArea(const TextElement* elements, size_t count, ElementBox& area);
+
+// Redraws area of an off-screen canvas whose first row is originY: fills it
+// with the background, then draws every element that overlaps it. Pixels
+// outside area are left alone. With a palette, colors are written as
+// palette indices.
+void drawElementsInArea(TFT_eSPI& canvas, const TextElement* elements, size_t count,
+                        const ElementBox& area, int16_t originY, uint16_t background,
+                        const uint16_t* palette = nullptr, uint8_t paletteSize = 0);
+
+// Index of a color in a palette, 0 if the palette does not contain it
+uint8_t paletteIndex(uint16_t color, const uint16_t* palette, uint8_t paletteSize);
+
+// Marks dirty elements as painted with their current text
+void commitElements(TextElement* elements, size_t count);
+
+// Forgets what is on the panel, e.g. after a full screen fill
+void invalidateElements(TextElement* elements, size_t count);
+
+#endif
@@ -0,0 +1,34 @@
+#include "DisplayPower.h"
+
+void DisplayPowerPolicy::wake(uint32_t nowMs) {
+  lastWakeMs = nowMs;
+  update(nowMs);
+}
+
+DisplayPowerState DisplayPowerPolicy::update(uint32_t nowMs) {
+  timeInState[currentState] += nowMs - lastUpdateMs;
+  lastUpdateMs = nowMs;
+
+  uint32_t idle = nowMs - lastWakeMs;
+  if (idle >= config.sleepAfterMs) {
+    currentState = DISPLAY_SLEEP;
+  } else if (idle >= config.dimAfterMs) {
+    currentState = DISPLAY_DIM;
+  } else {
+    currentState = DISPLAY_ON;
+  }
+  return currentState;
+}
+
+void DisplayPowerPolicy::recordWakeLatency(uint32_t latencyUs) {
+  wakeCount++;
+  totalWakeUs += latencyUs;
+  if (latencyUs > maxWakeUs) maxWakeUs = latencyUs;
+}
+
+void DisplayPowerPolicy::resetStats() {
+  for (size_t i = 0; i < DISPLAY_POWER_STATES; i++) timeInState[i] = 0;
+  wakeCount = 0;
+  totalWakeUs = 0;
+  maxWakeUs = 0;
+}
@@ -0,0 +1,95 @@
+#ifndef DISPLAYPOWER_H
+#define DISPLAYPOWER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// GC9A01 commands for the panel power states
+const uint8_t PANEL_CMD_SLEEP_IN = 0x10;
+const uint8_t PANEL_CMD_SLEEP_OUT = 0x11;
+const uint8_t PANEL_CMD_DISPLAY_OFF = 0x28;
+const uint8_t PANEL_CMD_DISPLAY_ON = 0x29;
+// After SLEEP_OUT the panel takes 5 ms before the next command, and must
+// stay awake 120 ms before the next SLEEP_IN. After SLEEP_IN it needs
+// 120 ms before it takes a SLEEP_OUT.
+const uint32_t PANEL_SLEEP_OUT_DELAY_MS = 5;
+const uint32_t PANEL_MIN_AWAKE_MS = 120;
+const uint32_t PANEL_MIN_ASLEEP_MS = 120;
+
+// Keeps the panel's sleep commands to those timings. The panel is awake
+// after power-on, so before the first command nothing is held back.
+class PanelSleepGuard {
+public:
+  void sleepIn(uint32_t nowMs) {
+    sleepInMs = nowMs;
+    sleptIn = true;
+  }
+  void sleepOut(uint32_t nowMs) {
+    sleepOutMs = nowMs;
+    sleptOut = true;
+  }
+
+  bool canSleepIn(uint32_t nowMs) const { return !sleptOut || nowMs - sleepOutMs >= PANEL_MIN_AWAKE_MS; }
+  bool canSleepOut(uint32_t nowMs) const { return !sleptIn || nowMs - sleepInMs >= PANEL_MIN_ASLEEP_MS; }
+  // Whether the panel takes commands again after the last SLEEP_OUT
+  bool awake(uint32_t nowMs) const { return !sleptOut || nowMs - sleepOutMs >= PANEL_SLEEP_OUT_DELAY_MS; }
+
+private:
+  uint32_t sleepInMs = 0;
+  uint32_t sleepOutMs = 0;
+  bool sleptIn = false;
+  bool sleptOut = false;
+};
+
+// ON -> DIM after dimAfterMs without a wake reason, DIM -> SLEEP after
+// sleepAfterMs. Any wake reason goes back to ON.
+enum DisplayPowerState : uint8_t {
+  DISPLAY_ON,
+  DISPLAY_DIM,
+  DISPLAY_SLEEP,
+  DISPLAY_POWER_STATES
+};
+
+struct DisplayPowerConfig {
+  uint32_t dimAfterMs;
+  uint32_t sleepAfterMs;
+  // Backlight duty cycles out of 255
+  uint8_t onLevel;
+  uint8_t dimLevel;
+};
+
+// Decides the display power state from the time since the last wake
+// reason and keeps the time spent in each state and the wake latency.
+// Time only comes from the caller, so it also runs on a host.
+class DisplayPowerPolicy {
+public:
+  explicit DisplayPowerPolicy(const DisplayPowerConfig& config) : config(config) {}
+
+  const DisplayPowerConfig& configuration() const { return config; }
+
+  // Flow, a BLE state change or a reminder escalation
+  void wake(uint32_t nowMs);
+  DisplayPowerState update(uint32_t nowMs);
+  DisplayPowerState state() const { return currentState; }
+
+  // Time from a wake reason to the first visible pixel of a sleeping panel
+  void recordWakeLatency(uint32_t latencyUs);
+
+  uint32_t stateMs(DisplayPowerState state) const { return timeInState[state]; }
+  uint32_t wakes() const { return wakeCount; }
+  uint32_t meanWakeLatencyUs() const { return wakeCount > 0 ? (uint32_t)(totalWakeUs / wakeCount) : 0; }
+  uint32_t maxWakeLatencyUs() const { return maxWakeUs; }
+  void resetStats();
+
+private:
+  DisplayPowerConfig config;
+  DisplayPowerState currentState = DISPLAY_ON;
+  uint32_t lastWakeMs = 0;
+  uint32_t lastUpdateMs = 0;
+  uint32_t timeInState[DISPLAY_POWER_STATES] = {};
+  uint32_t wakeCount = 0;
+  uint64_t totalWakeUs = 0;
+  uint32_t maxWakeUs = 0;
+};
+
+#endif
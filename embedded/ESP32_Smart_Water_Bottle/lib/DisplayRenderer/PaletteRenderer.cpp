@@ -0,0 +1,44 @@
+#include "PaletteRenderer.h"
+#include "RoundClip.h"
+#include <string.h>
+
+PaletteRenderer::PaletteRenderer(TFT_eSPI& tft) : tft(tft), frame(&tft) {
+  palette = nullptr;
+  paletteSize = 0;
+  memset(&paletteStats, 0, sizeof(paletteStats));
+}
+
+bool PaletteRenderer::begin(const uint16_t* colors, uint8_t colorCount) {
+  frame.setColorDepth(4);
+  if (frame.createSprite(tft.width(), tft.height()) == nullptr) return false;
+
+  palette = colors;
+  paletteSize = colorCount > PALETTE_SIZE ? PALETTE_SIZE : colorCount;
+  frame.createPalette((uint16_t*)palette, paletteSize);
+  frame.fillSprite(0);
+  return true;
+}
+
+size_t PaletteRenderer::bufferSize() const {
+  return frame.created() ? (size_t)frame.width() * frame.height() / 2 : 0;
+}
+
+void PaletteRenderer::render(TextElement* elements, size_t count, uint16_t background) {
+  ElementBox dirty;
+  if (!frame.created() || !dirtyArea(elements, count, dirty)) return;
+
+  drawElementsInArea(frame, elements, count, dirty, 0, background, palette, paletteSize);
+  commitElements(elements, count);
+  pushArea(dirty);
+  paletteStats.frames++;
+}
+
+void PaletteRenderer::pushArea(const ElementBox& area) {
+  // Only the visible part of the area goes out
+  ElementBox clip;
+  int16_t row = area.y;
+  while (nextClipBand(area, row, area.h, clip)) {
+    frame.pushSprite(clip.x, clip.y, clip.x, clip.y, clip.w, clip.h);
+    paletteStats.pixels += clip.w * clip.h;
+  }
+}
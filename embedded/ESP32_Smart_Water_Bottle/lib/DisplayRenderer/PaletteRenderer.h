@@ -0,0 +1,48 @@
+#ifndef PALETTERENDERER_H
+#define PALETTERENDERER_H
+
+#include "DirtyRenderer.h"
+
+// Colors a 4 bpp canvas can hold
+const uint8_t PALETTE_SIZE = 16;
+
+struct PaletteStats {
+  uint32_t frames;
+  uint32_t pixels;
+};
+
+// Full-screen framebuffer with 4 bits per pixel, 240 * 240 / 2 = 28.8 KB.
+// Every frame is composed in RAM and the visible part of the changed area
+// is pushed; the driver looks up each pixel in the palette while it
+// pushes, so the panel never shows a half drawn frame.
+class PaletteRenderer {
+public:
+  explicit PaletteRenderer(TFT_eSPI& tft);
+
+  // Allocates the framebuffer, false if there is not enough RAM. Element
+  // colors missing from the palette are drawn with palette entry 0.
+  bool begin(const uint16_t* palette, uint8_t paletteSize);
+
+  void render(TextElement* elements, size_t count, uint16_t background);
+
+  // Framebuffer for other widgets, colors are palette indices
+  TFT_eSPI& canvas() { return frame; }
+  uint8_t colorIndex(uint16_t color) const { return paletteIndex(color, palette, paletteSize); }
+
+  // Pushes the visible part of an area drawn through canvas()
+  void pushArea(const ElementBox& area);
+
+  // Framebuffer size in bytes, 0 if it is not allocated
+  size_t bufferSize() const;
+
+  const PaletteStats& stats() const { return paletteStats; }
+
+private:
+  TFT_eSPI& tft;
+  TFT_eSprite frame;
+  const uint16_t* palette;
+  uint8_t paletteSize;
+  PaletteStats paletteStats;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "ProgressRing.h"
+#include "TrigTable.h"
+
+void ProgressRing::begin(int16_t x, int16_t y, int16_t outer, int16_t thickness) {
+  centerX = x;
+  centerY = y;
+  outerRadius = outer;
+  innerRadius = outer - thickness;
+  targetSteps = 0;
+  paintedSteps = 0;
+  visible = false;
+  trackPainted = false;
+}
+
+void ProgressRing::setProgress(int32_t current, int32_t goal) {
+  if (goal <= 0 || current <= 0) {
+    targetSteps = 0;
+  } else if (current >= goal) {
+    targetSteps = RING_STEPS;
+  } else {
+    targetSteps = (int16_t)(current * RING_STEPS / goal);
+  }
+}
+
+void ProgressRing::setVisible(bool show) {
+  visible = show;
+}
+
+bool ProgressRing::needsUpdate() const {
+  if (!visible) return trackPainted;
+  return !trackPainted || paintedSteps != targetSteps;
+}
+
+void ProgressRing::point(int16_t step, int16_t radius, int16_t& x, int16_t& y) const {
+  // Step 0 points up, angles grow clockwise
+  x = centerX + (int16_t)(((int32_t)radius * sinDegQ14(step) + 8192) >> 14);
+  y = centerY - (int16_t)(((int32_t)radius * cosDegQ14(step) + 8192) >> 14);
+}
+
+// Fills the ring segments [from, to) as two triangles each
+void ProgressRing::drawSegments(TFT_eSPI& canvas, int16_t from, int16_t to, uint16_t color, ElementBox& changed) {
+  int16_t left = changed.w > 0 ? changed.x : 32767;
+  int16_t top = changed.w > 0 ? changed.y : 32767;
+  int16_t right = changed.w > 0 ? changed.x + changed.w : -32768;
+  int16_t bottom = changed.w > 0 ? changed.y + changed.h : -32768;
+
+  int16_t outerX, outerY, innerX, innerY;
+  point(from, outerRadius, outerX, outerY);
+  point(from, innerRadius, innerX, innerY);
+  for (int16_t step = from; step < to; step++) {
+    int16_t nextOuterX, nextOuterY, nextInnerX, nextInnerY;
+    point(step + 1, outerRadius, nextOuterX, nextOuterY);
+    point(step + 1, innerRadius, nextInnerX, nextInnerY);
+
+    canvas.fillTriangle(outerX, outerY, nextOuterX, nextOuterY, innerX, innerY, color);
+    canvas.fillTriangle(innerX, innerY, nextOuterX, nextOuterY, nextInnerX, nextInnerY, color);
+
+    int16_t xs[4] = { outerX, nextOuterX, innerX, nextInnerX };
+    int16_t ys[4] = { outerY, nextOuterY, innerY, nextInnerY };
+    for (int i = 0; i < 4; i++) {
+      if (xs[i] < left) left = xs[i];
+      if (xs[i] + 1 > right) right = xs[i] + 1;
+      if (ys[i] < top) top = ys[i];
+      if (ys[i] + 1 > bottom) bottom = ys[i] + 1;
+    }
+
+    outerX = nextOuterX;
+    outerY = nextOuterY;
+    innerX = nextInnerX;
+    innerY = nextInnerY;
+  }
+  if (right > left) changed = { left, top, (int16_t)(right - left), (int16_t)(bottom - top) };
+}
+
+bool ProgressRing::update(TFT_eSPI& canvas, uint16_t fillColor, uint16_t trackColor, uint16_t background, ElementBox& changed) {
+  changed = { 0, 0, 0, 0 };
+  if (!needsUpdate()) return false;
+
+  if (!visible) {
+    drawSegments(canvas, 0, RING_STEPS, background, changed);
+    trackPainted = false;
+    paintedSteps = 0;
+    return true;
+  }
+
+  // First frame after showing: the unfilled part becomes the track
+  if (!trackPainted) {
+    drawSegments(canvas, paintedSteps, RING_STEPS, trackColor, changed);
+    trackPainted = true;
+  }
+
+  if (paintedSteps < targetSteps) {
+    int16_t next = paintedSteps + RING_ANIMATION_STEPS < targetSteps ? paintedSteps + RING_ANIMATION_STEPS : targetSteps;
+    drawSegments(canvas, paintedSteps, next, fillColor, changed);
+    paintedSteps = next;
+  } else if (paintedSteps > targetSteps) {
+    int16_t next = paintedSteps - RING_ANIMATION_STEPS > targetSteps ? paintedSteps - RING_ANIMATION_STEPS : targetSteps;
+    drawSegments(canvas, next, paintedSteps, trackColor, changed);
+    paintedSteps = next;
+  }
+  return true;
+}
@@ -0,0 +1,45 @@
+#ifndef PROGRESSRING_H
+#define PROGRESSRING_H
+
+#include "DirtyRenderer.h"
+
+// One ring step per degree, starting at 12 o'clock and running clockwise
+const int16_t RING_STEPS = 360;
+// Most steps the fill moves per frame while animating
+const int16_t RING_ANIMATION_STEPS = 12;
+
+// Progress ring along the edge of the round panel. It remembers how far it
+// has been painted and each frame only draws the segments between that and
+// the target, so a change of a few percent costs a few segments.
+class ProgressRing {
+public:
+  void begin(int16_t centerX, int16_t centerY, int16_t outerRadius, int16_t thickness);
+
+  // Target fill from intake and goal, the ring animates towards it
+  void setProgress(int32_t current, int32_t goal);
+  // Hidden rings are erased with the background on the next update
+  void setVisible(bool visible);
+
+  // True while the painted ring differs from the target
+  bool needsUpdate() const;
+
+  // Paints the next animation step. Colors are whatever the canvas expects
+  // (RGB565 or palette indices). changed receives the bounding box of what
+  // was drawn; returns false if nothing was drawn.
+  bool update(TFT_eSPI& canvas, uint16_t fillColor, uint16_t trackColor, uint16_t background, ElementBox& changed);
+
+private:
+  void drawSegments(TFT_eSPI& canvas, int16_t from, int16_t to, uint16_t color, ElementBox& changed);
+  void point(int16_t step, int16_t radius, int16_t& x, int16_t& y) const;
+
+  int16_t centerX = 0;
+  int16_t centerY = 0;
+  int16_t outerRadius = 0;
+  int16_t innerRadius = 0;
+  int16_t targetSteps = 0;
+  int16_t paintedSteps = 0;
+  bool visible = false;
+  bool trackPainted = false;
+};
+
+#endif
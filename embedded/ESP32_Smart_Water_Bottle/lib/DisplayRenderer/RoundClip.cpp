@@ -0,0 +1,110 @@
+#include "RoundClip.h"
+
+// Bytes of CASET/RASET/RAMWR needed for every address window
+static const int32_t WINDOW_COST = 11;
+
+static bool clipEnabled = true;
+static uint8_t halfSpans[ROUND_PANEL_DIAMETER / 2];
+static bool halfSpansReady = false;
+
+static uint32_t isqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > value) bit >>= 2;
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Visible pixels right of the center for each row of the upper half.
+// Pixel k (counted from the center) is visible if (2k + 1)^2 + dy^2 <= D^2.
+static void buildHalfSpans() {
+  const int32_t diameter = ROUND_PANEL_DIAMETER;
+  for (int32_t y = 0; y < diameter / 2; y++) {
+    int32_t dy = 2 * y + 1 - diameter;
+    halfSpans[y] = (isqrt(diameter * diameter - dy * dy) + 1) / 2;
+  }
+  halfSpansReady = true;
+}
+
+void visibleSpan(int16_t y, int16_t& x0, int16_t& w) {
+  if (y < 0 || y >= ROUND_PANEL_DIAMETER) {
+    x0 = 0;
+    w = 0;
+    return;
+  }
+  if (!clipEnabled) {
+    x0 = 0;
+    w = ROUND_PANEL_DIAMETER;
+    return;
+  }
+  if (!halfSpansReady) buildHalfSpans();
+
+  int16_t row = y < ROUND_PANEL_DIAMETER / 2 ? y : ROUND_PANEL_DIAMETER - 1 - y;
+  int16_t half = halfSpans[row];
+  x0 = ROUND_PANEL_DIAMETER / 2 - half;
+  w = 2 * half;
+}
+
+// Visible part of one rect row as [left, right), empty if left >= right
+static void rowSpan(const ElementBox& rect, int16_t y, int16_t& left, int16_t& right) {
+  int16_t x0, w;
+  visibleSpan(y, x0, w);
+  left = x0 > rect.x ? x0 : rect.x;
+  right = x0 + w < rect.x + rect.w ? x0 + w : rect.x + rect.w;
+}
+
+bool nextClipBand(const ElementBox& rect, int16_t& row, int16_t maxRows, ElementBox& band) {
+  int16_t bottom = rect.y + rect.h;
+  int16_t left = 0, right = 0;
+
+  // Skip rows without visible pixels
+  while (row < bottom) {
+    rowSpan(rect, row, left, right);
+    if (left < right) break;
+    row++;
+  }
+  if (row >= bottom) return false;
+
+  band.x = left;
+  band.y = row;
+  band.w = right - left;
+  band.h = 1;
+  row++;
+
+  while (row < bottom && band.h < maxRows) {
+    rowSpan(rect, row, left, right);
+    if (left >= right) break;
+
+    int16_t mergedLeft = left < band.x ? left : band.x;
+    int16_t mergedRight = right > band.x + band.w ? right : band.x + band.w;
+    int32_t merged = (int32_t)(band.h + 1) * (mergedRight - mergedLeft) * 2;
+    int32_t separate = (int32_t)band.h * band.w * 2 + (right - left) * 2 + WINDOW_COST;
+    if (merged > separate) break;
+
+    band.x = mergedLeft;
+    band.w = mergedRight - mergedLeft;
+    band.h++;
+    row++;
+  }
+  return true;
+}
+
+void fillClipped(TFT_eSPI& tft, const ElementBox& rect, uint32_t color) {
+  ElementBox band;
+  int16_t row = rect.y;
+  while (nextClipBand(rect, row, rect.h, band)) {
+    tft.fillRect(band.x, band.y, band.w, band.h, color);
+  }
+}
+
+void setRoundClip(bool enabled) {
+  clipEnabled = enabled;
+}
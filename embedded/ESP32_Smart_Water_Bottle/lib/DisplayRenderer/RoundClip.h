@@ -0,0 +1,25 @@
+#ifndef ROUNDCLIP_H
+#define ROUNDCLIP_H
+
+#include "DirtyRenderer.h"
+
+// The GC9A01 panel is round: only pixels whose center lies inside the
+// inscribed circle are visible, the corners (about 21%) are never seen.
+const int16_t ROUND_PANEL_DIAMETER = TFT_WIDTH;
+
+// Visible columns [x0, x0 + w) of a panel row, w is 0 outside the panel
+void visibleSpan(int16_t y, int16_t& x0, int16_t& w);
+
+// Splits rect into bands of rows clipped to the circle. Neighbouring rows
+// are merged into one band while the extra corner pixels cost less than a
+// separate address window. Start with row = rect.y; returns false once
+// the whole rect is covered.
+bool nextClipBand(const ElementBox& rect, int16_t& row, int16_t maxRows, ElementBox& band);
+
+// fillRect that only sends the visible part of rect
+void fillClipped(TFT_eSPI& tft, const ElementBox& rect, uint32_t color);
+
+// Turns clipping off to measure its effect, bands then cover whole rows
+void setRoundClip(bool enabled);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef TRIGTABLE_H
+#define TRIGTABLE_H
+
+#include <stdint.h>
+
+// Sine and cosine in whole degrees as Q14 fixed point (16384 = 1.0).
+// The quarter-wave table is computed by the compiler, nothing runs at boot.
+
+constexpr double trigRadians(int degrees) {
+  return degrees * 3.14159265358979323846 / 180.0;
+}
+
+// Taylor series up to x^13, accurate to well below one Q14 step on [0, pi/2]
+constexpr double trigTaylorSin(double x) {
+  return x - x * x * x / 6 + x * x * x * x * x / 120 - x * x * x * x * x * x * x / 5040 +
+         x * x * x * x * x * x * x * x * x / 362880 - x * x * x * x * x * x * x * x * x * x * x / 39916800 +
+         x * x * x * x * x * x * x * x * x * x * x * x * x / 6227020800.0;
+}
+
+constexpr int16_t trigSinQ14(int degrees) {
+  return (int16_t)(trigTaylorSin(trigRadians(degrees)) * 16384 + 0.5);
+}
+
+#define TRIG_ROW(d) trigSinQ14(d), trigSinQ14(d + 1), trigSinQ14(d + 2), trigSinQ14(d + 3), trigSinQ14(d + 4), \
+                    trigSinQ14(d + 5), trigSinQ14(d + 6), trigSinQ14(d + 7), trigSinQ14(d + 8), trigSinQ14(d + 9)
+
+constexpr int16_t QUARTER_SINE_Q14[91] = {
+  TRIG_ROW(0), TRIG_ROW(10), TRIG_ROW(20), TRIG_ROW(30), TRIG_ROW(40),
+  TRIG_ROW(50), TRIG_ROW(60), TRIG_ROW(70), TRIG_ROW(80), trigSinQ14(90)
+};
+
+#undef TRIG_ROW
+
+inline int16_t sinDegQ14(int degrees) {
+  degrees %= 360;
+  if (degrees < 0) degrees += 360;
+  if (degrees <= 90) return QUARTER_SINE_Q14[degrees];
+  if (degrees <= 180) return QUARTER_SINE_Q14[180 - degrees];
+  if (degrees <= 270) return -QUARTER_SINE_Q14[degrees - 180];
+  return -QUARTER_SINE_Q14[360 - degrees];
+}
+
+inline int16_t cosDegQ14(int degrees) {
+  return sinDegQ14(degrees + 90);
+}
+
+#endif
@@ -0,0 +1,43 @@
+#include "VolumeFormat.h"
+
+// Appends text if it fits, keeps the output terminated
+static size_t append(char* out, size_t size, size_t length, const char* text) {
+  while (*text != '\0' && length + 1 < size) {
+    out[length++] = *text++;
+  }
+  if (size > 0) out[length] = '\0';
+  return length;
+}
+
+size_t formatLiters(char* out, size_t size, int32_t ml) {
+  char digits[16];
+  size_t count = 0;
+
+  bool negative = ml < 0;
+  uint32_t tenths = ((negative ? -(int64_t)ml : ml) + 50) / 100;
+
+  // Digits in reverse order: tenth, '.', then the whole liters
+  digits[count++] = '0' + tenths % 10;
+  digits[count++] = '.';
+  uint32_t liters = tenths / 10;
+  do {
+    digits[count++] = '0' + liters % 10;
+    liters /= 10;
+  } while (liters > 0);
+  if (negative && tenths > 0) digits[count++] = '-';
+
+  char text[20];
+  size_t length = 0;
+  while (count > 0) text[length++] = digits[--count];
+  text[length] = '\0';
+
+  length = append(out, size, 0, text);
+  return append(out, size, length, " L");
+}
+
+size_t formatVolumeText(char* out, size_t size, int32_t currentMl, int32_t goalMl) {
+  size_t length = formatLiters(out, size, currentMl);
+  length = append(out, size, length, " / ");
+  if (length + 1 < size) length += formatLiters(out + length, size - length, goalMl);
+  return length;
+}
@@ -0,0 +1,15 @@
+#ifndef VOLUMEFORMAT_H
+#define VOLUMEFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Writes milliliters as liters with one decimal ("1.2 L"), rounded to the
+// nearest 100 ml, without pulling in the float printf code.
+// Returns the length written, output is always terminated.
+size_t formatLiters(char* out, size_t size, int32_t ml);
+
+// "1.2 L / 4.0 L" for the volume line
+size_t formatVolumeText(char* out, size_t size, int32_t currentMl, int32_t goalMl);
+
+#endif
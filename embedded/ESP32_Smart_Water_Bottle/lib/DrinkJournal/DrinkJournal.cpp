@@ -0,0 +1,399 @@
+#include "DrinkJournal.h"
+#include <string.h>
+
+// Sector header: magic, sector number, journal epoch, CRC32 of the first 12 bytes
+static const uint32_t SECTOR_MAGIC = 0x324C4A44;  // "DJL2"
+static const size_t SECTOR_HEADER_SIZE = 16;
+
+// Slot: sequence, timestamp, amountMl, kind, flags, durationMs, peak and
+// mean flow in ml/min, CRC32 of the first 24 bytes
+static const size_t RECORD_SIZE = 28;
+static const uint8_t RECORD_KIND_DRINK = 0x01;
+static const uint8_t RECORD_KIND_ACK = 0x02;
+// Sequence is the last unsynced record it covers, timestamp the clock offset
+static const uint8_t RECORD_KIND_REBASE = 0x03;
+// Stored inverted, so an unused flags byte reads as no flags
+static const uint8_t RECORD_FLAG_UNSYNCED = 0x01;  // Drink record on the boot clock
+static const uint8_t RECORD_FLAG_LOST = 0x02;      // Rebase without an offset
+
+static uint32_t crc32(const uint8_t* data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static void putUint32(uint8_t* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t getUint32(const uint8_t* in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static void putUint16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t getUint16(const uint8_t* in) {
+  return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static bool isErased(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+// Decodes a record slot, returns its kind or 0 if the CRC does not match
+static uint8_t decodeRecord(const uint8_t* slot, JournalRecord& record, uint8_t& flags) {
+  if (crc32(slot, RECORD_SIZE - 4) != getUint32(slot + RECORD_SIZE - 4)) return 0;
+
+  flags = (uint8_t)~slot[15];
+  record.unsynced = (flags & RECORD_FLAG_UNSYNCED) != 0;
+  record.sequence = getUint32(slot);
+  record.timestampMs = (uint64_t)getUint32(slot + 4) | ((uint64_t)getUint32(slot + 8) << 32);
+  record.amountMl = getUint16(slot + 12);
+  record.durationMs = getUint32(slot + 16);
+  record.peakFlowMlPerMin = getUint16(slot + 20);
+  record.meanFlowMlPerMin = getUint16(slot + 22);
+  return slot[14];
+}
+
+DrinkJournal::DrinkJournal(FlashStore& flash) : flash(flash) {
+  sectorCount = 0;
+  slotCount = 0;
+  headSector = 0;
+  highestSectorNumber = 0;
+  nextSequence = 1;
+  ackedSequence = 0;
+  journalEpoch = 0;
+  memset(&journalStats, 0, sizeof(journalStats));
+  drainCursor.sectorNumber = 0;
+  rebaseCount = 0;
+  forgottenSequence = 0;
+  lastUnsyncedSequence = 0;
+}
+
+bool DrinkJournal::begin(uint32_t newEpoch) {
+  sectorCount = flash.sectorCount();
+  if (sectorCount > JOURNAL_MAX_SECTORS) sectorCount = JOURNAL_MAX_SECTORS;
+  if (sectorCount < 2 || flash.sectorSize() < SECTOR_HEADER_SIZE + RECORD_SIZE) return false;
+  slotCount = (flash.sectorSize() - SECTOR_HEADER_SIZE) / RECORD_SIZE;
+
+  highestSectorNumber = 0;
+  nextSequence = 1;
+  ackedSequence = 0;
+  memset(&journalStats, 0, sizeof(journalStats));
+  drainCursor.sectorNumber = 0;
+  rebaseCount = 0;
+  forgottenSequence = 0;
+  lastUnsyncedSequence = 0;
+
+  // The sector with the highest number is the current write head.
+  // Without any valid sector the first append opens sector 0.
+  headSector = sectorCount - 1;
+  for (size_t sector = 0; sector < sectorCount; sector++) {
+    if (!scanSector(sector)) return false;
+    if (sectors[sector].sectorNumber > highestSectorNumber) {
+      highestSectorNumber = sectors[sector].sectorNumber;
+      headSector = sector;
+    }
+  }
+
+  if (ackedSequence >= nextSequence) {
+    nextSequence = ackedSequence + 1;
+  }
+
+  // All sectors carry the same epoch, take it from the head
+  journalEpoch = newEpoch;
+  if (highestSectorNumber > 0) {
+    uint8_t epoch[4];
+    if (!flash.read(headSector * flash.sectorSize() + 8, epoch, sizeof(epoch))) return false;
+    journalEpoch = getUint32(epoch);
+  }
+  return true;
+}
+
+bool DrinkJournal::scanSector(size_t sector) {
+  SectorInfo& info = sectors[sector];
+  info.sectorNumber = 0;
+  info.usedSlots = 0;
+  info.firstSequence = 0;
+  info.lastSequence = 0;
+  info.erased = false;
+
+  uint8_t header[SECTOR_HEADER_SIZE];
+  if (!flash.read(sector * flash.sectorSize(), header, sizeof(header))) return false;
+
+  // Erased, torn or foreign sectors are erased again before they are used
+  if (getUint32(header) != SECTOR_MAGIC || crc32(header, 12) != getUint32(header + 12)) {
+    return true;
+  }
+  info.sectorNumber = getUint32(header + 4);
+
+  uint8_t slot[RECORD_SIZE];
+  for (size_t index = 0; index < slotCount; index++) {
+    if (!flash.read(slotAddress(sector, index), slot, RECORD_SIZE)) return false;
+    if (isErased(slot, RECORD_SIZE)) break;
+
+    // Torn slots stay occupied, appending continues after them
+    info.usedSlots = index + 1;
+
+    JournalRecord record;
+    uint8_t flags;
+    uint8_t kind = decodeRecord(slot, record, flags);
+    if (kind == RECORD_KIND_DRINK) {
+      if (info.firstSequence == 0) info.firstSequence = record.sequence;
+      info.lastSequence = record.sequence;
+      if (record.sequence >= nextSequence) nextSequence = record.sequence + 1;
+      if (record.unsynced && record.sequence > lastUnsyncedSequence) lastUnsyncedSequence = record.sequence;
+    } else if (kind == RECORD_KIND_ACK) {
+      if (record.sequence > ackedSequence) ackedSequence = record.sequence;
+    } else if (kind == RECORD_KIND_REBASE) {
+      Rebase rebase = { record.sequence, (flags & RECORD_FLAG_LOST) == 0, (int64_t)record.timestampMs };
+      addRebase(rebase);
+    } else {
+      journalStats.tornRecords++;
+    }
+  }
+  return true;
+}
+
+size_t DrinkJournal::slotAddress(size_t sector, size_t slot) const {
+  return sector * flash.sectorSize() + SECTOR_HEADER_SIZE + slot * RECORD_SIZE;
+}
+
+bool DrinkJournal::eraseSector(size_t sector) {
+  if (!flash.eraseSector(sector)) return false;
+  journalStats.sectorErases++;
+
+  SectorInfo& info = sectors[sector];
+  info.sectorNumber = 0;
+  info.usedSlots = 0;
+  info.firstSequence = 0;
+  info.lastSequence = 0;
+  info.erased = true;
+  return true;
+}
+
+bool DrinkJournal::openNextSector() {
+  size_t next = (headSector + 1) % sectorCount;
+  SectorInfo& info = sectors[next];
+
+  // Ring is full: the oldest sector still holds undelivered events, drop them
+  if (info.sectorNumber != 0 && info.lastSequence > ackedSequence) {
+    uint32_t firstPending = info.firstSequence > ackedSequence ? info.firstSequence : ackedSequence + 1;
+    journalStats.droppedRecords += info.lastSequence - firstPending + 1;
+    ackedSequence = info.lastSequence;
+  }
+
+  if (!info.erased && !eraseSector(next)) return false;
+
+  uint8_t header[SECTOR_HEADER_SIZE];
+  putUint32(header, SECTOR_MAGIC);
+  putUint32(header + 4, highestSectorNumber + 1);
+  putUint32(header + 8, journalEpoch);
+  putUint32(header + 12, crc32(header, 12));
+  info.erased = false;
+  if (!flash.write(next * flash.sectorSize(), header, sizeof(header))) return false;
+
+  highestSectorNumber++;
+  headSector = next;
+  info.sectorNumber = highestSectorNumber;
+
+  // Checkpoint the acknowledgement so erasing older sectors never loses it
+  if (ackedSequence > 0) {
+    return writeAck(ackedSequence);
+  }
+  return true;
+}
+
+bool DrinkJournal::writeAck(uint32_t sequence) {
+  JournalRecord record = {};
+  record.sequence = sequence;
+  return writeRecord(RECORD_KIND_ACK, record, 0);
+}
+
+bool DrinkJournal::writeRebase(bool known, int64_t offsetMs) {
+  uint32_t covered = rebaseCount > 0 ? rebases[rebaseCount - 1].sequence : 0;
+  if (forgottenSequence > covered) covered = forgottenSequence;
+  if (lastUnsyncedSequence <= covered) return true;
+
+  JournalRecord record = {};
+  record.sequence = lastUnsyncedSequence;
+  record.timestampMs = (uint64_t)offsetMs;
+  if (!writeRecord(RECORD_KIND_REBASE, record, known ? 0 : RECORD_FLAG_LOST)) return false;
+
+  Rebase rebase = { lastUnsyncedSequence, known, offsetMs };
+  addRebase(rebase);
+  return true;
+}
+
+void DrinkJournal::addRebase(const Rebase& rebase) {
+  // Full: forget the oldest, the records it covered keep an unknown time
+  if (rebaseCount == JOURNAL_MAX_REBASES) {
+    uint32_t oldest = rebases[0].sequence < rebase.sequence ? rebases[0].sequence : rebase.sequence;
+    if (oldest > forgottenSequence) forgottenSequence = oldest;
+    if (rebase.sequence <= oldest) return;
+    memmove(rebases, rebases + 1, (rebaseCount - 1) * sizeof(Rebase));
+    rebaseCount--;
+  }
+
+  // Sectors are scanned in flash order, not in the order they were written
+  size_t index = rebaseCount;
+  while (index > 0 && rebases[index - 1].sequence > rebase.sequence) {
+    rebases[index] = rebases[index - 1];
+    index--;
+  }
+  rebases[index] = rebase;
+  rebaseCount++;
+}
+
+void DrinkJournal::resolveTime(JournalRecord& record) const {
+  if (!record.unsynced) return;
+
+  if (record.sequence > forgottenSequence) {
+    for (size_t i = 0; i < rebaseCount; i++) {
+      if (rebases[i].sequence < record.sequence) continue;
+      if (rebases[i].known) {
+        record.timestampMs += rebases[i].offsetMs;
+        record.unsynced = false;
+        return;
+      }
+      break;
+    }
+  }
+  record.timestampMs = 0;
+}
+
+bool DrinkJournal::rebaseUnsynced(int64_t offsetMs) {
+  return writeRebase(true, offsetMs);
+}
+
+bool DrinkJournal::abandonUnsynced() {
+  return writeRebase(false, 0);
+}
+
+bool DrinkJournal::writeRecord(uint8_t kind, const JournalRecord& record, uint8_t flags) {
+  SectorInfo& head = sectors[headSector];
+  if (head.sectorNumber == 0 || head.usedSlots >= slotCount) {
+    if (!openNextSector()) return false;
+  }
+
+  uint8_t slot[RECORD_SIZE];
+  putUint32(slot, record.sequence);
+  putUint32(slot + 4, (uint32_t)record.timestampMs);
+  putUint32(slot + 8, (uint32_t)(record.timestampMs >> 32));
+  putUint16(slot + 12, record.amountMl);
+  slot[14] = kind;
+  slot[15] = (uint8_t)~flags;
+  putUint32(slot + 16, record.durationMs);
+  putUint16(slot + 20, record.peakFlowMlPerMin);
+  putUint16(slot + 22, record.meanFlowMlPerMin);
+  putUint32(slot + 24, crc32(slot, RECORD_SIZE - 4));
+
+  // The slot counts as used even if the write fails, it may be partly programmed
+  SectorInfo& info = sectors[headSector];
+  size_t address = slotAddress(headSector, info.usedSlots);
+  info.usedSlots++;
+  if (!flash.write(address, slot, sizeof(slot))) return false;
+
+  if (kind == RECORD_KIND_DRINK) {
+    if (info.firstSequence == 0) info.firstSequence = record.sequence;
+    info.lastSequence = record.sequence;
+  }
+  return true;
+}
+
+bool DrinkJournal::append(uint64_t timestampMs, uint16_t amountMl, uint32_t* sequence) {
+  JournalRecord record = {};
+  record.timestampMs = timestampMs;
+  record.amountMl = amountMl;
+  if (!append(record)) return false;
+
+  if (sequence != nullptr) *sequence = record.sequence;
+  return true;
+}
+
+bool DrinkJournal::append(JournalRecord& record) {
+  if (sectorCount == 0) return false;
+  record.sequence = nextSequence;
+  if (!writeRecord(RECORD_KIND_DRINK, record, record.unsynced ? RECORD_FLAG_UNSYNCED : 0)) return false;
+
+  if (record.unsynced) lastUnsyncedSequence = record.sequence;
+  nextSequence++;
+  return true;
+}
+
+size_t DrinkJournal::readAfter(uint32_t afterSequence, JournalRecord* records, size_t maxRecords) {
+  return readAfter(afterSequence, records, maxRecords, drainCursor);
+}
+
+size_t DrinkJournal::readAfter(uint32_t afterSequence, JournalRecord* records, size_t maxRecords, JournalCursor& cursor) {
+  if (sectorCount == 0 || maxRecords == 0) return 0;
+
+  size_t sector = JOURNAL_MAX_SECTORS;
+  size_t slot = 0;
+
+  bool cursorValid = cursor.sectorNumber != 0 && cursor.sector < sectorCount &&
+                     sectors[cursor.sector].sectorNumber == cursor.sectorNumber;
+  if (cursorValid && cursor.sequence == afterSequence) {
+    // Continue where the previous read stopped
+    sector = cursor.sector;
+    slot = cursor.slot;
+  } else {
+    // Find the oldest sector holding a newer record, the ring starts after the head
+    for (size_t i = 1; i <= sectorCount; i++) {
+      size_t candidate = (headSector + i) % sectorCount;
+      if (sectors[candidate].sectorNumber != 0 && sectors[candidate].lastSequence > afterSequence) {
+        sector = candidate;
+        break;
+      }
+    }
+    if (sector == JOURNAL_MAX_SECTORS) return 0;
+  }
+
+  size_t count = 0;
+  uint8_t buffer[RECORD_SIZE];
+  while (count < maxRecords) {
+    const SectorInfo& info = sectors[sector];
+    if (info.sectorNumber != 0) {
+      while (slot < info.usedSlots && count < maxRecords) {
+        if (!flash.read(slotAddress(sector, slot), buffer, RECORD_SIZE)) return count;
+        slot++;
+
+        JournalRecord record;
+        uint8_t flags;
+        if (decodeRecord(buffer, record, flags) == RECORD_KIND_DRINK && record.sequence > afterSequence) {
+          resolveTime(record);
+          records[count++] = record;
+          cursor.sequence = record.sequence;
+          cursor.sectorNumber = info.sectorNumber;
+          cursor.sector = sector;
+          cursor.slot = slot;
+        }
+      }
+      if (slot < info.usedSlots) break;
+    }
+
+    if (sector == headSector) break;
+    sector = (sector + 1) % sectorCount;
+    slot = 0;
+  }
+  return count;
+}
+
+bool DrinkJournal::acknowledge(uint32_t sequence) {
+  if (sequence >= nextSequence) sequence = nextSequence - 1;
+  if (sequence <= ackedSequence) return true;
+
+  ackedSequence = sequence;
+  return writeAck(sequence);
+}
@@ -0,0 +1,139 @@
+#ifndef DRINKJOURNAL_H
+#define DRINKJOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FlashStore.h"
+
+// Append-only journal of drink events stored in flash.
+//
+// The flash is used as a ring of sectors. Each sector starts with a header
+// holding a monotonically increasing sector number, followed by fixed-size
+// record slots. Every record carries a CRC32, so a record torn by a power
+// cut is detected and skipped on the next boot. Acknowledgements are
+// journaled as records as well. The write head always moves on to the next
+// sector in the ring, which spreads erases evenly over the partition.
+// Delivered sectors are only erased once the head comes round to them, so
+// acknowledged events stay readable as history until their space is needed.
+//
+// Sequences start at 1 again when the journal starts over on erased flash.
+// Every sector header carries the journal's epoch, a random value chosen
+// when that happens, so a central can tell the new sequences from the ones
+// it has seen before.
+//
+// Events recorded before the clock was synced carry the time of the boot
+// clock, which starts at 0 on a cold boot, and an unsynced flag. The first
+// sync journals the offset from that clock to epoch time, and reads return
+// those events rebased by it. A cold boot before any sync loses the boot
+// clock: the events it covered keep an unknown time, read as 0.
+
+// The 320 KB journal partition in 4 KB sectors, room for 10,000 pending events
+const size_t JOURNAL_MAX_SECTORS = 80;
+// Clock offsets kept for rebasing, the oldest is forgotten first
+const size_t JOURNAL_MAX_REBASES = 8;
+
+struct JournalRecord {
+  uint32_t sequence;
+  uint64_t timestampMs;  // Start of the drink session
+  uint16_t amountMl;
+  uint32_t durationMs;   // Session details
+  uint16_t peakFlowMlPerMin;
+  uint16_t meanFlowMlPerMin;
+  // timestampMs is on the boot clock. Reads return it rebased and cleared,
+  // or set with timestampMs 0 while the offset is not known.
+  bool unsynced;
+};
+
+// Read position for readAfter(), lets sequential reads continue without
+// rescanning their sector. Erasing the sector invalidates it.
+struct JournalCursor {
+  uint32_t sequence;
+  uint32_t sectorNumber;
+  uint16_t sector;
+  uint16_t slot;
+};
+
+struct JournalStats {
+  uint32_t tornRecords;     // Records with a bad CRC found while recovering
+  uint32_t droppedRecords;  // Unacknowledged records overwritten because the ring was full
+  uint32_t sectorErases;
+};
+
+class DrinkJournal {
+public:
+  explicit DrinkJournal(FlashStore& flash);
+
+  // Scans the flash and restores head, sequence, acknowledgement state and
+  // epoch. Without a journal on the flash newEpoch is used, pass a random value.
+  bool begin(uint32_t newEpoch);
+
+  // Appends a drink event, the assigned sequence number is written to sequence
+  bool append(uint64_t timestampMs, uint16_t amountMl, uint32_t* sequence = nullptr);
+  // Same with session details, record.sequence is assigned
+  bool append(JournalRecord& record);
+
+  // Copies up to maxRecords records with a sequence above afterSequence, oldest first
+  size_t readAfter(uint32_t afterSequence, JournalRecord* records, size_t maxRecords);
+  size_t readAfter(uint32_t afterSequence, JournalRecord* records, size_t maxRecords, JournalCursor& cursor);
+
+  // Marks every record up to and including sequence as delivered
+  bool acknowledge(uint32_t sequence);
+
+  // Unsynced records not rebased yet get epoch time = boot clock + offsetMs
+  bool rebaseUnsynced(int64_t offsetMs);
+  // The boot clock of unsynced records not rebased yet is gone, their time stays unknown
+  bool abandonUnsynced();
+
+  uint32_t acknowledgedSequence() const { return ackedSequence; }
+  uint32_t lastSequence() const { return nextSequence - 1; }
+  uint32_t pendingCount() const { return nextSequence - 1 - ackedSequence; }
+  uint32_t epoch() const { return journalEpoch; }
+  const JournalStats& stats() const { return journalStats; }
+
+private:
+  struct Rebase {
+    uint32_t sequence;  // Covers unsynced records up to here, after the previous rebase
+    bool known;
+    int64_t offsetMs;
+  };
+
+  struct SectorInfo {
+    uint32_t sectorNumber;  // 0 = erased or unusable
+    uint16_t usedSlots;
+    uint32_t firstSequence; // 0 = no drink records
+    uint32_t lastSequence;
+    bool erased;            // Known to be erased, can be opened without another erase
+  };
+
+  bool scanSector(size_t sector);
+  bool openNextSector();
+  bool eraseSector(size_t sector);
+  bool writeRecord(uint8_t kind, const JournalRecord& record, uint8_t flags);
+  bool writeAck(uint32_t sequence);
+  bool writeRebase(bool known, int64_t offsetMs);
+  void addRebase(const Rebase& rebase);
+  void resolveTime(JournalRecord& record) const;
+  size_t slotAddress(size_t sector, size_t slot) const;
+
+  FlashStore& flash;
+  size_t sectorCount;
+  size_t slotCount;
+  SectorInfo sectors[JOURNAL_MAX_SECTORS];
+  size_t headSector;
+  uint32_t highestSectorNumber;
+  uint32_t nextSequence;
+  uint32_t ackedSequence;
+  uint32_t journalEpoch;
+  JournalStats journalStats;
+
+  // Sorted by sequence. Unsynced records up to forgottenSequence lost their rebase.
+  Rebase rebases[JOURNAL_MAX_REBASES];
+  size_t rebaseCount;
+  uint32_t forgottenSequence;
+  uint32_t lastUnsyncedSequence;
+
+  // Cursor of the delivery path, history reads bring their own
+  JournalCursor drainCursor;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "FlashStore.h"
+#include <string.h>
+
+RamFlashStore::RamFlashStore(size_t sectorSize, size_t sectorCount)
+    : sectorBytes(sectorSize), sectors(sectorCount) {
+  memory = new uint8_t[sectorBytes * sectors];
+  erases = new uint32_t[sectors];
+  memset(memory, 0xFF, sectorBytes * sectors);
+  memset(erases, 0, sizeof(uint32_t) * sectors);
+}
+
+RamFlashStore::~RamFlashStore() {
+  delete[] memory;
+  delete[] erases;
+}
+
+bool RamFlashStore::read(size_t address, void* data, size_t length) {
+  if (address + length > sectorBytes * sectors) return false;
+  memcpy(data, memory + address, length);
+  return true;
+}
+
+bool RamFlashStore::write(size_t address, const void* data, size_t length) {
+  if (address + length > sectorBytes * sectors) return false;
+
+  size_t programmed = length;
+  if (tearAfter >= 0 && (size_t)tearAfter < length) {
+    programmed = tearAfter;
+  }
+  tearAfter = -1;
+
+  // Programming can only turn 1 bits into 0 bits
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < programmed; i++) {
+    memory[address + i] &= bytes[i];
+  }
+  return programmed == length;
+}
+
+bool RamFlashStore::eraseSector(size_t sector) {
+  if (sector >= sectors) return false;
+  memset(memory + sector * sectorBytes, 0xFF, sectorBytes);
+  erases[sector]++;
+  return true;
+}
+
+void RamFlashStore::failNextWriteAfter(size_t bytes) {
+  tearAfter = (long)bytes;
+}
@@ -0,0 +1,44 @@
+#ifndef FLASHSTORE_H
+#define FLASHSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal NOR flash interface used by the drink journal.
+// Like real flash, erased bytes read as 0xFF and writes can only clear bits.
+class FlashStore {
+public:
+  virtual ~FlashStore() {}
+  virtual size_t sectorSize() const = 0;
+  virtual size_t sectorCount() const = 0;
+  virtual bool read(size_t address, void* data, size_t length) = 0;
+  virtual bool write(size_t address, const void* data, size_t length) = 0;
+  virtual bool eraseSector(size_t sector) = 0;
+};
+
+// RAM backed stand-in for host builds. Follows NOR semantics, counts
+// erases per sector and can simulate a power cut in the middle of a write.
+class RamFlashStore : public FlashStore {
+public:
+  RamFlashStore(size_t sectorSize, size_t sectorCount);
+  ~RamFlashStore();
+
+  size_t sectorSize() const override { return sectorBytes; }
+  size_t sectorCount() const override { return sectors; }
+  bool read(size_t address, void* data, size_t length) override;
+  bool write(size_t address, const void* data, size_t length) override;
+  bool eraseSector(size_t sector) override;
+
+  // The next write only programs this many bytes and then fails
+  void failNextWriteAfter(size_t bytes);
+  uint32_t eraseCount(size_t sector) const { return erases[sector]; }
+
+private:
+  size_t sectorBytes;
+  size_t sectors;
+  uint8_t* memory;
+  uint32_t* erases;
+  long tearAfter = -1;
+};
+
+#endif
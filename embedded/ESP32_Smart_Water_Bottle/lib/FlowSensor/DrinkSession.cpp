@@ -0,0 +1,89 @@
+#include "DrinkSession.h"
+
+void DrinkSessionTracker::reset() {
+  currentState = SESSION_IDLE;
+  current = DrinkSession();
+  lastFlowMs = 0;
+  pending = DrinkSession();
+  lastPendingMs = 0;
+}
+
+static void accumulate(DrinkSession& target, const SessionSample& sample) {
+  target.volumeUl += sample.volumeUl;
+  target.pulses += sample.pulses;
+  target.pouringMs += sample.periodMs;
+
+  // A 100 ms sample holds too few pulses for a peak, so it comes from the
+  // averaged rate. volumeUl / pulses is the calibrated volume per pulse at it.
+  if (sample.pulses > 0) {
+    uint32_t flow = (uint32_t)((uint64_t)sample.rateMilliHz * sample.volumeUl * 60 / ((uint64_t)sample.pulses * 1000000));
+    if (flow > target.peakFlowMlPerMin) target.peakFlowMlPerMin = flow;
+  }
+}
+
+// Starts with the trickle held back right before, if any
+void DrinkSessionTracker::start(const SessionSample& sample) {
+  if (pending.pulses > 0) {
+    current = pending;
+  } else {
+    current = DrinkSession();
+    current.startMs = sample.timeMs - sample.periodMs;
+  }
+  pending = DrinkSession();
+  currentState = SESSION_POURING;
+}
+
+void DrinkSessionTracker::hold(const SessionSample& sample, bool flow) {
+  bool expired = sample.timeMs - lastPendingMs >= config.commitGapMs || (sample.flowStopped && !flow) ||
+                 sample.timeMs - pending.startMs >= config.maxSessionMs;
+  if (pending.pulses > 0 && expired) pending = DrinkSession();
+  if (!flow) return;
+
+  if (pending.pulses == 0) pending.startMs = sample.timeMs - sample.periodMs;
+  accumulate(pending, sample);
+  lastPendingMs = sample.timeMs;
+}
+
+void DrinkSessionTracker::add(const SessionSample& sample, bool pouring) {
+  accumulate(current, sample);
+  // Trickle adds its volume but does not keep the session open
+  if (pouring) lastFlowMs = sample.timeMs;
+}
+
+bool DrinkSessionTracker::commit(DrinkSession& session, bool split) {
+  current.durationMs = lastFlowMs - current.startMs;
+  current.meanFlowMlPerMin = current.pouringMs > 0 ? (uint32_t)((uint64_t)current.volumeUl * 60 / current.pouringMs) : 0;
+  current.split = split;
+
+  bool keep = current.volumeUl > 0 && current.volumeUl >= config.minVolumeUl;
+  if (keep) session = current;
+  currentState = keep ? SESSION_COMMITTED : SESSION_IDLE;
+  current = DrinkSession();
+  return keep;
+}
+
+bool DrinkSessionTracker::update(const SessionSample& sample, DrinkSession& session) {
+  bool flow = sample.pulses > 0;
+  bool pouring = flow && sample.rateMilliHz >= config.trickleRateMilliHz;
+
+  if (currentState == SESSION_IDLE || currentState == SESSION_COMMITTED) {
+    currentState = SESSION_IDLE;
+    if (pouring) {
+      start(sample);
+      add(sample, true);
+    } else {
+      hold(sample, flow);
+    }
+    return false;
+  }
+
+  if (flow) add(sample, pouring);
+  currentState = pouring ? SESSION_POURING : SESSION_PAUSE;
+
+  if (pouring) {
+    if (sample.timeMs - current.startMs >= config.maxSessionMs) return commit(session, true);
+    return false;
+  }
+  if ((sample.flowStopped && !flow) || sample.timeMs - lastFlowMs >= config.commitGapMs) return commit(session, false);
+  return false;
+}
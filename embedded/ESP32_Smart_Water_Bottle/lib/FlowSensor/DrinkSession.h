@@ -0,0 +1,93 @@
+#ifndef DRINKSESSION_H
+#define DRINKSESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Segments the stream of flow samples into drink sessions:
+//
+//   IDLE -> POURING     flow at or above the trickle rate
+//   POURING -> PAUSE    a sample without flow, or only trickling
+//   PAUSE -> POURING    flow again within commitGapMs
+//   PAUSE -> COMMITTED  commitGapMs without flow, or the pulse gap
+//                       detector reported that the flow stopped
+//
+// Trickle below the rate adds its volume to an open session but neither
+// starts one nor keeps it open. While idle it is held back until
+// commitGapMs pass without flow: the first pulses of a sip arrive before
+// the averaged rate reaches the trickle rate and join the session that
+// starts next.
+//   POURING -> COMMITTED  the session reached maxSessionMs, a flow that
+//                       keeps trickling is split into several sessions
+//   COMMITTED -> IDLE or POURING with the next sample
+//
+// Time only comes from the samples, so the tracker runs the same on the
+// device and in a host replay at any speed.
+enum SessionState : uint8_t {
+  SESSION_IDLE,
+  SESSION_POURING,
+  SESSION_PAUSE,
+  SESSION_COMMITTED
+};
+
+struct SessionConfig {
+  uint32_t commitGapMs;
+  uint32_t maxSessionMs;
+  // Slower flow does not start a session, dripping after a sip is ignored
+  uint32_t trickleRateMilliHz;
+  // Sessions with less volume are dropped instead of committed
+  uint32_t minVolumeUl;
+};
+
+const SessionConfig DEFAULT_SESSION_CONFIG = { 1000, 60000, 1500, 0 };
+
+struct SessionSample {
+  uint32_t timeMs;        // End of the sample period
+  uint32_t periodMs;
+  uint32_t pulses;
+  uint32_t volumeUl;
+  uint32_t rateMilliHz;   // Averaged, also gives the peak flow
+  bool flowStopped;       // From the pulse gap detector, if there is one
+};
+
+struct DrinkSession {
+  uint32_t startMs;
+  uint32_t durationMs;    // Start to the last sample above the trickle rate, pauses included
+  uint32_t pouringMs;     // Only the samples with flow
+  uint32_t volumeUl;
+  uint32_t pulses;
+  uint32_t peakFlowMlPerMin;  // Highest averaged rate through the calibration
+  uint32_t meanFlowMlPerMin;  // Volume over pouringMs
+  bool split;             // Ended by maxSessionMs while still flowing
+};
+
+class DrinkSessionTracker {
+public:
+  explicit DrinkSessionTracker(const SessionConfig& config = DEFAULT_SESSION_CONFIG) : config(config) {}
+
+  void setConfig(const SessionConfig& newConfig) { config = newConfig; }
+  void reset();
+
+  // Returns true if this sample committed a session, which is written to session
+  bool update(const SessionSample& sample, DrinkSession& session);
+
+  SessionState state() const { return currentState; }
+  // Volume of the open session so far
+  uint32_t openVolumeUl() const { return current.volumeUl; }
+
+private:
+  void start(const SessionSample& sample);
+  void hold(const SessionSample& sample, bool flow);
+  void add(const SessionSample& sample, bool pouring);
+  bool commit(DrinkSession& session, bool split);
+
+  SessionConfig config;
+  SessionState currentState = SESSION_IDLE;
+  DrinkSession current = {};
+  uint32_t lastFlowMs = 0;
+  // Trickle while idle, not yet part of a session
+  DrinkSession pending = {};
+  uint32_t lastPendingMs = 0;
+};
+
+#endif
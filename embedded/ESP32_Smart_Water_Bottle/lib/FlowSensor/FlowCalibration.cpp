@@ -0,0 +1,103 @@
+#include "FlowCalibration.h"
+#include <string.h>
+
+void FlowCalibration::setDefault() {
+  memset(&calibration, 0, sizeof(calibration));
+  calibration.version = CALIBRATION_VERSION;
+  calibration.count = 1;
+  calibration.points[0].rateMilliHz = 0;
+  calibration.points[0].microLitersPerPulse = DEFAULT_MICROLITERS_PER_PULSE;
+}
+
+bool FlowCalibration::setTable(const CalibrationTable& table) {
+  if (table.version != CALIBRATION_VERSION || table.count == 0 || table.count > CALIBRATION_MAX_POINTS) return false;
+  for (size_t i = 0; i < table.count; i++) {
+    if (table.points[i].microLitersPerPulse == 0) return false;
+    if (i > 0 && table.points[i].rateMilliHz <= table.points[i - 1].rateMilliHz) return false;
+  }
+  calibration = table;
+  return true;
+}
+
+uint32_t FlowCalibration::microLitersPerPulse(uint32_t rateMilliHz) const {
+  const CalibrationPoint* points = calibration.points;
+  size_t last = calibration.count - 1;
+  if (rateMilliHz <= points[0].rateMilliHz) return points[0].microLitersPerPulse;
+  if (rateMilliHz >= points[last].rateMilliHz) return points[last].microLitersPerPulse;
+
+  size_t upper = 1;
+  while (points[upper].rateMilliHz < rateMilliHz) upper++;
+  const CalibrationPoint& a = points[upper - 1];
+  const CalibrationPoint& b = points[upper];
+
+  // Signed, the volume per pulse usually falls with the rate
+  int64_t delta = (int64_t)b.microLitersPerPulse - a.microLitersPerPulse;
+  int64_t offset = delta * (rateMilliHz - a.rateMilliHz) / (b.rateMilliHz - a.rateMilliHz);
+  return (uint32_t)(a.microLitersPerPulse + offset);
+}
+
+bool CalibrationFitter::addRun(const CalibrationRun& run) {
+  if (run.pulses == 0 || run.activeMs == 0 || run.referenceMl == 0 || count >= MAX_RUNS) return false;
+  entries[count++] = run;
+  return true;
+}
+
+// Accumulated pulses, rates and reference volume of merged runs
+struct FitBin {
+  uint64_t pulses;
+  uint64_t pulseRateSum;
+  uint64_t referenceMl;
+
+  uint32_t rateMilliHz() const { return (uint32_t)(pulseRateSum / pulses); }
+};
+
+bool CalibrationFitter::fit(CalibrationTable& table) const {
+  if (count == 0) return false;
+
+  // One bin per run, sorted by rate
+  FitBin bins[MAX_RUNS];
+  size_t binCount = 0;
+  for (size_t i = 0; i < count; i++) {
+    FitBin bin = { entries[i].pulses, entries[i].pulseRateSum, entries[i].referenceMl };
+    size_t position = binCount;
+    while (position > 0 && bins[position - 1].rateMilliHz() > bin.rateMilliHz()) {
+      bins[position] = bins[position - 1];
+      position--;
+    }
+    bins[position] = bin;
+    binCount++;
+  }
+
+  // Merge the closest neighbours while they are too close or too many
+  while (binCount > 1) {
+    size_t closest = 0;
+    uint64_t closestRatio = UINT64_MAX;
+    for (size_t i = 0; i + 1 < binCount; i++) {
+      uint64_t low = bins[i].rateMilliHz();
+      uint64_t ratio = low > 0 ? (bins[i + 1].rateMilliHz() - low) * 1000 / low : 0;
+      if (ratio < closestRatio) {
+        closestRatio = ratio;
+        closest = i;
+      }
+    }
+    if (closestRatio > mergePermille && binCount <= CALIBRATION_MAX_POINTS) break;
+
+    bins[closest].pulses += bins[closest + 1].pulses;
+    bins[closest].pulseRateSum += bins[closest + 1].pulseRateSum;
+    bins[closest].referenceMl += bins[closest + 1].referenceMl;
+    for (size_t i = closest + 1; i + 1 < binCount; i++) bins[i] = bins[i + 1];
+    binCount--;
+  }
+
+  memset(&table, 0, sizeof(table));
+  table.version = CALIBRATION_VERSION;
+  for (size_t i = 0; i < binCount; i++) {
+    uint32_t rate = bins[i].rateMilliHz();
+    // Equal rates after rounding would break the ascending order
+    if (table.count > 0 && rate <= table.points[table.count - 1].rateMilliHz) continue;
+    table.points[table.count].rateMilliHz = rate;
+    table.points[table.count].microLitersPerPulse = (uint32_t)(bins[i].referenceMl * 1000 / bins[i].pulses);
+    table.count++;
+  }
+  return table.count > 0;
+}
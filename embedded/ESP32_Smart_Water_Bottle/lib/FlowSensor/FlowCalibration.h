@@ -0,0 +1,92 @@
+#ifndef FLOWCALIBRATION_H
+#define FLOWCALIBRATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Calibration points are pulse frequency -> volume per pulse, in mHz and
+// microliters, so the conversion needs no floating point
+const size_t CALIBRATION_MAX_POINTS = 8;
+const uint8_t CALIBRATION_VERSION = 1;
+
+// YF-S201 datasheet: 7.5 Hz per L/min, i.e. 2222 ul per pulse at any rate
+const uint32_t DEFAULT_MICROLITERS_PER_PULSE = 2222;
+
+struct CalibrationPoint {
+  uint32_t rateMilliHz;
+  uint32_t microLitersPerPulse;
+};
+
+// Stored as one blob, e.g. in NVS
+struct CalibrationTable {
+  uint8_t version;
+  uint8_t count;
+  CalibrationPoint points[CALIBRATION_MAX_POINTS];
+};
+
+// Piecewise linear map from pulse frequency to volume per pulse. Below the
+// first and above the last point the nearest point's value is used.
+class FlowCalibration {
+public:
+  FlowCalibration() { setDefault(); }
+
+  // Single point with the datasheet constant
+  void setDefault();
+  // Points must be ascending by rate with nonzero volumes
+  bool setTable(const CalibrationTable& table);
+  const CalibrationTable& table() const { return calibration; }
+
+  uint32_t microLitersPerPulse(uint32_t rateMilliHz) const;
+  uint32_t volumeMicroLiters(uint32_t pulses, uint32_t rateMilliHz) const {
+    return pulses * microLitersPerPulse(rateMilliHz);
+  }
+
+private:
+  CalibrationTable calibration;
+};
+
+// One reference pour: the pulses counted for a known volume, how long
+// pulses were arriving and the rates the volume lookup got for them. The
+// table is keyed by that same rate, whichever source the build uses, so a
+// lagging or averaged rate is fitted the way it is later looked up.
+struct CalibrationRun {
+  uint32_t pulses;
+  uint32_t activeMs;
+  uint32_t referenceMl;
+  // Sum of pulses times their sample's rate in mHz
+  uint64_t pulseRateSum;
+
+  void addSample(uint32_t samplePulses, uint32_t periodMs, uint32_t rateMilliHz) {
+    if (samplePulses == 0) return;
+    pulses += samplePulses;
+    activeMs += periodMs;
+    pulseRateSum += (uint64_t)samplePulses * rateMilliHz;
+  }
+
+  // Mean rate, weighted by pulses
+  uint32_t rateMilliHz() const { return pulses > 0 ? (uint32_t)(pulseRateSum / pulses) : 0; }
+};
+
+// Collects reference pours and fits a table from them. Pours whose mean
+// rate is within mergePermille of each other are merged into one point,
+// weighted by their pulses. With more distinct rates than points the
+// closest neighbours are merged until the table fits.
+class CalibrationFitter {
+public:
+  explicit CalibrationFitter(uint32_t mergePermille = 100) : mergePermille(mergePermille) {}
+
+  void clear() { count = 0; }
+  bool addRun(const CalibrationRun& run);
+  size_t runs() const { return count; }
+
+  // Returns false without any usable run
+  bool fit(CalibrationTable& table) const;
+
+private:
+  static const size_t MAX_RUNS = 16;
+  CalibrationRun entries[MAX_RUNS];
+  size_t count = 0;
+  uint32_t mergePermille;
+};
+
+#endif
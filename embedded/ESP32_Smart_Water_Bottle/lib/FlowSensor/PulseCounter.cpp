@@ -0,0 +1,32 @@
+#include "PulseCounter.h"
+
+SimulatedPulseCounter::SimulatedPulseCounter(uint32_t limit) : limit(limit), accumulator(limit) {}
+
+void SimulatedPulseCounter::addPulses(uint32_t pulses) {
+  while (pulses > 0) {
+    uint32_t step = limit - count;
+    if (pulses < step) {
+      count += pulses;
+      break;
+    }
+    pulses -= step;
+    count = 0;
+    pendingWraps++;
+  }
+  if (!holdEvents) {
+    reportedWraps += pendingWraps;
+    pendingWraps = 0;
+  }
+}
+
+void SimulatedPulseCounter::holdOverflowEvents(bool hold) {
+  holdEvents = hold;
+  if (!holdEvents) {
+    reportedWraps += pendingWraps;
+    pendingWraps = 0;
+  }
+}
+
+uint32_t SimulatedPulseCounter::take() {
+  return accumulator.update(reportedWraps, count);
+}
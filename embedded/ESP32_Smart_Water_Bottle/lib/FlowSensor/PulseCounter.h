@@ -0,0 +1,65 @@
+#ifndef PULSECOUNTER_H
+#define PULSECOUNTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Source of flow sensor pulses. take() is a read-and-clear: it returns the
+// pulses counted since the previous call, so no pulse is lost or counted
+// twice between two samples.
+class PulseCounter {
+public:
+  virtual ~PulseCounter() {}
+  virtual uint32_t take() = 0;
+};
+
+// Turns a hardware counter that wraps at a limit, plus the number of wraps
+// reported by its overflow interrupt, into pulses since the last update.
+// The counter is never cleared, so pulses arriving while it is read are
+// simply part of the next update. If the counter has already wrapped but
+// the interrupt has not been handled yet, the total would go backwards;
+// that missing wrap is added here. Fewer than limit pulses may arrive
+// between two updates, so at most one wrap can be unreported.
+class PulseAccumulator {
+public:
+  explicit PulseAccumulator(uint32_t limit) : limit(limit) {}
+
+  void reset(uint32_t wraps, uint32_t count) { lastTotal = (uint64_t)wraps * limit + count; }
+
+  uint32_t update(uint32_t wraps, uint32_t count) {
+    uint64_t total = (uint64_t)wraps * limit + count;
+    if (total < lastTotal) total += limit;
+    uint32_t pulses = (uint32_t)(total - lastTotal);
+    lastTotal = total;
+    return pulses;
+  }
+
+private:
+  uint32_t limit;
+  uint64_t lastTotal = 0;
+};
+
+// Host stand-in that behaves like the PCNT unit: the count wraps to 0 at
+// the limit and each wrap is reported as an overflow event, which can be
+// held back to simulate an interrupt that has not run yet.
+class SimulatedPulseCounter : public PulseCounter {
+public:
+  explicit SimulatedPulseCounter(uint32_t limit = 32767);
+
+  void addPulses(uint32_t pulses);
+  // Wraps stay pending until released, like a masked overflow interrupt
+  void holdOverflowEvents(bool hold);
+
+  uint32_t take() override;
+  uint32_t wraps() const { return reportedWraps; }
+
+private:
+  uint32_t limit;
+  uint32_t count = 0;
+  uint32_t reportedWraps = 0;
+  uint32_t pendingWraps = 0;
+  bool holdEvents = false;
+  PulseAccumulator accumulator;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "PulseFlowMeter.h"
+
+PulseFlowMeter::PulseFlowMeter(const PulseFlowConfig& config) : config(config) {}
+
+void PulseFlowMeter::reset() {
+  head = 0;
+  count = 0;
+}
+
+// Time covered by the intervals in the window
+uint32_t PulseFlowMeter::span() const {
+  size_t oldest = (head + FLOW_METER_INTERVALS + 1 - count) % (FLOW_METER_INTERVALS + 1);
+  return times[newest()] - times[oldest];
+}
+
+bool PulseFlowMeter::addPulse(uint32_t timeUs) {
+  if (count > 0) {
+    uint32_t gap = timeUs - times[newest()];
+    if (gap < config.minIntervalUs) {
+      rejected++;
+      return false;
+    }
+    if (gap > gapLimitUs()) reset();
+  }
+
+  times[head] = timeUs;
+  head = (head + 1) % (FLOW_METER_INTERVALS + 1);
+  if (count < FLOW_METER_INTERVALS + 1) count++;
+  return true;
+}
+
+uint32_t PulseFlowMeter::rateMilliHz(uint32_t nowUs) const {
+  if (intervals() == 0) return 0;
+
+  uint64_t spanUs = span();
+  uint32_t rate = (uint32_t)(intervals() * 1000000000ULL / spanUs);
+
+  // A gap longer than the mean interval caps the rate, so it drops while
+  // the flow stops instead of holding the last value
+  uint32_t gap = nowUs - times[newest()];
+  if (gap * (uint64_t)intervals() > spanUs) {
+    uint32_t gapRate = (uint32_t)(1000000000ULL / gap);
+    if (gapRate < rate) rate = gapRate;
+  }
+  return rate;
+}
+
+uint32_t PulseFlowMeter::gapLimitUs() const {
+  if (intervals() == 0) return config.maxGapUs;
+
+  uint64_t limit = (uint64_t)span() * config.gapFactor / intervals();
+  if (limit < config.minGapUs) return config.minGapUs;
+  if (limit > config.maxGapUs) return config.maxGapUs;
+  return (uint32_t)limit;
+}
+
+bool PulseFlowMeter::flowing(uint32_t nowUs) const {
+  if (count == 0) return false;
+  return nowUs - times[newest()] <= gapLimitUs();
+}
+
+void PulseCountRate::reset() {
+  *this = PulseCountRate();
+}
+
+uint32_t PulseCountRate::add(uint32_t samplePulses, uint32_t periodUs) {
+  pulseSum += samplePulses - pulses[next];
+  periodSum += periodUs - periods[next];
+  pulses[next] = samplePulses;
+  periods[next] = periodUs;
+  next = (next + 1) % COUNT_RATE_SAMPLES;
+  return periodSum > 0 ? (uint32_t)(pulseSum * 1000000000ULL / periodSum) : 0;
+}
@@ -0,0 +1,81 @@
+#ifndef PULSEFLOWMETER_H
+#define PULSEFLOWMETER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of pulse intervals the rate is averaged over
+const size_t FLOW_METER_INTERVALS = 4;
+
+struct PulseFlowConfig {
+  // Pulses closer than this are glitches, the YF-S201 tops out near 225 Hz
+  uint32_t minIntervalUs;
+  // Flow has stopped once the gap is this many mean intervals long...
+  uint32_t gapFactor;
+  // ...but never before minGapUs and always after maxGapUs
+  uint32_t minGapUs;
+  uint32_t maxGapUs;
+};
+
+const PulseFlowConfig DEFAULT_PULSE_FLOW_CONFIG = { 2000, 4, 150000, 1000000 };
+
+// Flow estimate from the time between individual pulses instead of pulses
+// per fixed window. The rate follows every pulse, and the end of a pour is
+// detected from the gap after the last pulse relative to the recent pulse
+// interval. Timestamps are microseconds from a free running 32 bit clock,
+// so they may wrap.
+class PulseFlowMeter {
+public:
+  explicit PulseFlowMeter(const PulseFlowConfig& config = DEFAULT_PULSE_FLOW_CONFIG);
+
+  void reset();
+
+  // Returns false if the pulse was rejected as a glitch. A pulse after a
+  // gap that ended the flow starts a new run.
+  bool addPulse(uint32_t timeUs);
+
+  // Pulse frequency in mHz, falls off once the current gap is longer
+  // than the recent intervals
+  uint32_t rateMilliHz(uint32_t nowUs) const;
+
+  // False once the gap since the last pulse exceeds gapLimitUs()
+  bool flowing(uint32_t nowUs) const;
+  uint32_t gapLimitUs() const;
+
+  uint32_t lastPulseUs() const { return count > 0 ? times[newest()] : 0; }
+  uint32_t rejectedPulses() const { return rejected; }
+
+private:
+  size_t newest() const { return (head + FLOW_METER_INTERVALS) % (FLOW_METER_INTERVALS + 1); }
+  size_t intervals() const { return count > 0 ? count - 1 : 0; }
+  uint32_t span() const;
+
+  PulseFlowConfig config;
+  uint32_t times[FLOW_METER_INTERVALS + 1];
+  size_t head = 0;
+  size_t count = 0;
+  uint32_t rejected = 0;
+};
+
+// Number of sample periods PulseCountRate averages over
+const size_t COUNT_RATE_SAMPLES = 10;
+
+// Flow rate from pulse counts alone, for builds without pulse timestamps.
+// One 100 ms sample holds only a few pulses, so the rate is averaged over
+// the last COUNT_RATE_SAMPLES samples.
+class PulseCountRate {
+public:
+  void reset();
+
+  // Adds one sample period and returns the rate in mHz
+  uint32_t add(uint32_t pulses, uint32_t periodUs);
+
+private:
+  uint32_t pulses[COUNT_RATE_SAMPLES] = {};
+  uint32_t periods[COUNT_RATE_SAMPLES] = {};
+  size_t next = 0;
+  uint32_t pulseSum = 0;
+  uint32_t periodSum = 0;
+};
+
+#endif
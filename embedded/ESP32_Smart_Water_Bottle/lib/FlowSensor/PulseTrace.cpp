@@ -0,0 +1,193 @@
+#include "PulseTrace.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Small deterministic generator, traces must be identical on every host
+static uint32_t nextRandom(uint32_t& state) {
+  state = state * 1664525 + 1013904223;
+  return state >> 8;
+}
+
+// Pulse frequency in mHz at t ms into a sip
+static uint32_t sipRateMilliHz(const SipSpec& sip, uint32_t t) {
+  uint32_t ramp = sip.durationMs / 5;
+  uint64_t peak = (uint64_t)sip.peakHz * 1000;
+  if (ramp == 0) return (uint32_t)peak;
+  if (t < ramp) return (uint32_t)(peak * (t + 1) / ramp);
+  if (t > sip.durationMs - ramp) return (uint32_t)(peak * (sip.durationMs - t + 1) / ramp);
+  return (uint32_t)peak;
+}
+
+// First ms after t at which sipRateMilliHz() can change
+static uint32_t sipRateEndMs(const SipSpec& sip, uint32_t t) {
+  uint32_t ramp = sip.durationMs / 5;
+  if (ramp == 0) return sip.durationMs;
+  if (t >= ramp && t <= sip.durationMs - ramp) return sip.durationMs - ramp + 1;
+  return t + 1;
+}
+
+// The rate is integrated in 100 us steps: mHz times 100 us is 1e-7 pulses
+static const uint32_t SYNTH_STEP_US = 100;
+static const uint64_t SYNTH_PULSE = 10000000;
+
+size_t synthesizePulseTrace(const SipSpec* sips, size_t sipCount, uint32_t jitterPermille, uint32_t seed,
+                            uint32_t* out, size_t capacity) {
+  size_t count = 0;
+  uint32_t state = seed;
+  for (size_t i = 0; i < sipCount && count < capacity; i++) {
+    const SipSpec& sip = sips[i];
+    uint64_t phase = 0;
+    uint64_t threshold = SYNTH_PULSE;
+
+    for (uint32_t t = 0; t < sip.durationMs * 1000 && count < capacity; t += SYNTH_STEP_US) {
+      phase += sipRateMilliHz(sip, t / 1000);
+      if (phase < threshold) continue;
+
+      out[count++] = sip.startMs * 1000 + t;
+      phase -= threshold;
+      threshold = SYNTH_PULSE;
+      if (jitterPermille > 0) {
+        int32_t jitter = (int32_t)(nextRandom(state) % (2 * jitterPermille + 1)) - (int32_t)jitterPermille;
+        threshold = SYNTH_PULSE * (1000 + jitter) / 1000;
+      }
+    }
+  }
+  return count;
+}
+
+size_t readPulseTrace(FILE* file, uint32_t* out, size_t capacity) {
+  char line[64];
+  size_t count = 0;
+  while (count < capacity && fgets(line, sizeof(line), file) != nullptr) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    out[count++] = (uint32_t)strtoul(line, nullptr, 10);
+  }
+  return count;
+}
+
+void writePulseTrace(FILE* file, const uint32_t* pulses, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    fprintf(file, "%lu\n", (unsigned long)pulses[i]);
+  }
+}
+
+static void endSession(ReplayStats& stats, uint32_t latencyMs, uint64_t& latencyTotal) {
+  stats.sessions++;
+  latencyTotal += latencyMs;
+  if (latencyMs > stats.maxEndLatencyMs) stats.maxEndLatencyMs = latencyMs;
+}
+
+void replayPulseTrace(const uint32_t* pulses, size_t count, uint32_t samplePeriodMs, uint32_t windowGapMs,
+                      const PulseFlowConfig& config, ReplayStats& window, ReplayStats& interval) {
+  memset(&window, 0, sizeof(window));
+  memset(&interval, 0, sizeof(interval));
+  if (count == 0) return;
+
+  PulseFlowMeter meter(config);
+  uint64_t windowLatency = 0;
+  uint64_t intervalLatency = 0;
+  uint32_t emptyMs = 0;
+  bool windowOpen = false;
+  bool intervalOpen = false;
+  uint32_t lastPulseUs = pulses[0];
+
+  uint32_t periodUs = samplePeriodMs * 1000;
+  uint32_t endUs = pulses[count - 1] + (windowGapMs + 2 * samplePeriodMs) * 1000 + config.maxGapUs;
+  size_t next = 0;
+  for (uint32_t nowUs = pulses[0] - pulses[0] % periodUs + periodUs; nowUs <= endUs; nowUs += periodUs) {
+    uint32_t samplePulses = 0;
+    while (next < count && pulses[next] <= nowUs) {
+      meter.addPulse(pulses[next]);
+      lastPulseUs = pulses[next];
+      samplePulses++;
+      next++;
+    }
+    window.pulses += samplePulses;
+    interval.pulses += samplePulses;
+
+    if (samplePulses > 0) {
+      windowOpen = true;
+      intervalOpen = true;
+      emptyMs = 0;
+    } else {
+      emptyMs += samplePeriodMs;
+    }
+
+    if (windowOpen && emptyMs >= windowGapMs) {
+      windowOpen = false;
+      endSession(window, (nowUs - lastPulseUs) / 1000, windowLatency);
+    }
+    if (intervalOpen && !meter.flowing(nowUs)) {
+      intervalOpen = false;
+      endSession(interval, (nowUs - lastPulseUs) / 1000, intervalLatency);
+    }
+  }
+
+  if (window.sessions > 0) window.meanEndLatencyMs = (uint32_t)(windowLatency / window.sessions);
+  if (interval.sessions > 0) interval.meanEndLatencyMs = (uint32_t)(intervalLatency / interval.sessions);
+}
+
+SipSampler::SipSampler(const SipSpec* sips, size_t sipCount, uint32_t periodMs, uint32_t microLitersPerPulse,
+                       bool usePulseGap)
+    : sips(sips), sipCount(sipCount), periodMs(periodMs), microLitersPerPulse(microLitersPerPulse),
+      usePulseGap(usePulseGap) {}
+
+bool SipSampler::next(SessionSample& sample) {
+  uint64_t endUs = timeUs + (uint64_t)periodMs * 1000;
+  bool wasFlowing = meter.flowing((uint32_t)timeUs);
+  uint32_t counted = 0;
+
+  // Only step through the parts of the period covered by a sip
+  while (sipIndex < sipCount) {
+    const SipSpec& sip = sips[sipIndex];
+    uint64_t sipStartUs = (uint64_t)sip.startMs * 1000;
+    uint64_t sipEndUs = sipStartUs + (uint64_t)sip.durationMs * 1000;
+    if (sipStartUs >= endUs) break;
+
+    uint64_t t = timeUs > sipStartUs ? timeUs : sipStartUs;
+    t -= (t - sipStartUs) % SYNTH_STEP_US;
+    // While the rate stays the same the steps up to the next pulse are
+    // counted instead of taken one by one
+    while (t < endUs && t < sipEndUs) {
+      uint32_t ms = (uint32_t)((t - sipStartUs) / 1000);
+      uint64_t limitUs = sipStartUs + (uint64_t)sipRateEndMs(sip, ms) * 1000;
+      if (endUs < limitUs) limitUs = endUs;
+      if (sipEndUs < limitUs) limitUs = sipEndUs;
+      uint64_t steps = (limitUs - t + SYNTH_STEP_US - 1) / SYNTH_STEP_US;
+      uint32_t rate = sipRateMilliHz(sip, ms);
+      uint64_t toPulse = rate > 0 ? (SYNTH_PULSE - phase + rate - 1) / rate : steps + 1;
+      if (toPulse > steps) {
+        phase += steps * rate;
+        t += steps * SYNTH_STEP_US;
+        continue;
+      }
+      t += (toPulse - 1) * SYNTH_STEP_US;
+      phase += toPulse * rate - SYNTH_PULSE;
+      counted++;
+      if (meter.addPulse((uint32_t)t)) wasFlowing = true;
+      t += SYNTH_STEP_US;
+    }
+    if (t < sipEndUs) break;
+    sipIndex++;
+    phase = 0;
+  }
+
+  timeUs = endUs;
+  pulses += counted;
+  sample.timeMs = (uint32_t)(timeUs / 1000);
+  sample.periodMs = periodMs;
+  sample.pulses = counted;
+  sample.volumeUl = counted * microLitersPerPulse;
+  if (usePulseGap) {
+    sample.rateMilliHz = meter.rateMilliHz((uint32_t)timeUs);
+    sample.flowStopped = wasFlowing && !meter.flowing((uint32_t)timeUs);
+  } else {
+    sample.rateMilliHz = countRate.add(counted, periodMs * 1000);
+    sample.flowStopped = false;
+  }
+
+  // Run on for a few seconds after the last sip so its session can end
+  if (sipIndex < sipCount) return true;
+  uint64_t lastEndUs = sipCount > 0 ? ((uint64_t)sips[sipCount - 1].startMs + sips[sipCount - 1].durationMs) * 1000 : 0;
+  return timeUs < lastEndUs + 5000000;
+}
@@ -0,0 +1,72 @@
+#ifndef PULSETRACE_H
+#define PULSETRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "PulseFlowMeter.h"
+#include "DrinkSession.h"
+
+// Pulse traces are lists of pulse timestamps in microseconds. As text they
+// are one timestamp per line, lines starting with '#' are comments, which
+// is also what the firmware prints with -D FLOW_PULSE_TRACE.
+
+// One sip of a synthetic trace: the flow ramps up over the first and down
+// over the last fifth of the duration around a plateau at peakHz
+struct SipSpec {
+  uint32_t startMs;
+  uint32_t durationMs;
+  uint32_t peakHz;
+};
+
+// Writes the pulses of the sips into out, returns the number written.
+// jitterPermille varies every interval randomly by up to that much.
+size_t synthesizePulseTrace(const SipSpec* sips, size_t sipCount, uint32_t jitterPermille, uint32_t seed,
+                            uint32_t* out, size_t capacity);
+
+size_t readPulseTrace(FILE* file, uint32_t* out, size_t capacity);
+void writePulseTrace(FILE* file, const uint32_t* pulses, size_t count);
+
+// Sessions found by one end-of-pour detector in a replayed trace
+struct ReplayStats {
+  uint32_t sessions;
+  uint32_t pulses;
+  // Time from the last pulse of a session until the detector ended it
+  uint32_t meanEndLatencyMs;
+  uint32_t maxEndLatencyMs;
+};
+
+// Replays a trace in steps of samplePeriodMs through both detectors: the
+// window detector ends a session after windowGapMs of empty samples, the
+// interval detector when PulseFlowMeter stops reporting flow
+void replayPulseTrace(const uint32_t* pulses, size_t count, uint32_t samplePeriodMs, uint32_t windowGapMs,
+                      const PulseFlowConfig& config, ReplayStats& window, ReplayStats& interval);
+
+// Turns a list of sips into the samples the sensor task would produce,
+// without storing the pulses, so whole days can be simulated. Sips must be
+// sorted and must not overlap. With usePulseGap the samples carry the
+// PulseFlowMeter rate and stop flag like in the FLOW_PULSE_TIMESTAMPS
+// firmware, otherwise the PulseCountRate of the default build.
+class SipSampler {
+public:
+  SipSampler(const SipSpec* sips, size_t sipCount, uint32_t periodMs, uint32_t microLitersPerPulse, bool usePulseGap);
+
+  // Returns false once every sip has been sampled and the flow has settled
+  bool next(SessionSample& sample);
+  uint32_t totalPulses() const { return pulses; }
+
+private:
+  const SipSpec* sips;
+  size_t sipCount;
+  size_t sipIndex = 0;
+  uint32_t periodMs;
+  uint32_t microLitersPerPulse;
+  bool usePulseGap;
+  uint64_t timeUs = 0;
+  uint64_t phase = 0;
+  uint32_t pulses = 0;
+  PulseFlowMeter meter;
+  PulseCountRate countRate;
+};
+
+#endif
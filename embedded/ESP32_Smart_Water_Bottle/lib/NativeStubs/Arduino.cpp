@@ -0,0 +1,174 @@
+#include "Arduino.h"
+#include "SimBoard.h"
+
+HardwareSerial Serial;
+
+const uint8_t LEDC_CHANNELS = 16;
+static uint32_t ledcDuty[LEDC_CHANNELS];
+static unsigned long randomState = 1;
+static uint32_t loopPasses = 0;
+
+unsigned long millis() {
+  return (unsigned long)(simNowUs() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)simNowUs();
+}
+
+void delay(uint32_t ms) {
+  vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (mode == INPUT_PULLUP) simSetPinPullUp(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  simDrivePin(pin, value);
+}
+
+int digitalRead(uint8_t pin) {
+  return simPinLevel(pin);
+}
+
+uint16_t analogRead(uint8_t pin) {
+  (void)pin;
+  return 0;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  simSetInterruptHandler(pin, handler);
+  simSetInterruptType(pin, mode);
+  simEnableInterrupt(pin, true);
+}
+
+void detachInterrupt(uint8_t pin) {
+  simEnableInterrupt(pin, false);
+  simSetInterruptHandler(pin, nullptr);
+}
+
+double ledcSetup(uint8_t channel, double frequency, uint8_t resolutionBits) {
+  (void)channel;
+  (void)resolutionBits;
+  return frequency;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+  (void)pin;
+  (void)channel;
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+  if (channel < LEDC_CHANNELS) ledcDuty[channel] = duty;
+}
+
+uint32_t ledcRead(uint8_t channel) {
+  return channel < LEDC_CHANNELS ? ledcDuty[channel] : 0;
+}
+
+// Park-Miller, the same sequence on every host
+long random(long max) {
+  if (max <= 0) return 0;
+  randomState = (randomState * 48271UL) % 2147483647UL;
+  return (long)(randomState % (unsigned long)max);
+}
+
+long random(long min, long max) {
+  if (min >= max) return min;
+  return min + random(max - min);
+}
+
+uint32_t esp_random() {
+  return (uint32_t)random(2147483647L);
+}
+
+void randomSeed(unsigned long seed) {
+  randomState = seed % 2147483647UL;
+  if (randomState == 0) randomState = 1;
+}
+
+uint32_t getCpuFrequencyMhz() {
+  return 240;
+}
+
+bool btStop() {
+  return true;
+}
+
+void HardwareSerial::flush() {
+  if (output != nullptr) fflush(output);
+}
+
+size_t HardwareSerial::write(const char* data, size_t length) {
+  written += length;
+  if (output == nullptr) return length;
+
+  for (size_t i = 0; i < length; i++) {
+    if (lineStart) {
+      uint64_t nowMs = simNowUs() / 1000;
+      fprintf(output, "[%7llu.%03u] ", (unsigned long long)(nowMs / 1000), (unsigned)(nowMs % 1000));
+      lineStart = false;
+    }
+    fputc(data[i], output);
+    if (data[i] == '\n') lineStart = true;
+  }
+  return length;
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  char buffer[256];
+  va_list arguments;
+  va_start(arguments, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, arguments);
+  va_end(arguments);
+  if (length < 0) return 0;
+  return write(buffer, (size_t)length < sizeof(buffer) ? length : sizeof(buffer) - 1);
+}
+
+size_t HardwareSerial::print(const char* text) {
+  return write(text, strlen(text));
+}
+
+size_t HardwareSerial::print(char c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::print(long long value) {
+  char buffer[24];
+  return write(buffer, snprintf(buffer, sizeof(buffer), "%lld", value));
+}
+
+size_t HardwareSerial::print(unsigned long long value) {
+  char buffer[24];
+  return write(buffer, snprintf(buffer, sizeof(buffer), "%llu", value));
+}
+
+size_t HardwareSerial::print(double value, int digits) {
+  char buffer[40];
+  return write(buffer, snprintf(buffer, sizeof(buffer), "%.*f", digits, value));
+}
+
+// Unit tests link the stand-ins without a sketch, so there is no setup() and loop()
+#ifndef PIO_UNIT_TESTING
+static uint32_t loopPassUs = 0;
+
+static void loopTask(void* parameter) {
+  (void)parameter;
+  setup();
+  for (;;) {
+    loop();
+    loopPasses++;
+    simBlockUntil(simNowUs() + loopPassUs);
+  }
+}
+
+void startArduinoLoopTask(uint32_t passUs) {
+  loopPassUs = passUs;
+  simCreateTask(loopTask, nullptr, "loopTask");
+}
+#endif
+
+uint32_t arduinoLoopPasses() {
+  return loopPasses;
+}
@@ -0,0 +1,112 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+// Host stand-in for the ESP32 Arduino core. Time, pins and interrupts
+// belong to the virtual board (SimBoard.h), setup() and loop() run in its
+// loop task like on the chip.
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+// Interrupt modes, same values as gpio_int_type_t
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define ONLOW 0x04
+#define ONHIGH 0x05
+
+#define digitalPinToInterrupt(pin) (pin)
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+// Backlight PWM, the duty is kept per channel
+double ledcSetup(uint8_t channel, double frequency, uint8_t resolutionBits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
+
+// Deterministic, analogRead() returns 0 so the seed is always the same
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+// The hardware RNG on the chip, here the next value of the same sequence
+uint32_t esp_random();
+
+uint32_t getCpuFrequencyMhz();
+bool btStop();
+
+// Serial output goes to stdout, every line prefixed with the virtual time
+class HardwareSerial {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  void flush();
+
+  size_t write(const char* data, size_t length);
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  size_t print(const char* text);
+  size_t print(char c);
+  size_t print(int value) { return print((long long)value); }
+  size_t print(unsigned int value) { return print((unsigned long long)value); }
+  size_t print(long value) { return print((long long)value); }
+  size_t print(unsigned long value) { return print((unsigned long long)value); }
+  size_t print(long long value);
+  size_t print(unsigned long long value);
+  size_t print(double value, int digits = 2);
+
+  size_t println() { return print("\n"); }
+  template <typename T> size_t println(T value) { return print(value) + println(); }
+
+  // Output is dropped but still counted
+  void setOutput(FILE* file) { output = file; }
+  uint64_t bytesWritten() const { return written; }
+
+private:
+  FILE* output = stdout;
+  bool lineStart = true;
+  uint64_t written = 0;
+};
+
+extern HardwareSerial Serial;
+
+// Defined by the firmware
+void setup();
+void loop();
+
+// Starts the loop task, which runs setup() and then loop() forever. Every
+// loop() pass takes passUs of virtual time on top of any blocking.
+void startArduinoLoopTask(uint32_t passUs);
+uint32_t arduinoLoopPasses();
+
+#endif
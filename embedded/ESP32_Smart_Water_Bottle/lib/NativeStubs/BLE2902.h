@@ -0,0 +1,7 @@
+#ifndef NATIVE_BLE2902_H
+#define NATIVE_BLE2902_H
+
+// Everything is declared in BLEDevice.h
+#include "BLEDevice.h"
+
+#endif
@@ -0,0 +1,162 @@
+#include "BLEDevice.h"
+#include <string.h>
+
+const uint16_t ATT_DEFAULT_MTU = 23;
+// Notification header: opcode and attribute handle
+const uint16_t ATT_NOTIFY_OVERHEAD = 3;
+// Long writes and reads carry up to this much
+const size_t ATT_MAX_VALUE = 512;
+
+static BLEServer* server = nullptr;
+static BLEAdvertising advertising;
+static bool advertisingActive = false;
+static uint16_t preferredMtu = ATT_DEFAULT_MTU;
+static uint16_t linkMtu = ATT_DEFAULT_MTU;
+static std::vector<BLECharacteristic*> characteristics;
+static BleNotifyListener notifyListener = nullptr;
+static BleLinkStats linkStats;
+
+static BLECharacteristic* findCharacteristic(const char* uuid, uint32_t property) {
+  for (size_t i = 0; i < characteristics.size(); i++) {
+    BLECharacteristic* characteristic = characteristics[i];
+    if (uuid != nullptr && strcmp(characteristic->getUUIDString(), uuid) != 0) continue;
+    if (characteristic->getProperties() & property) return characteristic;
+  }
+  return nullptr;
+}
+
+void BLECharacteristic::notify(bool isNotification) {
+  (void)isNotification;
+  if (server == nullptr || server->connectedCount == 0) return;
+
+  size_t length = value.size();
+  if (length > (size_t)(linkMtu - ATT_NOTIFY_OVERHEAD)) {
+    length = linkMtu - ATT_NOTIFY_OVERHEAD;
+    linkStats.truncatedNotifications++;
+  }
+  linkStats.notifications++;
+  linkStats.notifiedBytes += length;
+  if (notifyListener != nullptr) notifyListener(uuid, value.data(), length);
+}
+
+BLECharacteristic* BLEService::createCharacteristic(const char* characteristicUuid, uint32_t properties) {
+  BLECharacteristic* characteristic = new BLECharacteristic(characteristicUuid, properties);
+  characteristics.push_back(characteristic);
+  return characteristic;
+}
+
+BLEService* BLEServer::createService(const char* uuid) {
+  return new BLEService(uuid);
+}
+
+void BLEServer::startAdvertising() {
+  advertising.start();
+}
+
+void BLEAdvertising::start() {
+  advertisingActive = true;
+}
+
+void BLEAdvertising::stop() {
+  advertisingActive = false;
+}
+
+void BLEDevice::init(const char* deviceName) {
+  (void)deviceName;
+}
+
+void BLEDevice::setMTU(uint16_t mtu) {
+  preferredMtu = mtu;
+}
+
+BLEServer* BLEDevice::createServer() {
+  if (server == nullptr) server = new BLEServer();
+  return server;
+}
+
+BLEAdvertising* BLEDevice::getAdvertising() {
+  return &advertising;
+}
+
+void BLEDevice::startAdvertising() {
+  advertising.start();
+}
+
+void BLEDevice::stopAdvertising() {
+  advertising.stop();
+}
+
+bool bleCentralConnect() {
+  if (server == nullptr || !advertisingActive || server->connectedCount > 0) {
+    linkStats.refusedConnections++;
+    return false;
+  }
+  // Bluedroid stops advertising once a central is connected
+  advertisingActive = false;
+  linkMtu = ATT_DEFAULT_MTU;
+  server->connectedCount = 1;
+  linkStats.connections++;
+  if (server->callbacks != nullptr) server->callbacks->onConnect(server);
+  return true;
+}
+
+void bleCentralDisconnect() {
+  if (server == nullptr || server->connectedCount == 0) return;
+  server->connectedCount = 0;
+  if (server->callbacks != nullptr) server->callbacks->onDisconnect(server);
+}
+
+bool bleCentralConnected() {
+  return server != nullptr && server->connectedCount > 0;
+}
+
+void bleCentralRequestMtu(uint16_t mtu) {
+  if (!bleCentralConnected()) return;
+  linkMtu = mtu < preferredMtu ? mtu : preferredMtu;
+  if (linkMtu < ATT_DEFAULT_MTU) linkMtu = ATT_DEFAULT_MTU;
+
+  esp_ble_gatts_cb_param_t param = {};
+  param.mtu.mtu = linkMtu;
+  if (server->callbacks != nullptr) server->callbacks->onMtuChanged(server, &param);
+}
+
+bool bleCentralWrite(const char* uuid, const uint8_t* data, size_t length) {
+  BLECharacteristic* characteristic = findCharacteristic(uuid, BLECharacteristic::PROPERTY_WRITE);
+  if (characteristic == nullptr || !bleCentralConnected()) return false;
+  // Longer than MTU - 3 is a prepared (long) write, delivered as one value
+  if (length > ATT_MAX_VALUE) return false;
+
+  linkStats.writes++;
+  characteristic->setValue((uint8_t*)data, length);
+  if (characteristic->getCallbacks() != nullptr) characteristic->getCallbacks()->onWrite(characteristic);
+  return true;
+}
+
+size_t bleCentralRead(const char* uuid, uint8_t* out, size_t capacity) {
+  BLECharacteristic* characteristic = findCharacteristic(uuid, BLECharacteristic::PROPERTY_READ);
+  if (characteristic == nullptr || !bleCentralConnected()) return 0;
+
+  linkStats.reads++;
+  if (characteristic->getCallbacks() != nullptr) characteristic->getCallbacks()->onRead(characteristic);
+  size_t length = characteristic->getLength();
+  if (length > ATT_MAX_VALUE) length = ATT_MAX_VALUE;
+  if (length > capacity) length = capacity;
+  memcpy(out, characteristic->getData(), length);
+  return length;
+}
+
+void bleCentralSetNotifyListener(BleNotifyListener listener) {
+  notifyListener = listener;
+}
+
+size_t bleCharacteristicCount() {
+  return characteristics.size();
+}
+
+BLECharacteristic* bleCharacteristic(size_t index) {
+  return characteristics[index];
+}
+
+const BleLinkStats& bleLinkStats() {
+  return linkStats;
+}
@@ -0,0 +1,150 @@
+#ifndef NATIVE_BLEDEVICE_H
+#define NATIVE_BLEDEVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Host stand-in for the ESP32 BLE library (Bluedroid). One GATT server,
+// one central. The central side below is driven by the simulation, its
+// calls run the server callbacks like the Bluedroid task would.
+
+struct esp_ble_gatts_cb_param_t {
+  struct gatts_mtu_evt_param {
+    uint16_t conn_id;
+    uint16_t mtu;
+  } mtu;
+};
+
+class BLEServer;
+class BLECharacteristic;
+
+class BLEDescriptor {
+public:
+  virtual ~BLEDescriptor() {}
+};
+
+// Client Characteristic Configuration, notifications are always delivered
+class BLE2902 : public BLEDescriptor {};
+
+class BLECharacteristicCallbacks {
+public:
+  virtual ~BLECharacteristicCallbacks() {}
+  virtual void onRead(BLECharacteristic* characteristic) { (void)characteristic; }
+  virtual void onWrite(BLECharacteristic* characteristic) { (void)characteristic; }
+};
+
+class BLECharacteristic {
+public:
+  static const uint32_t PROPERTY_READ = 1 << 0;
+  static const uint32_t PROPERTY_WRITE = 1 << 1;
+  static const uint32_t PROPERTY_NOTIFY = 1 << 2;
+  static const uint32_t PROPERTY_BROADCAST = 1 << 3;
+  static const uint32_t PROPERTY_INDICATE = 1 << 4;
+  static const uint32_t PROPERTY_WRITE_NR = 1 << 5;
+
+  BLECharacteristic(const char* uuid, uint32_t properties) : uuid(uuid), properties(properties) {}
+
+  void setCallbacks(BLECharacteristicCallbacks* characteristicCallbacks) { callbacks = characteristicCallbacks; }
+  void addDescriptor(BLEDescriptor* descriptor) { descriptors.push_back(descriptor); }
+
+  void setValue(uint8_t* data, size_t length) { value.assign(data, data + length); }
+  uint8_t* getData() { return value.data(); }
+  size_t getLength() const { return value.size(); }
+  // Sent to the central if connected, truncated to the ATT MTU
+  void notify(bool isNotification = true);
+
+  const char* getUUIDString() const { return uuid; }
+  uint32_t getProperties() const { return properties; }
+  BLECharacteristicCallbacks* getCallbacks() const { return callbacks; }
+
+private:
+  const char* uuid;
+  uint32_t properties;
+  std::vector<uint8_t> value;
+  std::vector<BLEDescriptor*> descriptors;
+  BLECharacteristicCallbacks* callbacks = nullptr;
+};
+
+class BLEService {
+public:
+  explicit BLEService(const char* uuid) : uuid(uuid) {}
+
+  BLECharacteristic* createCharacteristic(const char* characteristicUuid, uint32_t properties);
+  void start() { started = true; }
+
+  const char* uuid;
+  bool started = false;
+};
+
+class BLEServerCallbacks {
+public:
+  virtual ~BLEServerCallbacks() {}
+  virtual void onConnect(BLEServer* server) { (void)server; }
+  virtual void onDisconnect(BLEServer* server) { (void)server; }
+  virtual void onMtuChanged(BLEServer* server, esp_ble_gatts_cb_param_t* param) {
+    (void)server;
+    (void)param;
+  }
+};
+
+class BLEServer {
+public:
+  void setCallbacks(BLEServerCallbacks* serverCallbacks) { callbacks = serverCallbacks; }
+  BLEService* createService(const char* uuid);
+  uint32_t getConnectedCount() { return connectedCount; }
+  void startAdvertising();
+
+  BLEServerCallbacks* callbacks = nullptr;
+  uint32_t connectedCount = 0;
+};
+
+class BLEAdvertising {
+public:
+  void addServiceUUID(const char* uuid) { (void)uuid; }
+  void setScanResponse(bool enabled) { (void)enabled; }
+  void setMinPreferred(uint16_t interval) { (void)interval; }
+  void setMaxPreferred(uint16_t interval) { (void)interval; }
+  void start();
+  void stop();
+};
+
+class BLEDevice {
+public:
+  static void init(const char* deviceName);
+  static void setMTU(uint16_t mtu);
+  static BLEServer* createServer();
+  static BLEAdvertising* getAdvertising();
+  static void startAdvertising();
+  static void stopAdvertising();
+};
+
+// Central side of the link, called by the simulation outside the tasks
+struct BleLinkStats {
+  uint32_t connections;
+  uint32_t refusedConnections;
+  uint32_t writes;
+  uint32_t reads;
+  uint32_t notifications;
+  uint64_t notifiedBytes;
+  uint32_t truncatedNotifications;
+};
+
+typedef void (*BleNotifyListener)(const char* uuid, const uint8_t* data, size_t length);
+
+// Only succeeds while the bottle is advertising
+bool bleCentralConnect();
+void bleCentralDisconnect();
+bool bleCentralConnected();
+// The smaller of this and the bottle's preferred MTU is used
+void bleCentralRequestMtu(uint16_t mtu);
+// To the first writable characteristic, or the one with this UUID
+bool bleCentralWrite(const char* uuid, const uint8_t* data, size_t length);
+size_t bleCentralRead(const char* uuid, uint8_t* out, size_t capacity);
+void bleCentralSetNotifyListener(BleNotifyListener listener);
+// Every characteristic created, in order
+size_t bleCharacteristicCount();
+BLECharacteristic* bleCharacteristic(size_t index);
+const BleLinkStats& bleLinkStats();
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef NATIVE_BLESERVER_H
+#define NATIVE_BLESERVER_H
+
+// Everything is declared in BLEDevice.h
+#include "BLEDevice.h"
+
+#endif
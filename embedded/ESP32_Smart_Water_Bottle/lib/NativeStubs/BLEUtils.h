@@ -0,0 +1,7 @@
+#ifndef NATIVE_BLEUTILS_H
+#define NATIVE_BLEUTILS_H
+
+// Everything is declared in BLEDevice.h
+#include "BLEDevice.h"
+
+#endif
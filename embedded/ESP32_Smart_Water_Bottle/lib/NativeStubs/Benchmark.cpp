@@ -0,0 +1,495 @@
+// Entry point of the native-bench build: boots the firmware on the virtual
+// board, then times its hot paths on the host and counts heap allocations.
+//
+//   program [--filter TEXT] [--batch-ms N]
+//
+// Prints one JSON object to stdout, so results can be kept per commit:
+//   {"benchmarks":[{"name":...,"iterations":...,"nsPerCall":...,
+//                   "nsMin":...,"allocationsPerCall":...}],
+//    "pulseTrace":{"sessions":...,"meanEndLatencyMs":...,...}}
+// pulseTrace is the end-of-sip latency and rate error on the synthetic
+// trace the PulseTrace cases replay, printed when those cases run.
+#ifdef WATERBOTTLE_BENCHMARK
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <DrinkJournal.h>
+#include <FlowCalibration.h>
+#include <HistoryCodec.h>
+#include <PulseTrace.h>
+#include <WaterProtocol.h>
+#include "SimBoard.h"
+#include "WaterBottleCommands.h"
+#include "WaterBottleDisplay.h"
+#include "WaterBottleSensor.h"
+
+// Defined in src/WaterBottleMain.cpp, which has no header
+bool parseTimestamp(const char* timestamp, uint64_t& epochMs);
+void processFlowSensorData(const FlowSample& sample);
+
+const uint8_t BENCH_FLOW_PIN = 19;
+const uint8_t BENCH_BUTTON_PIN = 17;
+const uint64_t BENCH_BOOT_US = 2000000;
+const uint32_t DEFAULT_BATCH_MS = 50;
+const int BATCHES = 5;
+// The journal partition from partitions.csv
+const size_t BENCH_JOURNAL_SECTORS = 0x50000 / 4096;
+const uint32_t BENCH_DRAIN_EVENTS = 10000;
+// Notification payload at a 247 byte MTU
+const size_t BENCH_CHUNK_CAPACITY = 244;
+// A compressed day of sips for the pulse trace cases
+const size_t BENCH_SIPS = 40;
+const uint32_t BENCH_SIP_JITTER_PERMILLE = 50;
+const size_t BENCH_TRACE_CAPACITY = 8192;
+const uint32_t BENCH_SAMPLE_PERIOD_MS = 100;
+const uint32_t BENCH_WINDOW_GAP_MS = 3000;
+
+// Every heap allocation of the process. glibc lets the program replace
+// malloc, which also catches operator new and ArduinoJson's default
+// allocator; elsewhere only operator new is counted.
+static uint64_t allocations = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+
+void* malloc(size_t size) {
+  allocations++;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  allocations++;
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+  allocations++;
+  return __libc_realloc(pointer, size);
+}
+}
+#else
+#include <new>
+
+void* operator new(size_t size) {
+  allocations++;
+  void* pointer = malloc(size ? size : 1);
+  if (pointer == nullptr) throw std::bad_alloc();
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+  free(pointer);
+}
+#endif
+
+struct BenchResult {
+  const char* name;
+  uint64_t iterations;
+  double nsPerCall;
+  double nsMin;
+  double allocationsPerCall;
+};
+
+typedef void (*BenchFunction)(uint32_t iteration);
+
+static uint32_t batchMs = DEFAULT_BATCH_MS;
+static BLECharacteristic* commandCharacteristic = nullptr;
+static volatile uint64_t sink = 0;
+
+static double elapsedNs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs batches of at least batchMs each, reports the median batch
+static BenchResult runBenchmark(const char* name, BenchFunction function) {
+  // Warm up and find how many calls fill one batch
+  uint64_t perBatch = 1;
+  uint32_t iteration = 0;
+  for (;;) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < perBatch; i++) function(iteration++);
+    if (elapsedNs(start) >= batchMs * 1e6 / 4) break;
+    perBatch *= 2;
+  }
+  perBatch *= 4;
+
+  double batchNs[BATCHES];
+  uint64_t allocationsBefore = allocations;
+  for (int batch = 0; batch < BATCHES; batch++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < perBatch; i++) function(iteration++);
+    batchNs[batch] = elapsedNs(start) / perBatch;
+  }
+  uint64_t calls = perBatch * BATCHES;
+  std::sort(batchNs, batchNs + BATCHES);
+
+  BenchResult result = { name, calls, batchNs[BATCHES / 2], batchNs[0],
+                         (double)(allocations - allocationsBefore) / calls };
+  return result;
+}
+
+// onWrite() as the Bluedroid task calls it, plus popping the commands it
+// posted so the queue never fills up
+static void writeCommand(const uint8_t* data, size_t length) {
+  commandCharacteristic->setValue((uint8_t*)data, length);
+  commandCharacteristic->getCallbacks()->onWrite(commandCharacteristic);
+  BottleCommand command;
+  while (commandQueue.pop(command)) sink += command.type;
+}
+
+static void benchJsonSettings(uint32_t iteration) {
+  static const char MESSAGE[] = "{\"DrinkReminderType\":1,\"waterGoal\":2500,\"currentWater\":1200}";
+  (void)iteration;
+  writeCommand((const uint8_t*)MESSAGE, sizeof(MESSAGE) - 1);
+}
+
+static void benchJsonSync(uint32_t iteration) {
+  static const char MESSAGE[] = "{\"syncConfirmed\":true,\"timestamp\":\"2025-07-01T08:00:00.000Z\"}";
+  (void)iteration;
+  writeCommand((const uint8_t*)MESSAGE, sizeof(MESSAGE) - 1);
+}
+
+static void benchBinaryFrames(uint32_t iteration) {
+  static uint8_t message[3 * WATER_FRAME_MAX_SIZE];
+  static size_t length = 0;
+  (void)iteration;
+  if (length == 0) {
+    WaterFrame frames[3] = {
+      { FRAME_WATER_GOAL, 1, 0, 2500, 0, 0, 0 },
+      { FRAME_CURRENT_WATER, 2, 0, 1200, 0, 0, 0 },
+      { FRAME_ACK, 3, 0, 16, 0, 0, 0 },
+    };
+    for (int i = 0; i < 3; i++) length += encodeWaterFrame(frames[i], message + length, sizeof(message) - length);
+  }
+  writeCommand(message, length);
+}
+
+static void benchParseTimestamp(uint32_t iteration) {
+  uint64_t epochMs = 0;
+  (void)iteration;
+  parseTimestamp("2025-07-01T08:00:00.000Z", epochMs);
+  sink += epochMs;
+}
+
+// A 3 s pour at 25 Hz every 5 s, so every 50th sample commits a session
+// and journals a drink event
+static void benchFlowSample(uint32_t iteration) {
+  const uint32_t SAMPLE_MS = 100;
+  const uint32_t CYCLE_SAMPLES = 50;
+  const uint32_t POUR_SAMPLES = 30;
+  bool pouring = iteration % CYCLE_SAMPLES < POUR_SAMPLES;
+
+  FlowSample sample;
+  sample.pulses = pouring ? 3 - iteration % 2 : 0;
+  sample.periodUs = SAMPLE_MS * 1000;
+  sample.timeMs = iteration * SAMPLE_MS;
+  sample.rateMilliHz = pouring ? 25000 : 0;
+  sample.flowStopped = !pouring;
+  processFlowSensorData(sample);
+}
+
+// The info screen after a new intake value, drawn into the TFT stand-in
+static void benchShowWaterInfo(uint32_t iteration) {
+  currentWater = iteration % 2 == 0 ? 1200 : 1250;
+  showWaterInfo();
+  renderDisplay();
+}
+
+// One drink event with session details. Acknowledging every 100th keeps
+// the ring from filling, so the sector erases of a long run are included.
+static void benchJournalAppend(uint32_t iteration) {
+  static RamFlashStore flash(4096, BENCH_JOURNAL_SECTORS);
+  static DrinkJournal journal(flash);
+  static bool ready = journal.begin(1);
+  (void)ready;
+
+  JournalRecord record = {};
+  record.timestampMs = 1751356800000ULL + iteration * 60000ULL;
+  record.amountMl = 150;
+  record.durationMs = 3000;
+  record.peakFlowMlPerMin = 4000;
+  record.meanFlowMlPerMin = 3000;
+  journal.append(record);
+  if (record.sequence % 100 == 0) journal.acknowledge(record.sequence);
+  sink += record.sequence;
+}
+
+// Reads a journal of 10,000 undelivered events from the start, in the
+// batches the binary drain uses. One call is the whole drain.
+static void benchJournalDrain(uint32_t iteration) {
+  static RamFlashStore flash(4096, BENCH_JOURNAL_SECTORS);
+  static DrinkJournal journal(flash);
+  static bool ready = false;
+  (void)iteration;
+  if (!ready) {
+    journal.begin(1);
+    for (uint32_t i = 0; i < BENCH_DRAIN_EVENTS; i++) journal.append(1751356800000ULL + i * 60000ULL, 150);
+    ready = true;
+  }
+
+  JournalRecord records[32];
+  uint32_t after = 0;
+  for (;;) {
+    size_t count = journal.readAfter(after, records, 32);
+    if (count == 0) break;
+    after = records[count - 1].sequence;
+  }
+  sink += after;
+}
+
+// Sips a few minutes apart, as a history request reads them
+static const HistoryRecord* historyRecords() {
+  static HistoryRecord records[64];
+  if (records[0].sequence == 0) {
+    for (uint32_t i = 0; i < 64; i++) {
+      HistoryRecord record = { 1 + i, 1751356800000ULL + i * 240000ULL + i * 7919 % 60000, (uint16_t)(80 + i * 37 % 200),
+                               2000 + i * 53 % 3000, (uint16_t)(3000 + i * 97 % 2000), (uint16_t)(2500 + i * 61 % 1500) };
+      records[i] = record;
+    }
+  }
+  return records;
+}
+
+// Fills one chunk as streamHistory() does, until a record no longer fits
+static size_t encodeHistoryChunk(uint8_t* chunk) {
+  const HistoryRecord* records = historyRecords();
+  HistoryChunkWriter writer;
+  writer.begin(chunk, BENCH_CHUNK_CAPACITY);
+  for (size_t i = 0; i < 64 && writer.add(records[i]); i++) {}
+  return writer.finish(64);
+}
+
+static void benchHistoryEncode(uint32_t iteration) {
+  uint8_t chunk[BENCH_CHUNK_CAPACITY];
+  (void)iteration;
+  sink += encodeHistoryChunk(chunk);
+}
+
+static void benchHistoryDecode(uint32_t iteration) {
+  static uint8_t chunk[BENCH_CHUNK_CAPACITY];
+  static size_t length = encodeHistoryChunk(chunk);
+  HistoryRecord records[HISTORY_CHUNK_MAX_RECORDS];
+  size_t count = 0;
+  (void)iteration;
+  decodeHistoryChunk(chunk, length, records, HISTORY_CHUNK_MAX_RECORDS, count);
+  sink += count;
+}
+
+// 40 sips of 1 to 4 s at 5 to 25 Hz, 1.5 to 9 s apart, the same on every run
+static const SipSpec* benchSips() {
+  static SipSpec sips[BENCH_SIPS];
+  static bool ready = false;
+  if (!ready) {
+    uint32_t state = 12345;
+    uint32_t startMs = 1000;
+    for (size_t i = 0; i < BENCH_SIPS; i++) {
+      state = state * 1664525 + 1013904223;
+      sips[i].startMs = startMs;
+      sips[i].durationMs = 1000 + (state >> 8) % 3000;
+      sips[i].peakHz = 5 + (state >> 20) % 21;
+      startMs += sips[i].durationMs + 1500 + (state >> 12) % 7500;
+    }
+    ready = true;
+  }
+  return sips;
+}
+
+static const uint32_t* benchTrace(size_t& count) {
+  static uint32_t pulses[BENCH_TRACE_CAPACITY];
+  static size_t pulseCount =
+      synthesizePulseTrace(benchSips(), BENCH_SIPS, BENCH_SIP_JITTER_PERMILLE, 1, pulses, BENCH_TRACE_CAPACITY);
+  count = pulseCount;
+  return pulses;
+}
+
+// Both end-of-pour detectors over the whole trace
+static void benchPulseTraceReplay(uint32_t iteration) {
+  size_t count = 0;
+  const uint32_t* pulses = benchTrace(count);
+  ReplayStats window;
+  ReplayStats interval;
+  (void)iteration;
+  replayPulseTrace(pulses, count, BENCH_SAMPLE_PERIOD_MS, BENCH_WINDOW_GAP_MS, DEFAULT_PULSE_FLOW_CONFIG, window,
+                   interval);
+  sink += window.sessions + interval.sessions;
+}
+
+// One pulse into PulseFlowMeter and its rate read back, as the sensor
+// task does with FLOW_PULSE_TIMESTAMPS
+static void benchPulseFlowMeter(uint32_t iteration) {
+  static PulseFlowMeter meter;
+  size_t count = 0;
+  const uint32_t* pulses = benchTrace(count);
+  size_t index = iteration % count;
+  if (index == 0) meter.reset();
+  meter.addPulse(pulses[index]);
+  sink += meter.rateMilliHz(pulses[index]);
+}
+
+// volumeMicroLiters() for one sample, at rates swept from below the first
+// to above the last point so every segment and both ends are looked up
+static void lookupCalibration(const FlowCalibration& calibration, uint32_t iteration) {
+  uint32_t rateMilliHz = (iteration * 997) % 30000;
+  sink += calibration.volumeMicroLiters(2, rateMilliHz);
+}
+
+static void benchCalibrationDefault(uint32_t iteration) {
+  static FlowCalibration calibration;
+  lookupCalibration(calibration, iteration);
+}
+
+static void benchCalibrationFull(uint32_t iteration) {
+  static FlowCalibration calibration;
+  static bool ready = false;
+  if (!ready) {
+    CalibrationTable table = { CALIBRATION_VERSION, CALIBRATION_MAX_POINTS, {} };
+    for (size_t i = 0; i < CALIBRATION_MAX_POINTS; i++) {
+      table.points[i].rateMilliHz = 2000 + (uint32_t)i * 3000;
+      table.points[i].microLitersPerPulse = 2600 - (uint32_t)i * 50;
+    }
+    calibration.setTable(table);
+    ready = true;
+  }
+  lookupCalibration(calibration, iteration);
+}
+
+struct PulseTraceQuality {
+  ReplayStats window;
+  ReplayStats interval;
+  uint32_t meanRateErrorPermille;
+  uint32_t maxRateErrorPermille;
+};
+
+// End latency of both detectors, and how far the PulseFlowMeter rate is
+// from the true frequency on the flat part of each sip once its interval
+// average only holds plateau pulses
+static PulseTraceQuality measurePulseTrace() {
+  PulseTraceQuality quality = {};
+  size_t count = 0;
+  const uint32_t* pulses = benchTrace(count);
+  const SipSpec* sips = benchSips();
+  replayPulseTrace(pulses, count, BENCH_SAMPLE_PERIOD_MS, BENCH_WINDOW_GAP_MS, DEFAULT_PULSE_FLOW_CONFIG,
+                   quality.window, quality.interval);
+
+  PulseFlowMeter meter;
+  uint64_t errorTotal = 0;
+  uint32_t samples = 0;
+  size_t sip = 0;
+  for (size_t i = 0; i < count; i++) {
+    meter.addPulse(pulses[i]);
+    uint32_t ms = pulses[i] / 1000;
+    while (sip + 1 < BENCH_SIPS && ms >= sips[sip + 1].startMs) sip++;
+    uint32_t ramp = sips[sip].durationMs / 5;
+    uint32_t settleMs = (FLOW_METER_INTERVALS + 1) * 1000 / sips[sip].peakHz;
+    uint32_t t = ms - sips[sip].startMs;
+    if (t < ramp + settleMs || t > sips[sip].durationMs - ramp) continue;
+
+    uint32_t trueRate = sips[sip].peakHz * 1000;
+    uint32_t rate = meter.rateMilliHz(pulses[i]);
+    uint32_t error = (uint32_t)((uint64_t)(rate > trueRate ? rate - trueRate : trueRate - rate) * 1000 / trueRate);
+    errorTotal += error;
+    samples++;
+    if (error > quality.maxRateErrorPermille) quality.maxRateErrorPermille = error;
+  }
+  if (samples > 0) quality.meanRateErrorPermille = (uint32_t)(errorTotal / samples);
+  return quality;
+}
+
+struct BenchCase {
+  const char* name;
+  BenchFunction function;
+};
+
+static const BenchCase CASES[] = {
+  { "onWrite/json_settings", benchJsonSettings },
+  { "onWrite/json_sync", benchJsonSync },
+  { "onWrite/binary_frames", benchBinaryFrames },
+  { "parseTimestamp", benchParseTimestamp },
+  { "processFlowSensorData", benchFlowSample },
+  { "showWaterInfo/render", benchShowWaterInfo },
+  { "DrinkJournal/append", benchJournalAppend },
+  { "DrinkJournal/drain_10k", benchJournalDrain },
+  { "HistoryCodec/encode_chunk", benchHistoryEncode },
+  { "HistoryCodec/decode_chunk", benchHistoryDecode },
+  { "PulseTrace/replay_day", benchPulseTraceReplay },
+  { "PulseFlowMeter/add_pulse", benchPulseFlowMeter },
+  { "FlowCalibration/lookup_default", benchCalibrationDefault },
+  { "FlowCalibration/lookup_8_points", benchCalibrationFull },
+};
+
+// Runs setup() and a second of loop() on the virtual board with a central
+// connected and synced, the state the hot paths normally run in
+static void bootFirmware() {
+  Serial.setOutput(nullptr);
+  simSetPinLevel(BENCH_FLOW_PIN, HIGH);
+  simSetPinLevel(BENCH_BUTTON_PIN, HIGH);
+  startArduinoLoopTask(1000);
+  simRunUntil(BENCH_BOOT_US / 2);
+
+  bleCentralConnect();
+  static const char SYNC[] = "{\"syncConfirmed\":true,\"timestamp\":\"2025-07-01T08:00:00.000Z\"}";
+  bleCentralWrite(nullptr, (const uint8_t*)SYNC, sizeof(SYNC) - 1);
+  simRunUntil(BENCH_BOOT_US);
+
+  for (size_t i = 0; i < bleCharacteristicCount(); i++) {
+    if (bleCharacteristic(i)->getProperties() & BLECharacteristic::PROPERTY_WRITE) {
+      commandCharacteristic = bleCharacteristic(i);
+      break;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  const char* filter = nullptr;
+  for (int i = 1; i < argc; i++) {
+    std::string option = argv[i];
+    if (option == "--filter" && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (option == "--batch-ms" && i + 1 < argc) {
+      batchMs = (uint32_t)atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: program [--filter TEXT] [--batch-ms N]\n");
+      return 2;
+    }
+  }
+
+  bootFirmware();
+  if (commandCharacteristic == nullptr) {
+    fprintf(stderr, "firmware created no writable characteristic\n");
+    return 1;
+  }
+
+  printf("{\"benchmarks\":[");
+  bool first = true;
+  for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+    if (filter != nullptr && strstr(CASES[i].name, filter) == nullptr) continue;
+    BenchResult result = runBenchmark(CASES[i].name, CASES[i].function);
+    printf("%s\n  {\"name\":\"%s\",\"iterations\":%llu,\"nsPerCall\":%.1f,\"nsMin\":%.1f,\"allocationsPerCall\":%.2f}",
+           first ? "" : ",", result.name, (unsigned long long)result.iterations, result.nsPerCall, result.nsMin,
+           result.allocationsPerCall);
+    first = false;
+  }
+  printf("\n]");
+
+  if (filter == nullptr || strstr("PulseTrace/replay_day", filter) != nullptr) {
+    PulseTraceQuality quality = measurePulseTrace();
+    printf(",\n\"pulseTrace\":{\"sips\":%u,\"pulses\":%lu,\"windowSessions\":%lu,\"windowMeanEndLatencyMs\":%lu,"
+           "\"windowMaxEndLatencyMs\":%lu,\"gapSessions\":%lu,\"gapMeanEndLatencyMs\":%lu,"
+           "\"gapMaxEndLatencyMs\":%lu,\"meanRateErrorPermille\":%lu,\"maxRateErrorPermille\":%lu}",
+           (unsigned)BENCH_SIPS, (unsigned long)quality.interval.pulses, (unsigned long)quality.window.sessions,
+           (unsigned long)quality.window.meanEndLatencyMs, (unsigned long)quality.window.maxEndLatencyMs,
+           (unsigned long)quality.interval.sessions, (unsigned long)quality.interval.meanEndLatencyMs,
+           (unsigned long)quality.interval.maxEndLatencyMs, (unsigned long)quality.meanRateErrorPermille,
+           (unsigned long)quality.maxRateErrorPermille);
+  }
+  printf("}\n");
+  return 0;
+}
+
+#endif
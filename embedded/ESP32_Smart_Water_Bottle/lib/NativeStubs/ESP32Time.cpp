@@ -0,0 +1,49 @@
+#include "ESP32Time.h"
+#include <stdint.h>
+#include "SimBoard.h"
+
+// System time minus the virtual clock, in microseconds
+static int64_t epochOffsetUs = 0;
+
+static int64_t systemTimeUs() {
+  return (int64_t)simNowUs() + epochOffsetUs;
+}
+
+// unsigned long is 32 bits on the chip, larger epochs wrap there too
+void ESP32Time::setTime(unsigned long epoch, int ms) {
+  epochOffsetUs = (int64_t)(uint32_t)epoch * 1000000 + (int64_t)ms * 1000 - (int64_t)simNowUs();
+}
+
+void ESP32Time::setTime(int second, int minute, int hour, int day, int month, int year, int ms) {
+  struct tm time = {};
+  time.tm_year = year - 1900;
+  time.tm_mon = month - 1;
+  time.tm_mday = day;
+  time.tm_hour = hour;
+  time.tm_min = minute;
+  time.tm_sec = second;
+  setTime((unsigned long)timegm(&time), ms);
+}
+
+struct tm ESP32Time::getTimeStruct() {
+  time_t now = (time_t)getLocalEpoch();
+  struct tm time;
+  gmtime_r(&now, &time);
+  return time;
+}
+
+unsigned long ESP32Time::getEpoch() {
+  return (unsigned long)(systemTimeUs() / 1000000);
+}
+
+unsigned long ESP32Time::getLocalEpoch() {
+  return getEpoch() + offset;
+}
+
+unsigned long ESP32Time::getMillis() {
+  return (unsigned long)(systemTimeUs() / 1000 % 1000);
+}
+
+unsigned long ESP32Time::getMicros() {
+  return (unsigned long)(systemTimeUs() % 1000000);
+}
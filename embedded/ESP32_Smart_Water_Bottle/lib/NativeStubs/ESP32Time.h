@@ -0,0 +1,25 @@
+#ifndef NATIVE_ESP32TIME_H
+#define NATIVE_ESP32TIME_H
+
+#include <time.h>
+
+// Same interface as fbiego/ESP32Time. The system time is an offset to the
+// virtual clock, shared by all instances like settimeofday() on the chip.
+class ESP32Time {
+public:
+  explicit ESP32Time(unsigned long offset = 0) : offset(offset) {}
+
+  void setTime(unsigned long epoch = 1609459200, int ms = 0);
+  void setTime(int second, int minute, int hour, int day, int month, int year, int ms = 0);
+
+  struct tm getTimeStruct();
+  unsigned long getEpoch();
+  unsigned long getLocalEpoch();
+  unsigned long getMillis();
+  unsigned long getMicros();
+
+private:
+  unsigned long offset;
+};
+
+#endif
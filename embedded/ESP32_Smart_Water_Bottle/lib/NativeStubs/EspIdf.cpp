@@ -0,0 +1,275 @@
+#include <string.h>
+#include <map>
+#include <string>
+#include <FlashStore.h>
+#include "SimBoard.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "hal/cpu_hal.h"
+#include "rom/ets_sys.h"
+#include "hal/gpio_ll.h"
+#include "driver/pcnt.h"
+
+int64_t esp_timer_get_time() {
+  return (int64_t)simNowUs();
+}
+
+uint32_t cpu_hal_get_cycle_count() {
+  return (uint32_t)(simNowUs() * 240);
+}
+
+uint32_t ets_get_cpu_frequency() {
+  return 240;
+}
+
+// GPIO interrupts map onto the pins of the virtual board
+gpio_dev_t GPIO;
+
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type) {
+  simSetInterruptType(pin, type);
+  return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t pin) {
+  simEnableInterrupt(pin, true);
+  return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t pin) {
+  simEnableInterrupt(pin, false);
+  return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type) {
+  (void)pin;
+  (void)type;
+  return ESP_OK;
+}
+
+void gpio_ll_set_intr_type(gpio_dev_t* hw, gpio_num_t pin, gpio_int_type_t type) {
+  (void)hw;
+  simSetInterruptType(pin, type);
+}
+
+// Pulse counter
+const uint32_t PCNT_FILTER_CLOCK_MHZ = 80;
+
+struct SimPcntUnit {
+  bool configured;
+  int pin;
+  pcnt_count_mode_t posMode;
+  pcnt_count_mode_t negMode;
+  int16_t highLimit;
+  int16_t lowLimit;
+  uint16_t filterCycles;
+  bool filterEnabled;
+  uint32_t events;
+  bool running;
+  int16_t count;
+  void (*handler)(void* argument);
+  void* argument;
+};
+
+static SimPcntUnit pcntUnits[PCNT_UNIT_MAX];
+static bool pcntListening = false;
+
+static void countEdge(SimPcntUnit& unit, pcnt_count_mode_t mode) {
+  if (mode == PCNT_COUNT_INC) {
+    unit.count++;
+  } else if (mode == PCNT_COUNT_DEC) {
+    unit.count--;
+  } else {
+    return;
+  }
+
+  if (unit.count >= unit.highLimit && unit.highLimit > 0) {
+    unit.count = 0;
+    if ((unit.events & PCNT_EVT_H_LIM) && unit.handler != nullptr) unit.handler(unit.argument);
+  } else if (unit.count <= unit.lowLimit && unit.lowLimit < 0) {
+    unit.count = 0;
+    if ((unit.events & PCNT_EVT_L_LIM) && unit.handler != nullptr) unit.handler(unit.argument);
+  }
+}
+
+static void onPcntEdge(uint8_t pin, int level, uint64_t heldUs) {
+  for (int i = 0; i < PCNT_UNIT_MAX; i++) {
+    SimPcntUnit& unit = pcntUnits[i];
+    if (!unit.configured || !unit.running || unit.pin != pin) continue;
+    if (unit.filterEnabled && heldUs * PCNT_FILTER_CLOCK_MHZ < unit.filterCycles) continue;
+    countEdge(unit, level ? unit.posMode : unit.negMode);
+  }
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config) {
+  if (config->unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+  SimPcntUnit& unit = pcntUnits[config->unit];
+  unit.configured = true;
+  unit.pin = config->pulse_gpio_num;
+  unit.posMode = config->pos_mode;
+  unit.negMode = config->neg_mode;
+  unit.highLimit = config->counter_h_lim;
+  unit.lowLimit = config->counter_l_lim;
+  unit.count = 0;
+  unit.running = true;
+  if (!pcntListening) {
+    simAddEdgeListener(onPcntEdge);
+    pcntListening = true;
+  }
+  return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t filterCycles) {
+  if (filterCycles > 1023) return ESP_ERR_INVALID_ARG;
+  pcntUnits[unit].filterCycles = filterCycles;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit) {
+  pcntUnits[unit].filterEnabled = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t event) {
+  pcntUnits[unit].events |= event;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_isr_service_install(int flags) {
+  (void)flags;
+  static bool installed = false;
+  if (installed) return ESP_ERR_INVALID_STATE;
+  installed = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*handler)(void* argument), void* argument) {
+  pcntUnits[unit].handler = handler;
+  pcntUnits[unit].argument = argument;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit) {
+  pcntUnits[unit].running = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit) {
+  pcntUnits[unit].running = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit) {
+  pcntUnits[unit].count = 0;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count) {
+  *count = pcntUnits[unit].count;
+  return ESP_OK;
+}
+
+// Power management
+struct esp_pm_lock {
+  esp_pm_lock_type_t type;
+  const char* name;
+  int count;
+};
+
+esp_err_t esp_pm_configure(const void* config) {
+  const esp_pm_config_esp32_t* pm = (const esp_pm_config_esp32_t*)config;
+  if (pm->light_sleep_enable && !simTicklessIdle()) return ESP_ERR_NOT_SUPPORTED;
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char* name, esp_pm_lock_handle_t* handle) {
+  (void)arg;
+  esp_pm_lock* lock = new esp_pm_lock();
+  lock->type = type;
+  lock->name = name;
+  *handle = lock;
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+  if (handle == nullptr) return ESP_ERR_INVALID_ARG;
+  handle->count++;
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+  if (handle == nullptr) return ESP_ERR_INVALID_ARG;
+  if (handle->count == 0) return ESP_ERR_INVALID_STATE;
+  handle->count--;
+  return ESP_OK;
+}
+
+// Sleep
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+  return ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup() {
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t pin, int level) {
+  (void)pin;
+  (void)level;
+  return ESP_OK;
+}
+
+void esp_deep_sleep_start() {
+  simStop("deep sleep");
+  abort();
+}
+
+// Partitions
+struct SimPartition {
+  esp_partition_t partition;
+  RamFlashStore* flash;
+};
+
+static std::map<std::string, SimPartition> partitions;
+
+static RamFlashStore* partitionFlash(const esp_partition_t* partition) {
+  return partitions[partition->label].flash;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+  if (type != ESP_PARTITION_TYPE_DATA || label == nullptr) return nullptr;
+  SimPartition& entry = partitions[label];
+  if (entry.flash == nullptr) {
+    entry.partition.type = type;
+    entry.partition.subtype = subtype;
+    entry.partition.size = SIM_PARTITION_SIZE;
+    strncpy(entry.partition.label, label, sizeof(entry.partition.label) - 1);
+    entry.flash = new RamFlashStore(SPI_FLASH_SEC_SIZE, SIM_PARTITION_SIZE / SPI_FLASH_SEC_SIZE);
+  }
+  return &entry.partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* data, size_t length) {
+  return partitionFlash(partition)->read(offset, data, length) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* data, size_t length) {
+  return partitionFlash(partition)->write(offset, data, length) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t length) {
+  if (offset % SPI_FLASH_SEC_SIZE != 0 || length % SPI_FLASH_SEC_SIZE != 0) return ESP_ERR_INVALID_ARG;
+  RamFlashStore* flash = partitionFlash(partition);
+  for (size_t sector = offset / SPI_FLASH_SEC_SIZE; sector < (offset + length) / SPI_FLASH_SEC_SIZE; sector++) {
+    if (!flash->eraseSector(sector)) return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
+
+void heap_caps_get_info(multi_heap_info_t* info, uint32_t caps) {
+  (void)caps;
+  memset(info, 0, sizeof(*info));
+}
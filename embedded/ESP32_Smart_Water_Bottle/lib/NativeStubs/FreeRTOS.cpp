@@ -0,0 +1,59 @@
+#include "freertos/task.h"
+#include "SimBoard.h"
+
+static uint64_t ticksToUs(TickType_t ticks) {
+  return ticks == portMAX_DELAY ? SIM_FOREVER : (uint64_t)ticks * 1000000 / configTICK_RATE_HZ;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* createdTask, BaseType_t core) {
+  (void)stackDepth;
+  (void)priority;
+  (void)core;
+  SimTask* task = simCreateTask(function, parameter, name);
+  if (createdTask != nullptr) *createdTask = task;
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  // Only self deletion is used
+  if (task == nullptr || task == simCurrentTask()) simEndTask();
+}
+
+void vTaskDelay(TickType_t ticks) {
+  simBlockUntil(simNowUs() + ticksToUs(ticks));
+}
+
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment) {
+  *previousWake += increment;
+  uint64_t wakeUs = ticksToUs(*previousWake);
+  // Like FreeRTOS, a missed wake time does not block
+  if (wakeUs > simNowUs()) simBlockUntil(wakeUs);
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(simNowUs() * configTICK_RATE_HZ / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return simCurrentTask();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+  return simWaitNotify(clearOnExit != pdFALSE, ticksToUs(ticksToWait));
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  simNotify(task);
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+  simNotify(task);
+  if (higherPriorityTaskWoken != nullptr) *higherPriorityTaskWoken = pdFALSE;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  (void)task;
+  return 0;
+}
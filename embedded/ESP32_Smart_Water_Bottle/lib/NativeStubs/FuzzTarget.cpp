@@ -0,0 +1,172 @@
+// Entry point of the native-fuzz build: feeds arbitrary bytes into the BLE
+// write path of the firmware. onWrite() decodes them as JSON or binary
+// frames, and loop() then applies the commands it posted.
+//
+// Built with clang and WATERBOTTLE_LIBFUZZER, libFuzzer provides main().
+// Otherwise a small driver replays the given files, then mutates a built-in
+// set of valid messages:
+//
+//   program [--runs N] [--seed S] [FILE...]
+#ifdef WATERBOTTLE_FUZZ
+
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <WaterProtocol.h>
+#include "SimBoard.h"
+
+const uint8_t FUZZ_FLOW_PIN = 19;
+const uint8_t FUZZ_BUTTON_PIN = 17;
+const uint64_t FUZZ_BOOT_US = 1000000;
+// Longest attribute value a central can write
+const size_t FUZZ_MAX_WRITE = 512;
+// loop() runs this long after every write, enough to apply every command
+const uint64_t FUZZ_LOOP_US = 50000;
+
+// Boots the firmware with a central connected at a 185 byte MTU
+static void bootFirmware() {
+  Serial.setOutput(nullptr);
+  simSetPinLevel(FUZZ_FLOW_PIN, HIGH);
+  simSetPinLevel(FUZZ_BUTTON_PIN, HIGH);
+  startArduinoLoopTask(1000);
+  simRunUntil(FUZZ_BOOT_US);
+  bleCentralConnect();
+  bleCentralRequestMtu(185);
+  simRunUntil(simNowUs() + FUZZ_LOOP_US);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  static bool booted = false;
+  if (!booted) {
+    bootFirmware();
+    booted = true;
+  }
+  if (size == 0 || size > FUZZ_MAX_WRITE) return 0;
+
+  bleCentralWrite(nullptr, data, size);
+  simRunUntil(simNowUs() + FUZZ_LOOP_US);
+  return 0;
+}
+
+#ifndef WATERBOTTLE_LIBFUZZER
+
+const uint32_t DEFAULT_RUNS = 100000;
+const int MAX_MUTATIONS = 4;
+
+static const char* JSON_SEEDS[] = {
+  "{\"syncConfirmed\":true,\"timestamp\":\"2025-07-01T08:00:00.000Z\"}",
+  "{\"syncConfirmed\":true}",
+  "{\"DrinkReminderType\":2,\"waterGoal\":2500,\"currentWater\":1200}",
+  "{\"calibrate\":250}",
+  "{\"calibrate\":-1}",
+};
+
+static const uint8_t FRAME_SEEDS[] = {
+  FRAME_HELLO, FRAME_SYNC_CONFIRM, FRAME_REMINDER, FRAME_WATER_GOAL, FRAME_CURRENT_WATER,
+  FRAME_ACK, FRAME_HISTORY_REQUEST, FRAME_CALIBRATE,
+};
+
+static std::vector<std::vector<uint8_t> > corpus;
+static uint32_t randomState = 1;
+
+// xorshift32, the same inputs for the same seed on every host
+static uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+static void buildCorpus() {
+  for (size_t i = 0; i < sizeof(JSON_SEEDS) / sizeof(JSON_SEEDS[0]); i++) {
+    corpus.push_back(std::vector<uint8_t>(JSON_SEEDS[i], JSON_SEEDS[i] + strlen(JSON_SEEDS[i])));
+  }
+  for (size_t i = 0; i < sizeof(FRAME_SEEDS); i++) {
+    WaterFrame frame = { FRAME_SEEDS[i], (uint32_t)i, 1751356800000ULL, 1200, 0, 0, 0 };
+    uint8_t buffer[WATER_FRAME_MAX_SIZE];
+    size_t length = encodeWaterFrame(frame, buffer, sizeof(buffer));
+    corpus.push_back(std::vector<uint8_t>(buffer, buffer + length));
+  }
+}
+
+static void mutate(std::vector<uint8_t>& input) {
+  int mutations = 1 + nextRandom() % MAX_MUTATIONS;
+  for (int i = 0; i < mutations; i++) {
+    size_t position = input.empty() ? 0 : nextRandom() % input.size();
+    switch (nextRandom() % 6) {
+      case 0:
+        if (!input.empty()) input[position] ^= 1 << (nextRandom() % 8);
+        break;
+      case 1:
+        if (!input.empty()) input[position] = (uint8_t)nextRandom();
+        break;
+      case 2:
+        input.insert(input.begin() + position, (uint8_t)nextRandom());
+        break;
+      case 3:
+        if (!input.empty()) input.erase(input.begin() + position);
+        break;
+      case 4:
+        input.resize(position);
+        break;
+      default: {
+        // Concatenates another message, several frames may share a write
+        const std::vector<uint8_t>& other = corpus[nextRandom() % corpus.size()];
+        input.insert(input.end(), other.begin(), other.end());
+        break;
+      }
+    }
+  }
+}
+
+static bool replayFile(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) return false;
+  std::vector<uint8_t> input;
+  int c;
+  while ((c = fgetc(file)) != EOF) input.push_back((uint8_t)c);
+  fclose(file);
+  LLVMFuzzerTestOneInput(input.data(), input.size());
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint32_t runs = DEFAULT_RUNS;
+  std::vector<const char*> files;
+  for (int i = 1; i < argc; i++) {
+    std::string option = argv[i];
+    if (option == "--runs" && i + 1 < argc) {
+      runs = (uint32_t)atol(argv[++i]);
+    } else if (option == "--seed" && i + 1 < argc) {
+      randomState = (uint32_t)atol(argv[++i]);
+      if (randomState == 0) randomState = 1;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+
+  for (size_t i = 0; i < files.size(); i++) {
+    if (!replayFile(files[i])) {
+      fprintf(stderr, "cannot read %s\n", files[i]);
+      return 1;
+    }
+  }
+
+  buildCorpus();
+  uint64_t bytes = 0;
+  for (uint32_t run = 0; run < runs; run++) {
+    std::vector<uint8_t> input = corpus[nextRandom() % corpus.size()];
+    mutate(input);
+    bytes += input.size();
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+
+  fprintf(stderr, "%zu files and %u mutated inputs (%llu bytes) in %.0f s of virtual time%s%s\n", files.size(), runs,
+          (unsigned long long)bytes, simNowUs() / 1e6, simStopped() ? ", stopped by " : "",
+          simStopped() ? simStopReason() : "");
+  return 0;
+}
+
+#endif
+#endif
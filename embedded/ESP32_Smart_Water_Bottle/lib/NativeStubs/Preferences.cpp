@@ -0,0 +1,50 @@
+#include "Preferences.h"
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t> > PreferenceSpace;
+static std::map<std::string, PreferenceSpace> storage;
+
+bool Preferences::begin(const char* name, bool openReadOnly) {
+  space = name;
+  readOnly = openReadOnly;
+  return true;
+}
+
+void Preferences::end() {
+  space = nullptr;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (space == nullptr) return 0;
+  PreferenceSpace& entries = storage[space];
+  PreferenceSpace::iterator entry = entries.find(key);
+  return entry != entries.end() ? entry->second.size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t length) {
+  size_t stored = getBytesLength(key);
+  if (stored == 0 || stored > length) return 0;
+  memcpy(buffer, storage[space][key].data(), stored);
+  return stored;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+  if (space == nullptr || readOnly) return 0;
+  const uint8_t* bytes = (const uint8_t*)value;
+  storage[space][key].assign(bytes, bytes + length);
+  return length;
+}
+
+bool Preferences::remove(const char* key) {
+  if (space == nullptr || readOnly) return false;
+  return storage[space].erase(key) > 0;
+}
+
+bool Preferences::clear() {
+  if (space == nullptr || readOnly) return false;
+  storage[space].clear();
+  return true;
+}
@@ -0,0 +1,284 @@
+#include "SimBoard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+#include <queue>
+#include <vector>
+
+// Host code needs far more stack than the firmware asks for
+const size_t SIM_TASK_STACK = 256 * 1024;
+
+struct SimTask {
+  ucontext_t context;
+  SimTaskFunction function;
+  void* parameter;
+  const char* name;
+  char* stack;
+  // Runnable from this time, SIM_FOREVER while waiting for a notification only
+  uint64_t wakeUs;
+  bool waitingNotify;
+  uint32_t notifyCount;
+  uint32_t runs;
+  bool finished;
+};
+
+struct SimTimer {
+  uint64_t timeUs;
+  uint64_t order;
+  SimTimerFunction function;
+  void* argument;
+
+  bool operator>(const SimTimer& other) const {
+    return timeUs != other.timeUs ? timeUs > other.timeUs : order > other.order;
+  }
+};
+
+struct SimPin {
+  int level;
+  uint64_t changedUs;
+  uint8_t interruptType;
+  bool interruptEnabled;
+  SimInterruptHandler handler;
+};
+
+static uint64_t nowUs = 0;
+static std::vector<SimTask*> tasks;
+static SimTask* current = nullptr;
+static ucontext_t schedulerContext;
+static std::priority_queue<SimTimer, std::vector<SimTimer>, std::greater<SimTimer> > timers;
+static uint64_t timerOrder = 0;
+static uint64_t switches = 0;
+static bool stopped = false;
+static const char* stopReason = "";
+
+static SimPin pins[SIM_PIN_COUNT];
+static std::vector<SimEdgeListener> edgeListeners;
+static uint32_t interrupts = 0;
+static bool ticklessIdle = false;
+
+uint64_t simNowUs() {
+  return nowUs;
+}
+
+static void taskEntry() {
+  current->function(current->parameter);
+  simEndTask();
+}
+
+SimTask* simCreateTask(SimTaskFunction function, void* parameter, const char* name) {
+  SimTask* task = new SimTask();
+  task->function = function;
+  task->parameter = parameter;
+  task->name = name;
+  task->stack = (char*)malloc(SIM_TASK_STACK);
+  task->wakeUs = nowUs;
+
+  getcontext(&task->context);
+  task->context.uc_stack.ss_sp = task->stack;
+  task->context.uc_stack.ss_size = SIM_TASK_STACK;
+  task->context.uc_link = &schedulerContext;
+  makecontext(&task->context, taskEntry, 0);
+  tasks.push_back(task);
+  return task;
+}
+
+SimTask* simCurrentTask() {
+  return current;
+}
+
+const char* simTaskName(const SimTask* task) {
+  return task->name;
+}
+
+uint32_t simTaskRuns(const SimTask* task) {
+  return task->runs;
+}
+
+size_t simTaskCount() {
+  return tasks.size();
+}
+
+SimTask* simTask(size_t index) {
+  return tasks[index];
+}
+
+// Hands control back to the scheduler until the task is resumed
+static void suspend() {
+  SimTask* task = current;
+  swapcontext(&task->context, &schedulerContext);
+}
+
+void simBlockUntil(uint64_t wakeUs) {
+  if (current == nullptr) return;
+  current->wakeUs = wakeUs;
+  suspend();
+}
+
+uint32_t simWaitNotify(bool clear, uint64_t timeoutUs) {
+  SimTask* task = current;
+  if (task == nullptr) return 0;
+  if (task->notifyCount == 0 && timeoutUs > 0) {
+    task->waitingNotify = true;
+    task->wakeUs = timeoutUs == SIM_FOREVER ? SIM_FOREVER : nowUs + timeoutUs;
+    suspend();
+    task->waitingNotify = false;
+  }
+  uint32_t count = task->notifyCount;
+  if (count > 0) task->notifyCount = clear ? 0 : count - 1;
+  return count;
+}
+
+void simNotify(SimTask* task) {
+  if (task == nullptr || task->finished) return;
+  task->notifyCount++;
+  if (task->waitingNotify) task->wakeUs = nowUs;
+}
+
+void simEndTask() {
+  current->finished = true;
+  for (;;) suspend();
+}
+
+void simScheduleTimer(uint64_t timeUs, SimTimerFunction function, void* argument) {
+  SimTimer timer = { timeUs < nowUs ? nowUs : timeUs, timerOrder++, function, argument };
+  timers.push(timer);
+}
+
+// Earliest due task first, tasks created earlier first on a tie
+static SimTask* nextTask() {
+  SimTask* next = nullptr;
+  for (size_t i = 0; i < tasks.size(); i++) {
+    SimTask* task = tasks[i];
+    if (task->finished) continue;
+    if (next == nullptr || task->wakeUs < next->wakeUs) next = task;
+  }
+  return next;
+}
+
+void simRunUntil(uint64_t untilUs) {
+  while (!stopped) {
+    SimTask* task = nextTask();
+    uint64_t taskUs = task != nullptr ? task->wakeUs : SIM_FOREVER;
+    uint64_t timerUs = timers.empty() ? SIM_FOREVER : timers.top().timeUs;
+    uint64_t next = timerUs <= taskUs ? timerUs : taskUs;
+    if (next > untilUs) break;
+    if (next > nowUs) nowUs = next;
+
+    if (timerUs <= taskUs) {
+      SimTimer timer = timers.top();
+      timers.pop();
+      timer.function(timer.argument);
+    } else {
+      current = task;
+      task->runs++;
+      switches++;
+      swapcontext(&schedulerContext, &task->context);
+      current = nullptr;
+    }
+  }
+  if (!stopped && untilUs > nowUs) nowUs = untilUs;
+}
+
+void simStop(const char* reason) {
+  stopped = true;
+  stopReason = reason;
+  if (current != nullptr) {
+    current->finished = true;
+    for (;;) suspend();
+  }
+}
+
+bool simStopped() {
+  return stopped;
+}
+
+const char* simStopReason() {
+  return stopReason;
+}
+
+uint64_t simSwitches() {
+  return switches;
+}
+
+// Fires the pin's interrupt if its type matches the edge or the level
+static void checkInterrupt(uint8_t pin, bool edge) {
+  SimPin& state = pins[pin];
+  if (!state.interruptEnabled || state.handler == nullptr) return;
+
+  bool fire = false;
+  switch (state.interruptType) {
+    case SIM_INTR_POSEDGE: fire = edge && state.level == 1; break;
+    case SIM_INTR_NEGEDGE: fire = edge && state.level == 0; break;
+    case SIM_INTR_ANYEDGE: fire = edge; break;
+    case SIM_INTR_LOW_LEVEL: fire = state.level == 0; break;
+    case SIM_INTR_HIGH_LEVEL: fire = state.level == 1; break;
+  }
+  // A level interrupt that stays enabled would fire again right away on
+  // the chip, handlers here are expected to disable it like the firmware does
+  if (fire) {
+    interrupts++;
+    state.handler();
+  }
+}
+
+void simSetPinLevel(uint8_t pin, int level) {
+  if (pin >= SIM_PIN_COUNT) return;
+  SimPin& state = pins[pin];
+  level = level != 0;
+  if (state.level == level) return;
+
+  uint64_t heldUs = nowUs - state.changedUs;
+  state.level = level;
+  state.changedUs = nowUs;
+  for (size_t i = 0; i < edgeListeners.size(); i++) {
+    edgeListeners[i](pin, level, heldUs);
+  }
+  checkInterrupt(pin, true);
+}
+
+int simPinLevel(uint8_t pin) {
+  return pin < SIM_PIN_COUNT ? pins[pin].level : 0;
+}
+
+void simDrivePin(uint8_t pin, int level) {
+  if (pin >= SIM_PIN_COUNT) return;
+  pins[pin].level = level != 0;
+}
+
+void simSetPinPullUp(uint8_t pin) {
+  if (pin >= SIM_PIN_COUNT) return;
+  if (pins[pin].changedUs == 0) pins[pin].level = 1;
+}
+
+void simSetInterruptHandler(uint8_t pin, SimInterruptHandler handler) {
+  if (pin >= SIM_PIN_COUNT) return;
+  pins[pin].handler = handler;
+}
+
+void simSetInterruptType(uint8_t pin, uint8_t type) {
+  if (pin >= SIM_PIN_COUNT) return;
+  pins[pin].interruptType = type;
+  checkInterrupt(pin, false);
+}
+
+void simEnableInterrupt(uint8_t pin, bool enabled) {
+  if (pin >= SIM_PIN_COUNT) return;
+  pins[pin].interruptEnabled = enabled;
+  if (enabled) checkInterrupt(pin, false);
+}
+
+void simAddEdgeListener(SimEdgeListener listener) {
+  edgeListeners.push_back(listener);
+}
+
+uint32_t simInterrupts() {
+  return interrupts;
+}
+
+void simSetTicklessIdle(bool enabled) {
+  ticklessIdle = enabled;
+}
+
+bool simTicklessIdle() {
+  return ticklessIdle;
+}
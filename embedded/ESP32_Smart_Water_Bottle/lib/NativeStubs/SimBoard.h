@@ -0,0 +1,90 @@
+#ifndef SIMBOARD_H
+#define SIMBOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Virtual ESP32 behind the native stand-ins. Time only moves when every
+// task is blocked, so a run is deterministic and idle stretches cost
+// nothing. The FreeRTOS tasks of the firmware run as coroutines on one
+// host thread: a task runs until it blocks in a delay, a notification
+// wait or its loop pass, then the next due task or timer runs.
+
+const uint64_t SIM_FOREVER = UINT64_MAX;
+
+// Microseconds since the virtual boot
+uint64_t simNowUs();
+
+// Tasks
+typedef void (*SimTaskFunction)(void* parameter);
+struct SimTask;
+
+SimTask* simCreateTask(SimTaskFunction function, void* parameter, const char* name);
+// The running task, nullptr in timers and interrupt handlers
+SimTask* simCurrentTask();
+const char* simTaskName(const SimTask* task);
+uint32_t simTaskRuns(const SimTask* task);
+size_t simTaskCount();
+SimTask* simTask(size_t index);
+
+// Blocks the running task until wakeUs
+void simBlockUntil(uint64_t wakeUs);
+// Blocks the running task until it is notified or timeoutUs passed,
+// returns the notification count before taking it
+uint32_t simWaitNotify(bool clear, uint64_t timeoutUs);
+// Also from timers and interrupt handlers
+void simNotify(SimTask* task);
+// Ends the running task, does not return
+void simEndTask();
+
+// Timers run in scheduler context at their time, before any task due at
+// the same time. External events (pulses, central writes) are timers.
+typedef void (*SimTimerFunction)(void* argument);
+void simScheduleTimer(uint64_t timeUs, SimTimerFunction function, void* argument);
+
+// Runs tasks and timers until every task is blocked beyond untilUs or
+// the run was stopped, the clock then stands at untilUs
+void simRunUntil(uint64_t untilUs);
+// Ends the run, from a task it does not return (deep sleep, restart)
+void simStop(const char* reason);
+bool simStopped();
+const char* simStopReason();
+// Task switches since boot
+uint64_t simSwitches();
+
+// GPIO. Levels set by the simulation cause edges, which drive the pin
+// interrupts and listeners such as the pulse counter.
+const uint8_t SIM_PIN_COUNT = 40;
+
+// gpio_int_type_t values, which Arduino's interrupt modes share
+enum SimInterruptType : uint8_t {
+  SIM_INTR_DISABLE = 0,
+  SIM_INTR_POSEDGE = 1,
+  SIM_INTR_NEGEDGE = 2,
+  SIM_INTR_ANYEDGE = 3,
+  SIM_INTR_LOW_LEVEL = 4,
+  SIM_INTR_HIGH_LEVEL = 5
+};
+
+typedef void (*SimInterruptHandler)();
+// Pin, new level and how long the previous level was held
+typedef void (*SimEdgeListener)(uint8_t pin, int level, uint64_t heldUs);
+
+void simSetPinLevel(uint8_t pin, int level);
+int simPinLevel(uint8_t pin);
+// Output drivers of the firmware do not trigger interrupts
+void simDrivePin(uint8_t pin, int level);
+void simSetPinPullUp(uint8_t pin);
+
+void simSetInterruptHandler(uint8_t pin, SimInterruptHandler handler);
+void simSetInterruptType(uint8_t pin, uint8_t type);
+void simEnableInterrupt(uint8_t pin, bool enabled);
+void simAddEdgeListener(SimEdgeListener listener);
+uint32_t simInterrupts();
+
+// The stock Arduino core has no tickless idle and rejects automatic light
+// sleep, a core built with it accepts it
+void simSetTicklessIdle(bool enabled);
+bool simTicklessIdle();
+
+#endif
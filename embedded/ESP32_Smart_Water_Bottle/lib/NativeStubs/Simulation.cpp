@@ -0,0 +1,478 @@
+// Entry point of the native build: boots the firmware on the virtual board
+// and replays a pulse trace and a central script against it.
+//
+//   program [--trace FILE] [--script FILE] [--duration S] [--quiet]
+//           [--light-sleep] [--loop-pass-us N] [--epoch S]
+//
+// Script lines are "<seconds> <command> [argument]", '#' starts a comment:
+//   connect | disconnect | mtu <n> | write <text> | hex <bytes> |
+//   read <uuid> | button | pour <seconds> <Hz>
+//
+// The central answers sync requests and acknowledges binary drink events
+// like the app does. Without --duration the run ends 60 s after the last
+// trace pulse or script line.
+#if !defined(WATERBOTTLE_BENCHMARK) && !defined(WATERBOTTLE_FUZZ) && !defined(PIO_UNIT_TESTING)
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <WaterProtocol.h>
+#include <PulseTrace.h>
+#include "SimBoard.h"
+
+// Pins of the bottle, see WaterBottleMain.cpp
+const uint8_t SIM_FLOW_PIN = 19;
+const uint8_t SIM_BUTTON_PIN = 17;
+
+const uint32_t DEFAULT_LOOP_PASS_US = 1000;
+const uint64_t SETTLE_US = 60000000;
+// The sensor output stays low for half the pulse interval, at most this long
+const uint64_t PULSE_MAX_LOW_US = 20000;
+const uint64_t BUTTON_PRESS_US = 100000;
+// The central answers one connection interval later
+const uint64_t CENTRAL_RESPONSE_US = 30000;
+const uint16_t CENTRAL_CREDITS = 16;
+// 2025-07-01T08:00:00Z, the central's clock at the virtual boot
+const uint64_t DEFAULT_CENTRAL_EPOCH_S = 1751356800;
+const uint32_t POUR_JITTER_PERMILLE = 20;
+const size_t TRACE_CHUNK = 256;
+
+struct ScriptLine {
+  uint64_t timeUs;
+  int number;
+  std::string command;
+  std::string argument;
+};
+
+struct CentralStats {
+  uint32_t drinkEvents;
+  uint32_t duplicateEvents;
+  uint32_t syncAnswers;
+  uint32_t acks;
+  uint32_t historyChunks;
+};
+
+static std::vector<ScriptLine> script;
+static size_t scriptNext = 0;
+static uint64_t lastEventUs = 0;
+static uint64_t centralEpochMs = DEFAULT_CENTRAL_EPOCH_S * 1000;
+static CentralStats central;
+
+// Pulses come from the trace file, merged with the pours of the script
+static FILE* traceFile = nullptr;
+static uint32_t traceChunk[TRACE_CHUNK];
+static size_t traceCount = 0;
+static size_t traceIndex = 0;
+static uint32_t traceLastRaw = 0;
+static uint64_t traceWrapUs = 0;
+static bool traceHasPending = false;
+static uint64_t tracePendingUs = 0;
+static std::multiset<uint64_t> pourPulses;
+static bool pulseScheduled = false;
+static uint64_t pulsesReplayed = 0;
+
+// Trace timestamps are the 32 bit microsecond clock of the firmware, which
+// wraps after 71 minutes
+static bool readTracePulse(uint64_t& timeUs) {
+  if (traceFile == nullptr) return false;
+  if (traceIndex == traceCount) {
+    traceCount = readPulseTrace(traceFile, traceChunk, TRACE_CHUNK);
+    traceIndex = 0;
+    if (traceCount == 0) {
+      fclose(traceFile);
+      traceFile = nullptr;
+      return false;
+    }
+  }
+  uint32_t raw = traceChunk[traceIndex++];
+  if (raw < traceLastRaw) traceWrapUs += 1ULL << 32;
+  traceLastRaw = raw;
+  timeUs = traceWrapUs + raw;
+  return true;
+}
+
+static bool peekPulse(uint64_t& timeUs) {
+  if (!traceHasPending) traceHasPending = readTracePulse(tracePendingUs);
+  bool found = traceHasPending;
+  timeUs = tracePendingUs;
+  if (!pourPulses.empty() && (!found || *pourPulses.begin() < timeUs)) {
+    timeUs = *pourPulses.begin();
+    found = true;
+  }
+  return found;
+}
+
+static void takePulse(uint64_t timeUs) {
+  if (traceHasPending && tracePendingUs == timeUs) {
+    traceHasPending = false;
+  } else {
+    pourPulses.erase(pourPulses.begin());
+  }
+}
+
+static void pulseRise(void* argument) {
+  (void)argument;
+  simSetPinLevel(SIM_FLOW_PIN, HIGH);
+}
+
+static void schedulePulse();
+
+// A pour added by the script can come before the pulse already scheduled,
+// the timer of a replaced pulse finds a newer generation and does nothing
+static uintptr_t pulseGeneration = 0;
+static uint64_t scheduledPulseUs = 0;
+
+static void pulseFall(void* argument) {
+  if ((uintptr_t)argument != pulseGeneration) return;
+  pulseScheduled = false;
+  uint64_t nowUs = simNowUs();
+  uint64_t pulseUs;
+  peekPulse(pulseUs);
+  takePulse(pulseUs);
+  simSetPinLevel(SIM_FLOW_PIN, LOW);
+  pulsesReplayed++;
+  lastEventUs = nowUs;
+
+  uint64_t nextUs;
+  uint64_t lowUs = PULSE_MAX_LOW_US;
+  if (peekPulse(nextUs) && nextUs > nowUs && (nextUs - nowUs) / 2 < lowUs) lowUs = (nextUs - nowUs) / 2;
+  if (lowUs == 0) lowUs = 1;
+  simScheduleTimer(nowUs + lowUs, pulseRise, nullptr);
+  schedulePulse();
+}
+
+static void schedulePulse() {
+  uint64_t nextUs;
+  if (!peekPulse(nextUs)) return;
+  // Pulses closer than the output can follow are merged
+  uint64_t earliest = simNowUs() + 2;
+  if (nextUs < earliest) nextUs = earliest;
+  if (pulseScheduled && scheduledPulseUs <= nextUs) return;
+
+  pulseGeneration++;
+  scheduledPulseUs = nextUs;
+  simScheduleTimer(nextUs, pulseFall, (void*)pulseGeneration);
+  pulseScheduled = true;
+}
+
+static void addPour(uint64_t startUs, double seconds, uint32_t hz, int seed) {
+  SipSpec sip = { 0, (uint32_t)(seconds * 1000), hz };
+  std::vector<uint32_t> pulses((size_t)(seconds * hz) + 16);
+  size_t count = synthesizePulseTrace(&sip, 1, POUR_JITTER_PERMILLE, seed, pulses.data(), pulses.size());
+  for (size_t i = 0; i < count; i++) pourPulses.insert(startUs + pulses[i]);
+  schedulePulse();
+}
+
+static void buttonRelease(void* argument) {
+  (void)argument;
+  simSetPinLevel(SIM_BUTTON_PIN, HIGH);
+}
+
+// Central writes go through timers, never from inside a notification
+struct CentralWrite {
+  std::vector<uint8_t> data;
+};
+
+static void centralWriteNow(void* argument) {
+  CentralWrite* write = (CentralWrite*)argument;
+  bleCentralWrite(nullptr, write->data.data(), write->data.size());
+  delete write;
+}
+
+static void centralWriteLater(const uint8_t* data, size_t length) {
+  CentralWrite* write = new CentralWrite();
+  write->data.assign(data, data + length);
+  simScheduleTimer(simNowUs() + CENTRAL_RESPONSE_US, centralWriteNow, write);
+}
+
+static uint64_t centralTimeMs() {
+  return centralEpochMs + simNowUs() / 1000;
+}
+
+static void answerJsonSync() {
+  time_t seconds = (time_t)(centralTimeMs() / 1000);
+  struct tm time;
+  gmtime_r(&seconds, &time);
+  char message[96];
+  size_t length = strftime(message, sizeof(message), "{\"syncConfirmed\":true,\"timestamp\":\"%Y-%m-%dT%H:%M:%S", &time);
+  length += snprintf(message + length, sizeof(message) - length, ".%03dZ\"}", (int)(centralTimeMs() % 1000));
+  centralWriteLater((const uint8_t*)message, length);
+  central.syncAnswers++;
+}
+
+static void sendFrame(uint8_t type, uint32_t sequence, uint16_t value) {
+  WaterFrame frame = { type, sequence, centralTimeMs(), value, 0, 0, 0 };
+  uint8_t buffer[WATER_FRAME_MAX_SIZE];
+  size_t length = encodeWaterFrame(frame, buffer, sizeof(buffer));
+  centralWriteLater(buffer, length);
+}
+
+// Sequences seen so far, they only count within one journal epoch
+static uint32_t journalEpoch = 0;
+static uint32_t highestEventSequence = 0;
+
+static void onBinaryNotification(const uint8_t* data, size_t length) {
+  bool ack = false;
+  size_t offset = 0;
+  while (offset < length) {
+    WaterFrame frame;
+    size_t consumed = decodeWaterFrame(data + offset, length - offset, frame);
+    if (consumed == 0) {
+      // History chunks have a variable length and fill the notification
+      if (readWaterFrameHeader(data + offset, length - offset, frame) && frame.type == FRAME_HISTORY_CHUNK) {
+        central.historyChunks++;
+      }
+      break;
+    }
+    offset += consumed;
+
+    if (frame.type == FRAME_HELLO) {
+      if (frame.sequence != journalEpoch) {
+        journalEpoch = frame.sequence;
+        highestEventSequence = 0;
+      }
+    } else if (frame.type == FRAME_SYNC_REQUEST) {
+      sendFrame(FRAME_SYNC_CONFIRM, 0, 0);
+      central.syncAnswers++;
+    } else if (frame.type == FRAME_CREDIT_PROBE) {
+      ack = true;
+    } else if (frame.type == FRAME_DRINK_EVENT) {
+      if (frame.sequence > highestEventSequence) {
+        highestEventSequence = frame.sequence;
+        central.drinkEvents++;
+      } else {
+        central.duplicateEvents++;
+      }
+      ack = true;
+    }
+  }
+  if (ack) {
+    sendFrame(FRAME_ACK, highestEventSequence, CENTRAL_CREDITS);
+    central.acks++;
+  }
+}
+
+static void onNotification(const char* uuid, const uint8_t* data, size_t length) {
+  (void)uuid;
+  if (length == 0) return;
+  if (isBinaryFrame(data, length)) {
+    onBinaryNotification(data, length);
+    return;
+  }
+
+  std::string text((const char*)data, length);
+  if (text.find("\"syncRequest\"") != std::string::npos) answerJsonSync();
+  if (text.find("\"amountMl\"") != std::string::npos) central.drinkEvents++;
+}
+
+static void printValue(const char* uuid, const uint8_t* data, size_t length) {
+  printf("%s: ", uuid);
+  bool text = true;
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] < 0x20 || data[i] > 0x7E) text = false;
+  }
+  for (size_t i = 0; i < length; i++) {
+    if (text) {
+      putchar(data[i]);
+    } else {
+      printf("%02x", data[i]);
+    }
+  }
+  putchar('\n');
+}
+
+static bool parseHex(const std::string& text, std::vector<uint8_t>& out) {
+  std::string digits;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] != ' ') digits += text[i];
+  }
+  if (digits.size() % 2 != 0) return false;
+  for (size_t i = 0; i < digits.size(); i += 2) {
+    char* end;
+    std::string pair = digits.substr(i, 2);
+    out.push_back((uint8_t)strtoul(pair.c_str(), &end, 16));
+    if (*end != '\0') return false;
+  }
+  return true;
+}
+
+static void runScriptLine(void* argument) {
+  const ScriptLine& line = *(const ScriptLine*)argument;
+  scriptNext++;
+  lastEventUs = simNowUs();
+
+  if (line.command == "connect") {
+    if (!bleCentralConnect()) fprintf(stderr, "script line %d: bottle not advertising\n", line.number);
+  } else if (line.command == "disconnect") {
+    bleCentralDisconnect();
+  } else if (line.command == "mtu") {
+    bleCentralRequestMtu((uint16_t)atoi(line.argument.c_str()));
+  } else if (line.command == "write") {
+    if (!bleCentralWrite(nullptr, (const uint8_t*)line.argument.data(), line.argument.size())) {
+      fprintf(stderr, "script line %d: write failed\n", line.number);
+    }
+  } else if (line.command == "hex") {
+    std::vector<uint8_t> data;
+    parseHex(line.argument, data);
+    if (!bleCentralWrite(nullptr, data.data(), data.size())) {
+      fprintf(stderr, "script line %d: write failed\n", line.number);
+    }
+  } else if (line.command == "read") {
+    uint8_t value[512];
+    size_t length = bleCentralRead(line.argument.c_str(), value, sizeof(value));
+    printValue(line.argument.c_str(), value, length);
+  } else if (line.command == "button") {
+    simSetPinLevel(SIM_BUTTON_PIN, LOW);
+    simScheduleTimer(simNowUs() + BUTTON_PRESS_US, buttonRelease, nullptr);
+  } else if (line.command == "pour") {
+    double seconds = 0;
+    unsigned hz = 0;
+    sscanf(line.argument.c_str(), "%lf %u", &seconds, &hz);
+    addPour(simNowUs(), seconds, hz, line.number);
+  }
+}
+
+static bool loadScript(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (file == nullptr) return false;
+
+  static const char* COMMANDS[] = { "connect", "disconnect", "mtu", "write", "hex", "read", "button", "pour" };
+  char text[600];
+  int number = 0;
+  bool valid = true;
+  while (fgets(text, sizeof(text), file) != nullptr) {
+    number++;
+    std::string line(text);
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+    size_t start = line.find_first_not_of(' ');
+    if (start == std::string::npos || line[start] == '#') continue;
+
+    char command[16] = "";
+    double seconds = -1;
+    int consumed = 0;
+    if (sscanf(line.c_str(), "%lf %15s %n", &seconds, command, &consumed) < 2 || seconds < 0) {
+      fprintf(stderr, "%s:%d: expected \"<seconds> <command> [argument]\"\n", path, number);
+      valid = false;
+      continue;
+    }
+    bool known = false;
+    for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); i++) {
+      if (strcmp(command, COMMANDS[i]) == 0) known = true;
+    }
+    std::vector<uint8_t> bytes;
+    if (!known || (strcmp(command, "hex") == 0 && !parseHex(line.substr(consumed), bytes))) {
+      fprintf(stderr, "%s:%d: unknown command or argument \"%s\"\n", path, number, command);
+      valid = false;
+      continue;
+    }
+
+    ScriptLine entry = { (uint64_t)(seconds * 1000000), number, command, consumed > 0 ? line.substr(consumed) : "" };
+    script.push_back(entry);
+  }
+  fclose(file);
+  return valid;
+}
+
+static void printSummary(double wallSeconds) {
+  double simSeconds = simNowUs() / 1e6;
+  printf("Simulated %.3f s in %.3f s (%.0fx real time)", simSeconds, wallSeconds,
+         wallSeconds > 0 ? simSeconds / wallSeconds : 0.0);
+  if (simStopped()) printf(", stopped by %s", simStopReason());
+  printf("\n");
+
+  printf("Tasks:");
+  for (size_t i = 0; i < simTaskCount(); i++) {
+    printf(" %s %u runs,", simTaskName(simTask(i)), simTaskRuns(simTask(i)));
+  }
+  printf(" %llu switches, %u loop passes\n", (unsigned long long)simSwitches(), arduinoLoopPasses());
+
+  const BleLinkStats& link = bleLinkStats();
+  printf("Flow: %llu pulses, %u pin interrupts\n", (unsigned long long)pulsesReplayed, simInterrupts());
+  printf("Central: %u connections (%u refused), %u writes, %u reads, %u notifications (%llu bytes, %u truncated)\n",
+         link.connections, link.refusedConnections, link.writes, link.reads, link.notifications,
+         (unsigned long long)link.notifiedBytes, link.truncatedNotifications);
+  printf("Central: %u drink events received (%u repeated), %u sync answers, %u acks, %u history chunks\n",
+         central.drinkEvents, central.duplicateEvents, central.syncAnswers, central.acks, central.historyChunks);
+  printf("Serial: %llu bytes\n", (unsigned long long)Serial.bytesWritten());
+
+  // Diagnostics are read only, their last value is part of the result
+  for (size_t i = 0; i < bleCharacteristicCount(); i++) {
+    BLECharacteristic* characteristic = bleCharacteristic(i);
+    if (characteristic->getProperties() != BLECharacteristic::PROPERTY_READ) continue;
+    printValue(characteristic->getUUIDString(), characteristic->getData(), characteristic->getLength());
+  }
+}
+
+static void usage() {
+  fprintf(stderr, "usage: simulation [--trace FILE] [--script FILE] [--duration S] [--quiet] [--light-sleep]\n"
+                  "                  [--loop-pass-us N] [--epoch S]\n");
+}
+
+int main(int argc, char** argv) {
+  const char* tracePath = nullptr;
+  const char* scriptPath = nullptr;
+  double durationS = 0;
+  uint32_t loopPassUs = DEFAULT_LOOP_PASS_US;
+
+  for (int i = 1; i < argc; i++) {
+    std::string option = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (option == "--trace" && hasValue) {
+      tracePath = argv[++i];
+    } else if (option == "--script" && hasValue) {
+      scriptPath = argv[++i];
+    } else if (option == "--duration" && hasValue) {
+      durationS = atof(argv[++i]);
+    } else if (option == "--loop-pass-us" && hasValue) {
+      loopPassUs = (uint32_t)atol(argv[++i]);
+    } else if (option == "--epoch" && hasValue) {
+      centralEpochMs = (uint64_t)atoll(argv[++i]) * 1000;
+    } else if (option == "--quiet") {
+      Serial.setOutput(nullptr);
+    } else if (option == "--light-sleep") {
+      simSetTicklessIdle(true);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  if (tracePath != nullptr && (traceFile = fopen(tracePath, "r")) == nullptr) {
+    fprintf(stderr, "cannot open trace %s\n", tracePath);
+    return 1;
+  }
+  if (scriptPath != nullptr && !loadScript(scriptPath)) {
+    fprintf(stderr, "cannot load script %s\n", scriptPath);
+    return 1;
+  }
+
+  // The flow sensor and the button rest high
+  simSetPinLevel(SIM_FLOW_PIN, HIGH);
+  simSetPinLevel(SIM_BUTTON_PIN, HIGH);
+  bleCentralSetNotifyListener(onNotification);
+  for (size_t i = 0; i < script.size(); i++) {
+    simScheduleTimer(script[i].timeUs, runScriptLine, &script[i]);
+  }
+  schedulePulse();
+  startArduinoLoopTask(loopPassUs);
+
+  std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+  if (durationS > 0) {
+    simRunUntil((uint64_t)(durationS * 1000000));
+  } else {
+    while (!simStopped() && (pulseScheduled || scriptNext < script.size())) {
+      simRunUntil(simNowUs() + 1000000);
+    }
+    simRunUntil(lastEventUs + SETTLE_US);
+  }
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - wallStart;
+
+  Serial.flush();
+  printSummary(wall.count());
+  return 0;
+}
+
+#endif
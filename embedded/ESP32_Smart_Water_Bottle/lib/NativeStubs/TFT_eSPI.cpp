@@ -0,0 +1,149 @@
+#include "TFT_eSPI.h"
+#include <stdlib.h>
+#include <string.h>
+
+TFT_eSPI::TFT_eSPI(int16_t width, int16_t height) : screenWidth(width), screenHeight(height) {}
+
+void TFT_eSPI::countWindow(int32_t x, int32_t y, int32_t w, int32_t h) {
+  // Clip like the driver does before setting the address window
+  if (x < 0) { w += x; x = 0; }
+  if (y < 0) { h += y; y = 0; }
+  if (x + w > screenWidth) w = screenWidth - x;
+  if (y + h > screenHeight) h = screenHeight - y;
+  if (w <= 0 || h <= 0) return;
+
+  addressWindows++;
+  pixelsPushed += w * h;
+  bytesPushed += TFT_WINDOW_OVERHEAD_BYTES + w * h * 2;
+}
+
+void TFT_eSPI::fillScreen(uint32_t color) {
+  fillRect(0, 0, screenWidth, screenHeight, color);
+}
+
+void TFT_eSPI::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+  (void)color;
+  countWindow(x, y, w, h);
+}
+
+void TFT_eSPI::drawPixel(int32_t x, int32_t y, uint32_t color) {
+  (void)color;
+  countWindow(x, y, 1, 1);
+}
+
+// Rasterized like the driver: one horizontal line (one window) per row
+void TFT_eSPI::fillTriangle(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t color) {
+  (void)color;
+  int32_t top = y0 < y1 ? (y0 < y2 ? y0 : y2) : (y1 < y2 ? y1 : y2);
+  int32_t bottom = y0 > y1 ? (y0 > y2 ? y0 : y2) : (y1 > y2 ? y1 : y2);
+  int32_t xs[3] = { x0, x1, x2 };
+  int32_t ys[3] = { y0, y1, y2 };
+
+  for (int32_t y = top; y <= bottom; y++) {
+    int32_t left = 0x7FFFFFFF, right = -0x7FFFFFFF;
+    for (int e = 0; e < 3; e++) {
+      int32_t ax = xs[e], ay = ys[e], bx = xs[(e + 1) % 3], by = ys[(e + 1) % 3];
+      if ((y < ay && y < by) || (y > ay && y > by)) continue;
+      if (ay == by) {
+        if (ax < left) left = ax;
+        if (bx < left) left = bx;
+        if (ax > right) right = ax;
+        if (bx > right) right = bx;
+        continue;
+      }
+      int32_t x = ax + (bx - ax) * (y - ay) / (by - ay);
+      if (x < left) left = x;
+      if (x > right) right = x;
+    }
+    if (right >= left) countWindow(left, y, right - left + 1, 1);
+  }
+}
+
+void TFT_eSPI::setTextColor(uint16_t color) {
+  textColor = color;
+  textBackground = color;
+}
+
+void TFT_eSPI::setTextColor(uint16_t color, uint16_t background, bool fillBackground) {
+  (void)fillBackground;
+  textColor = color;
+  textBackground = background;
+}
+
+int16_t TFT_eSPI::textWidth(const char* text) {
+  return strlen(text) * 6 * textSize;
+}
+
+void TFT_eSPI::drawChar(char c) {
+  (void)c;
+  if (textBackground == textColor) {
+    // Transparent text: only set pixels are drawn, assume about half of the cell
+    for (int i = 0; i < 24; i++) {
+      countWindow(cursorX, cursorY, textSize, textSize);
+    }
+  } else if (textSize == 1) {
+    // Solid background at size 1 is pushed as one 6x8 block
+    countWindow(cursorX, cursorY, 6, 8);
+  } else {
+    // Larger sizes are drawn as one fillRect per font pixel
+    for (int i = 0; i < 48; i++) {
+      countWindow(cursorX, cursorY, textSize, textSize);
+    }
+  }
+  cursorX += 6 * textSize;
+}
+
+size_t TFT_eSPI::print(const char* text) {
+  size_t length = strlen(text);
+  for (size_t i = 0; i < length; i++) {
+    drawChar(text[i]);
+  }
+  return length;
+}
+
+size_t TFT_eSPI::println(const char* text) {
+  size_t length = print(text);
+  cursorX = 0;
+  cursorY += 8 * textSize;
+  return length;
+}
+
+void TFT_eSPI::resetCounters() {
+  pixelsPushed = 0;
+  addressWindows = 0;
+  bytesPushed = 0;
+}
+
+void TFT_eSPI::pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* data) {
+  (void)data;
+  countWindow(x, y, w, h);
+}
+
+void* TFT_eSprite::createSprite(int16_t width, int16_t height) {
+  deleteSprite();
+  buffer = (uint8_t*)calloc((size_t)width * height * colorDepth / 8, 1);
+  if (buffer != nullptr) {
+    screenWidth = width;
+    screenHeight = height;
+  }
+  return buffer;
+}
+
+void TFT_eSprite::deleteSprite() {
+  free(buffer);
+  buffer = nullptr;
+  screenWidth = 0;
+  screenHeight = 0;
+}
+
+void TFT_eSprite::pushSprite(int32_t x, int32_t y) {
+  parent->countWindow(x, y, screenWidth, screenHeight);
+}
+
+bool TFT_eSprite::pushSprite(int32_t tx, int32_t ty, int32_t sx, int32_t sy, int32_t sw, int32_t sh) {
+  (void)sx;
+  (void)sy;
+  if (buffer == nullptr) return false;
+  parent->countWindow(tx, ty, sw, sh);
+  return true;
+}
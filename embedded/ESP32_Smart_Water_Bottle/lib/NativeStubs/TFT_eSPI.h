@@ -0,0 +1,115 @@
+#ifndef NATIVE_TFT_ESPI_H
+#define NATIVE_TFT_ESPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Host stand-in for TFT_eSPI. Nothing is drawn; instead every call counts
+// the pixels, address windows and SPI bytes the real driver would push to
+// the GC9A01, so the cost of a display update can be measured on Linux.
+
+#ifndef TFT_WIDTH
+#define TFT_WIDTH 240
+#endif
+#ifndef TFT_HEIGHT
+#define TFT_HEIGHT 240
+#endif
+
+#define TFT_BLACK 0x0000
+#define TFT_WHITE 0xFFFF
+#define TFT_RED 0xF800
+#define TFT_GREEN 0x07E0
+#define TFT_YELLOW 0xFFE0
+#define TFT_BLUE 0x001F
+#define TFT_DARKGREY 0x7BEF
+
+// CASET + 4 bytes, RASET + 4 bytes, RAMWR
+const uint32_t TFT_WINDOW_OVERHEAD_BYTES = 11;
+
+class TFT_eSPI {
+public:
+  TFT_eSPI(int16_t width = TFT_WIDTH, int16_t height = TFT_HEIGHT);
+
+  void init() {}
+  void setRotation(uint8_t rotation) { (void)rotation; }
+  int16_t width() const { return screenWidth; }
+  int16_t height() const { return screenHeight; }
+
+  void fillScreen(uint32_t color);
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+  void drawPixel(int32_t x, int32_t y, uint32_t color);
+  void fillTriangle(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t color);
+
+  void setTextColor(uint16_t color);
+  void setTextColor(uint16_t color, uint16_t background, bool fillBackground = false);
+  void setTextSize(uint8_t size) { textSize = size > 0 ? size : 1; }
+  void setCursor(int16_t x, int16_t y) { cursorX = x; cursorY = y; }
+  int16_t textWidth(const char* text);
+  size_t print(const char* text);
+  size_t println(const char* text);
+
+  // The window is counted with its pixels, pushColors only fills it
+  void setAddrWindow(int32_t x, int32_t y, int32_t w, int32_t h) { countWindow(x, y, w, h); }
+  void pushColors(uint16_t* data, uint32_t length, bool swap = true) { (void)data; (void)length; (void)swap; }
+
+  // DMA transfers complete immediately on the host
+  bool initDMA() { return true; }
+  void startWrite() {}
+  void endWrite() {}
+  void setSwapBytes(bool swap) { (void)swap; }
+  bool dmaBusy() { return false; }
+  void dmaWait() {}
+  void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* data);
+
+  // Panel commands such as sleep in/out, one byte each
+  void writecommand(uint8_t command) { lastCommand = command; bytesPushed++; }
+  uint8_t lastCommand = 0;
+
+  // Counters for the host measurements
+  uint32_t pixelsPushed = 0;
+  uint32_t addressWindows = 0;
+  uint32_t bytesPushed = 0;
+  void resetCounters();
+
+protected:
+  friend class TFT_eSprite;
+  void countWindow(int32_t x, int32_t y, int32_t w, int32_t h);
+  void drawChar(char c);
+
+  int16_t screenWidth;
+  int16_t screenHeight;
+  int16_t cursorX = 0;
+  int16_t cursorY = 0;
+  uint8_t textSize = 1;
+  uint16_t textColor = TFT_WHITE;
+  uint16_t textBackground = TFT_WHITE;
+};
+
+// Off-screen canvas. Draw calls are counted on the sprite itself, so its
+// counters show the composition work done in RAM.
+class TFT_eSprite : public TFT_eSPI {
+public:
+  explicit TFT_eSprite(TFT_eSPI* tft) : TFT_eSPI(0, 0), parent(tft) {}
+  ~TFT_eSprite() { deleteSprite(); }
+
+  // 16 or 4 bits per pixel, must be set before createSprite
+  void setColorDepth(int8_t bits) { colorDepth = bits; }
+  void createPalette(uint16_t* colors, uint8_t count) { (void)colors; (void)count; }
+
+  void* createSprite(int16_t width, int16_t height);
+  void deleteSprite();
+  bool created() const { return buffer != nullptr; }
+  void* getPointer() { return buffer; }
+  void fillSprite(uint32_t color) { fillScreen(color); }
+
+  // Pushes to the parent display, counted there
+  void pushSprite(int32_t x, int32_t y);
+  bool pushSprite(int32_t tx, int32_t ty, int32_t sx, int32_t sy, int32_t sw, int32_t sh);
+
+private:
+  TFT_eSPI* parent;
+  int8_t colorDepth = 16;
+  uint8_t* buffer = nullptr;
+};
+
+#endif
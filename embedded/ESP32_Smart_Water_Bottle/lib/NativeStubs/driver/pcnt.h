@@ -0,0 +1,49 @@
+#ifndef NATIVE_DRIVER_PCNT_H
+#define NATIVE_DRIVER_PCNT_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Pulse counter on the virtual board: counts the edges of its pin, resets
+// at the high limit and calls the handler for the enabled limit event.
+// The glitch filter drops levels held shorter than the filter at 80 MHz.
+
+#define PCNT_PIN_NOT_USED (-1)
+
+typedef enum { PCNT_UNIT_0, PCNT_UNIT_1, PCNT_UNIT_2, PCNT_UNIT_3, PCNT_UNIT_4, PCNT_UNIT_5, PCNT_UNIT_6, PCNT_UNIT_7, PCNT_UNIT_MAX } pcnt_unit_t;
+typedef enum { PCNT_CHANNEL_0, PCNT_CHANNEL_1, PCNT_CHANNEL_MAX } pcnt_channel_t;
+typedef enum { PCNT_COUNT_DIS, PCNT_COUNT_INC, PCNT_COUNT_DEC } pcnt_count_mode_t;
+typedef enum { PCNT_MODE_KEEP, PCNT_MODE_REVERSE, PCNT_MODE_DISABLE } pcnt_ctrl_mode_t;
+typedef enum {
+  PCNT_EVT_THRES_1 = 1 << 2,
+  PCNT_EVT_THRES_0 = 1 << 3,
+  PCNT_EVT_L_LIM = 1 << 4,
+  PCNT_EVT_H_LIM = 1 << 5,
+  PCNT_EVT_ZERO = 1 << 6
+} pcnt_evt_type_t;
+
+typedef struct {
+  int pulse_gpio_num;
+  int ctrl_gpio_num;
+  pcnt_ctrl_mode_t lctrl_mode;
+  pcnt_ctrl_mode_t hctrl_mode;
+  pcnt_count_mode_t pos_mode;
+  pcnt_count_mode_t neg_mode;
+  int16_t counter_h_lim;
+  int16_t counter_l_lim;
+  pcnt_unit_t unit;
+  pcnt_channel_t channel;
+} pcnt_config_t;
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config);
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t filterCycles);
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit);
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t event);
+esp_err_t pcnt_isr_service_install(int flags);
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*handler)(void* argument), void* argument);
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit);
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit);
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit);
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef NATIVE_ESP_PARTITION_H
+#define NATIVE_ESP_PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Data partitions are RAM backed with NOR flash semantics (RamFlashStore),
+// every label gets SIM_PARTITION_SIZE bytes, the size of the journal
+// partition in partitions.csv. Nothing is kept between runs.
+
+#define SPI_FLASH_SEC_SIZE 4096
+const size_t SIM_PARTITION_SIZE = 0x50000;
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  bool encrypted;
+} esp_partition_t;
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label);
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* data, size_t length);
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* data, size_t length);
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t length);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef NATIVE_ESP_PM_H
+#define NATIVE_ESP_PM_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Locks are counted, automatic light sleep is only accepted when the board
+// simulates a core with tickless idle (simSetTicklessIdle)
+
+typedef enum { ESP_PM_CPU_FREQ_MAX, ESP_PM_APB_FREQ_MAX, ESP_PM_NO_LIGHT_SLEEP } esp_pm_lock_type_t;
+
+struct esp_pm_lock;
+typedef struct esp_pm_lock* esp_pm_lock_handle_t;
+
+typedef struct {
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+esp_err_t esp_pm_configure(const void* config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char* name, esp_pm_lock_handle_t* handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+
+#endif
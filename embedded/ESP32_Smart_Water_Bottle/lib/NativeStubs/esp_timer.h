@@ -0,0 +1,9 @@
+#ifndef NATIVE_ESP_TIMER_H
+#define NATIVE_ESP_TIMER_H
+
+#include <stdint.h>
+
+// Virtual microseconds since boot
+int64_t esp_timer_get_time();
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef NATIVE_CPU_HAL_H
+#define NATIVE_CPU_HAL_H
+
+#include <stdint.h>
+
+// Derived from the virtual clock at 240 MHz. Time does not move inside an
+// interrupt handler, so handler cycles measured with it are always 0.
+uint32_t cpu_hal_get_cycle_count();
+
+#endif
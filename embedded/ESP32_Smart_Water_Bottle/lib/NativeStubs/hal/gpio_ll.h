@@ -0,0 +1,14 @@
+#ifndef NATIVE_GPIO_LL_H
+#define NATIVE_GPIO_LL_H
+
+#include "driver/gpio.h"
+
+typedef struct gpio_dev_s {
+  int unused;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
+
+void gpio_ll_set_intr_type(gpio_dev_t* hw, gpio_num_t pin, gpio_int_type_t type);
+
+#endif
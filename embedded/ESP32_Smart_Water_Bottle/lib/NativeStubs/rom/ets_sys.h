@@ -0,0 +1,9 @@
+#ifndef NATIVE_ETS_SYS_H
+#define NATIVE_ETS_SYS_H
+
+#include <stdint.h>
+
+// CPU clock in MHz. The virtual board never scales it, like cpu_hal.
+uint32_t ets_get_cpu_frequency();
+
+#endif
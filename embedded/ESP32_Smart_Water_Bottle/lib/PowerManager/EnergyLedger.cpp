@@ -0,0 +1,102 @@
+#include "EnergyLedger.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+EnergyProfile withoutBacklightControl(const EnergyProfile& profile) {
+  // Display states follow DisplayPowerState: on, dim, sleep
+  EnergyProfile full = profile;
+  full.microAmps[ENERGY_DISPLAY][1] = profile.microAmps[ENERGY_DISPLAY][0];
+  return full;
+}
+
+void EnergyLedger::begin(uint64_t nowUs) {
+  *this = EnergyLedger(profile);
+  startUs = nowUs;
+  lastUs = nowUs;
+  for (size_t i = 0; i < ENERGY_SUBSYSTEMS; i++) sinceUs[i] = nowUs;
+}
+
+void EnergyLedger::setState(EnergySubsystem subsystem, uint8_t state, uint64_t nowUs) {
+  if (state >= ENERGY_MAX_STATES || state == currentState[subsystem]) return;
+  // Time up to sinceUs is already charged, an earlier timestamp must not
+  // charge it again to the new state
+  if (nowUs > sinceUs[subsystem]) {
+    timeInState[subsystem][currentState[subsystem]] += nowUs - sinceUs[subsystem];
+    sinceUs[subsystem] = nowUs;
+  }
+  currentState[subsystem] = state;
+  transitionCount[subsystem]++;
+  if (nowUs > lastUs) lastUs = nowUs;
+}
+
+void EnergyLedger::addIsrTime(EnergySubsystem subsystem, uint32_t us) {
+  interruptUs[subsystem] += us;
+}
+
+void EnergyLedger::update(uint64_t nowUs) {
+  for (size_t i = 0; i < ENERGY_SUBSYSTEMS; i++) {
+    if (nowUs <= sinceUs[i]) continue;
+    timeInState[i][currentState[i]] += nowUs - sinceUs[i];
+    sinceUs[i] = nowUs;
+  }
+  if (nowUs > lastUs) lastUs = nowUs;
+}
+
+uint64_t EnergyLedger::charge(EnergySubsystem subsystem) const {
+  uint64_t total = interruptUs[subsystem] * profile.isrMicroAmps;
+  for (size_t state = 0; state < ENERGY_MAX_STATES; state++) {
+    total += timeInState[subsystem][state] * profile.microAmps[subsystem][state];
+  }
+  return total;
+}
+
+uint64_t EnergyLedger::microAmpHours(EnergySubsystem subsystem) const {
+  // 3.6e9 us per hour
+  return charge(subsystem) / 3600000000ULL;
+}
+
+uint32_t EnergyLedger::averageMicroAmps(EnergySubsystem subsystem) const {
+  uint64_t elapsed = elapsedUs();
+  return elapsed > 0 ? (uint32_t)(charge(subsystem) / elapsed) : 0;
+}
+
+// Appends to out at length, a length of capacity or more means it overflowed
+static void append(char* out, size_t capacity, size_t& length, const char* format, ...) {
+  if (length >= capacity) return;
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(out + length, capacity - length, format, args);
+  va_end(args);
+  length = written < 0 ? capacity : length + (size_t)written;
+}
+
+size_t formatEnergyReport(const EnergyLedger& ledger, char* out, size_t capacity) {
+  size_t length = 0;
+  uint32_t total = 0;
+
+  // mAh per hour is the average current in mA, printed with two decimals
+  append(out, capacity, length, "{\"uptimeS\":%lu,\"mAhPerHour\":{", (unsigned long)(ledger.elapsedUs() / 1000000));
+  for (size_t i = 0; i < ENERGY_SUBSYSTEMS; i++) {
+    uint32_t ua = ledger.averageMicroAmps((EnergySubsystem)i);
+    total += ua;
+    append(out, capacity, length, "%s\"%s\":%lu.%02lu", i > 0 ? "," : "", ENERGY_SUBSYSTEM_NAMES[i],
+           (unsigned long)(ua / 1000), (unsigned long)(ua % 1000 / 10));
+  }
+  append(out, capacity, length, "},\"totalMAhPerHour\":%lu.%02lu,\"stateS\":{", (unsigned long)(total / 1000),
+         (unsigned long)(total % 1000 / 10));
+  for (size_t i = 0; i < ENERGY_SUBSYSTEMS; i++) {
+    append(out, capacity, length, "%s\"%s\":[", i > 0 ? "," : "", ENERGY_SUBSYSTEM_NAMES[i]);
+    for (size_t state = 0; state < ENERGY_MAX_STATES; state++) {
+      append(out, capacity, length, "%s%lu", state > 0 ? "," : "",
+             (unsigned long)(ledger.stateUs((EnergySubsystem)i, state) / 1000000));
+    }
+    append(out, capacity, length, "]");
+  }
+  append(out, capacity, length, "},\"isrMs\":{\"sensor\":%lu}}", (unsigned long)(ledger.isrUs(ENERGY_SENSOR) / 1000));
+
+  if (length >= capacity) {
+    if (capacity > 0) out[0] = '\0';
+    return 0;
+  }
+  return length;
+}
@@ -0,0 +1,99 @@
+#ifndef ENERGYLEDGER_H
+#define ENERGYLEDGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Time-in-state energy accounting per subsystem. Every subsystem is in
+// exactly one state at a time; each state change closes the interval of
+// the previous state and charges it at that state's current. Timestamps
+// are microseconds from a 64 bit clock (esp_timer on the device).
+enum EnergySubsystem : uint8_t {
+  ENERGY_RADIO,
+  ENERGY_DISPLAY,
+  ENERGY_CPU,
+  ENERGY_SENSOR,
+  ENERGY_SUBSYSTEMS
+};
+
+const size_t ENERGY_MAX_STATES = 3;
+
+// States per subsystem, the display uses DisplayPowerState (on, dim, sleep)
+enum RadioEnergyState : uint8_t { RADIO_OFF, RADIO_ADVERTISING, RADIO_CONNECTED };
+enum CpuEnergyState : uint8_t { CPU_IDLE, CPU_BUSY };
+enum SensorEnergyState : uint8_t { SENSOR_NO_FLOW, SENSOR_FLOWING };
+
+// Current per subsystem and state in uA. Interrupt time is charged on top
+// of the state at isrMicroAmps.
+struct EnergyProfile {
+  uint32_t microAmps[ENERGY_SUBSYSTEMS][ENERGY_MAX_STATES];
+  uint32_t isrMicroAmps;
+};
+
+// Estimates for the nodemcu-32s with the GC9A01 module and the YF-S201:
+// BLE averages over advertising and connection intervals, backlight on,
+// dimmed and panel asleep, CPU waiting at 80 MHz or running at 240 MHz,
+// and the hall sensor, which draws the same with and without flow
+const EnergyProfile DEFAULT_ENERGY_PROFILE = {
+  {
+    { 0, 8000, 12000 },
+    { 25000, 6000, 50 },
+    { 10000, 40000, 0 },
+    { 15000, 15000, 0 }
+  },
+  40000
+};
+
+// Without backlight control (no TFT_BL) dimming only changes the display
+// state and the backlight stays fully lit, so the dimmed state is charged
+// at the on current
+EnergyProfile withoutBacklightControl(const EnergyProfile& profile);
+
+const char* const ENERGY_SUBSYSTEM_NAMES[ENERGY_SUBSYSTEMS] = { "radio", "display", "cpu", "sensor" };
+
+class EnergyLedger {
+public:
+  explicit EnergyLedger(const EnergyProfile& profile = DEFAULT_ENERGY_PROFILE) : profile(profile) {}
+
+  void setProfile(const EnergyProfile& newProfile) { profile = newProfile; }
+
+  // Starts accounting at nowUs with every subsystem in state 0
+  void begin(uint64_t nowUs);
+  void setState(EnergySubsystem subsystem, uint8_t state, uint64_t nowUs);
+  // Interrupt time measured by the subsystem itself
+  void addIsrTime(EnergySubsystem subsystem, uint32_t us);
+  // Closes the open intervals so the totals include time up to nowUs
+  void update(uint64_t nowUs);
+
+  uint8_t state(EnergySubsystem subsystem) const { return currentState[subsystem]; }
+  uint64_t elapsedUs() const { return lastUs - startUs; }
+  uint64_t stateUs(EnergySubsystem subsystem, uint8_t state) const { return timeInState[subsystem][state]; }
+  uint32_t transitions(EnergySubsystem subsystem) const { return transitionCount[subsystem]; }
+  uint64_t isrUs(EnergySubsystem subsystem) const { return interruptUs[subsystem]; }
+
+  // Charge in uAh since begin()
+  uint64_t microAmpHours(EnergySubsystem subsystem) const;
+  // Average current, which is also the uAh used per hour
+  uint32_t averageMicroAmps(EnergySubsystem subsystem) const;
+
+private:
+  // Sum of uA * us over all closed intervals
+  uint64_t charge(EnergySubsystem subsystem) const;
+
+  EnergyProfile profile;
+  uint64_t startUs = 0;
+  uint64_t lastUs = 0;
+  uint64_t sinceUs[ENERGY_SUBSYSTEMS] = {};
+  uint8_t currentState[ENERGY_SUBSYSTEMS] = {};
+  uint64_t timeInState[ENERGY_SUBSYSTEMS][ENERGY_MAX_STATES] = {};
+  uint32_t transitionCount[ENERGY_SUBSYSTEMS] = {};
+  uint64_t interruptUs[ENERGY_SUBSYSTEMS] = {};
+};
+
+// Writes the ledger as JSON, e.g.
+// {"uptimeS":3600,"mAhPerHour":{"radio":8.41,...},"totalMAhPerHour":42.10,
+//  "stateS":{"radio":[0,3500,100],...},"isrMs":{"sensor":12}}
+// Returns the length, 0 if the buffer is too small.
+size_t formatEnergyReport(const EnergyLedger& ledger, char* out, size_t capacity);
+
+#endif
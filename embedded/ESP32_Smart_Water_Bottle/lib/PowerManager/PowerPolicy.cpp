@@ -0,0 +1,53 @@
+#include "PowerPolicy.h"
+
+void PowerPolicy::noteActivity(uint32_t nowMs) {
+  lastActivityMs = nowMs;
+  currentState = POWER_ACTIVE;
+}
+
+PowerState PowerPolicy::update(uint32_t nowMs, bool connected, bool deepSleepAllowed) {
+  uint32_t idle = nowMs - lastActivityMs;
+  if (idle < config.activeHoldMs) {
+    currentState = POWER_ACTIVE;
+  } else if (deepSleepAllowed && !connected && idle >= config.deepSleepIdleMs) {
+    currentState = POWER_DEEP_SLEEP;
+  } else {
+    currentState = POWER_IDLE;
+  }
+  return currentState;
+}
+
+void PowerLedger::reset() {
+  for (size_t i = 0; i < POWER_STATE_COUNT; i++) stateMs[i] = 0;
+  transitions = 0;
+  lastState = POWER_ACTIVE;
+}
+
+void PowerLedger::add(PowerState state, uint32_t ms) {
+  if (state != lastState) transitions++;
+  lastState = state;
+  stateMs[state] += ms;
+}
+
+uint64_t PowerLedger::totalMs() const {
+  uint64_t total = 0;
+  for (size_t i = 0; i < POWER_STATE_COUNT; i++) total += stateMs[i];
+  return total;
+}
+
+uint32_t PowerLedger::dutyCyclePermille(const PowerModel& model) const {
+  uint64_t total = totalMs();
+  if (total == 0) return 0;
+  uint64_t awake = stateMs[POWER_ACTIVE] * 1000 + stateMs[POWER_IDLE] * model.idleAwakePermille;
+  return (uint32_t)(awake / total);
+}
+
+uint32_t PowerLedger::averageMicroAmps(const PowerModel& model) const {
+  uint64_t total = totalMs();
+  if (total == 0) return 0;
+  uint64_t idleUa = ((uint64_t)model.idleAwakeUa * model.idleAwakePermille +
+                     (uint64_t)model.lightSleepUa * (1000 - model.idleAwakePermille)) / 1000;
+  uint64_t charge = stateMs[POWER_ACTIVE] * model.activeUa + stateMs[POWER_IDLE] * idleUa +
+                    stateMs[POWER_DEEP_SLEEP] * model.deepSleepUa;
+  return (uint32_t)(charge / total);
+}
@@ -0,0 +1,85 @@
+#ifndef POWERPOLICY_H
+#define POWERPOLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decides how deeply the bottle may sleep:
+//
+//   ACTIVE       flow, a button press or BLE traffic within activeHoldMs,
+//                light sleep is blocked so the pulse counter keeps running
+//   IDLE         loop() blocks between events and the chip may enter
+//                light sleep, a flow edge or a BLE command wakes it
+//   DEEP_SLEEP   nothing happened for deepSleepIdleMs while disconnected
+//
+// Time only comes from the caller, so the policy runs the same on the
+// device and in a host simulation.
+enum PowerState : uint8_t {
+  POWER_ACTIVE,
+  POWER_IDLE,
+  POWER_DEEP_SLEEP,
+  POWER_STATE_COUNT
+};
+
+struct PowerConfig {
+  uint32_t activeHoldMs;
+  uint32_t deepSleepIdleMs;
+};
+
+const PowerConfig DEFAULT_POWER_CONFIG = { 10000, 2 * 60 * 60 * 1000UL };
+
+class PowerPolicy {
+public:
+  explicit PowerPolicy(const PowerConfig& config = DEFAULT_POWER_CONFIG) : config(config) {}
+
+  void setConfig(const PowerConfig& newConfig) { config = newConfig; }
+
+  // Anything that should keep the bottle awake for another activeHoldMs
+  void noteActivity(uint32_t nowMs);
+
+  // Returns the state for nowMs, deep sleep only if the caller has a way
+  // to wake up from it
+  PowerState update(uint32_t nowMs, bool connected, bool deepSleepAllowed);
+
+  PowerState state() const { return currentState; }
+  uint32_t idleMs(uint32_t nowMs) const { return nowMs - lastActivityMs; }
+
+private:
+  PowerConfig config;
+  PowerState currentState = POWER_ACTIVE;
+  uint32_t lastActivityMs = 0;
+};
+
+// Supply current per state, in uA. While idle the chip is awake for
+// idleAwakePermille of the time (sensor samples, advertising, connection
+// events) and in light sleep for the rest. A core without automatic
+// light sleep stays awake, that is idleAwakePermille = 1000.
+struct PowerModel {
+  uint32_t activeUa;
+  uint32_t idleAwakeUa;
+  uint32_t lightSleepUa;
+  uint32_t deepSleepUa;
+  uint32_t idleAwakePermille;
+};
+
+// ESP32 datasheet figures: 240 MHz with the radio in use, 80 MHz modem
+// sleep, light and deep sleep. The display is not included.
+const PowerModel STOCK_CORE_POWER_MODEL = { 45000, 20000, 800, 10, 1000 };
+const PowerModel LIGHT_SLEEP_POWER_MODEL = { 45000, 20000, 800, 10, 20 };
+
+// Time spent in every power state
+struct PowerLedger {
+  uint64_t stateMs[POWER_STATE_COUNT];
+  uint32_t transitions;
+  PowerState lastState;
+
+  void reset();
+  void add(PowerState state, uint32_t ms);
+
+  uint64_t totalMs() const;
+  // Share of the time the CPU is awake, in permille
+  uint32_t dutyCyclePermille(const PowerModel& model) const;
+  uint32_t averageMicroAmps(const PowerModel& model) const;
+};
+
+#endif
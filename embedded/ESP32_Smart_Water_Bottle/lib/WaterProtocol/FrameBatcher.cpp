@@ -0,0 +1,81 @@
+#include "FrameBatcher.h"
+#include <string.h>
+
+FrameBatcher::FrameBatcher(FrameSink& sink, uint32_t maxDelayMs)
+    : sink(sink), maxDelayMs(maxDelayMs) {
+  capacity = BATCH_DEFAULT_PAYLOAD;
+  used = 0;
+  bufferedFrames = 0;
+  oldestFrameMs = 0;
+  resetStats();
+}
+
+void FrameBatcher::setMtu(uint16_t mtu) {
+  size_t payload = mtu > 3 ? mtu - 3 : 0;
+  if (payload < WATER_FRAME_MAX_SIZE) payload = BATCH_DEFAULT_PAYLOAD;
+  if (payload > BATCH_MAX_PAYLOAD) payload = BATCH_MAX_PAYLOAD;
+
+  if (payload < used) flush();
+  capacity = payload;
+}
+
+bool FrameBatcher::add(const WaterFrame& frame, uint32_t nowMs) {
+  size_t size = waterFrameSize(frame.type);
+  // A drink event does not fit the payload of the default MTU
+  if (size == 0 || size > capacity) return false;
+
+  // Not enough room left: send what is buffered first
+  if (used + size > capacity && !flush()) return false;
+
+  if (bufferedFrames == 0) oldestFrameMs = nowMs;
+  used += encodeWaterFrame(frame, buffer + used, capacity - used);
+  bufferedFrames++;
+
+  // A full notification does not need to wait for the deadline
+  if (capacity - used < WATER_FRAME_HEADER_SIZE) flush();
+  return true;
+}
+
+void FrameBatcher::poll(uint32_t nowMs) {
+  if (bufferedFrames > 0 && nowMs - oldestFrameMs >= maxDelayMs) {
+    flush();
+  }
+}
+
+bool FrameBatcher::flush() {
+  if (bufferedFrames == 0) return true;
+  if (!sink.sendNotification(buffer, used)) return false;
+
+  batchStats.frames += bufferedFrames;
+  batchStats.notifications++;
+  batchStats.bytes += used;
+
+  used = 0;
+  bufferedFrames = 0;
+  return true;
+}
+
+void FrameBatcher::clear() {
+  used = 0;
+  bufferedFrames = 0;
+}
+
+void FrameBatcher::resetStats() {
+  memset(&batchStats, 0, sizeof(batchStats));
+}
+
+bool LoopbackFrameSink::sendNotification(const uint8_t* data, size_t length) {
+  receivedNotifications++;
+
+  size_t offset = 0;
+  while (offset < length) {
+    size_t consumed = decodeWaterFrame(data + offset, length - offset, lastFrame);
+    if (consumed == 0) {
+      decodeErrors++;
+      return true;
+    }
+    receivedFrames++;
+    offset += consumed;
+  }
+  return true;
+}
@@ -0,0 +1,70 @@
+#ifndef FRAMEBATCHER_H
+#define FRAMEBATCHER_H
+
+#include "WaterProtocol.h"
+
+// Largest notification payload: ATT attribute values are limited to 512 bytes
+const size_t BATCH_MAX_PAYLOAD = 512;
+// Payload of the default ATT MTU (23) minus the 3 byte notification header
+const size_t BATCH_DEFAULT_PAYLOAD = 20;
+
+// Destination for packed notifications
+class FrameSink {
+public:
+  virtual ~FrameSink() {}
+  virtual bool sendNotification(const uint8_t* data, size_t length) = 0;
+};
+
+struct BatchStats {
+  uint32_t frames;
+  uint32_t notifications;
+  uint32_t bytes;
+};
+
+// Packs consecutive frames into as few notifications as the negotiated
+// MTU allows. A notification goes out as soon as the next frame would not
+// fit, or once the oldest buffered frame has waited maxDelayMs.
+class FrameBatcher {
+public:
+  FrameBatcher(FrameSink& sink, uint32_t maxDelayMs);
+
+  // Applies a negotiated ATT MTU, flushing frames that no longer fit
+  void setMtu(uint16_t mtu);
+  size_t payloadCapacity() const { return capacity; }
+
+  // Returns false if the frame can never fit the current MTU or the
+  // buffered frames could not be sent to make room
+  bool add(const WaterFrame& frame, uint32_t nowMs);
+  void poll(uint32_t nowMs);
+  bool flush();
+
+  // Drops buffered frames, e.g. after a disconnect
+  void clear();
+
+  const BatchStats& stats() const { return batchStats; }
+  void resetStats();
+
+private:
+  FrameSink& sink;
+  uint32_t maxDelayMs;
+  size_t capacity;
+  uint8_t buffer[BATCH_MAX_PAYLOAD];
+  size_t used;
+  uint16_t bufferedFrames;
+  uint32_t oldestFrameMs;
+  BatchStats batchStats;
+};
+
+// Loopback stand-in for host builds: decodes every notification again and
+// counts what a central would have received
+class LoopbackFrameSink : public FrameSink {
+public:
+  bool sendNotification(const uint8_t* data, size_t length) override;
+
+  uint32_t receivedFrames = 0;
+  uint32_t receivedNotifications = 0;
+  uint32_t decodeErrors = 0;
+  WaterFrame lastFrame = {};
+};
+
+#endif
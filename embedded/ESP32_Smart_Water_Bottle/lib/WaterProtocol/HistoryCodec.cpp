@@ -0,0 +1,129 @@
+#include "HistoryCodec.h"
+#include <string.h>
+
+size_t writeVarint(uint8_t* out, size_t capacity, uint64_t value) {
+  size_t length = 0;
+  do {
+    if (length >= capacity) return 0;
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    out[length++] = value != 0 ? (byte | 0x80) : byte;
+  } while (value != 0);
+  return length;
+}
+
+size_t readVarint(const uint8_t* data, size_t length, uint64_t& value) {
+  value = 0;
+  for (size_t i = 0; i < length && i < 10; i++) {
+    value |= (uint64_t)(data[i] & 0x7F) << (7 * i);
+    if ((data[i] & 0x80) == 0) return i + 1;
+  }
+  return 0;
+}
+
+uint64_t zigzagEncode(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+int64_t zigzagDecode(uint64_t value) {
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+void HistoryChunkWriter::begin(uint8_t* out, size_t capacity) {
+  this->out = out;
+  this->capacity = capacity;
+  used = HISTORY_CHUNK_HEADER_SIZE;
+  records = 0;
+}
+
+bool HistoryChunkWriter::add(const HistoryRecord& record) {
+  if (records == HISTORY_CHUNK_MAX_RECORDS || used >= capacity) return false;
+
+  // Encode into a scratch buffer first so a record never ends up half written
+  uint8_t scratch[32];
+  size_t length = 0;
+  if (records > 0) {
+    length += writeVarint(scratch, sizeof(scratch), record.sequence - previous.sequence);
+    length += writeVarint(scratch + length, sizeof(scratch) - length,
+                          zigzagEncode((int64_t)(record.timestampMs - previous.timestampMs)));
+  }
+  length += writeVarint(scratch + length, sizeof(scratch) - length, record.amountMl);
+  length += writeVarint(scratch + length, sizeof(scratch) - length, record.durationMs);
+  length += writeVarint(scratch + length, sizeof(scratch) - length, record.peakFlowMlPerMin);
+  length += writeVarint(scratch + length, sizeof(scratch) - length, record.meanFlowMlPerMin);
+  if (used + length > capacity) return false;
+
+  if (records == 0) {
+    writeWaterFrameHeader(FRAME_HISTORY_CHUNK, record.sequence, record.timestampMs, out);
+  }
+  memcpy(out + used, scratch, length);
+  used += length;
+  records++;
+  previous = record;
+  return true;
+}
+
+size_t HistoryChunkWriter::finish(uint32_t lastSequence) {
+  if (records == 0) {
+    writeWaterFrameHeader(FRAME_HISTORY_CHUNK, lastSequence, 0, out);
+  }
+  out[WATER_FRAME_HEADER_SIZE] = records;
+  return used;
+}
+
+bool decodeHistoryChunk(const uint8_t* data, size_t length, HistoryRecord* records,
+                        size_t maxRecords, size_t& recordCount) {
+  WaterFrame header;
+  recordCount = 0;
+  if (length < HISTORY_CHUNK_HEADER_SIZE || !readWaterFrameHeader(data, length, header)) return false;
+  if (header.type != FRAME_HISTORY_CHUNK) return false;
+
+  size_t count = data[WATER_FRAME_HEADER_SIZE];
+  if (count > maxRecords) return false;
+
+  size_t offset = HISTORY_CHUNK_HEADER_SIZE;
+  HistoryRecord current;
+  current.sequence = header.sequence;
+  current.timestampMs = header.timestampMs;
+
+  for (size_t i = 0; i < count; i++) {
+    uint64_t value;
+    size_t consumed;
+    if (i > 0) {
+      consumed = readVarint(data + offset, length - offset, value);
+      if (consumed == 0) return false;
+      current.sequence += (uint32_t)value;
+      offset += consumed;
+
+      consumed = readVarint(data + offset, length - offset, value);
+      if (consumed == 0) return false;
+      current.timestampMs += (uint64_t)zigzagDecode(value);
+      offset += consumed;
+    }
+
+    consumed = readVarint(data + offset, length - offset, value);
+    if (consumed == 0 || value > 0xFFFF) return false;
+    current.amountMl = (uint16_t)value;
+    offset += consumed;
+
+    consumed = readVarint(data + offset, length - offset, value);
+    if (consumed == 0 || value > 0xFFFFFFFF) return false;
+    current.durationMs = (uint32_t)value;
+    offset += consumed;
+
+    consumed = readVarint(data + offset, length - offset, value);
+    if (consumed == 0 || value > 0xFFFF) return false;
+    current.peakFlowMlPerMin = (uint16_t)value;
+    offset += consumed;
+
+    consumed = readVarint(data + offset, length - offset, value);
+    if (consumed == 0 || value > 0xFFFF) return false;
+    current.meanFlowMlPerMin = (uint16_t)value;
+    offset += consumed;
+
+    records[i] = current;
+  }
+
+  recordCount = count;
+  return offset == length;
+}
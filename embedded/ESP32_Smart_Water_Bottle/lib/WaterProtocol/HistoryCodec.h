@@ -0,0 +1,66 @@
+#ifndef HISTORYCODEC_H
+#define HISTORYCODEC_H
+
+#include "WaterProtocol.h"
+
+// History chunks answer a HISTORY_REQUEST with every journaled drink event
+// after the sequence the central asked for. Unlike the other frames a chunk
+// has a variable length and always fills a notification on its own:
+//
+//   [0..13]  frame header, sequence and timestamp of the first record
+//            (timestamps are 0 for events whose time was never known)
+//   [14]     number of records in the chunk (0 marks the end of the history)
+//   [15..]   the first record: amountMl, durationMs, peak and mean ml/min,
+//            then every further record: sequence delta, zigzag timestamp
+//            delta in ms, amountMl, durationMs, peak and mean ml/min
+//            (all varints)
+//
+// Consecutive sips are a few minutes apart, so a record usually takes
+// 11-12 bytes instead of a 24 byte DRINK_EVENT frame.
+
+const size_t HISTORY_CHUNK_HEADER_SIZE = WATER_FRAME_HEADER_SIZE + 1;
+const uint8_t HISTORY_CHUNK_MAX_RECORDS = 255;
+
+struct HistoryRecord {
+  uint32_t sequence;
+  uint64_t timestampMs;
+  uint16_t amountMl;
+  uint32_t durationMs;
+  uint16_t peakFlowMlPerMin;
+  uint16_t meanFlowMlPerMin;
+};
+
+// LEB128 varints, zigzag for signed values
+size_t writeVarint(uint8_t* out, size_t capacity, uint64_t value);
+size_t readVarint(const uint8_t* data, size_t length, uint64_t& value);
+uint64_t zigzagEncode(int64_t value);
+int64_t zigzagDecode(uint64_t value);
+
+class HistoryChunkWriter {
+public:
+  // Starts a chunk in out, capacity is usually the notification payload size
+  void begin(uint8_t* out, size_t capacity);
+
+  // Returns false if the record does not fit anymore
+  bool add(const HistoryRecord& record);
+
+  // Finishes the chunk, returns its length. An empty chunk ends the history
+  // and carries lastSequence so the central knows where the bottle stopped.
+  size_t finish(uint32_t lastSequence);
+
+  uint8_t count() const { return records; }
+
+private:
+  uint8_t* out;
+  size_t capacity;
+  size_t used;
+  uint8_t records;
+  HistoryRecord previous;
+};
+
+// Decodes a chunk into records, returns false for malformed data.
+// recordCount is 0 for the end-of-history marker.
+bool decodeHistoryChunk(const uint8_t* data, size_t length, HistoryRecord* records,
+                        size_t maxRecords, size_t& recordCount);
+
+#endif
@@ -0,0 +1,87 @@
+#include "ReliableLink.h"
+#include <string.h>
+
+ReliableLink::ReliableLink(FrameBatcher& batcher, uint32_t retransmitTimeoutMs, uint16_t initialCredits,
+                           uint32_t creditProbeMs)
+    : batcher(batcher), retransmitTimeoutMs(retransmitTimeoutMs), initialCredits(initialCredits),
+      creditProbeMs(creditProbeMs) {
+  memset(&linkStats, 0, sizeof(linkStats));
+  reset(0, 0);
+}
+
+void ReliableLink::reset(uint32_t ackedSequence, uint32_t lastSequence) {
+  head = 0;
+  count = 0;
+  acked = ackedSequence;
+  highestSequence = lastSequence > ackedSequence ? lastSequence : ackedSequence;
+  credits = initialCredits;
+  probing = false;
+}
+
+bool ReliableLink::canSend() const {
+  return count < RELIABLE_WINDOW && count < credits;
+}
+
+bool ReliableLink::send(const WaterFrame& frame, uint32_t nowMs) {
+  if (!canSend()) return false;
+
+  Slot& slot = window[(head + count) % RELIABLE_WINDOW];
+  slot.frame = frame;
+  slot.sentMs = nowMs;
+  count++;
+  if (frame.sequence > highestSequence) highestSequence = frame.sequence;
+  linkStats.sent++;
+
+  // A failed add is recovered by the retransmission timer
+  batcher.add(frame, nowMs);
+  return true;
+}
+
+void ReliableLink::onAck(uint32_t sequence, uint16_t credits) {
+  // Acks beyond every event the central could have seen belong to another journal
+  if (sequence > highestSequence) {
+    linkStats.invalidAcks++;
+    return;
+  }
+  if (sequence < acked) {
+    linkStats.staleAcks++;
+    return;
+  }
+
+  this->credits = credits;
+  if (sequence == acked) return;
+
+  acked = sequence;
+  linkStats.acks++;
+  while (count > 0 && window[head].frame.sequence <= sequence) {
+    head = (head + 1) % RELIABLE_WINDOW;
+    count--;
+  }
+}
+
+void ReliableLink::poll(uint32_t nowMs) {
+  if (count > 0 && nowMs - window[head].sentMs >= retransmitTimeoutMs) {
+    // Go back N: send the whole window again, the central drops duplicates
+    for (size_t i = 0; i < count; i++) {
+      Slot& slot = window[(head + i) % RELIABLE_WINDOW];
+      slot.sentMs = nowMs;
+      batcher.add(slot.frame, nowMs);
+    }
+    linkStats.retransmitted += count;
+  }
+
+  if (credits == 0 && count == 0) {
+    if (!probing) {
+      probing = true;
+      probeMs = nowMs;
+    } else if (nowMs - probeMs >= creditProbeMs) {
+      WaterFrame probe = { FRAME_CREDIT_PROBE, acked, 0, 0, 0, 0, 0 };
+      batcher.add(probe, nowMs);
+      probeMs = nowMs;
+      linkStats.creditProbes++;
+    }
+  } else {
+    probing = false;
+  }
+  batcher.poll(nowMs);
+}
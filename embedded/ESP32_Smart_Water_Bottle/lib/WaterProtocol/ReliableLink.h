@@ -0,0 +1,75 @@
+#ifndef RELIABLELINK_H
+#define RELIABLELINK_H
+
+#include "FrameBatcher.h"
+
+// Maximum number of unacknowledged drink events kept for retransmission
+const size_t RELIABLE_WINDOW = 64;
+
+struct ReliableStats {
+  uint32_t sent;
+  uint32_t retransmitted;
+  uint32_t acks;
+  uint32_t staleAcks;    // Older than the current ack, credits included
+  uint32_t invalidAcks;  // Above the highest event sent, ignored
+  uint32_t creditProbes;
+};
+
+// Sequenced delivery of drink events on top of the frame batcher.
+//
+// Every event keeps the sequence number it got in the journal. The central
+// acknowledges cumulatively with an ACK frame whose payload grants credits:
+// the number of events it is willing to have in flight. Events stay in a
+// bounded window until they are acknowledged and the whole window is sent
+// again when the oldest one times out. The central drops sequence numbers
+// it has already seen, which together gives exactly-once delivery.
+//
+// An ACK for the current sequence only updates the credits. Older ACKs
+// arrived out of order, their credits are outdated and ignored as well, and
+// so are ACKs above the last event sent or known from before the reset.
+// After a grant of 0 credits nothing is in flight that would draw another
+// ACK, so a CREDIT_PROBE goes out every creditProbeMs until one arrives.
+class ReliableLink {
+public:
+  ReliableLink(FrameBatcher& batcher, uint32_t retransmitTimeoutMs, uint16_t initialCredits,
+               uint32_t creditProbeMs);
+
+  // Forgets everything in flight, e.g. after a reconnect. Events up to
+  // lastSequence may have reached the central before and can be acked.
+  void reset(uint32_t ackedSequence, uint32_t lastSequence);
+
+  bool canSend() const;
+  bool send(const WaterFrame& frame, uint32_t nowMs);
+  void onAck(uint32_t sequence, uint16_t credits);
+
+  // Retransmits timed out events, probes for credits and flushes the
+  // batcher on its deadline
+  void poll(uint32_t nowMs);
+
+  uint32_t ackedSequence() const { return acked; }
+  size_t inFlight() const { return count; }
+  uint16_t availableCredits() const { return credits; }
+  const ReliableStats& stats() const { return linkStats; }
+
+private:
+  struct Slot {
+    WaterFrame frame;
+    uint32_t sentMs;
+  };
+
+  FrameBatcher& batcher;
+  uint32_t retransmitTimeoutMs;
+  uint16_t initialCredits;
+  uint32_t creditProbeMs;
+  Slot window[RELIABLE_WINDOW];
+  size_t head;
+  size_t count;
+  uint32_t acked;
+  uint32_t highestSequence;  // Newest event the central may have seen
+  uint16_t credits;
+  bool probing;
+  uint32_t probeMs;  // Start of the wait for credits or time of the last probe
+  ReliableStats linkStats;
+};
+
+#endif
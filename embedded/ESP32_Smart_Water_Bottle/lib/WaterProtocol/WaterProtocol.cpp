@@ -0,0 +1,143 @@
+#include "WaterProtocol.h"
+
+static void writeUint16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)(value);
+  out[1] = (uint8_t)(value >> 8);
+}
+
+static void writeUint32(uint8_t* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static void writeUint64(uint8_t* out, uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static uint16_t readUint16(const uint8_t* in) {
+  return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t readUint32(const uint8_t* in) {
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; i--) {
+    value = (value << 8) | in[i];
+  }
+  return value;
+}
+
+static uint64_t readUint64(const uint8_t* in) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | in[i];
+  }
+  return value;
+}
+
+// Payload size per frame type, -1 for unknown types
+static int payloadSize(uint8_t type) {
+  switch (type) {
+    case FRAME_HELLO:
+    case FRAME_SYNC_REQUEST:
+    case FRAME_SYNC_CONFIRM:
+    case FRAME_HISTORY_REQUEST:
+    case FRAME_CREDIT_PROBE:
+      return 0;
+    case FRAME_REMINDER:
+      return 1;
+    case FRAME_WATER_GOAL:
+    case FRAME_CURRENT_WATER:
+    case FRAME_ACK:
+    case FRAME_CALIBRATE:
+    case FRAME_CALIBRATION_RUN:
+    case FRAME_CALIBRATION_STORED:
+      return 2;
+    case FRAME_DRINK_EVENT:
+      return 10;
+    default:
+      return -1;
+  }
+}
+
+bool isBinaryFrame(const uint8_t* data, size_t length) {
+  return length > 0 && data[0] == WATER_PROTOCOL_VERSION;
+}
+
+size_t waterFrameSize(uint8_t type) {
+  int payload = payloadSize(type);
+  if (payload < 0) return 0;
+  return WATER_FRAME_HEADER_SIZE + payload;
+}
+
+void writeWaterFrameHeader(uint8_t type, uint32_t sequence, uint64_t timestampMs, uint8_t* out) {
+  out[0] = WATER_PROTOCOL_VERSION;
+  out[1] = type;
+  writeUint32(out + 2, sequence);
+  writeUint64(out + 6, timestampMs);
+}
+
+bool readWaterFrameHeader(const uint8_t* data, size_t length, WaterFrame& frame) {
+  if (length < WATER_FRAME_HEADER_SIZE || data[0] != WATER_PROTOCOL_VERSION) return false;
+
+  frame.type = data[1];
+  frame.sequence = readUint32(data + 2);
+  frame.timestampMs = readUint64(data + 6);
+  frame.value = 0;
+  frame.durationMs = 0;
+  frame.peakFlowMlPerMin = 0;
+  frame.meanFlowMlPerMin = 0;
+  return true;
+}
+
+size_t encodeWaterFrame(const WaterFrame& frame, uint8_t* out, size_t capacity) {
+  size_t size = waterFrameSize(frame.type);
+  if (size == 0 || size > capacity) return 0;
+
+  writeWaterFrameHeader(frame.type, frame.sequence, frame.timestampMs, out);
+
+  uint8_t* payload = out + WATER_FRAME_HEADER_SIZE;
+  switch (size - WATER_FRAME_HEADER_SIZE) {
+    case 1:
+      payload[0] = (uint8_t)frame.value;
+      break;
+    case 2:
+      writeUint16(payload, frame.value);
+      break;
+    case 10:
+      writeUint16(payload, frame.value);
+      writeUint32(payload + 2, frame.durationMs);
+      writeUint16(payload + 6, frame.peakFlowMlPerMin);
+      writeUint16(payload + 8, frame.meanFlowMlPerMin);
+      break;
+  }
+  return size;
+}
+
+size_t decodeWaterFrame(const uint8_t* data, size_t length, WaterFrame& frame) {
+  if (length < WATER_FRAME_HEADER_SIZE || data[0] != WATER_PROTOCOL_VERSION) return 0;
+
+  size_t size = waterFrameSize(data[1]);
+  if (size == 0 || size > length) return 0;
+
+  readWaterFrameHeader(data, length, frame);
+
+  const uint8_t* payload = data + WATER_FRAME_HEADER_SIZE;
+  switch (size - WATER_FRAME_HEADER_SIZE) {
+    case 1:
+      frame.value = payload[0];
+      break;
+    case 2:
+      frame.value = readUint16(payload);
+      break;
+    case 10:
+      frame.value = readUint16(payload);
+      frame.durationMs = readUint32(payload + 2);
+      frame.peakFlowMlPerMin = readUint16(payload + 6);
+      frame.meanFlowMlPerMin = readUint16(payload + 8);
+      break;
+  }
+  return size;
+}
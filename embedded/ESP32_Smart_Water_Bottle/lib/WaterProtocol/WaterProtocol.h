@@ -0,0 +1,79 @@
+#ifndef WATERPROTOCOL_H
+#define WATERPROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary BLE wire protocol shared by the bottle and the app.
+// Every frame starts with a fixed header (all fields little endian):
+//
+//   [0]      protocol version
+//   [1]      frame type
+//   [2..5]   sequence number, see below
+//   [6..13]  timestamp in epoch milliseconds, 0 while the bottle has no time
+//   [14..]   fixed-size payload depending on the frame type
+//
+// Frames have a fixed length per type, so several frames can be
+// concatenated into one BLE write or notification. The first byte of a
+// JSON message is always '{', which never collides with a protocol
+// version, so both formats can be told apart on the same characteristic.
+//
+// The sequence number belongs to the journal: drink events and history
+// chunks carry the sequence of a journaled event, ACK, HISTORY_REQUEST
+// and CREDIT_PROBE refer to one. Every other frame is a control frame with
+// sequence 0, except the bottle's HELLO, which carries the journal epoch
+// (see DrinkJournal.h).
+
+// Version 2 added the session details to DRINK_EVENT and history records
+const uint8_t WATER_PROTOCOL_VERSION = 2;
+const size_t WATER_FRAME_HEADER_SIZE = 14;
+const size_t WATER_FRAME_MAX_SIZE = WATER_FRAME_HEADER_SIZE + 10;
+
+enum WaterFrameType : uint8_t {
+  FRAME_HELLO = 0x01,          // Both directions: central asks for binary, bottle confirms with its journal epoch
+  FRAME_DRINK_EVENT = 0x02,    // Bottle -> central: amountMl (uint16), durationMs (uint32), peak and mean ml/min (uint16)
+  FRAME_SYNC_REQUEST = 0x03,   // Bottle -> central: no payload
+  FRAME_SYNC_CONFIRM = 0x04,   // Central -> bottle: header timestamp is the current time
+  FRAME_REMINDER = 0x05,       // Central -> bottle: payload DrinkReminderType (uint8)
+  FRAME_WATER_GOAL = 0x06,     // Central -> bottle: payload waterGoal in ml (uint16)
+  FRAME_CURRENT_WATER = 0x07,  // Central -> bottle: payload currentWater in ml (uint16)
+  FRAME_ACK = 0x08,            // Central -> bottle: header sequence is the cumulative ack, payload credits (uint16)
+  FRAME_HISTORY_REQUEST = 0x09,// Central -> bottle: header sequence is the last event the central has seen
+  FRAME_HISTORY_CHUNK = 0x0A,  // Bottle -> central: variable length, see HistoryCodec.h
+  FRAME_CALIBRATE = 0x0B,      // Central -> bottle: reference ml for the next pour, 0 fits and stores, 0xFFFF resets
+  FRAME_CALIBRATION_RUN = 0x0C,// Bottle -> central: pulses counted for the reference pour (uint16)
+  FRAME_CALIBRATION_STORED = 0x0D,// Bottle -> central: points in the stored table (uint16), 0 if none could be fitted
+  FRAME_CREDIT_PROBE = 0x0E    // Bottle -> central: header sequence is the bottle's ack, asks for an ACK with credits
+};
+
+struct WaterFrame {
+  uint8_t type;
+  uint32_t sequence;
+  uint64_t timestampMs;
+  // amountMl, reminder type, water goal, current water, credits or calibration value depending on type
+  uint16_t value;
+  // DRINK_EVENT only, 0 in every other frame
+  uint32_t durationMs;
+  uint16_t peakFlowMlPerMin;
+  uint16_t meanFlowMlPerMin;
+};
+
+// Returns true if the first byte of a message belongs to a binary frame
+bool isBinaryFrame(const uint8_t* data, size_t length);
+
+// Total frame size (header + payload) for a type, 0 for unknown types
+size_t waterFrameSize(uint8_t type);
+
+// Writes a frame into out, returns the number of bytes written or 0 if
+// the type is unknown or the buffer is too small
+size_t encodeWaterFrame(const WaterFrame& frame, uint8_t* out, size_t capacity);
+
+// Header helpers for frames with a variable length payload
+void writeWaterFrameHeader(uint8_t type, uint32_t sequence, uint64_t timestampMs, uint8_t* out);
+bool readWaterFrameHeader(const uint8_t* data, size_t length, WaterFrame& frame);
+
+// Reads one frame from data, returns the number of bytes consumed or 0
+// if the data does not start with a complete, supported frame
+size_t decodeWaterFrame(const uint8_t* data, size_t length, WaterFrame& frame);
+
+#endif
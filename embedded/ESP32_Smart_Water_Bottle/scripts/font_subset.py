@@ -0,0 +1,164 @@
+"""Generates UiFont.h, the subset of the GLCD font the display actually uses.
+
+Runs as a PlatformIO pre script: collects every character of the strings
+the UI shows (setElementText() literals and reminder messages in
+src/WaterBottleDisplay.cpp, plus what the volume formatter prints) and
+copies only those glyphs out of TFT_eSPI's Fonts/glcdfont.c. The header is
+written to the build directory, so the full 1280 byte font table and the
+other TFT_eSPI fonts are not compiled in.
+
+Every other string or character literal in those sources, except in
+Serial calls, may reach the screen through a variable. The build fails if
+one of them uses a character that is not in the subset, and also if the
+volume formatter prints one that FORMATTER_CHARACTERS lacks.
+
+Standalone, e.g. for host builds:
+    python scripts/font_subset.py <glcdfont.c> <output directory>
+"""
+
+import codecs
+import os
+import re
+import sys
+
+UI_SOURCES = ["src/WaterBottleDisplay.cpp"]
+FORMATTER_SOURCES = ["lib/DisplayRenderer/VolumeFormat.cpp"]
+# Everything lib/DisplayRenderer/VolumeFormat.cpp can print
+FORMATTER_CHARACTERS = "0123456789.- L/"
+
+UI_STRING_PATTERNS = [
+    re.compile(r'setElementText\([^,]+,\s*"((?:[^"\\]|\\.)*)"'),
+    re.compile(r'\bmessage\s*=\s*"((?:[^"\\]|\\.)*)"'),
+]
+
+
+def used_characters(project_dir):
+    characters = set(FORMATTER_CHARACTERS)
+    for source in UI_SOURCES:
+        with open(os.path.join(project_dir, source), encoding="utf-8") as f:
+            text = f.read()
+        for pattern in UI_STRING_PATTERNS:
+            for literal in pattern.findall(text):
+                characters.update(literal)
+    unsupported = sorted(c for c in characters if not 0x20 <= ord(c) <= 0x7E)
+    if unsupported:
+        raise ValueError("UI text uses characters outside printable ASCII: %r" % unsupported)
+    return "".join(sorted(characters))
+
+
+# Comments, literals, preprocessor lines and statement boundaries of C++
+# source, in order. A '//' or quote inside a literal or comment is part of
+# that token, so it cannot start another one.
+CPP_TOKEN = re.compile(
+    r'//[^\n]*|/\*.*?\*/|"(?:[^"\\\n]|\\.)*"|\'(?:[^\'\\\n]|\\.)*\'|^[ \t]*#[^\n]*|[;{}]',
+    re.S | re.M)
+LOG_CALL = re.compile(r"\bSerial\.\w+\s*\(")
+
+
+def drawable_literals(text):
+    """Yields (line, text) for every literal outside comments, preprocessor
+    lines and Serial calls."""
+    statement_start = 0
+    for token in CPP_TOKEN.finditer(text):
+        value = token.group()
+        if value in ";{}":
+            statement_start = token.end()
+            continue
+        if value[0] not in "\"'":
+            continue
+        if LOG_CALL.search(text, statement_start, token.start()):
+            continue
+        body = value[1:-1].encode("latin-1", "backslashreplace")
+        yield text.count("\n", 0, token.start()) + 1, codecs.decode(body, "unicode_escape")
+
+
+def check_drawn_text(project_dir, characters):
+    checks = (
+        (UI_SOURCES, characters, "the UI font subset lacks; pass UI text to setElementText() or message = "
+                                 "as a literal, or add its pattern to UI_STRING_PATTERNS"),
+        (FORMATTER_SOURCES, FORMATTER_CHARACTERS, "FORMATTER_CHARACTERS lacks"),
+    )
+    problems = []
+    for sources, allowed, reason in checks:
+        for source in sources:
+            with open(os.path.join(project_dir, source), encoding="utf-8") as f:
+                text = f.read()
+            for line, literal in drawable_literals(text):
+                # Control characters are never drawn
+                missing = sorted(set(c for c in literal if ord(c) >= 0x20) - set(allowed))
+                if missing:
+                    problems.append("%s:%d: %r uses %r, which %s" % (source, line, literal, missing, reason))
+    if problems:
+        raise ValueError("\n".join(problems))
+
+
+def read_glcd_font(path):
+    """Returns the 5 column bytes of every character in glcdfont.c."""
+    with open(path, encoding="utf-8", errors="replace") as f:
+        text = f.read()
+    table = text[text.index("{") + 1:text.rindex("}")]
+    table = re.sub(r"//[^\n]*|/\*.*?\*/", "", table, flags=re.S)
+    values = [int(token, 0) for token in re.findall(r"0[xX][0-9a-fA-F]+|\d+", table)]
+    if len(values) < 128 * 5:
+        raise ValueError("%s does not look like a GLCD font table" % path)
+    return [values[i:i + 5] for i in range(0, len(values) - 4, 5)]
+
+
+def write_header(path, characters, glyphs):
+    index = [0xFF] * 95
+    for position, character in enumerate(characters):
+        index[ord(character) - 0x20] = position
+
+    lines = [
+        "// Generated by scripts/font_subset.py from TFT_eSPI Fonts/glcdfont.c, do not edit",
+        "#ifndef UIFONT_H",
+        "#define UIFONT_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        "// Characters: %s" % characters.replace("\\", "\\\\"),
+        "const uint8_t UI_FONT_GLYPH_COUNT = %d;" % len(characters),
+        "",
+        "// Glyph per ASCII code from 0x20 to 0x7E, 0xFF if not in the subset",
+        "const uint8_t UI_FONT_INDEX[95] = {",
+    ]
+    for start in range(0, 95, 16):
+        lines.append("  " + ", ".join("0x%02X" % value for value in index[start:start + 16]) + ",")
+    lines += [
+        "};",
+        "",
+        "// 5 columns per glyph, bit 0 is the top row",
+        "const uint8_t UI_FONT_GLYPHS[%d][5] = {" % len(characters),
+    ]
+    for character in characters:
+        columns = ", ".join("0x%02X" % value for value in glyphs[ord(character)])
+        lines.append("  { %s },  // '%s'" % (columns, character))
+    lines += ["};", "", "#endif", ""]
+
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "w", encoding="utf-8") as f:
+        f.write("\n".join(lines))
+
+
+def generate(project_dir, glcd_path, output_dir):
+    characters = used_characters(project_dir)
+    check_drawn_text(project_dir, characters)
+    write_header(os.path.join(output_dir, "UiFont.h"), characters, read_glcd_font(glcd_path))
+    subset_bytes = len(characters) * 5 + 95
+    print("UI font subset: %d glyphs, %d bytes instead of 1280 (%s)" % (len(characters), subset_bytes, characters))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit("usage: font_subset.py <glcdfont.c> <output directory>")
+    generate(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."), sys.argv[1], sys.argv[2])
+else:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+
+    glcd_path = os.path.join(env.subst("$PROJECT_LIBDEPS_DIR"), env.subst("$PIOENV"), "TFT_eSPI", "Fonts", "glcdfont.c")
+    if not os.path.isfile(glcd_path):
+        sys.exit("font_subset.py: %s not found, install the TFT_eSPI dependency first" % glcd_path)
+
+    output_dir = os.path.join(env.subst("$BUILD_DIR"), "generated")
+    generate(env.subst("$PROJECT_DIR"), glcd_path, output_dir)
+    env.Append(CPPPATH=[output_dir], CPPDEFINES=["UI_FONT_SUBSET"])
@@ -0,0 +1,23 @@
+"""Compiler and sanitizer setup of the native-fuzz environment.
+
+The sanitizers have to be passed to the linker as well, which build_flags
+does not do. With clang the target is linked against libFuzzer:
+
+    CC=clang CXX=clang++ pio run -e native-fuzz
+
+Otherwise lib/NativeStubs/FuzzTarget.cpp brings its own driver.
+"""
+
+import os
+
+Import("env")  # noqa: F821 - provided by PlatformIO
+
+sanitizers = "address,undefined"
+compiler = os.environ.get("CXX", "")
+if "clang" in compiler:
+    env.Replace(CC=os.environ.get("CC", "clang"), CXX=compiler, LINK=compiler)
+    env.Append(CPPDEFINES=["WATERBOTTLE_LIBFUZZER"])
+    sanitizers = "fuzzer," + sanitizers
+
+flags = ["-fsanitize=" + sanitizers, "-fno-omit-frame-pointer", "-g"]
+env.Append(CCFLAGS=flags, LINKFLAGS=flags)
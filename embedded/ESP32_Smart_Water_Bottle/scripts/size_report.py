@@ -0,0 +1,64 @@
+"""Adds a "size_report" target that prints flash and RAM use per region.
+
+    pio run -e nodemcu-32s -t size_report
+
+The numbers are also written to size_report.json in the build directory.
+If size_baseline.json exists in the project directory, the report shows
+the difference to it. Copy a report there to keep it as the baseline.
+"""
+
+import json
+import os
+import subprocess
+
+Import("env")  # noqa: F821 - provided by PlatformIO
+
+# Output sections of the ESP32 linker script grouped by where they live
+FLASH_SECTIONS = (".flash.text", ".flash.rodata", ".flash.appdesc", ".iram0.text", ".iram0.vectors", ".dram0.data")
+RAM_SECTIONS = (".dram0.data", ".dram0.bss", ".noinit")
+
+
+def section_sizes(size_tool, elf):
+    output = subprocess.check_output([size_tool, "-A", elf], universal_newlines=True)
+    sizes = {}
+    for line in output.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith(".") and parts[1].isdigit():
+            sizes[parts[0]] = int(parts[1])
+    return sizes
+
+
+def size_report(target, source, env):
+    elf = str(source[0])
+    sizes = section_sizes(env.subst("$SIZETOOL"), elf)
+    report = {
+        "flash": sum(sizes.get(name, 0) for name in FLASH_SECTIONS),
+        "ram": sum(sizes.get(name, 0) for name in RAM_SECTIONS),
+        "sections": sizes,
+    }
+
+    baseline = {}
+    baseline_path = os.path.join(env.subst("$PROJECT_DIR"), "size_baseline.json")
+    if os.path.isfile(baseline_path):
+        with open(baseline_path) as f:
+            baseline = json.load(f)
+
+    for key in ("flash", "ram"):
+        line = "%-6s %8d bytes" % (key, report[key])
+        if key in baseline:
+            line += "  (%+d vs baseline)" % (report[key] - baseline[key])
+        print(line)
+    for name in sorted(sizes):
+        print("  %-18s %8d" % (name, sizes[name]))
+
+    with open(os.path.join(env.subst("$BUILD_DIR"), "size_report.json"), "w") as f:
+        json.dump(report, f, indent=2)
+
+
+env.AddCustomTarget(  # noqa: F821
+    name="size_report",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=size_report,
+    title="Size Report",
+    description="Flash and RAM use per section, compared with size_baseline.json",
+)
@@ -0,0 +1,102 @@
+#include "WaterBottleCalibration.h"
+#include <Preferences.h>
+
+FlowCalibration flowCalibration;
+
+static CalibrationFitter calibrationFitter;
+static CalibrationRun currentRun;
+static bool runActive = false;
+static uint32_t runStartMs = 0;
+
+void loadCalibration() {
+  Preferences preferences;
+  preferences.begin("flow", true);
+  CalibrationTable table;
+  if (preferences.getBytesLength("calibration") == sizeof(table)) {
+    preferences.getBytes("calibration", &table, sizeof(table));
+    if (!flowCalibration.setTable(table)) {
+      Serial.println("Stored flow calibration invalid, using datasheet constant");
+    }
+  }
+  preferences.end();
+
+  Serial.print("Flow calibration points: ");
+  Serial.println(flowCalibration.table().count);
+}
+
+static void storeCalibration(bool remove) {
+  Preferences preferences;
+  preferences.begin("flow", false);
+  if (remove) {
+    preferences.remove("calibration");
+  } else {
+    preferences.putBytes("calibration", &flowCalibration.table(), sizeof(CalibrationTable));
+  }
+  preferences.end();
+}
+
+void startCalibrationRun(uint32_t referenceMl) {
+  currentRun = CalibrationRun();
+  currentRun.referenceMl = referenceMl;
+  runActive = true;
+  runStartMs = millis();
+
+  Serial.print("Calibration run started for ");
+  Serial.print(referenceMl);
+  Serial.println(" ml");
+}
+
+bool calibrationRunActive() {
+  return runActive;
+}
+
+void addCalibrationSample(const FlowSample& sample) {
+  if (!runActive) return;
+
+  if (sample.pulses > 0) {
+    // The same rate processFlowSensorData() looks the volume up with
+    currentRun.addSample(sample.pulses, sample.periodUs / 1000, sample.rateMilliHz);
+  } else if (currentRun.pulses == 0 && millis() - runStartMs >= CALIBRATION_RUN_TIMEOUT_MS) {
+    runActive = false;
+    Serial.println("Calibration run timed out");
+  }
+}
+
+bool finishCalibrationRun(CalibrationRun& run) {
+  if (!runActive || currentRun.pulses == 0) return false;
+  runActive = false;
+  run = currentRun;
+
+  if (!calibrationFitter.addRun(run)) {
+    Serial.println("Calibration run not stored, too many runs");
+  }
+  Serial.print("Calibration run: ");
+  Serial.print(run.pulses);
+  Serial.print(" pulses in ");
+  Serial.print(run.activeMs);
+  Serial.print(" ms at ");
+  Serial.print(run.rateMilliHz());
+  Serial.print(" mHz for ");
+  Serial.print(run.referenceMl);
+  Serial.println(" ml");
+  return true;
+}
+
+size_t commitCalibration() {
+  CalibrationTable table;
+  if (!calibrationFitter.fit(table) || !flowCalibration.setTable(table)) return 0;
+
+  storeCalibration(false);
+  calibrationFitter.clear();
+  Serial.print("Flow calibration stored, points: ");
+  Serial.println(table.count);
+  return table.count;
+}
+
+void resetCalibration() {
+  runActive = false;
+  calibrationFitter.clear();
+  flowCalibration.setDefault();
+  storeCalibration(true);
+  Serial.println("Flow calibration reset to datasheet constant");
+}
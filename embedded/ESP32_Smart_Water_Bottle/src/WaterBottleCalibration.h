@@ -0,0 +1,30 @@
+#ifndef WATERBOTTLECALIBRATION_H
+#define WATERBOTTLECALIBRATION_H
+
+#include <Arduino.h>
+#include <FlowCalibration.h>
+#include "WaterBottleSensor.h"
+
+// A calibration run without any pulse is cancelled after a minute
+const uint32_t CALIBRATION_RUN_TIMEOUT_MS = 60000;
+
+extern FlowCalibration flowCalibration;
+
+// Loads the table from NVS, falls back to the datasheet constant
+void loadCalibration();
+
+// Reference pours: the next pour is measured against referenceMl instead
+// of being recorded as a drink event
+void startCalibrationRun(uint32_t referenceMl);
+bool calibrationRunActive();
+void addCalibrationSample(const FlowSample& sample);
+// Ends the run once the flow stopped, returns false if nothing was poured
+bool finishCalibrationRun(CalibrationRun& run);
+
+// Fits a table from all runs since boot and stores it, returns its points
+// or 0 if there was no usable run
+size_t commitCalibration();
+// Back to the datasheet constant, also in NVS
+void resetCalibration();
+
+#endif
@@ -0,0 +1,80 @@
+#include "WaterBottleCommands.h"
+#include "WaterBottlePower.h"
+
+const unsigned long COMMAND_STATS_INTERVAL = 10000;
+
+SpscQueue<BottleCommand, COMMAND_QUEUE_SIZE> commandQueue;
+
+// Written by the BLE task, read and reset by loop()
+static std::atomic<uint32_t> callbackCount{0};
+static std::atomic<uint32_t> callbackTotalUs{0};
+static std::atomic<uint32_t> callbackMaxUs{0};
+
+// Link state as the BLE task last saw it, for when its commands were lost
+static std::atomic<bool> linkConnected{false};
+static std::atomic<int32_t> linkMtu{0};
+static std::atomic<bool> linkResync{false};
+
+static bool isLinkCommand(uint8_t type) {
+  return type == CMD_CONNECTED || type == CMD_DISCONNECTED || type == CMD_MTU_CHANGED;
+}
+
+bool postCommand(uint8_t type, int32_t value, uint32_t sequence, uint64_t timestampMs) {
+  BottleCommand command;
+  command.type = type;
+  command.value = value;
+  command.sequence = sequence;
+  command.timestampMs = timestampMs;
+
+  bool link = isLinkCommand(type);
+  if (type == CMD_MTU_CHANGED) {
+    linkMtu.store(value, std::memory_order_relaxed);
+  } else if (link) {
+    linkConnected.store(type == CMD_CONNECTED, std::memory_order_relaxed);
+    linkMtu.store(0, std::memory_order_relaxed);
+  }
+
+  bool posted = commandQueue.push(command, link ? 0 : COMMAND_LINK_RESERVED_SLOTS);
+  if (!posted && link) linkResync.store(true, std::memory_order_release);
+  // loop() may be blocked in its idle wait
+  wakeLoop();
+  return posted;
+}
+
+bool takeLinkResync(bool& connected, int32_t& mtu) {
+  if (!linkResync.exchange(false, std::memory_order_acquire)) return false;
+  connected = linkConnected.load(std::memory_order_relaxed);
+  mtu = linkMtu.load(std::memory_order_relaxed);
+  return true;
+}
+
+void recordCallbackTime(unsigned long startUs) {
+  uint32_t elapsed = micros() - startUs;
+  callbackCount.fetch_add(1, std::memory_order_relaxed);
+  callbackTotalUs.fetch_add(elapsed, std::memory_order_relaxed);
+  if (elapsed > callbackMaxUs.load(std::memory_order_relaxed)) {
+    callbackMaxUs.store(elapsed, std::memory_order_relaxed);
+  }
+}
+
+void logCommandStats(unsigned long now) {
+  static unsigned long lastLog = 0;
+  if (now - lastLog < COMMAND_STATS_INTERVAL) return;
+  lastLog = now;
+
+  uint32_t count = callbackCount.exchange(0, std::memory_order_relaxed);
+  uint32_t totalUs = callbackTotalUs.exchange(0, std::memory_order_relaxed);
+  uint32_t maxUs = callbackMaxUs.exchange(0, std::memory_order_relaxed);
+  if (count == 0) return;
+
+  Serial.print("BLE callbacks: ");
+  Serial.print(count);
+  Serial.print(" avg: ");
+  Serial.print(totalUs / count);
+  Serial.print(" us max: ");
+  Serial.print(maxUs);
+  Serial.print(" us | queue max depth: ");
+  Serial.print(commandQueue.maxDepth());
+  Serial.print(" dropped: ");
+  Serial.println(commandQueue.dropped());
+}
@@ -0,0 +1,49 @@
+#ifndef WATERBOTTLECOMMANDS_H
+#define WATERBOTTLECOMMANDS_H
+
+#include <Arduino.h>
+#include <SpscQueue.h>
+
+// Everything the BLE callbacks learn is posted as a command and applied by
+// loop(), so no callback touches the display, the journal or shared globals
+enum BottleCommandType : uint8_t {
+  CMD_CONNECTED,
+  CMD_DISCONNECTED,
+  CMD_MTU_CHANGED,      // value: negotiated ATT MTU
+  CMD_BINARY_HELLO,
+  CMD_SYNC_CONFIRMED,   // timestampMs: central time, 0 if it sent none
+  CMD_REMINDER,         // value: DrinkReminderType
+  CMD_WATER_GOAL,       // value: ml
+  CMD_CURRENT_WATER,    // value: ml
+  CMD_ACK,              // sequence: cumulative ack, value: credits
+  CMD_HISTORY_REQUEST,  // sequence: last event the central has seen
+  CMD_CALIBRATE         // value: reference ml to start a run, 0 to fit and store, -1 to reset
+};
+
+struct BottleCommand {
+  uint8_t type;
+  int32_t value;
+  uint32_t sequence;
+  uint64_t timestampMs;
+};
+
+// All BLE callbacks run in the Bluedroid task, which is the only producer
+const size_t COMMAND_QUEUE_SIZE = 32;
+extern SpscQueue<BottleCommand, COMMAND_QUEUE_SIZE> commandQueue;
+// Slots only connect, disconnect and MTU commands may use, so a burst of
+// writes cannot push a connection change out of the queue
+const size_t COMMAND_LINK_RESERVED_SLOTS = 3;
+
+// BLE task side
+bool postCommand(uint8_t type, int32_t value = 0, uint32_t sequence = 0, uint64_t timestampMs = 0);
+void recordCallbackTime(unsigned long startUs);
+
+// loop() side: true once after a connection command was dropped even
+// though slots are reserved for them. connected and mtu are then the link
+// state the dropped commands would have left behind.
+bool takeLinkResync(bool& connected, int32_t& mtu);
+
+// Logs callback execution time and queue depth every 10 seconds
+void logCommandStats(unsigned long now);
+
+#endif
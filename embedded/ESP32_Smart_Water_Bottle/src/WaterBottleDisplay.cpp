@@ -1,17 +1,146 @@
 #include "WaterBottleDisplay.h"
 #include <TFT_eSPI.h>
+#include <DirtyRenderer.h>
+#include <RoundClip.h>
+#include <ProgressRing.h>
+#include <VolumeFormat.h>
+#include <DisplayPower.h>
+#include "WaterBottlePower.h"
+#if defined(DISPLAY_USE_DMA)
+#include <BandRenderer.h>
+#elif defined(DISPLAY_USE_FRAMEBUFFER)
+#include <PaletteRenderer.h>
+#endif
 
 // Display Constants
 const int SCREEN_COLOR = TFT_BLACK;
 const int TEXT_COLOR = TFT_WHITE;
 const unsigned long STATUS_DISPLAY_DURATION = 5000;
 
+const int DISPLAY_CENTER_X = 240 / 2;
+const int DISPLAY_CENTER_Y = 240 / 2;
+const uint16_t RING_COLOR = TFT_BLUE;
+const uint16_t RING_TRACK_COLOR = TFT_DARKGREY;
+const unsigned long DISPLAY_STATS_INTERVAL = 10000;
+
+// Shortest time between two rendered frames, set with -D DISPLAY_FRAME_INTERVAL_MS
+#ifndef DISPLAY_FRAME_INTERVAL_MS
+#define DISPLAY_FRAME_INTERVAL_MS 50
+#endif
+const unsigned long DISPLAY_FRAME_INTERVAL = DISPLAY_FRAME_INTERVAL_MS;
+
+// Inactivity before the backlight dims and the panel goes to sleep, set
+// with -D DISPLAY_DIM_AFTER_MS and -D DISPLAY_SLEEP_AFTER_MS
+#ifndef DISPLAY_DIM_AFTER_MS
+#define DISPLAY_DIM_AFTER_MS 15000
+#endif
+#ifndef DISPLAY_SLEEP_AFTER_MS
+#define DISPLAY_SLEEP_AFTER_MS 30000
+#endif
+const DisplayPowerConfig DISPLAY_POWER_CONFIG = { DISPLAY_DIM_AFTER_MS, DISPLAY_SLEEP_AFTER_MS, 255, 40 };
+
+// Backlight PWM, only if the backlight is wired to a pin (-D TFT_BL=<pin>).
+// Otherwise dimming is skipped and the panel still goes to sleep.
+const uint8_t BACKLIGHT_CHANNEL = 7;
+const uint32_t BACKLIGHT_PWM_HZ = 5000;
+
 // TFT_eSPI Object for Display
 TFT_eSPI tft = TFT_eSPI();
 
+// On-screen elements, each one only repaints its own box when it changes
+enum DisplayElementId {
+  ELEMENT_TITLE,
+  ELEMENT_BLE_STATUS,
+  ELEMENT_SYNC_STATUS,
+  ELEMENT_VOLUME,
+  ELEMENT_REMINDER,
+  ELEMENT_COUNT
+};
+TextElement elements[ELEMENT_COUNT];
+
+// Intake vs goal along the edge, its inner edge stays clear of the text rows
+ProgressRing progressRing;
+
+#if defined(DISPLAY_USE_DMA)
+// Composes in two sprite bands and pushes them by DMA, falls back to direct
+// drawing if the band buffers cannot be allocated
+BandRenderer bandRenderer(tft);
+bool bandRendererReady = false;
+#elif defined(DISPLAY_USE_FRAMEBUFFER)
+// Every color the UI uses, the 4 bpp framebuffer stores indices into this
+const uint16_t DISPLAY_PALETTE[] = { TFT_BLACK, TFT_WHITE, TFT_GREEN, TFT_YELLOW, TFT_RED, TFT_BLUE, TFT_DARKGREY };
+PaletteRenderer paletteRenderer(tft);
+bool paletteRendererReady = false;
+#endif
+
+// Render timing: CPU time spent in a render call, and time until the frame
+// is on the panel (the same thing when drawing directly)
+unsigned long redrawsRequested = 0;
+unsigned long framesRendered = 0;
+unsigned long maxRenderUs = 0;
+unsigned long maxFrameUs = 0;
+unsigned long maxLoopUs = 0;
+unsigned long frameStartUs = 0;
+bool frameInFlight = false;
+
+// Set by every state change that affects the screen, cleared by the next frame
+bool displayInvalid = false;
+unsigned long lastFrameMs = 0;
+
+// The panel keeps its frame memory in sleep, so after waking only the
+// changes made in the meantime are drawn before the display is switched on
+DisplayPowerPolicy displayPower(DISPLAY_POWER_CONFIG);
+DisplayPowerState panelState = DISPLAY_ON;
+bool panelWaking = false;
+PanelSleepGuard panelSleep;
+unsigned long wakeRequestUs = 0;
+
+void setPanelState(DisplayPowerState state) {
+  panelState = state;
+  energyLedger.setState(ENERGY_DISPLAY, state, energyNowUs());
+}
+
+void setBacklight(uint8_t level) {
+#ifdef TFT_BL
+#if defined(TFT_BACKLIGHT_ON) && TFT_BACKLIGHT_ON == LOW
+  level = 255 - level;
+#endif
+  ledcWrite(BACKLIGHT_CHANNEL, level);
+#endif
+}
+
 void initializeDisplay() {
   tft.init();
   tft.setRotation(0);
+#ifdef TFT_BL
+  ledcSetup(BACKLIGHT_CHANNEL, BACKLIGHT_PWM_HZ, 8);
+  ledcAttachPin(TFT_BL, BACKLIGHT_CHANNEL);
+#endif
+  setBacklight(DISPLAY_POWER_CONFIG.onLevel);
+  displayPower.wake(millis());
+  // The corners of the round panel are never visible, leave them as they are
+  ElementBox screen = { 0, 0, (int16_t)tft.width(), (int16_t)tft.height() };
+  fillClipped(tft, screen, SCREEN_COLOR);
+
+  initElement(elements[ELEMENT_TITLE], DISPLAY_CENTER_X, 90, 2);
+  initElement(elements[ELEMENT_BLE_STATUS], DISPLAY_CENTER_X, 120, 2);
+  initElement(elements[ELEMENT_SYNC_STATUS], DISPLAY_CENTER_X, 140, 2);
+  initElement(elements[ELEMENT_VOLUME], DISPLAY_CENTER_X, 120, 2);
+  initElement(elements[ELEMENT_REMINDER], DISPLAY_CENTER_X, 150, 2);
+  progressRing.begin(DISPLAY_CENTER_X, DISPLAY_CENTER_Y, 119, 6);
+
+#if defined(DISPLAY_USE_DMA)
+  bandRendererReady = bandRenderer.begin();
+  Serial.println(bandRendererReady ? "Display: DMA band rendering" : "Display: DMA unavailable, drawing directly");
+#elif defined(DISPLAY_USE_FRAMEBUFFER)
+  paletteRendererReady = paletteRenderer.begin(DISPLAY_PALETTE, sizeof(DISPLAY_PALETTE) / sizeof(DISPLAY_PALETTE[0]));
+  if (paletteRendererReady) {
+    Serial.print("Display: 4 bpp framebuffer, bytes: ");
+    Serial.println(paletteRenderer.bufferSize());
+  } else {
+    Serial.println("Display: framebuffer unavailable, drawing directly");
+  }
+#endif
   
   // Initialize status display (device starts disconnected, so show status)
   shouldShowStatus = true;
@@ -43,62 +172,207 @@ void setReminderLEDs(int reminderType) {
       // LEDs are already turned off
       break;
     default:
-      Serial.println("Unknown DrinkReminderType: " + String(reminderType));
+      Serial.print("Unknown DrinkReminderType: ");
+      Serial.println(reminderType);
       break;
   }
 }
 
+// Draws the next ring animation step, into the framebuffer if there is one
+void renderProgressRing() {
+  ElementBox changed;
+#if defined(DISPLAY_USE_FRAMEBUFFER)
+  if (paletteRendererReady) {
+    uint8_t fill = paletteRenderer.colorIndex(RING_COLOR);
+    uint8_t track = paletteRenderer.colorIndex(RING_TRACK_COLOR);
+    uint8_t background = paletteRenderer.colorIndex(SCREEN_COLOR);
+    if (progressRing.update(paletteRenderer.canvas(), fill, track, background, changed)) {
+      paletteRenderer.pushArea(changed);
+    }
+    return;
+  }
+#endif
+  progressRing.update(tft, RING_COLOR, RING_TRACK_COLOR, SCREEN_COLOR, changed);
+}
+
+void renderDisplay() {
+  unsigned long start = micros();
+  // Frames only start once the previous DMA transfer is done, so the ring
+  // can be drawn straight to the panel first
+  renderProgressRing();
+#if defined(DISPLAY_USE_DMA)
+  if (bandRendererReady) {
+    bandRenderer.render(elements, ELEMENT_COUNT, SCREEN_COLOR);
+    if (!frameInFlight) frameStartUs = start;
+    frameInFlight = true;
+  } else
+#endif
+  {
+#if defined(DISPLAY_USE_FRAMEBUFFER)
+    if (paletteRendererReady) {
+      paletteRenderer.render(elements, ELEMENT_COUNT, SCREEN_COLOR);
+    } else
+#endif
+    renderElements(tft, elements, ELEMENT_COUNT, SCREEN_COLOR);
+    unsigned long frameUs = micros() - start;
+    if (frameUs > maxFrameUs) maxFrameUs = frameUs;
+  }
+
+  unsigned long renderUs = micros() - start;
+  if (renderUs > maxRenderUs) maxRenderUs = renderUs;
+  framesRendered++;
+}
+
+void invalidateDisplay() {
+  displayInvalid = true;
+  redrawsRequested++;
+}
+
+void wakeDisplay() {
+  if (panelState == DISPLAY_SLEEP && !panelWaking) wakeRequestUs = micros();
+  displayPower.wake(millis());
+}
+
+bool displayAwake() {
+  return panelState != DISPLAY_SLEEP || panelWaking;
+}
+
+void renderFrame(unsigned long now) {
+  displayInvalid = false;
+  lastFrameMs = now;
+  renderDisplay();
+  // Keep rendering until the ring animation has caught up
+  if (progressRing.needsUpdate()) displayInvalid = true;
+}
+
+// Moves the panel towards the policy state. Waking takes two steps: the
+// panel needs 5 ms after SLEEP_OUT, then the pending changes are drawn
+// and the display and backlight are switched on. A wake within 120 ms of
+// SLEEP_IN waits for the panel before sending SLEEP_OUT.
+void servicePanelPower(unsigned long now) {
+  DisplayPowerState target = displayPower.update(now);
+
+  if (panelWaking) {
+    if (!panelSleep.awake(now)) return;
+    if (displayInvalid && !frameInFlight) renderFrame(now);
+    if (frameInFlight) return;
+    tft.writecommand(PANEL_CMD_DISPLAY_ON);
+    setBacklight(DISPLAY_POWER_CONFIG.onLevel);
+    displayPower.recordWakeLatency(micros() - wakeRequestUs);
+    panelWaking = false;
+    setPanelState(DISPLAY_ON);
+    return;
+  }
+
+  if (target == panelState) return;
+  if (target == DISPLAY_SLEEP) {
+    if (!panelSleep.canSleepIn(now) || frameInFlight) return;
+    setBacklight(0);
+    tft.writecommand(PANEL_CMD_DISPLAY_OFF);
+    tft.writecommand(PANEL_CMD_SLEEP_IN);
+    panelSleep.sleepIn(now);
+    setPanelState(DISPLAY_SLEEP);
+  } else if (panelState == DISPLAY_SLEEP) {
+    if (!panelSleep.canSleepOut(now)) return;
+    tft.writecommand(PANEL_CMD_SLEEP_OUT);
+    panelSleep.sleepOut(now);
+    panelWaking = true;
+  } else {
+    setBacklight(target == DISPLAY_DIM ? DISPLAY_POWER_CONFIG.dimLevel : DISPLAY_POWER_CONFIG.onLevel);
+    setPanelState(target);
+  }
+}
+
+void serviceDisplay(unsigned long now, unsigned long loopStartUs) {
+#ifdef DISPLAY_USE_DMA
+  // Frame time is measured up to the first loop pass that sees DMA idle
+  if (frameInFlight && !bandRenderer.busy()) {
+    unsigned long frameUs = micros() - frameStartUs;
+    if (frameUs > maxFrameUs) maxFrameUs = frameUs;
+    frameInFlight = false;
+  }
+#endif
+
+  servicePanelPower(now);
+
+  // All invalidations since the last frame collapse into one render pass.
+  // A sleeping panel collects them until it wakes.
+  if (displayInvalid && !frameInFlight && panelState != DISPLAY_SLEEP && now - lastFrameMs >= DISPLAY_FRAME_INTERVAL) {
+    renderFrame(now);
+  }
+
+  unsigned long loopUs = micros() - loopStartUs;
+  if (loopUs > maxLoopUs) maxLoopUs = loopUs;
+
+  static unsigned long lastLog = 0;
+  if (now - lastLog < DISPLAY_STATS_INTERVAL) return;
+  lastLog = now;
+
+  Serial.print("Display redraws requested: ");
+  Serial.print(redrawsRequested);
+  Serial.print(" frames: ");
+  Serial.print(framesRendered);
+  Serial.print(" render max: ");
+  Serial.print(maxRenderUs);
+  Serial.print(" us frame max: ");
+  Serial.print(maxFrameUs);
+  Serial.print(" us | loop max: ");
+  Serial.print(maxLoopUs);
+  Serial.print(" us | on/dim/sleep: ");
+  Serial.print(displayPower.stateMs(DISPLAY_ON) / 1000);
+  Serial.print('/');
+  Serial.print(displayPower.stateMs(DISPLAY_DIM) / 1000);
+  Serial.print('/');
+  Serial.print(displayPower.stateMs(DISPLAY_SLEEP) / 1000);
+  Serial.print(" s, wakes: ");
+  Serial.print(displayPower.wakes());
+  Serial.print(" latency mean/max: ");
+  Serial.print(displayPower.meanWakeLatencyUs());
+  Serial.print('/');
+  Serial.print(displayPower.maxWakeLatencyUs());
+  Serial.println(" us");
+
+  redrawsRequested = 0;
+  framesRendered = 0;
+  maxRenderUs = 0;
+  maxFrameUs = 0;
+  maxLoopUs = 0;
+  displayPower.resetStats();
+}
+
 void showConnectionStatus(int centerX) {
   // BLE Status
-  String bleText;
   if (isConnected) {
-    tft.setTextColor(TFT_GREEN);
-    bleText = "BT: Connected";
+    setElementText(elements[ELEMENT_BLE_STATUS], "BT: Connected", TFT_GREEN);
   } else {
-    tft.setTextColor(TFT_RED);
-    bleText = "BT: Waiting...";
+    setElementText(elements[ELEMENT_BLE_STATUS], "BT: Waiting...", TFT_RED);
   }
   
-  // Center BLE status text using 12 pixels per character
-  int bleWidth = bleText.length() * 12; 
-  tft.setCursor(centerX - (bleWidth / 2), 120);
-  tft.println(bleText);
-  
   // Sync Status
-  String syncText;
   if (timeSyncConfirmed) {
-    tft.setTextColor(TFT_GREEN);
-    syncText = "Sync: Confirmed";
+    setElementText(elements[ELEMENT_SYNC_STATUS], "Sync: Confirmed", TFT_GREEN);
   } else {
-    tft.setTextColor(TFT_YELLOW);
-    syncText = "Sync: Waiting...";
+    setElementText(elements[ELEMENT_SYNC_STATUS], "Sync: Waiting...", TFT_YELLOW);
   }
-
-  // Center Sync status text using 12 pixels per character
-  int syncWidth = syncText.length() * 12;
-  tft.setCursor(centerX - (syncWidth / 2), 140);
-  tft.println(syncText);
 }
 
 void showStatusDisplay() {
-  tft.fillScreen(SCREEN_COLOR);
-  tft.setTextColor(TEXT_COLOR);
-  
-  int displayWidth = 240;
-  int centerX = displayWidth / 2;
-  
-  // Center the title text
-  tft.setTextSize(2);
-  String title = "Smart Water Bottle";
-  int titleWidth = title.length() * 12; 
-  tft.setCursor(centerX - (titleWidth / 2), 90);
-  tft.println(title);
-
-  showConnectionStatus(centerX);  
+  progressRing.setVisible(false);
+  setElementText(elements[ELEMENT_TITLE], "Smart Water Bottle", TEXT_COLOR);
+  setElementText(elements[ELEMENT_VOLUME], "", TEXT_COLOR);
+  setElementText(elements[ELEMENT_REMINDER], "", TEXT_COLOR);
+  showConnectionStatus(DISPLAY_CENTER_X);
+  invalidateDisplay();
 }
 
 void clearDisplay() {
-  tft.fillScreen(SCREEN_COLOR);
+  // Only the areas that currently show text need to be painted black
+  for (int i = 0; i < ELEMENT_COUNT; i++) {
+    setElementText(elements[i], "", TEXT_COLOR);
+  }
+  progressRing.setVisible(false);
+  invalidateDisplay();
+
   digitalWrite(ledNone, LOW);
   digitalWrite(ledNormal, LOW);
   digitalWrite(ledImportant, LOW);
@@ -106,30 +380,22 @@ void clearDisplay() {
 }
 
 void showWaterInfo() {
-  tft.fillScreen(SCREEN_COLOR);
-  tft.setTextColor(TEXT_COLOR);
-  
-  int displayWidth = 240;
-  int centerX = displayWidth / 2;
-  
-  // Center the title text
-  tft.setTextSize(2);
-  String title = "Smart Water Bottle";
-  int titleWidth = title.length() * 12; 
-  tft.setCursor(centerX - (titleWidth / 2), 90);
-  tft.println(title);
-  
-  // Water information
-  tft.setTextSize(2);
-  tft.setTextColor(TFT_WHITE);
+  // Reminder type 3 turns the display off
+  if (currentReminderType == 3) {
+    clearDisplay();
+    return;
+  }
 
-  // Show current water amount and goal / calculate text width to center it
+  setElementText(elements[ELEMENT_TITLE], "Smart Water Bottle", TEXT_COLOR);
+  setElementText(elements[ELEMENT_BLE_STATUS], "", TEXT_COLOR);
+  setElementText(elements[ELEMENT_SYNC_STATUS], "", TEXT_COLOR);
+
+  // Show current water amount and goal
   char buf[32];
-  snprintf(buf, sizeof(buf), "%.1f L / %.1f L", currentWater / 1000.0, waterGoal / 1000.0);
-  String waterText = String(buf);
-  int waterTextWidth = waterText.length() * 12; 
-  tft.setCursor(centerX - (waterTextWidth / 2), 120);
-  tft.println(waterText);
+  formatVolumeText(buf, sizeof(buf), currentWater, waterGoal);
+  setElementText(elements[ELEMENT_VOLUME], buf, TFT_WHITE);
+  progressRing.setVisible(true);
+  progressRing.setProgress(currentWater, waterGoal);
   
   const char* message = "";
   uint16_t reminderTextColor = TFT_WHITE;
@@ -151,25 +417,16 @@ void showWaterInfo() {
         reminderTextColor = TFT_RED;
         break;
       }
-    case 3: {
-      clearDisplay();
-      break;
-    }
   }
 
   // Show goal reached message if current water is greater than or equal to the goal
-  if (currentWater >= waterGoal && currentReminderType != 3) {
+  if (currentWater >= waterGoal) {
     reminderTextColor = TFT_GREEN;
     message = "Ziel erreicht!";
   } 
 
-  if (strlen(message) > 0) {
-    tft.setTextColor(reminderTextColor);
-    int reminderWidth = tft.textWidth(message); 
-    int reminderY = 150;
-    tft.setCursor(centerX - (reminderWidth / 2), reminderY);
-    tft.println(message);
-  }
+  setElementText(elements[ELEMENT_REMINDER], message, reminderTextColor);
+  invalidateDisplay();
 }
 
 void clearStatusDisplay() {
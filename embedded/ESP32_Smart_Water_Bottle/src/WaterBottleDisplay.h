@@ -13,6 +13,20 @@ void clearStatusDisplay();
 void updateStatusDisplayLogic();
 void setReminderLEDs(int reminderType);
 
+// Draws pending element changes, directly or through an off-screen renderer
+void renderDisplay();
+// Marks the screen for the next frame instead of drawing right away
+void invalidateDisplay();
+// Called at the end of every loop pass: renders at most one frame per
+// frame interval, completes DMA frames and logs render and loop timing
+void serviceDisplay(unsigned long now, unsigned long loopStartUs);
+
+// The backlight dims and the panel sleeps after a while without a wake
+// reason: flow, a BLE state change, a reminder escalation or the button
+void wakeDisplay();
+// False while the panel sleeps
+bool displayAwake();
+
 // External variable declarations
 extern bool isConnected;
 extern bool timeSyncConfirmed;
@@ -4,26 +4,41 @@
 #include <BLE2902.h>
 #include <ArduinoJson.h>
 #include <ESP32Time.h>
+#include <WaterProtocol.h>
+#include <FrameBatcher.h>
+#include <ReliableLink.h>
+#include <HistoryCodec.h>
+#include <DrinkSession.h>
 #include "WaterBottleDisplay.h"
+#include "WaterBottleMemory.h"
+#include "WaterBottleStorage.h"
+#include "WaterBottleCommands.h"
+#include "WaterBottleSensor.h"
+#include "WaterBottleCalibration.h"
+#include "WaterBottlePower.h"
+#include "WaterBottleProfiling.h"
 
 // BLE UUIDs
 #define SERVICE_UUID        "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
 #define CHARACTERISTIC_UUID "beb5483e-36e1-4688-b7f5-ea07361b26a8"
+// Read only, JSON energy report (see EnergyLedger.h), refreshed every 5 s
+#define DIAGNOSTICS_CHARACTERISTIC_UUID "beb5483f-36e1-4688-b7f5-ea07361b26a8"
+// Read only, JSON loop phase histograms, only in profiling builds
+#define PROFILE_CHARACTERISTIC_UUID "beb54840-36e1-4688-b7f5-ea07361b26a8"
 
 // Input/Output Pins
-volatile int pulseCount = 0;
 const byte flowPin = 19;
 const byte ledNone = 14;
 const byte ledNormal = 12;
 const byte ledImportant = 13;
 const byte randomWaterDataPin = 17;
+const unsigned long BUTTON_DEBOUNCE_MS = 200;
 
 // Water Variables
-unsigned long lastFlowCheck = 0;
-const unsigned long FLOW_CHECK_INTERVAL = 1000;
-float sessionVolumeMl = 0.0;
-int noWaterCounter = 0; 
-int fillingDirection = 1;
+const size_t JOURNAL_DRAIN_BATCH = 4;
+const size_t JOURNAL_DRAIN_BATCH_BINARY = 32;
+// Splits the flow samples into drink sessions, see DrinkSession.h
+DrinkSessionTracker drinkSessions;
 int waterGoal = 4000;
 int currentWater = 0;
 
@@ -33,11 +48,43 @@ const unsigned long SYNC_REQUEST_INTERVAL = 2000;
 bool timeSyncRequested = false;
 bool timeSyncConfirmed = false;
 bool lastSynchedState = false;
+// False until a central sent its time, the RTC counts from boot until then
+bool clockSynced = false;
 
 // Connection Status
 bool isConnected = false;
 bool lastConnectedState = false;
 
+// Protocol Variables (JSON until the central negotiates binary frames)
+bool useBinaryProtocol = false;
+
+// Notification Batching Variables
+const uint16_t PREFERRED_MTU = 517;
+const uint32_t BATCH_MAX_DELAY_MS = 20;
+const unsigned long BATCH_STATS_INTERVAL = 10000;
+uint16_t negotiatedMtu = 23;
+// Set once the central exchanged the MTU on this connection
+bool mtuExchanged = false;
+uint32_t lastQueuedSequence = 0;
+
+// Longest outbound JSON message plus terminator. A drink event with every
+// field at its maximum serializes to 131 characters.
+const size_t JSON_MESSAGE_SIZE = 160;
+
+// Reliable Delivery Variables
+const uint32_t RETRANSMIT_TIMEOUT_MS = 1000;
+const uint16_t INITIAL_CREDITS = 16;
+const uint32_t CREDIT_PROBE_INTERVAL_MS = 2000;
+
+// History Sync Variables
+const size_t HISTORY_READ_BATCH = 64;
+bool historyActive = false;
+uint32_t historyAfter = 0;
+JournalCursor historyCursor = {};
+JournalRecord historyRecords[HISTORY_READ_BATCH];
+size_t historyBuffered = 0;
+size_t historyIndex = 0;
+
 // Display Variables
 unsigned long messageDisplayStart = 0;
 bool showReminderMessage = false;
@@ -53,45 +100,154 @@ ESP32Time rtc(0);
 
 // BLE Variables
 BLECharacteristic* pCharacteristic;
+BLECharacteristic* pDiagnosticsCharacteristic;
+#ifdef WATERBOTTLE_PROFILING
+BLECharacteristic* pProfileCharacteristic;
+#endif
 BLEServer* pServer;
 
-void setRTCFromTimestamp(String timestamp) {
-  // Timestamp Format: "2025-06-26T14:35:00.000Z"
-  // Parsing: YYYY-MM-DDTHH:MM:SS.sssZ
-  if (timestamp.length() < 19) {
-    Serial.println("Invalid Timestamp Format");
-    return;
+// Sends packed frames as one notification on the data characteristic
+class BleFrameSink : public FrameSink {
+public:
+  bool sendNotification(const uint8_t* data, size_t length) override {
+    if (pServer->getConnectedCount() == 0) return false;
+    pCharacteristic->setValue((uint8_t*)data, length);
+    pCharacteristic->notify();
+    return true;
   }
-  
-  // Extract year, month, day, hour, minute, second from the timestamp
-  int year = timestamp.substring(0, 4).toInt();
-  int month = timestamp.substring(5, 7).toInt();
-  int day = timestamp.substring(8, 10).toInt();
-  int hour = timestamp.substring(11, 13).toInt();
-  int minute = timestamp.substring(14, 16).toInt();
-  int second = timestamp.substring(17, 19).toInt();
-  
-  // Set RTC time: second, minute, hour, day, month, year
-  rtc.setTime(second, minute, hour, day, month, year);
-  
-  Serial.println("RTC successfully set:");
+};
+
+BleFrameSink bleFrameSink;
+FrameBatcher frameBatcher(bleFrameSink, BATCH_MAX_DELAY_MS);
+ReliableLink reliableLink(frameBatcher, RETRANSMIT_TIMEOUT_MS, INITIAL_CREDITS, CREDIT_PROBE_INTERVAL_MS);
+
+// Static JSON arenas, one per task that builds documents
+JsonArenaAllocator inboundJsonArena;
+JsonArenaAllocator outboundJsonArena;
+
+// Formats the RTC time into a caller provided buffer without a String
+size_t formatRtcTime(char* out, size_t size, const char* format) {
+  struct tm timeinfo = rtc.getTimeStruct();
+  return strftime(out, size, format, &timeinfo);
+}
+
+void printRtcTime() {
+  char timeText[24];
+  formatRtcTime(timeText, sizeof(timeText), "%Y-%m-%d %H:%M:%S");
   Serial.print("New Time: ");
-  Serial.println(rtc.getTime("%Y-%m-%d %H:%M:%S"));
+  Serial.println(timeText);
+}
+
+// Parses a fixed number of decimal digits, returns -1 on any other character
+int parseDigits(const char* text, int count) {
+  int value = 0;
+  for (int i = 0; i < count; i++) {
+    if (text[i] < '0' || text[i] > '9') return -1;
+    value = value * 10 + (text[i] - '0');
+  }
+  return value;
+}
+
+// Days since 1970-01-01 for a date in the proleptic Gregorian calendar
+long daysFromCivil(int year, int month, int day) {
+  year -= month <= 2;
+  long era = (year >= 0 ? year : year - 399) / 400;
+  long yearOfEra = year - era * 400;
+  long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+// Days in a month of the proleptic Gregorian calendar
+int daysInMonth(int year, int month) {
+  static const uint8_t DAYS[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  bool leapYear = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+  return month == 2 && leapYear ? 29 : DAYS[month - 1];
+}
+
+// Parses "2025-06-26T14:35:00.000Z" (UTC) into epoch milliseconds.
+// Fractional seconds are ignored like before.
+bool parseTimestamp(const char* timestamp, uint64_t& epochMs) {
+  if (timestamp == nullptr || strlen(timestamp) < 19) return false;
+
+  // Extract year, month, day, hour, minute, second from the timestamp
+  int year = parseDigits(timestamp, 4);
+  int month = parseDigits(timestamp + 5, 2);
+  int day = parseDigits(timestamp + 8, 2);
+  int hour = parseDigits(timestamp + 11, 2);
+  int minute = parseDigits(timestamp + 14, 2);
+  int second = parseDigits(timestamp + 17, 2);
+  if (year < 0 || month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month)) return false;
+  if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59) return false;
+
+  uint64_t seconds = (uint64_t)daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+  epochMs = seconds * 1000;
+  return true;
+}
+
+// Notifies a serialized JSON message from a static buffer. Returns false
+// without notifying when nobody is connected or the message does not fit
+// into one notification at the current MTU, a cut message is invalid JSON.
+bool notifyJson(const JsonDocument& doc) {
+  static char output[JSON_MESSAGE_SIZE];
+  if (pServer->getConnectedCount() == 0) return false;
+
+  size_t length = measureJson(doc);
+  if (length >= sizeof(output)) {
+    Serial.println("JSON message too long, not sent");
+    return false;
+  }
+  if (length > (size_t)negotiatedMtu - 3) return false;
+  serializeJson(doc, output, sizeof(output));
+  pCharacteristic->setValue((uint8_t*)output, length);
+  pCharacteristic->notify();
+
+  Serial.print("Sent: ");
+  Serial.println(output);
+  return true;
+}
+
+uint64_t currentEpochMs() {
+  return (uint64_t)rtc.getEpoch() * 1000 + rtc.getMillis();
+}
+
+// Timestamp for the central, 0 while the time is unknown
+uint64_t wallClockMs() {
+  return clockSynced ? currentEpochMs() : 0;
+}
+
+// Control frames are not journaled and go out with sequence 0, only the
+// HELLO answer passes the journal epoch
+void sendBinaryFrame(uint8_t type, uint16_t value, uint32_t sequence = 0) {
+  WaterFrame frame;
+  frame.type = type;
+  frame.sequence = sequence;
+  frame.timestampMs = wallClockMs();
+  frame.value = value;
+
+  uint8_t buffer[WATER_FRAME_MAX_SIZE];
+  size_t size = encodeWaterFrame(frame, buffer, sizeof(buffer));
+  if (size == 0) return;
+
+  pCharacteristic->setValue(buffer, size);
+  pCharacteristic->notify();
+
+  Serial.print("Sent frame type ");
+  Serial.println(type);
 }
 
 void sendTimeSyncRequest() {
   if (pServer->getConnectedCount() == 0) return;
+
+  if (useBinaryProtocol) {
+    sendBinaryFrame(FRAME_SYNC_REQUEST, 0);
+    return;
+  }
   
-  JsonDocument doc;
+  outboundJsonArena.reset();
+  JsonDocument doc(&outboundJsonArena);
   doc["syncRequest"] = true;
- 
-  String output;
-  serializeJson(doc, output);
-  pCharacteristic->setValue(output.c_str());
-  pCharacteristic->notify();
-
-  Serial.print("Sync-Request sent: ");
-  Serial.println(output);
+  notifyJson(doc);
 }
 
 void handleTimeSynchronization() {
@@ -106,138 +262,535 @@ void handleTimeSynchronization() {
   lastSyncRequestTime = millis();
 }
 
-void sendWaterDataViaBLE(float volumeMl) {
-  if (pServer->getConnectedCount() == 0) return;
-  
-  JsonDocument doc;
-  doc["amountMl"] = volumeMl;
-  doc["timestamp"] = rtc.getTime("%Y-%m-%dT%H:%M:%S.000Z");
- 
-  String output;
-  serializeJson(doc, output);
-  pCharacteristic->setValue(output.c_str());
-  pCharacteristic->notify();
+// Formats an epoch millisecond timestamp as "2025-06-26T14:35:00.000Z"
+void formatIsoTimestamp(char* out, size_t size, uint64_t timestampMs) {
+  time_t seconds = timestampMs / 1000;
+  struct tm timeinfo;
+  gmtime_r(&seconds, &timeinfo);
+  size_t length = strftime(out, size, "%Y-%m-%dT%H:%M:%S", &timeinfo);
+  snprintf(out + length, size - length, ".%03dZ", (int)(timestampMs % 1000));
+}
 
-  Serial.print("Sent: ");
-  Serial.println(output);
+// Returns true only if the whole event went out
+bool sendWaterDataViaBLE(const JournalRecord& record) {
+  if (pServer->getConnectedCount() == 0) return false;
+
+  char timestamp[32];
+  formatIsoTimestamp(timestamp, sizeof(timestamp), record.timestampMs);
+
+  outboundJsonArena.reset();
+  JsonDocument doc(&outboundJsonArena);
+  doc["amountMl"] = record.amountMl;
+  // Events from before a sync that was lost with a cold boot have no time
+  if (record.timestampMs != 0) doc["timestamp"] = timestamp;
+  doc["durationMs"] = record.durationMs;
+  doc["peakFlowMlPerMin"] = record.peakFlowMlPerMin;
+  doc["meanFlowMlPerMin"] = record.meanFlowMlPerMin;
+  return notifyJson(doc);
 }
 
-void IRAM_ATTR pulseCounter() {
-  pulseCount++;
+// Every completed drink session goes to the flash journal first, so it
+// survives a reboot and is delivered once a synced central is connected
+void journalDrinkEvent(JournalRecord& record) {
+  if (!drinkJournal.append(record)) {
+    Serial.println("Failed to journal drink event");
+    return;
+  }
+  Serial.print("Drink event journaled, seq ");
+  Serial.println(record.sequence);
 }
 
-void processFlowSensorData(int countedPulses, bool isConnected) {
-  float flowRate = (float)countedPulses / 7.5;
-  float volumePerSecond = flowRate / 60.0;
-  float volumeMl = volumePerSecond * 1000.0;
-  
-  if (fillingDirection == 1) {
-    if (volumeMl > 0) {
-      sessionVolumeMl += volumeMl;
-      noWaterCounter = 0;
-    } else {
-      noWaterCounter++;
+static uint16_t clampUint16(uint32_t value) {
+  return value > UINT16_MAX ? UINT16_MAX : (uint16_t)value;
+}
+
+// nowMs is the sample time the session was committed at, the session
+// start is dated back from the current time by the difference
+void recordDrinkEvent(const DrinkSession& session, uint32_t nowMs) {
+  JournalRecord record;
+  record.timestampMs = currentEpochMs() - (nowMs - session.startMs);
+  record.unsynced = !clockSynced;
+  record.amountMl = (uint16_t)((session.volumeUl + 500) / 1000);
+  record.durationMs = session.durationMs;
+  record.peakFlowMlPerMin = clampUint16(session.peakFlowMlPerMin);
+  record.meanFlowMlPerMin = clampUint16(session.meanFlowMlPerMin);
+  journalDrinkEvent(record);
+}
+
+// Test events without session details
+void recordDrinkEvent(float volumeMl) {
+  JournalRecord record = {};
+  record.timestampMs = currentEpochMs();
+  record.unsynced = !clockSynced;
+  record.amountMl = (uint16_t)(volumeMl + 0.5);
+  journalDrinkEvent(record);
+}
+
+void startHistory(uint32_t lastSeenSequence) {
+  historyActive = true;
+  historyAfter = lastSeenSequence;
+  historyBuffered = 0;
+  historyIndex = 0;
+  Serial.print("History requested after seq ");
+  Serial.println(lastSeenSequence);
+}
+
+// Streams one full-MTU history chunk per loop pass, ending with an empty chunk
+void streamHistory() {
+  // Unsynced events only get their time once the central sent its clock
+  if (!historyActive || !timeSyncConfirmed) return;
+
+  if (historyIndex == historyBuffered) {
+    historyBuffered = drinkJournal.readAfter(historyAfter, historyRecords, HISTORY_READ_BATCH, historyCursor);
+    historyIndex = 0;
+  }
+
+  // Chunks have a variable length and need a notification of their own
+  frameBatcher.flush();
+
+  // A chunk the link refused is built again from the same records next pass
+  uint32_t chunkAfter = historyAfter;
+  size_t chunkIndex = historyIndex;
+
+  uint8_t chunk[BATCH_MAX_PAYLOAD];
+  HistoryChunkWriter writer;
+  writer.begin(chunk, frameBatcher.payloadCapacity());
+  while (historyIndex < historyBuffered) {
+    const JournalRecord& record = historyRecords[historyIndex];
+    HistoryRecord entry = { record.sequence, record.timestampMs, record.amountMl,
+                            record.durationMs, record.peakFlowMlPerMin, record.meanFlowMlPerMin };
+    if (!writer.add(entry)) break;
+    historyAfter = record.sequence;
+    historyIndex++;
+  }
+
+  size_t length = writer.finish(drinkJournal.lastSequence());
+  if (!bleFrameSink.sendNotification(chunk, length)) {
+    historyAfter = chunkAfter;
+    historyIndex = chunkIndex;
+    return;
+  }
+
+  if (writer.count() == 0) {
+    historyActive = false;
+    Serial.println("History sync complete");
+  }
+}
+
+// Sends journaled events through the reliable link as far as the central's
+// credits allow. Events are only compacted once the central acknowledged them.
+void drainDrinkJournalBinary(unsigned long now) {
+  uint32_t after = drinkJournal.acknowledgedSequence();
+  if (lastQueuedSequence > after) after = lastQueuedSequence;
+
+  if (reliableLink.canSend()) {
+    JournalRecord records[JOURNAL_DRAIN_BATCH_BINARY];
+    size_t count = drinkJournal.readAfter(after, records, JOURNAL_DRAIN_BATCH_BINARY);
+
+    for (size_t i = 0; i < count && reliableLink.canSend(); i++) {
+      WaterFrame frame;
+      frame.type = FRAME_DRINK_EVENT;
+      frame.sequence = records[i].sequence;
+      frame.timestampMs = records[i].timestampMs;
+      frame.value = records[i].amountMl;
+      frame.durationMs = records[i].durationMs;
+      frame.peakFlowMlPerMin = records[i].peakFlowMlPerMin;
+      frame.meanFlowMlPerMin = records[i].meanFlowMlPerMin;
+      reliableLink.send(frame, now);
+      lastQueuedSequence = frame.sequence;
     }
-    
-    // Send water data if enough time (3s) has passed without water
-    if (noWaterCounter >= 3 && sessionVolumeMl > 0 && isConnected && timeSyncConfirmed) {
-      sendWaterDataViaBLE(sessionVolumeMl);
-      sessionVolumeMl = 0;
+  }
+  reliableLink.poll(now);
+
+  if (reliableLink.ackedSequence() > drinkJournal.acknowledgedSequence()) {
+    drinkJournal.acknowledge(reliableLink.ackedSequence());
+  }
+}
+
+// Sends journaled events in order, a few per loop pass
+void drainDrinkJournal(unsigned long now) {
+  if (!isConnected || !timeSyncConfirmed) return;
+
+  // No event fits the 20 byte payload of the default MTU, in either format,
+  // so wait for the exchange
+  if (!mtuExchanged) return;
+
+  if (useBinaryProtocol) {
+    drainDrinkJournalBinary(now);
+    return;
+  }
+
+  JournalRecord records[JOURNAL_DRAIN_BATCH];
+  size_t count = drinkJournal.readAfter(drinkJournal.acknowledgedSequence(), records, JOURNAL_DRAIN_BATCH);
+  if (count == 0) return;
+
+  // Only events that went out whole are acknowledged, the rest stay journaled
+  size_t sent = 0;
+  while (sent < count && sendWaterDataViaBLE(records[sent])) sent++;
+  if (sent > 0) {
+    drinkJournal.acknowledge(records[sent - 1].sequence);
+    return;
+  }
+
+  static uint32_t reportedSequence = 0;
+  if (records[0].sequence != reportedSequence) {
+    reportedSequence = records[0].sequence;
+    Serial.print("Drink event too large for the notification payload, kept seq ");
+    Serial.println(reportedSequence);
+  }
+}
+
+// Starts a fresh batch and window after (re)connecting or when the MTU changed.
+// Unacknowledged events are sent again from the journal.
+void updateFrameBatcher(bool connectionChanged) {
+  static uint16_t appliedMtu = 0;
+  if (connectionChanged) {
+    frameBatcher.clear();
+    reliableLink.reset(drinkJournal.acknowledgedSequence(), drinkJournal.lastSequence());
+    historyActive = false;
+    lastQueuedSequence = drinkJournal.acknowledgedSequence();
+    if (!isConnected) negotiatedMtu = 23;
+  }
+  if (negotiatedMtu != appliedMtu) {
+    appliedMtu = negotiatedMtu;
+    frameBatcher.setMtu(appliedMtu);
+    Serial.print("Notification payload: ");
+    Serial.print(frameBatcher.payloadCapacity());
+    Serial.println(" bytes");
+  }
+}
+
+void logBatchStats(unsigned long now) {
+  static unsigned long lastLog = 0;
+  if (now - lastLog < BATCH_STATS_INTERVAL) return;
+
+  const BatchStats& stats = frameBatcher.stats();
+  if (stats.frames > 0) {
+    unsigned long elapsed = now - lastLog;
+    Serial.print("BLE batching: ");
+    Serial.print(stats.frames * 1000UL / elapsed);
+    Serial.print(" events/s, ");
+    Serial.print(stats.bytes / stats.frames);
+    Serial.print(" bytes/event, ");
+    Serial.print(stats.frames / stats.notifications);
+    Serial.print(" events/notification, in flight: ");
+    Serial.print(reliableLink.inFlight());
+    Serial.print(", retransmitted: ");
+    Serial.println(reliableLink.stats().retransmitted);
+  }
+  frameBatcher.resetStats();
+  lastLog = now;
+}
+
+void sendCalibrationRun(const CalibrationRun& run) {
+  if (pServer->getConnectedCount() == 0) return;
+
+  if (useBinaryProtocol) {
+    sendBinaryFrame(FRAME_CALIBRATION_RUN, run.pulses > 0xFFFF ? 0xFFFF : run.pulses);
+    return;
+  }
+
+  outboundJsonArena.reset();
+  JsonDocument doc(&outboundJsonArena);
+  doc["calibrationPulses"] = run.pulses;
+  doc["calibrationMs"] = run.activeMs;
+  notifyJson(doc);
+}
+
+void sendCalibrationStored(size_t points) {
+  if (pServer->getConnectedCount() == 0) return;
+
+  if (useBinaryProtocol) {
+    sendBinaryFrame(FRAME_CALIBRATION_STORED, points);
+    return;
+  }
+
+  outboundJsonArena.reset();
+  JsonDocument doc(&outboundJsonArena);
+  doc["calibrationPoints"] = points;
+  notifyJson(doc);
+}
+
+void processFlowSensorData(const FlowSample& sample) {
+  SessionSample sessionSample;
+  sessionSample.timeMs = sample.timeMs;
+  sessionSample.periodMs = sample.periodUs / 1000;
+  sessionSample.pulses = sample.pulses;
+  // Volume per pulse depends on the flow rate, see the calibration table
+  sessionSample.volumeUl = flowCalibration.volumeMicroLiters(sample.pulses, sample.rateMilliHz);
+  sessionSample.rateMilliHz = sample.rateMilliHz;
+  sessionSample.flowStopped = sample.flowStopped;
+
+  DrinkSession session;
+  bool committed = drinkSessions.update(sessionSample, session);
+
+  // Reference pours for the calibration are not drink events. A long pour
+  // split at the maximum session length still belongs to the same run.
+  if (calibrationRunActive()) {
+    addCalibrationSample(sample);
+    CalibrationRun run;
+    if (committed && !session.split && finishCalibrationRun(run)) {
+      sendCalibrationRun(run);
     }
+    return;
+  }
+
+  if (committed) {
+    recordDrinkEvent(session, sample.timeMs);
   }
 }
 
 void generateAndSendRandomWaterData(bool isConnected) {
   static int lastButtonState = 0;
+  static unsigned long lastPressTime = 0;
   int currentButton = digitalRead(randomWaterDataPin);
- 
-  if (currentButton == LOW && lastButtonState == HIGH) {
+
+  // Debounce by time instead of delay(), which would stall the whole loop
+  if (currentButton == LOW && lastButtonState == HIGH && millis() - lastPressTime >= BUTTON_DEBOUNCE_MS) {
+    lastPressTime = millis();
+    powerPolicy.noteActivity(lastPressTime);
+    wakeDisplay();
     if (timeSyncConfirmed && isConnected) {
       // Random value between 1 and 1000 ml
       float randomVolume = random(1, 1001);
-      sendWaterDataViaBLE(randomVolume);
-      Serial.println("Test-Water-Data sent: " + String(randomVolume) + " ml");
-    } 
-    // Debounce delay
-    delay(200); 
+      recordDrinkEvent(randomVolume);
+      Serial.print("Test-Water-Data recorded: ");
+      Serial.print(randomVolume);
+      Serial.println(" ml");
+    }
   }
   lastButtonState = currentButton;
 }
 
+#ifdef SENSOR_LOAD_TEST
+// Keeps the APP core busy for the sensor jitter measurement: the volume
+// line and the ring change on every pass, so a frame is rendered every
+// frame interval, and a drink event is journaled and sent every second.
+// Fills the journal quickly, only meant for test builds.
+void generateSensorLoad(unsigned long now) {
+  static unsigned long lastEvent = 0;
+  currentWater = (currentWater + 37) % (waterGoal + 1);
+  showWaterInfo();
+
+  if (now - lastEvent >= 1000) {
+    lastEvent = now;
+    recordDrinkEvent(random(1, 1001));
+  }
+}
+#endif
+
+// Urgency of a reminder type: 1 normal and 2 important, none and off are 0
+int reminderUrgency(int reminderType) {
+  return reminderType == 1 || reminderType == 2 ? reminderType : 0;
+}
+
+// Applies one command posted by the BLE task, runs in loop()
+void applyCommand(const BottleCommand& command) {
+  switch (command.type) {
+    case CMD_CONNECTED:
+    case CMD_DISCONNECTED:
+    case CMD_SYNC_CONFIRMED:
+      // State the screen shows changed, a reminder only wakes it if it escalates
+      wakeDisplay();
+      break;
+    case CMD_REMINDER:
+      if (reminderUrgency(command.value) > reminderUrgency(currentReminderType)) wakeDisplay();
+      break;
+  }
+
+  switch (command.type) {
+    case CMD_CONNECTED:
+      Serial.println("Client connected");
+      // A new central starts in JSON, also if its disconnect was lost
+      useBinaryProtocol = false;
+      mtuExchanged = false;
+      // Start time synchronization on connect
+      timeSyncRequested = true;
+      timeSyncConfirmed = false;
+      lastSyncRequestTime = 0; // Send immediately
+      Serial.println("Starting time synchronization...");
+      break;
+    case CMD_DISCONNECTED:
+      Serial.println("Client disconnected");
+      // Reset synchronization and fall back to JSON for the next central
+      timeSyncRequested = false;
+      timeSyncConfirmed = false;
+      useBinaryProtocol = false;
+      mtuExchanged = false;
+      BLEDevice::startAdvertising();
+      Serial.println("Started advertising again");
+      break;
+    case CMD_MTU_CHANGED:
+      negotiatedMtu = command.value;
+      mtuExchanged = true;
+      break;
+    case CMD_BINARY_HELLO:
+      // Central speaks the binary protocol: answer and switch over. The
+      // epoch tells the central whether the sequences it saw still apply.
+      useBinaryProtocol = true;
+      sendBinaryFrame(FRAME_HELLO, 0, drinkJournal.epoch());
+      Serial.println("Binary protocol negotiated");
+      break;
+    case CMD_SYNC_CONFIRMED:
+      timeSyncConfirmed = true;
+      timeSyncRequested = false;
+      Serial.println("Time synchronization confirmed!");
+      if (command.timestampMs != 0) {
+        // Events journaled on the boot clock move by the same offset as the RTC
+        if (!clockSynced && !drinkJournal.rebaseUnsynced((int64_t)(command.timestampMs - currentEpochMs()))) {
+          Serial.println("Failed to rebase unsynced drink events");
+        }
+        rtc.setTime(command.timestampMs / 1000, command.timestampMs % 1000);
+        clockSynced = true;
+        printRtcTime();
+      } else if (command.value != 0) {
+        Serial.println("Invalid Timestamp Format");
+      }
+      break;
+    case CMD_REMINDER:
+      setReminderLEDs(command.value);
+      break;
+    case CMD_WATER_GOAL:
+      if (waterGoal != command.value) {
+        waterGoal = command.value;
+        wakeDisplay();
+        if (isConnected && timeSyncConfirmed && !statusDisplayActive) {
+          showWaterInfo();
+        }
+      }
+      break;
+    case CMD_CURRENT_WATER:
+      if (currentWater != command.value) {
+        currentWater = command.value;
+        wakeDisplay();
+        if (isConnected && timeSyncConfirmed && !statusDisplayActive) {
+          showWaterInfo();
+        }
+      }
+      break;
+    case CMD_ACK:
+      reliableLink.onAck(command.sequence, command.value);
+      break;
+    case CMD_HISTORY_REQUEST:
+      startHistory(command.sequence);
+      break;
+    case CMD_CALIBRATE:
+      if (command.value > 0) {
+        startCalibrationRun(command.value);
+      } else if (command.value == 0) {
+        sendCalibrationStored(commitCalibration());
+      } else {
+        resetCalibration();
+        sendCalibrationStored(flowCalibration.table().count);
+      }
+      break;
+  }
+}
+
+// Drains the command queue. The state it changes is only read by loop().
+void processCommands() {
+  BottleCommand command;
+  while (commandQueue.pop(command)) {
+    applyCommand(command);
+    powerPolicy.noteActivity(millis());
+  }
+
+  // Connection commands were lost in a full queue: start over from the
+  // link the BLE task saw last
+  bool connected = false;
+  int32_t mtu = 0;
+  if (takeLinkResync(connected, mtu)) {
+    command = BottleCommand{ connected ? CMD_CONNECTED : CMD_DISCONNECTED, 0, 0, 0 };
+    applyCommand(command);
+    if (connected && mtu != 0) {
+      command = BottleCommand{ CMD_MTU_CHANGED, mtu, 0, 0 };
+      applyCommand(command);
+    }
+    powerPolicy.noteActivity(millis());
+  }
+}
+
 // Server Callbacks for Connect/Disconnect Events
 class WaterBottleServerCallbacks : public BLEServerCallbacks {
   void onConnect(BLEServer* pServer) override {
-    Serial.println("Client connected");
-    // Start time synchronization on connect
-    timeSyncRequested = true;
-    timeSyncConfirmed = false;
-    lastSyncRequestTime = 0; // Send immediately
-    Serial.println("Starting time synchronization...");
+    postCommand(CMD_CONNECTED);
+  }
+
+  void onMtuChanged(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override {
+    postCommand(CMD_MTU_CHANGED, param->mtu.mtu);
   }
   
   void onDisconnect(BLEServer* pServer) override {
-    Serial.println("Client disconnected");
-    // Reset synchronization
-    timeSyncRequested = false;
-    timeSyncConfirmed = false;
-    // Restart advertising after short delay
-    delay(500);
-    BLEDevice::startAdvertising();
-    Serial.println("Started advertising again");
+    postCommand(CMD_DISCONNECTED);
   }
 };
 
-// BLE Callback Handler for Characteristic Writes
+// BLE Callback Handler for Characteristic Writes. Messages are only
+// decoded here, everything else happens in loop().
 class WaterBottleBLEHandler : public BLECharacteristicCallbacks {
 private:
   void handleTimeSynchronization(const JsonDocument& doc) {
-    timeSyncConfirmed = true;
-    timeSyncRequested = false;
-    Serial.println("Time synchronization confirmed!");
-
-    // Set RTC time from the received timestamp
-    if (doc["timestamp"].is<String>()) {
-      String timestamp = doc["timestamp"];
-      Serial.print("Time received: ");
-      Serial.println(timestamp);
-      
-      setRTCFromTimestamp(timestamp);
+    // Set RTC time from the received timestamp, if there is a valid one
+    uint64_t epochMs = 0;
+    bool invalid = false;
+    if (doc["timestamp"].is<const char*>()) {
+      invalid = !parseTimestamp(doc["timestamp"], epochMs);
     }
-  }
-  
-  void handleDrinkReminder(const JsonDocument& doc) {
-    int reminderType = doc["DrinkReminderType"];
-    setReminderLEDs(reminderType);
+    postCommand(CMD_SYNC_CONFIRMED, invalid, 0, epochMs);
   }
 
-  void handleWaterGoal(const JsonDocument& doc) {
-    int receivedWaterGoal = doc["waterGoal"];
-    if (waterGoal != receivedWaterGoal) {
-      waterGoal = receivedWaterGoal;
-      if (isConnected && timeSyncConfirmed && !statusDisplayActive) {
-        showWaterInfo();
-      }
+  void handleBinaryFrame(const WaterFrame& frame) {
+    switch (frame.type) {
+      case FRAME_HELLO:
+        postCommand(CMD_BINARY_HELLO);
+        break;
+      case FRAME_SYNC_CONFIRM:
+        postCommand(CMD_SYNC_CONFIRMED, 0, 0, frame.timestampMs);
+        break;
+      case FRAME_REMINDER:
+        postCommand(CMD_REMINDER, frame.value);
+        break;
+      case FRAME_WATER_GOAL:
+        postCommand(CMD_WATER_GOAL, frame.value);
+        break;
+      case FRAME_CURRENT_WATER:
+        postCommand(CMD_CURRENT_WATER, frame.value);
+        break;
+      case FRAME_ACK:
+        postCommand(CMD_ACK, frame.value, frame.sequence);
+        break;
+      case FRAME_HISTORY_REQUEST:
+        postCommand(CMD_HISTORY_REQUEST, 0, frame.sequence);
+        break;
+      case FRAME_CALIBRATE:
+        postCommand(CMD_CALIBRATE, frame.value == 0xFFFF ? -1 : frame.value);
+        break;
+      default:
+        Serial.print("Unexpected frame type: ");
+        Serial.println(frame.type);
+        break;
     }
   }
-    
-  void handleCurrentWater(const JsonDocument& doc) {
-    int receivedCurrentWater = doc["currentWater"];
-    if (currentWater != receivedCurrentWater) {
-      currentWater = receivedCurrentWater;
-      if (isConnected && timeSyncConfirmed && !statusDisplayActive) {
-        showWaterInfo();
+
+  void handleBinaryMessage(const uint8_t* data, size_t length) {
+    // A single write may carry several concatenated frames
+    size_t offset = 0;
+    while (offset < length) {
+      WaterFrame frame;
+      size_t consumed = decodeWaterFrame(data + offset, length - offset, frame);
+      if (consumed == 0) {
+        Serial.println("Error in binary frame");
+        return;
       }
+      handleBinaryFrame(frame);
+      offset += consumed;
     }
   }
 
-public:
-  void onWrite(BLECharacteristic* characteristic) override {
-    std::string value = std::string((char*)characteristic->getData(), characteristic->getLength());
-    if (value.length() == 0) return;
-    
-    String input = String(value.c_str());
-    JsonDocument doc;
-    DeserializationError err = deserializeJson(doc, input);
+  void handleJsonMessage(const uint8_t* data, size_t length) {
+    inboundJsonArena.reset();
+    JsonDocument doc(&inboundJsonArena);
+    DeserializationError err = deserializeJson(doc, (const char*)data, length);
     
     if (err) {
       Serial.print("Error in JSON: ");
@@ -245,9 +798,6 @@ public:
       return;
     }
 
-    Serial.print("Received JSON: ");
-    Serial.println(input);
-
     // Time synchronization confirmation check
     if (doc["syncConfirmed"].is<bool>() && doc["syncConfirmed"] == true) {
       handleTimeSynchronization(doc);
@@ -256,29 +806,85 @@ public:
 
     // Process DrinkReminderType
     if (doc["DrinkReminderType"].is<int>()) {
-      handleDrinkReminder(doc);
+      postCommand(CMD_REMINDER, doc["DrinkReminderType"].as<int>());
     }
 
     // Process water goal
     if (doc["waterGoal"].is<int>()) {
-      handleWaterGoal(doc);
+      postCommand(CMD_WATER_GOAL, doc["waterGoal"].as<int>());
     }
 
     // Process current water
     if (doc["currentWater"].is<int>()) {
-      handleCurrentWater(doc);
+      postCommand(CMD_CURRENT_WATER, doc["currentWater"].as<int>());
+    }
+
+    // Flow calibration: reference ml, 0 to store, -1 to reset
+    if (doc["calibrate"].is<int>()) {
+      postCommand(CMD_CALIBRATE, doc["calibrate"].as<int>());
+    }
+  }
+
+public:
+  void onWrite(BLECharacteristic* characteristic) override {
+    unsigned long startUs = micros();
+    PROFILE_START(startCycles);
+    recordBleTaskStack();
+
+    // Parse straight from the characteristic buffer, no intermediate copies
+    const uint8_t* data = characteristic->getData();
+    size_t length = characteristic->getLength();
+    if (length > 0) {
+      if (isBinaryFrame(data, length)) {
+        handleBinaryMessage(data, length);
+      } else {
+        handleJsonMessage(data, length);
+      }
     }
+    recordCallbackTime(startUs);
+    PROFILE_END(PHASE_BLE_WRITE, startCycles);
   }
 };
 
 void setup() {
+  unsigned long bootStartMs = millis();
   Serial.begin(115200);
+#ifdef WATERBOTTLE_PROFILING
+  initializeProfiling();
+#endif
+  initializePower(flowPin);
+
+  // Goal and progress survive deep sleep in RTC memory, and so does the
+  // system time. After a cold boot the RTC counts from 0 until a central
+  // sends its time.
+  RetainedState retained;
+  bool warmBoot = restoreRetainedState(retained);
+  if (warmBoot) {
+    waterGoal = retained.waterGoal;
+    currentWater = retained.currentWater;
+    clockSynced = retained.clockSynced;
+    if (currentEpochMs() < retained.epochMs) {
+      rtc.setTime(retained.epochMs / 1000, retained.epochMs % 1000);
+    }
+    Serial.println("Woke from deep sleep");
+  } else {
+    rtc.setTime(0, 0);
+  }
 
   // Initialize TFT display
+  unsigned long phaseStartMs = millis();
   initializeDisplay();
+  unsigned long displayMs = millis() - phaseStartMs;
+
+  // Recover drink events recorded before the last reboot
+  phaseStartMs = millis();
+  initializeJournal();
+  // The boot clock of unsynced events from before a cold boot is gone
+  if (!warmBoot) drinkJournal.abandonUnsynced();
+  unsigned long journalMs = millis() - phaseStartMs;
 
-  // Set default RTC time 
-  rtc.setTime(0, 35, 14, 26, 6, 2025); 
+  // Flow sensor calibration table from NVS
+  loadCalibration();
 
   // Initialize pins
   pinMode(flowPin, INPUT_PULLUP);
@@ -286,9 +892,13 @@ void setup() {
   pinMode(ledNone, OUTPUT);
   pinMode(ledNormal, OUTPUT);
   pinMode(ledImportant, OUTPUT);
-  attachInterrupt(digitalPinToInterrupt(flowPin), pulseCounter, FALLING);
+  // Flow sampling runs in its own task on the other core
+  startSensorTask(flowPin);
 
+  phaseStartMs = millis();
   BLEDevice::init("Smart Water Bottle");
+  // Allow the central to negotiate the largest MTU it supports
+  BLEDevice::setMTU(PREFERRED_MTU);
   pServer = BLEDevice::createServer();
   pServer->setCallbacks(new WaterBottleServerCallbacks()); 
   BLEService* pService = pServer->createService(SERVICE_UUID);
@@ -302,6 +912,17 @@ void setup() {
 
   pCharacteristic->addDescriptor(new BLE2902());
   pCharacteristic->setCallbacks(new WaterBottleBLEHandler());
+
+  pDiagnosticsCharacteristic = pService->createCharacteristic(
+    DIAGNOSTICS_CHARACTERISTIC_UUID,
+    BLECharacteristic::PROPERTY_READ
+  );
+#ifdef WATERBOTTLE_PROFILING
+  pProfileCharacteristic = pService->createCharacteristic(
+    PROFILE_CHARACTERISTIC_UUID,
+    BLECharacteristic::PROPERTY_READ
+  );
+#endif
   pService->start();
 
   // Advertising beim Neustart
@@ -312,7 +933,12 @@ void setup() {
   pAdvertising->setMinPreferred(0x06);  
   pAdvertising->setMinPreferred(0x12);
   BLEDevice::startAdvertising();
+  energyLedger.setState(ENERGY_RADIO, RADIO_ADVERTISING, energyNowUs());
+  unsigned long bleMs = millis() - phaseStartMs;
 
+  // millis() starts after the ROM and bootloader, so this is the time spent in setup()
+  Serial.printf("Boot: %lu ms (display %lu ms, journal %lu ms, BLE %lu ms)\n",
+                millis() - bootStartMs, displayMs, journalMs, bleMs);
   Serial.println("Waiting for client connection...");
 
   // Initialize random seed for random water data
@@ -320,11 +946,18 @@ void setup() {
 }
 
 void loop() {
+  unsigned long loopStartUs = micros();
+  PROFILE_START(loopStartCycles);
   unsigned long now = millis();
-  
+
+  // Apply everything the BLE callbacks posted since the last pass
+  processCommands();
+
   // Handle status display logic
   if (!showReminderMessage) {
+    PROFILE_START(statusStartCycles);
     updateStatusDisplayLogic();
+    PROFILE_END(PHASE_STATUS_DISPLAY, statusStartCycles);
   }
 
   // Handle disconnected clients and restart advertising
@@ -335,24 +968,77 @@ void loop() {
     Serial.println("Client hat getrennt (loop-Check)");
     BLEDevice::startAdvertising();
   }
+  updateFrameBatcher(wasConnected != isConnected);
+  if (wasConnected != isConnected) {
+    energyLedger.setState(ENERGY_RADIO, isConnected ? RADIO_CONNECTED : RADIO_ADVERTISING, energyNowUs());
+  }
   wasConnected = isConnected;
 
   // Handle time synchronization requests
+  PROFILE_START(syncStartCycles);
   handleTimeSynchronization();
+  PROFILE_END(PHASE_TIME_SYNC, syncStartCycles);
 
-  // Process flow sensor data every second without delay
-  if (now - lastFlowCheck >= FLOW_CHECK_INTERVAL) {
-    lastFlowCheck = now;
-
-    noInterrupts();
-    int countedPulses = pulseCount;
-    pulseCount = 0;
-    interrupts();
+  // Process the flow samples taken by the sensor task since the last pass
+  FlowSample sample;
+  while (flowSampleQueue.pop(sample)) {
+    PROFILE_START(flowStartCycles);
+    if (sample.pulses > 0) {
+      powerPolicy.noteActivity(now);
+      wakeDisplay();
+    }
+    energyLedger.setState(ENERGY_SENSOR, sample.pulses > 0 ? SENSOR_FLOWING : SENSOR_NO_FLOW, energyNowUs());
+    processFlowSensorData(sample);
+    PROFILE_END(PHASE_FLOW, flowStartCycles);
+  }
 
-    processFlowSensorData(countedPulses, isConnected);
+  // Deliver journaled drink events
+  drainDrinkJournal(now);
+  if (isConnected && useBinaryProtocol) {
+    streamHistory();
   }
+  logBatchStats(now);
 
   if (isConnected) {
     generateAndSendRandomWaterData(isConnected);
   }
+
+  logMemoryTelemetry(now);
+  logCommandStats(now);
+  logSensorStats(now);
+#ifdef FLOW_PULSE_TRACE
+  printPulseTrace();
+#endif
+#ifdef SENSOR_LOAD_TEST
+  generateSensorLoad(now);
+#endif
+  serviceDisplay(now, loopStartUs);
+
+  // Idle: block until the next command, flow edge or batch deadline so
+  // the chip can sleep, and go to deep sleep after a long idle period
+  logPowerStats(now);
+  char energyReport[ENERGY_REPORT_SIZE];
+  size_t energyReportLength = updateEnergyReport(now, energyReport, sizeof(energyReport));
+  if (energyReportLength > 0) {
+    pDiagnosticsCharacteristic->setValue((uint8_t*)energyReport, energyReportLength);
+  }
+#ifdef WATERBOTTLE_PROFILING
+  PROFILE_END(PHASE_LOOP, loopStartCycles);
+  char profileReport[PROFILE_REPORT_SIZE];
+  size_t profileReportLength = updateProfileReport(now, profileReport, sizeof(profileReport));
+  if (profileReportLength > 0) {
+    pProfileCharacteristic->setValue((uint8_t*)profileReport, profileReportLength);
+  }
+#endif
+#ifdef TFT_BL
+  // The backlight PWM stops in light sleep, so a lit panel keeps the chip awake
+  if (displayAwake()) powerPolicy.noteActivity(now);
+#endif
+  PowerState power = servicePower(now, isConnected);
+  if (power == POWER_DEEP_SLEEP) {
+    RetainedState state = { 0, currentEpochMs(), waterGoal, currentWater, clockSynced };
+    enterDeepSleep(state);
+  } else if (power == POWER_IDLE) {
+    idleWait(isConnected ? BATCH_MAX_DELAY_MS : IDLE_LOOP_WAIT_MS);
+  }
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "WaterBottleMemory.h"
+#include <esp_heap_caps.h>
+#include "WaterBottleSensor.h"
+
+const unsigned long TELEMETRY_LOG_INTERVAL = 10000;
+
+// Task handle of the Bluedroid callback task, captured from its first callback
+static TaskHandle_t bleTaskHandle = NULL;
+
+// Every block is prefixed with its size so reallocate knows how much to copy
+static const size_t BLOCK_HEADER = sizeof(size_t);
+
+static size_t alignedSize(size_t size) {
+  return (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+}
+
+void* JsonArenaAllocator::allocate(size_t size) {
+  size_t total = BLOCK_HEADER + alignedSize(size);
+  if (used + total > JSON_ARENA_SIZE) return nullptr;
+
+  uint8_t* block = buffer + used;
+  *(size_t*)block = size;
+  lastBlock = used;
+  used += total;
+  return block + BLOCK_HEADER;
+}
+
+void JsonArenaAllocator::deallocate(void* pointer) {
+  if (pointer == nullptr) return;
+
+  // Only the most recent block can be given back, the rest waits for reset()
+  uint8_t* block = (uint8_t*)pointer - BLOCK_HEADER;
+  if (block == buffer + lastBlock) {
+    used = lastBlock;
+  }
+}
+
+void* JsonArenaAllocator::reallocate(void* pointer, size_t newSize) {
+  if (pointer == nullptr) return allocate(newSize);
+
+  uint8_t* block = (uint8_t*)pointer - BLOCK_HEADER;
+  size_t oldSize = *(size_t*)block;
+
+  // Grow or shrink the most recent block in place
+  if (block == buffer + lastBlock) {
+    size_t total = BLOCK_HEADER + alignedSize(newSize);
+    if (lastBlock + total > JSON_ARENA_SIZE) return nullptr;
+    *(size_t*)block = newSize;
+    used = lastBlock + total;
+    return pointer;
+  }
+
+  if (newSize <= oldSize) {
+    *(size_t*)block = newSize;
+    return pointer;
+  }
+
+  void* moved = allocate(newSize);
+  if (moved == nullptr) return nullptr;
+  memcpy(moved, pointer, oldSize);
+  return moved;
+}
+
+void JsonArenaAllocator::reset() {
+  used = 0;
+  lastBlock = 0;
+}
+
+void recordBleTaskStack() {
+  if (bleTaskHandle == NULL) {
+    bleTaskHandle = xTaskGetCurrentTaskHandle();
+  }
+}
+
+MemoryTelemetry readMemoryTelemetry() {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+
+  MemoryTelemetry telemetry;
+  telemetry.freeHeap = info.total_free_bytes;
+  telemetry.minFreeHeap = info.minimum_free_bytes;
+  telemetry.largestFreeBlock = info.largest_free_block;
+  telemetry.allocatedBlocks = info.allocated_blocks;
+  telemetry.loopStackHighWater = uxTaskGetStackHighWaterMark(NULL);
+  telemetry.bleStackHighWater = bleTaskHandle != NULL ? uxTaskGetStackHighWaterMark(bleTaskHandle) : 0;
+  TaskHandle_t sensorTask = sensorTaskHandle();
+  telemetry.sensorStackHighWater = sensorTask != NULL ? uxTaskGetStackHighWaterMark(sensorTask) : 0;
+  return telemetry;
+}
+
+void logMemoryTelemetry(unsigned long now) {
+  static unsigned long lastLog = 0;
+  if (now - lastLog < TELEMETRY_LOG_INTERVAL) return;
+  lastLog = now;
+
+  MemoryTelemetry telemetry = readMemoryTelemetry();
+  Serial.print("Heap free: ");
+  Serial.print(telemetry.freeHeap);
+  Serial.print(" min: ");
+  Serial.print(telemetry.minFreeHeap);
+  Serial.print(" largest: ");
+  Serial.print(telemetry.largestFreeBlock);
+  Serial.print(" blocks: ");
+  Serial.print(telemetry.allocatedBlocks);
+  Serial.print(" | Stack HWM loop: ");
+  Serial.print(telemetry.loopStackHighWater);
+  Serial.print(" ble: ");
+  Serial.print(telemetry.bleStackHighWater);
+  Serial.print(" sensor: ");
+  Serial.println(telemetry.sensorStackHighWater);
+}
@@ -0,0 +1,42 @@
+#ifndef WATERBOTTLEMEMORY_H
+#define WATERBOTTLEMEMORY_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Size of the static arena used for every JsonDocument in the message path
+const size_t JSON_ARENA_SIZE = 2048;
+
+// Bump allocator for ArduinoJson backed by a static buffer.
+// Messages are handled one at a time, so the arena is simply reset once
+// the document is gone. Running out of space makes ArduinoJson report
+// NoMemory instead of touching the heap.
+class JsonArenaAllocator : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override;
+  void deallocate(void* pointer) override;
+  void* reallocate(void* pointer, size_t newSize) override;
+  void reset();
+
+private:
+  alignas(8) uint8_t buffer[JSON_ARENA_SIZE];
+  size_t used = 0;
+  size_t lastBlock = 0;
+};
+
+// Heap and stack counters to check that memory usage stays flat
+struct MemoryTelemetry {
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;
+  uint32_t largestFreeBlock;
+  uint32_t allocatedBlocks;
+  uint32_t loopStackHighWater;
+  uint32_t bleStackHighWater;
+  uint32_t sensorStackHighWater;
+};
+
+void recordBleTaskStack();
+MemoryTelemetry readMemoryTelemetry();
+void logMemoryTelemetry(unsigned long now);
+
+#endif
@@ -0,0 +1,183 @@
+#include "WaterBottlePower.h"
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <hal/gpio_ll.h>
+#include <esp_timer.h>
+#include "WaterBottleSensor.h"
+
+PowerPolicy powerPolicy;
+EnergyLedger energyLedger;
+
+RTC_DATA_ATTR static RetainedState retainedState = {};
+
+static TaskHandle_t loopTask = NULL;
+static esp_pm_lock_handle_t noLightSleepLock = NULL;
+static volatile bool lightSleepBlocked = false;
+static bool lightSleepEnabled = false;
+static uint8_t wakePin = 0;
+static volatile bool flowWake = false;
+static volatile uint32_t flowWakes = 0;
+
+static PowerLedger powerLedger;
+static unsigned long lastServiceMs = 0;
+static uint32_t lastSensorIsrCycles = 0;
+
+// Armed only while idle: the first flow edge takes the light sleep lock,
+// so PCNT counts the rest of the pour, and wakes loop()
+static void IRAM_ATTR onFlowWake() {
+  // Level interrupt, so it has to be switched off right away. Arduino
+  // registers IRAM interrupts, so only inline HAL calls are safe here.
+  gpio_ll_set_intr_type(&GPIO, (gpio_num_t)wakePin, GPIO_INTR_DISABLE);
+  if (!lightSleepBlocked) {
+    esp_pm_lock_acquire(noLightSleepLock);
+    lightSleepBlocked = true;
+  }
+  flowWake = true;
+  flowWakes++;
+
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(loopTask, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+// The sensor can rest at either level, so wait for the other one
+static void armFlowWake() {
+  gpio_int_type_t type = digitalRead(wakePin) == HIGH ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL;
+  gpio_wakeup_enable((gpio_num_t)wakePin, type);
+  gpio_set_intr_type((gpio_num_t)wakePin, type);
+  gpio_intr_enable((gpio_num_t)wakePin);
+}
+
+void initializePower(uint8_t flowPin) {
+  loopTask = xTaskGetCurrentTaskHandle();
+  wakePin = flowPin;
+  powerLedger.reset();
+#ifndef TFT_BL
+  energyLedger.setProfile(withoutBacklightControl(DEFAULT_ENERGY_PROFILE));
+#endif
+  energyLedger.begin(energyNowUs());
+  energyLedger.setState(ENERGY_CPU, CPU_BUSY, energyNowUs());
+
+  if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "active", &noLightSleepLock) != ESP_OK) {
+    Serial.println("Power management not available in this core");
+    return;
+  }
+  esp_pm_lock_acquire(noLightSleepLock);
+  lightSleepBlocked = true;
+
+  // The BT controller needs the APB clock at 80 MHz
+  esp_pm_config_esp32_t config = { 240, 80, false };
+#ifndef FLOW_PULSE_TIMESTAMPS
+  // Light sleep would stop the edge timestamps, so that build only scales the clock
+  config.light_sleep_enable = true;
+  lightSleepEnabled = esp_pm_configure(&config) == ESP_OK;
+#endif
+  if (!lightSleepEnabled) {
+    // Cores without tickless idle reject light sleep, scaling still works
+    config.light_sleep_enable = false;
+    esp_pm_configure(&config);
+  }
+
+#ifndef FLOW_PULSE_TIMESTAMPS
+  attachInterrupt(digitalPinToInterrupt(flowPin), onFlowWake, ONLOW);
+  gpio_intr_disable((gpio_num_t)flowPin);
+  esp_sleep_enable_gpio_wakeup();
+#endif
+
+  Serial.println(lightSleepEnabled ? "Power: automatic light sleep" : "Power: frequency scaling only");
+}
+
+bool restoreRetainedState(RetainedState& state) {
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED) return false;
+  if (retainedState.magic != RETAINED_STATE_MAGIC) return false;
+  state = retainedState;
+  retainedState.magic = 0;
+  return true;
+}
+
+PowerState servicePower(unsigned long now, bool connected) {
+  if (flowWake) {
+    flowWake = false;
+    powerPolicy.noteActivity(now);
+  }
+
+  PowerState previous = powerPolicy.state();
+  PowerState state = powerPolicy.update(now, connected, DEEP_SLEEP_AVAILABLE);
+  powerLedger.add(previous, now - lastServiceMs);
+  lastServiceMs = now;
+  if (noLightSleepLock == NULL) return state;
+
+  if (state == POWER_ACTIVE && !lightSleepBlocked) {
+    if (lightSleepEnabled) gpio_intr_disable((gpio_num_t)wakePin);
+    esp_pm_lock_acquire(noLightSleepLock);
+    lightSleepBlocked = true;
+  } else if (state == POWER_IDLE && lightSleepBlocked) {
+    lightSleepBlocked = false;
+    esp_pm_lock_release(noLightSleepLock);
+    if (lightSleepEnabled) armFlowWake();
+  }
+  return state;
+}
+
+void idleWait(uint32_t maxWaitMs) {
+  energyLedger.setState(ENERGY_CPU, CPU_IDLE, energyNowUs());
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(maxWaitMs));
+  energyLedger.setState(ENERGY_CPU, CPU_BUSY, energyNowUs());
+}
+
+uint64_t energyNowUs() {
+  return (uint64_t)esp_timer_get_time();
+}
+
+size_t updateEnergyReport(unsigned long now, char* out, size_t capacity) {
+  static unsigned long lastReport = 0;
+  if (now - lastReport < ENERGY_REPORT_INTERVAL) return 0;
+  lastReport = now;
+
+  // The cycle counter runs at the current CPU clock, which frequency scaling changes
+  uint32_t cycles = sensorIsrCycleCount();
+  energyLedger.addIsrTime(ENERGY_SENSOR, (cycles - lastSensorIsrCycles) / getCpuFrequencyMhz());
+  lastSensorIsrCycles = cycles;
+  energyLedger.update(energyNowUs());
+  return formatEnergyReport(energyLedger, out, capacity);
+}
+
+void wakeLoop() {
+  if (loopTask != NULL) xTaskNotifyGive(loopTask);
+}
+
+void enterDeepSleep(const RetainedState& state) {
+#ifdef FLOW_WAKE_PIN
+  retainedState = state;
+  retainedState.magic = RETAINED_STATE_MAGIC;
+  Serial.println("Entering deep sleep");
+  Serial.flush();
+
+  btStop();
+  // Wake on the first level change, whatever level the sensor rests at
+  int level = digitalRead(FLOW_WAKE_PIN);
+  esp_sleep_enable_ext0_wakeup((gpio_num_t)FLOW_WAKE_PIN, level == HIGH ? 0 : 1);
+  esp_deep_sleep_start();
+#endif
+}
+
+void logPowerStats(unsigned long now) {
+  static unsigned long lastLog = 0;
+  if (now - lastLog < POWER_STATS_INTERVAL) return;
+  lastLog = now;
+
+  const PowerModel& model = lightSleepEnabled ? LIGHT_SLEEP_POWER_MODEL : STOCK_CORE_POWER_MODEL;
+  Serial.printf("Power: active %llu s idle %llu s, %u transitions, flow wakes %u | duty cycle %u permille, ~%u uA\n",
+                (unsigned long long)(powerLedger.stateMs[POWER_ACTIVE] / 1000),
+                (unsigned long long)(powerLedger.stateMs[POWER_IDLE] / 1000),
+                powerLedger.transitions, flowWakes, powerLedger.dutyCyclePermille(model),
+                powerLedger.averageMicroAmps(model));
+
+  char report[ENERGY_REPORT_SIZE];
+  energyLedger.update(energyNowUs());
+  if (formatEnergyReport(energyLedger, report, sizeof(report)) > 0) {
+    Serial.print("Energy: ");
+    Serial.println(report);
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef WATERBOTTLEPOWER_H
+#define WATERBOTTLEPOWER_H
+
+#include <Arduino.h>
+#include <PowerPolicy.h>
+#include <EnergyLedger.h>
+
+// While idle, loop() blocks until a BLE command or a flow edge wakes it,
+// or for at most this long. Connected, it wakes at least every batch delay.
+const uint32_t IDLE_LOOP_WAIT_MS = 500;
+const unsigned long POWER_STATS_INTERVAL = 60000;
+// The diagnostics characteristic is refreshed this often
+const unsigned long ENERGY_REPORT_INTERVAL = 5000;
+const size_t ENERGY_REPORT_SIZE = 400;
+const uint32_t RETAINED_STATE_MAGIC = 0x54525742; // "BWRT"
+
+// Kept in RTC slow memory across deep sleep
+struct RetainedState {
+  uint32_t magic;
+  uint64_t epochMs;      // Time when the bottle went to sleep
+  int32_t waterGoal;
+  int32_t currentWater;
+  bool clockSynced;      // False if epochMs is on the boot clock
+};
+
+// Deep sleep needs an RTC capable pin to wake on flow. GPIO19 is not one,
+// so it is only entered with -D FLOW_WAKE_PIN=<rtc gpio> and the sensor
+// output also wired to that pin.
+#ifdef FLOW_WAKE_PIN
+const bool DEEP_SLEEP_AVAILABLE = true;
+#else
+const bool DEEP_SLEEP_AVAILABLE = false;
+#endif
+
+extern PowerPolicy powerPolicy;
+
+// Time in state per subsystem: the radio and CPU states are set by
+// loop(), the display by its power manager and the sensor per sample
+extern EnergyLedger energyLedger;
+// Microsecond clock of the ledger
+uint64_t energyNowUs();
+// Every ENERGY_REPORT_INTERVAL brings the ledger up to date, adds the
+// sensor interrupt time and writes the report, returns its length or 0
+size_t updateEnergyReport(unsigned long now, char* out, size_t capacity);
+
+// Dynamic frequency scaling and, where the core supports it, automatic
+// light sleep. Must run in the loop() task.
+void initializePower(uint8_t flowPin);
+
+// Returns true after a wake from deep sleep with the state from before
+bool restoreRetainedState(RetainedState& state);
+
+// Applies the policy state: holds or releases the light sleep lock and
+// arms the flow wake-up. Returns the state so loop() can enter deep sleep.
+PowerState servicePower(unsigned long now, bool connected);
+
+// Blocks loop() while idle until wakeLoop() or maxWaitMs
+void idleWait(uint32_t maxWaitMs);
+// Wakes a blocked loop(), from any task
+void wakeLoop();
+
+// Does not return, the next boot restores state
+void enterDeepSleep(const RetainedState& state);
+
+// Logs time per power state, the estimated duty cycle and the energy report every minute
+void logPowerStats(unsigned long now);
+
+#endif
@@ -0,0 +1,56 @@
+#include "WaterBottleProfiling.h"
+
+#ifdef WATERBOTTLE_PROFILING
+#include <AtomicSnapshot.h>
+#include <rom/ets_sys.h>
+
+// Owned by loop(), except the BLE write slot
+static CycleHistogram phases[LOOP_PHASES];
+// Owned by the Bluedroid task, published after every write
+static CycleHistogram bleWrites;
+static AtomicSnapshot<CycleHistogram> bleWriteSnapshot;
+
+void initializeProfiling() {
+  for (size_t i = 0; i < LOOP_PHASES; i++) phases[i].reset();
+  bleWrites.reset();
+  bleWriteSnapshot.publish(bleWrites);
+}
+
+void recordLoopPhase(LoopPhase phase, uint32_t cycles) {
+  // Frequency scaling switches the clock between 80 and 240 MHz, so cycle
+  // counts of different samples only compare once converted to time
+  uint32_t us = cycles / ets_get_cpu_frequency();
+  if (phase == PHASE_BLE_WRITE) {
+    bleWrites.record(us);
+    bleWriteSnapshot.publish(bleWrites);
+    return;
+  }
+  phases[phase].record(us);
+}
+
+size_t updateProfileReport(unsigned long now, char* out, size_t capacity) {
+  static unsigned long lastReport = 0;
+  if (now - lastReport < PROFILE_REPORT_INTERVAL) return 0;
+  lastReport = now;
+
+  phases[PHASE_BLE_WRITE] = bleWriteSnapshot.read();
+
+  int length = snprintf(out, capacity, "{\"us\":{");
+  for (size_t i = 0; i < LOOP_PHASES && length >= 0 && (size_t)length < capacity; i++) {
+    const CycleHistogram& histogram = phases[i];
+    length += snprintf(out + length, capacity - length, "%s\"%s\":[%lu,%lu,%lu,%lu,%lu]", i > 0 ? "," : "",
+                       LOOP_PHASE_NAMES[i], (unsigned long)histogram.samples,
+                       (unsigned long)(histogram.samples > 0 ? histogram.minCycles : 0),
+                       (unsigned long)histogram.percentile(500), (unsigned long)histogram.percentile(990),
+                       (unsigned long)histogram.maxCycles);
+  }
+  if (length >= 0 && (size_t)length < capacity) length += snprintf(out + length, capacity - length, "}}");
+
+  if (length < 0 || (size_t)length >= capacity) {
+    if (capacity > 0) out[0] = '\0';
+    return 0;
+  }
+  return length;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef WATERBOTTLEPROFILING_H
+#define WATERBOTTLEPROFILING_H
+
+#include <Arduino.h>
+#include <CycleHistogram.h>
+
+// Execution time of the loop() phases and the BLE write callback, measured
+// with the CPU cycle counter and kept in microseconds. Only built with
+// -D WATERBOTTLE_PROFILING, otherwise the PROFILE_ macros expand to nothing.
+enum LoopPhase : uint8_t {
+  PHASE_STATUS_DISPLAY,  // updateStatusDisplayLogic()
+  PHASE_TIME_SYNC,       // handleTimeSynchronization()
+  PHASE_FLOW,            // One flow sample from the queue, processed
+  PHASE_BLE_WRITE,       // onWrite(), in the Bluedroid task
+  PHASE_LOOP,            // A whole loop() pass up to the idle wait
+  LOOP_PHASES
+};
+
+const char* const LOOP_PHASE_NAMES[LOOP_PHASES] = { "statusDisplay", "timeSync", "flow", "bleWrite", "loop" };
+
+// The profile characteristic is refreshed this often
+const unsigned long PROFILE_REPORT_INTERVAL = 5000;
+const size_t PROFILE_REPORT_SIZE = 400;
+
+#ifdef WATERBOTTLE_PROFILING
+#include <hal/cpu_hal.h>
+
+#define PROFILE_START(start) uint32_t start = cpu_hal_get_cycle_count()
+#define PROFILE_END(phase, start) recordLoopPhase(phase, cpu_hal_get_cycle_count() - (start))
+
+void initializeProfiling();
+// PHASE_BLE_WRITE from the Bluedroid task, every other phase from loop().
+// Cycles are converted with the current CPU clock before they are recorded.
+void recordLoopPhase(LoopPhase phase, uint32_t cycles);
+// Every PROFILE_REPORT_INTERVAL writes the histograms since boot as JSON,
+// e.g. {"us":{"statusDisplay":[n,min,p50,p99,max],...}}, returns its
+// length or 0
+size_t updateProfileReport(unsigned long now, char* out, size_t capacity);
+#else
+#define PROFILE_START(start)
+#define PROFILE_END(phase, start)
+#endif
+
+#endif
@@ -0,0 +1,223 @@
+#include "WaterBottleSensor.h"
+#include <esp_timer.h>
+#include <hal/cpu_hal.h>
+
+const uint32_t SENSOR_REPORT_SAMPLES = 10000 / SENSOR_SAMPLE_PERIOD_MS;
+const unsigned long SENSOR_STATS_INTERVAL = 10000;
+
+SpscQueue<FlowSample, FLOW_SAMPLE_QUEUE_SIZE> flowSampleQueue;
+AtomicSnapshot<JitterStats> sensorJitter;
+
+PcntPulseCounter flowPulseCounter;
+
+static TaskHandle_t sensorHandle = NULL;
+
+bool PcntPulseCounter::begin(uint8_t pin, pcnt_unit_t counterUnit) {
+  unit = counterUnit;
+
+  pcnt_config_t config = {};
+  config.pulse_gpio_num = pin;
+  config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+  config.channel = PCNT_CHANNEL_0;
+  config.unit = unit;
+  // Falling edges only, like the interrupt this replaces
+  config.pos_mode = PCNT_COUNT_DIS;
+  config.neg_mode = PCNT_COUNT_INC;
+  config.lctrl_mode = PCNT_MODE_KEEP;
+  config.hctrl_mode = PCNT_MODE_KEEP;
+  config.counter_h_lim = PCNT_COUNT_LIMIT;
+  config.counter_l_lim = 0;
+  if (pcnt_unit_config(&config) != ESP_OK) return false;
+
+  pcnt_set_filter_value(unit, PCNT_FILTER_CYCLES);
+  pcnt_filter_enable(unit);
+
+  // The counter resets to 0 at the high limit, the interrupt counts the wraps
+  pcnt_event_enable(unit, PCNT_EVT_H_LIM);
+  esp_err_t result = pcnt_isr_service_install(0);
+  if (result != ESP_OK && result != ESP_ERR_INVALID_STATE) return false;
+  if (pcnt_isr_handler_add(unit, onLimit, this) != ESP_OK) return false;
+
+  pcnt_counter_pause(unit);
+  pcnt_counter_clear(unit);
+  wraps = 0;
+  accumulator.reset(0, 0);
+  return pcnt_counter_resume(unit) == ESP_OK;
+}
+
+// Cycles spent in the sensor interrupts, only ever increases. Both run on
+// the sensor core at the same level, so they never interrupt each other.
+static volatile uint32_t sensorIsrCycles = 0;
+
+uint32_t sensorIsrCycleCount() {
+  return sensorIsrCycles;
+}
+
+void IRAM_ATTR PcntPulseCounter::onLimit(void* arg) {
+  uint32_t start = cpu_hal_get_cycle_count();
+  static_cast<PcntPulseCounter*>(arg)->wraps++;
+  sensorIsrCycles += cpu_hal_get_cycle_count() - start;
+}
+
+uint32_t PcntPulseCounter::take() {
+  // Read the wrap count on both sides of the counter, so both belong together
+  uint32_t before, after;
+  int16_t count;
+  do {
+    before = wraps;
+    pcnt_get_counter_value(unit, &count);
+    after = wraps;
+  } while (before != after);
+  return accumulator.update(before, (uint16_t)count);
+}
+
+#ifdef FLOW_PULSE_TIMESTAMPS
+// Written by the edge interrupt, read by the sensor task on the same core
+static volatile uint32_t pulseTimes[PULSE_TIME_RING_SIZE];
+static volatile uint32_t pulseTimeHead = 0;
+static volatile uint32_t pulseTimeTail = 0;
+static volatile uint32_t pulseTimeOverruns = 0;
+
+static void IRAM_ATTR onFlowEdge() {
+  uint32_t start = cpu_hal_get_cycle_count();
+  uint32_t head = pulseTimeHead;
+  if (head - pulseTimeTail >= PULSE_TIME_RING_SIZE) {
+    pulseTimeOverruns++;
+  } else {
+    pulseTimes[head % PULSE_TIME_RING_SIZE] = (uint32_t)esp_timer_get_time();
+    pulseTimeHead = head + 1;
+  }
+  sensorIsrCycles += cpu_hal_get_cycle_count() - start;
+}
+
+static PulseFlowMeter flowMeter;
+
+#ifdef FLOW_PULSE_TRACE
+static SpscQueue<uint32_t, 256> pulseTraceQueue;
+
+void printPulseTrace() {
+  uint32_t timeUs;
+  while (pulseTraceQueue.pop(timeUs)) {
+    Serial.println(timeUs);
+  }
+}
+#endif
+
+// Feeds the new edge timestamps to the flow meter and fills in its rate
+// and whether the pulse gap ended the flow
+static void measurePulseIntervals(FlowSample& sample, uint32_t nowUs) {
+  bool wasFlowing = flowMeter.flowing(nowUs - sample.periodUs);
+  while (pulseTimeTail != pulseTimeHead) {
+    uint32_t timeUs = pulseTimes[pulseTimeTail % PULSE_TIME_RING_SIZE];
+    pulseTimeTail = pulseTimeTail + 1;
+    if (flowMeter.addPulse(timeUs)) wasFlowing = true;
+#ifdef FLOW_PULSE_TRACE
+    pulseTraceQueue.push(timeUs);
+#endif
+  }
+  sample.rateMilliHz = flowMeter.rateMilliHz(nowUs);
+  sample.flowStopped = wasFlowing && !flowMeter.flowing(nowUs);
+}
+#else
+static PulseCountRate countRate;
+#endif
+
+static void sensorTask(void* parameter) {
+  uint8_t flowPin = (uint8_t)(uintptr_t)parameter;
+  if (!flowPulseCounter.begin(flowPin, PCNT_UNIT_0)) {
+    Serial.println("Flow pulse counter not available");
+    sensorHandle = NULL;
+    vTaskDelete(NULL);
+    return;
+  }
+#ifdef FLOW_PULSE_TIMESTAMPS
+  // PCNT keeps counting the volume, the interrupt only adds timestamps
+  attachInterrupt(digitalPinToInterrupt(flowPin), onFlowEdge, FALLING);
+#endif
+
+  JitterStats stats;
+  stats.reset(SENSOR_SAMPLE_PERIOD_MS * 1000);
+
+  TickType_t lastWake = xTaskGetTickCount();
+  int64_t lastSampleUs = esp_timer_get_time();
+  // What a sample dropped on a full queue held, added to the next one
+  FlowSample carried = {};
+  for (;;) {
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(SENSOR_SAMPLE_PERIOD_MS));
+    int64_t nowUs = esp_timer_get_time();
+    uint32_t periodUs = (uint32_t)(nowUs - lastSampleUs);
+
+    FlowSample sample;
+    sample.pulses = flowPulseCounter.take();
+    sample.periodUs = periodUs;
+    sample.timeMs = (uint32_t)(nowUs / 1000);
+    lastSampleUs = nowUs;
+#ifdef FLOW_PULSE_TIMESTAMPS
+    measurePulseIntervals(sample, (uint32_t)nowUs);
+#else
+    sample.rateMilliHz = countRate.add(sample.pulses, sample.periodUs);
+    sample.flowStopped = false;
+#endif
+
+    // The rate is measured over this period only, the volume and the time
+    // it took include the dropped samples
+    sample.pulses += carried.pulses;
+    sample.periodUs += carried.periodUs;
+    sample.flowStopped = sample.flowStopped || carried.flowStopped;
+    if (flowSampleQueue.push(sample)) {
+      carried = FlowSample();
+    } else {
+      carried = sample;
+    }
+
+    stats.record(periodUs);
+    if (stats.samples >= SENSOR_REPORT_SAMPLES) {
+      sensorJitter.publish(stats);
+      stats.reset(SENSOR_SAMPLE_PERIOD_MS * 1000);
+    }
+  }
+}
+
+void startSensorTask(uint8_t flowPin) {
+  xTaskCreatePinnedToCore(sensorTask, "sensor", SENSOR_TASK_STACK, (void*)(uintptr_t)flowPin,
+                          SENSOR_TASK_PRIORITY, &sensorHandle, SENSOR_TASK_CORE);
+}
+
+TaskHandle_t sensorTaskHandle() {
+  return sensorHandle;
+}
+
+void logSensorStats(unsigned long now) {
+  static unsigned long lastLog = 0;
+  if (now - lastLog < SENSOR_STATS_INTERVAL) return;
+  lastLog = now;
+
+  JitterStats stats = sensorJitter.read();
+  if (stats.samples == 0) return;
+
+  Serial.print("Sensor period: mean ");
+  Serial.print(stats.meanPeriodUs());
+  Serial.print(" us min ");
+  Serial.print(stats.minPeriodUs);
+  Serial.print(" max ");
+  Serial.print(stats.maxPeriodUs);
+  Serial.print(" | deviation max ");
+  Serial.print(stats.maxDeviationUs);
+  Serial.print(" us, <20/<100/<500/<1000/<5000/more us:");
+  for (size_t i = 0; i < JITTER_BUCKETS; i++) {
+    Serial.print(' ');
+    Serial.print(stats.buckets[i]);
+  }
+  Serial.print(" | queue max depth: ");
+  Serial.print(flowSampleQueue.maxDepth());
+  Serial.print(" dropped: ");
+#ifdef FLOW_PULSE_TIMESTAMPS
+  Serial.print(flowSampleQueue.dropped());
+  Serial.print(" | edge overruns: ");
+  Serial.print(pulseTimeOverruns);
+  Serial.print(" glitches: ");
+  Serial.println(flowMeter.rejectedPulses());
+#else
+  Serial.println(flowSampleQueue.dropped());
+#endif
+}
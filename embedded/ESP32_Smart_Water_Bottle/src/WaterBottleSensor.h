@@ -0,0 +1,90 @@
+#ifndef WATERBOTTLESENSOR_H
+#define WATERBOTTLESENSOR_H
+
+#include <Arduino.h>
+#include <SpscQueue.h>
+#include <AtomicSnapshot.h>
+#include <JitterStats.h>
+#include <PulseCounter.h>
+#include <PulseFlowMeter.h>
+#include <driver/pcnt.h>
+
+// The flow sensor is sampled by its own task pinned to the PRO core, where
+// nothing but the Bluedroid stack runs. Display, journal and notifications
+// stay in loop() on the APP core, so a slow redraw or a flash erase no
+// longer shifts the sampling period.
+const uint32_t SENSOR_SAMPLE_PERIOD_MS = 100;
+const BaseType_t SENSOR_TASK_CORE = 0;
+// Above the Bluedroid host tasks (19, 20), below the BT controller (23)
+const UBaseType_t SENSOR_TASK_PRIORITY = configMAX_PRIORITIES - 4;
+const uint32_t SENSOR_TASK_STACK = 2048;
+
+// Flow pulses are counted by the PCNT peripheral, the CPU only reads the
+// counter once per sampling period. The hardware counter wraps at
+// PCNT_COUNT_LIMIT and reports each wrap through an interrupt.
+const int16_t PCNT_COUNT_LIMIT = 32767;
+// Edges shorter than 1023 APB cycles (12.8 us) are ignored as glitches
+const uint16_t PCNT_FILTER_CYCLES = 1023;
+
+class PcntPulseCounter : public PulseCounter {
+public:
+  PcntPulseCounter() : accumulator(PCNT_COUNT_LIMIT) {}
+
+  // Counts falling edges on pin, the overflow interrupt runs on the calling core
+  bool begin(uint8_t pin, pcnt_unit_t unit);
+  uint32_t take() override;
+
+private:
+  static void IRAM_ATTR onLimit(void* arg);
+
+  pcnt_unit_t unit = PCNT_UNIT_0;
+  volatile uint32_t wraps = 0;
+  PulseAccumulator accumulator;
+};
+
+// With -D FLOW_PULSE_TIMESTAMPS a GPIO interrupt also timestamps every
+// edge, the rate then follows the pulse intervals and the end of a pour is
+// detected from the pulse gap (PulseFlowMeter) instead of empty seconds.
+// -D FLOW_PULSE_TRACE additionally prints the timestamps as a pulse trace.
+const size_t PULSE_TIME_RING_SIZE = 64;
+#if defined(FLOW_PULSE_TRACE) && !defined(FLOW_PULSE_TIMESTAMPS)
+#error "FLOW_PULSE_TRACE needs FLOW_PULSE_TIMESTAMPS"
+#endif
+
+// Pulses counted in one sampling period, or in several if the queue was
+// full and the previous samples were carried over
+struct FlowSample {
+  uint32_t pulses;
+  uint32_t periodUs;
+  uint32_t timeMs;
+  // Pulse frequency, averaged over the period or from the pulse intervals
+  uint32_t rateMilliHz;
+  // Pulse gap detector: the flow stopped during this period
+  bool flowStopped;
+};
+
+// Sensor task -> loop(). 32 samples cover 3.2 s of loop() stalls.
+const size_t FLOW_SAMPLE_QUEUE_SIZE = 32;
+extern SpscQueue<FlowSample, FLOW_SAMPLE_QUEUE_SIZE> flowSampleQueue;
+
+// Sampling period statistics, published by the sensor task every 10 s
+extern AtomicSnapshot<JitterStats> sensorJitter;
+
+// Starts the sensor task, which sets up the pulse counter on its own core
+void startSensorTask(uint8_t flowPin);
+// NULL before the task started and after it gave up on the pulse counter
+TaskHandle_t sensorTaskHandle();
+
+// CPU cycles spent in the pulse counter and edge interrupts since boot,
+// wraps around, readers use the difference
+uint32_t sensorIsrCycleCount();
+
+// Logs the last published period statistics every 10 seconds
+void logSensorStats(unsigned long now);
+
+#ifdef FLOW_PULSE_TRACE
+// Prints the pulse timestamps captured since the last call, from loop()
+void printPulseTrace();
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+#include "WaterBottleStorage.h"
+
+PartitionFlashStore journalFlash;
+DrinkJournal drinkJournal(journalFlash);
+
+bool PartitionFlashStore::begin(const char* label) {
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  return partition != nullptr;
+}
+
+size_t PartitionFlashStore::sectorCount() const {
+  return partition != nullptr ? partition->size / SPI_FLASH_SEC_SIZE : 0;
+}
+
+bool PartitionFlashStore::read(size_t address, void* data, size_t length) {
+  return esp_partition_read(partition, address, data, length) == ESP_OK;
+}
+
+bool PartitionFlashStore::write(size_t address, const void* data, size_t length) {
+  return esp_partition_write(partition, address, data, length) == ESP_OK;
+}
+
+bool PartitionFlashStore::eraseSector(size_t sector) {
+  return esp_partition_erase_range(partition, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE) == ESP_OK;
+}
+
+void initializeJournal() {
+  // A journal started on erased flash gets a random epoch
+  if (!journalFlash.begin("journal") || !drinkJournal.begin(esp_random())) {
+    Serial.println("Drink journal not available");
+    return;
+  }
+
+  Serial.print("Drink journal ready, pending events: ");
+  Serial.print(drinkJournal.pendingCount());
+  Serial.print(", torn records: ");
+  Serial.print(drinkJournal.stats().tornRecords);
+  Serial.print(", epoch: ");
+  Serial.println(drinkJournal.epoch());
+}
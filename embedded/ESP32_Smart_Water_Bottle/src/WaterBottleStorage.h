@@ -0,0 +1,27 @@
+#ifndef WATERBOTTLESTORAGE_H
+#define WATERBOTTLESTORAGE_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <DrinkJournal.h>
+
+// FlashStore on top of the "journal" data partition from partitions.csv
+class PartitionFlashStore : public FlashStore {
+public:
+  bool begin(const char* label);
+
+  size_t sectorSize() const override { return SPI_FLASH_SEC_SIZE; }
+  size_t sectorCount() const override;
+  bool read(size_t address, void* data, size_t length) override;
+  bool write(size_t address, const void* data, size_t length) override;
+  bool eraseSector(size_t sector) override;
+
+private:
+  const esp_partition_t* partition = nullptr;
+};
+
+extern DrinkJournal drinkJournal;
+
+void initializeJournal();
+
+#endif
@@ -0,0 +1,257 @@
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include <SpscQueue.h>
+#include <AtomicSnapshot.h>
+#include <JitterStats.h>
+#include <CycleHistogram.h>
+
+void setUp() {}
+void tearDown() {}
+
+void test_queue_is_fifo() {
+  SpscQueue<uint32_t, 8> queue;
+  uint32_t item;
+  TEST_ASSERT_FALSE(queue.pop(item));
+
+  for (uint32_t i = 1; i <= 5; i++) TEST_ASSERT_TRUE(queue.push(i));
+  TEST_ASSERT_EQUAL_size_t(5, queue.size());
+  for (uint32_t i = 1; i <= 5; i++) {
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_UINT32(i, item);
+  }
+  TEST_ASSERT_FALSE(queue.pop(item));
+  TEST_ASSERT_EQUAL_UINT32(5, queue.maxDepth());
+}
+
+void test_full_queue_drops_and_counts() {
+  SpscQueue<uint32_t, 4> queue;
+  for (uint32_t i = 0; i < 4; i++) TEST_ASSERT_TRUE(queue.push(i));
+  TEST_ASSERT_FALSE(queue.push(99));
+  TEST_ASSERT_FALSE(queue.push(99));
+  TEST_ASSERT_EQUAL_UINT32(2, queue.dropped());
+  TEST_ASSERT_EQUAL_UINT32(4, queue.maxDepth());
+
+  // The queued items are untouched by the dropped ones
+  uint32_t item;
+  TEST_ASSERT_TRUE(queue.pop(item));
+  TEST_ASSERT_EQUAL_UINT32(0, item);
+  TEST_ASSERT_TRUE(queue.push(4));
+}
+
+// Items pushed with a reserve leave the last slots to the ones without
+void test_reserved_slots_stay_free() {
+  SpscQueue<uint32_t, 8> queue;
+  for (uint32_t i = 0; i < 5; i++) TEST_ASSERT_TRUE(queue.push(i, 3));
+  TEST_ASSERT_FALSE(queue.push(99, 3));
+  TEST_ASSERT_EQUAL_UINT32(1, queue.dropped());
+
+  for (uint32_t i = 5; i < 8; i++) TEST_ASSERT_TRUE(queue.push(i));
+  TEST_ASSERT_FALSE(queue.push(99));
+
+  uint32_t item;
+  TEST_ASSERT_TRUE(queue.pop(item));
+  TEST_ASSERT_EQUAL_UINT32(0, item);
+  TEST_ASSERT_FALSE(queue.push(99, 3));
+  TEST_ASSERT_TRUE(queue.push(8));
+  for (uint32_t i = 1; i <= 8; i++) {
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_UINT32(i, item);
+  }
+}
+
+void test_queue_wraps_around() {
+  SpscQueue<uint32_t, 4> queue;
+  uint32_t item;
+  for (uint32_t i = 0; i < 1000; i++) {
+    TEST_ASSERT_TRUE(queue.push(i));
+    TEST_ASSERT_TRUE(queue.push(i + 1));
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_UINT32(i, item);
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_UINT32(i + 1, item);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, queue.maxDepth());
+  TEST_ASSERT_EQUAL_UINT32(0, queue.dropped());
+}
+
+// A producer and a consumer thread: every item arrives once and in order
+void test_queue_across_threads() {
+  const uint32_t ITEMS = 100000;
+  static SpscQueue<uint32_t, 32> queue;
+  std::thread producer([] {
+    for (uint32_t i = 1; i <= ITEMS; i++) {
+      while (!queue.push(i)) std::this_thread::yield();
+    }
+  });
+
+  uint32_t expected = 1;
+  bool ordered = true;
+  while (expected <= ITEMS) {
+    uint32_t item;
+    if (!queue.pop(item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (item != expected) ordered = false;
+    expected++;
+  }
+  producer.join();
+  TEST_ASSERT_TRUE(ordered);
+}
+
+struct Sample {
+  uint32_t a;
+  uint64_t b;
+  uint16_t c;
+  uint32_t d;
+};
+
+void test_snapshot_round_trip() {
+  AtomicSnapshot<Sample> snapshot;
+  Sample zero = snapshot.read();
+  TEST_ASSERT_EQUAL_UINT32(0, zero.a);
+
+  Sample value = { 7, 0x123456789ULL, 3, 42 };
+  snapshot.publish(value);
+  Sample copy = snapshot.read();
+  TEST_ASSERT_EQUAL_UINT32(7, copy.a);
+  TEST_ASSERT_EQUAL_UINT64(0x123456789ULL, copy.b);
+  TEST_ASSERT_EQUAL_UINT16(3, copy.c);
+  TEST_ASSERT_EQUAL_UINT32(42, copy.d);
+}
+
+// A writer publishing structs whose fields all hold the same counter: a
+// reader must never see fields from two different publishes
+void test_snapshot_reads_are_never_torn() {
+  static AtomicSnapshot<Sample> snapshot;
+  static std::atomic<bool> done{false};
+  std::thread writer([] {
+    for (uint32_t i = 1; i <= 50000; i++) {
+      Sample value = { i, i, (uint16_t)i, i };
+      snapshot.publish(value);
+      if (i % 64 == 0) std::this_thread::yield();
+    }
+    done.store(true);
+  });
+
+  uint32_t torn = 0;
+  uint32_t last = 0;
+  bool monotonic = true;
+  while (!done.load()) {
+    Sample value = snapshot.read();
+    if (value.b != value.a || value.d != value.a || value.c != (uint16_t)value.a) torn++;
+    if (value.a < last) monotonic = false;
+    last = value.a;
+    std::this_thread::yield();
+  }
+  writer.join();
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_TRUE(monotonic);
+  TEST_ASSERT_EQUAL_UINT32(50000, snapshot.read().a);
+}
+
+void test_jitter_buckets() {
+  JitterStats stats;
+  stats.reset(100000);
+  const uint32_t periods[] = { 100000, 100019, 99980, 100099, 100500, 101000, 95000, 90000 };
+  for (size_t i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) stats.record(periods[i]);
+
+  // <20, <100, <500, <1000, <5000 us and above
+  const uint32_t expected[JITTER_BUCKETS] = { 2, 2, 0, 1, 1, 2 };
+  for (size_t i = 0; i < JITTER_BUCKETS; i++) TEST_ASSERT_EQUAL_UINT32(expected[i], stats.buckets[i]);
+  TEST_ASSERT_EQUAL_UINT32(90000, stats.minPeriodUs);
+  TEST_ASSERT_EQUAL_UINT32(101000, stats.maxPeriodUs);
+  TEST_ASSERT_EQUAL_UINT32(10000, stats.maxDeviationUs);
+  TEST_ASSERT_EQUAL_UINT32(98324, stats.meanPeriodUs());
+}
+
+// Buckets are contiguous, each starts right after the previous one ends,
+// and none is wider than a quarter of its lower bound
+void test_cycle_buckets_tile_the_range() {
+  TEST_ASSERT_EQUAL_size_t(0, CycleHistogram::bucketOf(0));
+  TEST_ASSERT_EQUAL_size_t(3, CycleHistogram::bucketOf(3));
+  TEST_ASSERT_EQUAL_size_t(CYCLE_HISTOGRAM_BUCKETS - 1, CycleHistogram::bucketOf(UINT32_MAX));
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, CycleHistogram::bucketUpper(CYCLE_HISTOGRAM_BUCKETS - 1));
+
+  for (size_t bucket = 0; bucket < CYCLE_HISTOGRAM_BUCKETS; bucket++) {
+    uint32_t upper = CycleHistogram::bucketUpper(bucket);
+    uint32_t lower = bucket == 0 ? 0 : CycleHistogram::bucketUpper(bucket - 1) + 1;
+    TEST_ASSERT_EQUAL_size_t(bucket, CycleHistogram::bucketOf(lower));
+    TEST_ASSERT_EQUAL_size_t(bucket, CycleHistogram::bucketOf(upper));
+    if (bucket + 1 < CYCLE_HISTOGRAM_BUCKETS) TEST_ASSERT_EQUAL_size_t(bucket + 1, CycleHistogram::bucketOf(upper + 1));
+    if (lower >= 4) TEST_ASSERT_LESS_OR_EQUAL(lower / 4, upper - lower);
+  }
+}
+
+void test_cycle_bucket_of_sample_counts() {
+  // 1000 = 0b1111101000: exponent 9, next two bits 11
+  TEST_ASSERT_EQUAL_size_t(4 + 7 * 4 + 3, CycleHistogram::bucketOf(1000));
+  TEST_ASSERT_EQUAL_UINT32(1023, CycleHistogram::bucketUpper(CycleHistogram::bucketOf(1000)));
+  TEST_ASSERT_EQUAL_size_t(4 + 8 * 4, CycleHistogram::bucketOf(1024));
+  TEST_ASSERT_EQUAL_UINT32(1279, CycleHistogram::bucketUpper(CycleHistogram::bucketOf(1024)));
+
+  uint32_t state = 1;
+  for (int i = 0; i < 100000; i++) {
+    state = state * 1664525 + 1013904223;
+    uint32_t cycles = state >> (state & 31);
+    size_t bucket = CycleHistogram::bucketOf(cycles);
+    TEST_ASSERT_GREATER_OR_EQUAL(cycles, CycleHistogram::bucketUpper(bucket));
+    if (bucket > 0) TEST_ASSERT_LESS_THAN(cycles, CycleHistogram::bucketUpper(bucket - 1));
+  }
+}
+
+void test_cycle_percentiles() {
+  CycleHistogram histogram;
+  histogram.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, histogram.percentile(500));
+
+  for (uint32_t cycles = 1; cycles <= 1000; cycles++) histogram.record(cycles);
+  TEST_ASSERT_EQUAL_UINT32(1000, histogram.samples);
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.minCycles);
+  TEST_ASSERT_EQUAL_UINT32(1000, histogram.maxCycles);
+
+  // The upper end of the bucket, never below the exact percentile and at
+  // most 25% above it
+  TEST_ASSERT_EQUAL_UINT32(511, histogram.percentile(500));
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.percentile(0));
+  TEST_ASSERT_EQUAL_UINT32(1000, histogram.percentile(1000));
+  for (uint32_t permille = 1; permille <= 1000; permille++) {
+    uint32_t exact = permille;
+    uint32_t estimate = histogram.percentile(permille);
+    TEST_ASSERT_GREATER_OR_EQUAL(exact, estimate);
+    TEST_ASSERT_LESS_OR_EQUAL(exact + exact / 4, estimate);
+  }
+}
+
+// A single sample is every percentile, the bucket end is kept to it
+void test_cycle_percentile_within_min_and_max() {
+  CycleHistogram histogram;
+  histogram.reset();
+  histogram.record(100000);
+  TEST_ASSERT_EQUAL_UINT32(100000, histogram.percentile(10));
+  TEST_ASSERT_EQUAL_UINT32(100000, histogram.percentile(990));
+
+  histogram.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, histogram.samples);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, histogram.minCycles);
+  histogram.record(UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, histogram.percentile(500));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_queue_is_fifo);
+  RUN_TEST(test_full_queue_drops_and_counts);
+  RUN_TEST(test_reserved_slots_stay_free);
+  RUN_TEST(test_queue_wraps_around);
+  RUN_TEST(test_queue_across_threads);
+  RUN_TEST(test_snapshot_round_trip);
+  RUN_TEST(test_snapshot_reads_are_never_torn);
+  RUN_TEST(test_jitter_buckets);
+  RUN_TEST(test_cycle_buckets_tile_the_range);
+  RUN_TEST(test_cycle_bucket_of_sample_counts);
+  RUN_TEST(test_cycle_percentiles);
+  RUN_TEST(test_cycle_percentile_within_min_and_max);
+  return UNITY_END();
+}
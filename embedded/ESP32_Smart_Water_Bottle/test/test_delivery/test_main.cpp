@@ -0,0 +1,410 @@
+#include <unity.h>
+#include <FrameBatcher.h>
+#include <ReliableLink.h>
+
+const uint32_t MAX_DELAY_MS = 20;
+// Each drink event goes out in a notification of its own
+const uint16_t ONE_EVENT_MTU = WATER_FRAME_MAX_SIZE + 3;
+const uint32_t PROBE_MS = 2000;
+
+// Loopback central that can also refuse notifications, like a link
+// whose buffers are full
+class RefusingSink : public LoopbackFrameSink {
+public:
+  bool sendNotification(const uint8_t* data, size_t length) override {
+    if (refuse) return false;
+    lastLength = length;
+    return LoopbackFrameSink::sendNotification(data, length);
+  }
+
+  bool refuse = false;
+  size_t lastLength = 0;
+};
+
+// Central on a lossy link: loses notifications at random with a 1 in
+// lossOneIn chance, drops duplicates and acknowledges the highest sequence
+// received without gaps. A HELLO with another journal epoch starts over.
+class LossyCentral : public FrameSink {
+public:
+  bool sendNotification(const uint8_t* data, size_t length) override {
+    notifications++;
+    // xorshift32, the same losses on every run
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    if (lossOneIn > 0 && random % lossOneIn == 0) {
+      lost++;
+      return true;
+    }
+
+    size_t offset = 0;
+    WaterFrame frame;
+    while (offset < length) {
+      size_t consumed = decodeWaterFrame(data + offset, length - offset, frame);
+      if (consumed == 0) return true;
+      offset += consumed;
+      if (frame.type == FRAME_HELLO) {
+        if (frame.sequence != epoch) delivered = 0;
+        epoch = frame.sequence;
+        continue;
+      }
+      if (frame.type == FRAME_CREDIT_PROBE) {
+        probes++;
+        continue;
+      }
+      if (frame.sequence == delivered + 1) {
+        delivered++;
+        amountSum += frame.value;
+      } else {
+        duplicatesOrGaps++;
+      }
+    }
+    return true;
+  }
+
+  uint32_t lossOneIn = 0;
+  uint32_t random = 1;
+  uint32_t notifications = 0;
+  uint32_t lost = 0;
+  uint32_t delivered = 0;
+  uint32_t amountSum = 0;
+  uint32_t duplicatesOrGaps = 0;
+  uint32_t epoch = 0;
+  uint32_t probes = 0;
+};
+
+static WaterFrame drinkEvent(uint32_t sequence) {
+  WaterFrame frame = { FRAME_DRINK_EVENT, sequence, 1751356800000ULL + sequence, (uint16_t)(sequence % 500),
+                       3000 + sequence, 6000, 4500 };
+  return frame;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_smallest_mtu_sends_one_event_per_notification() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  TEST_ASSERT_EQUAL_size_t(BATCH_DEFAULT_PAYLOAD, batcher.payloadCapacity());
+
+  // A 24 byte event never fits the default MTU
+  TEST_ASSERT_FALSE(batcher.add(drinkEvent(1), 0));
+  TEST_ASSERT_TRUE(batcher.flush());
+  TEST_ASSERT_EQUAL_UINT32(0, sink.receivedNotifications);
+
+  // With room for exactly one it goes out at once
+  batcher.setMtu(ONE_EVENT_MTU);
+  TEST_ASSERT_EQUAL_size_t(WATER_FRAME_MAX_SIZE, batcher.payloadCapacity());
+  for (uint32_t sequence = 1; sequence <= 3; sequence++) TEST_ASSERT_TRUE(batcher.add(drinkEvent(sequence), 0));
+  TEST_ASSERT_EQUAL_UINT32(3, sink.receivedNotifications);
+  TEST_ASSERT_EQUAL_UINT32(3, sink.receivedFrames);
+  TEST_ASSERT_EQUAL_UINT32(0, sink.decodeErrors);
+}
+
+void test_large_mtu_packs_full_notifications() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(247);
+  TEST_ASSERT_EQUAL_size_t(244, batcher.payloadCapacity());
+
+  for (uint32_t sequence = 1; sequence <= 30; sequence++) TEST_ASSERT_TRUE(batcher.add(drinkEvent(sequence), 0));
+  TEST_ASSERT_EQUAL_UINT32(3, sink.receivedNotifications);
+  TEST_ASSERT_EQUAL_size_t(10 * 24, sink.lastLength);
+  TEST_ASSERT_EQUAL_UINT32(30, sink.receivedFrames);
+  TEST_ASSERT_EQUAL_UINT32(30, sink.lastFrame.sequence);
+  TEST_ASSERT_EQUAL_UINT32(3030, sink.lastFrame.durationMs);
+  TEST_ASSERT_EQUAL_UINT32(30, batcher.stats().frames);
+  TEST_ASSERT_EQUAL_UINT32(3, batcher.stats().notifications);
+  TEST_ASSERT_EQUAL_UINT32(30 * 24, batcher.stats().bytes);
+}
+
+void test_partial_batch_waits_for_the_deadline() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(185);
+
+  batcher.add(drinkEvent(1), 100);
+  batcher.add(drinkEvent(2), 110);
+  batcher.poll(119);
+  TEST_ASSERT_EQUAL_UINT32(0, sink.receivedNotifications);
+
+  // The deadline counts from the oldest frame
+  batcher.poll(120);
+  TEST_ASSERT_EQUAL_UINT32(1, sink.receivedNotifications);
+  TEST_ASSERT_EQUAL_UINT32(2, sink.receivedFrames);
+}
+
+void test_mtu_limits() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(517);
+  TEST_ASSERT_EQUAL_size_t(BATCH_MAX_PAYLOAD, batcher.payloadCapacity());
+  batcher.setMtu(10);
+  TEST_ASSERT_EQUAL_size_t(BATCH_DEFAULT_PAYLOAD, batcher.payloadCapacity());
+}
+
+void test_smaller_mtu_flushes_what_no_longer_fits() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(247);
+  for (uint32_t sequence = 1; sequence <= 4; sequence++) batcher.add(drinkEvent(sequence), 0);
+  TEST_ASSERT_EQUAL_UINT32(0, sink.receivedNotifications);
+
+  batcher.setMtu(23);
+  TEST_ASSERT_EQUAL_UINT32(1, sink.receivedNotifications);
+  TEST_ASSERT_EQUAL_UINT32(4, sink.receivedFrames);
+}
+
+void test_refused_notification_keeps_the_frames() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(75);  // Three events per notification
+
+  sink.refuse = true;
+  TEST_ASSERT_TRUE(batcher.add(drinkEvent(1), 0));
+  TEST_ASSERT_TRUE(batcher.add(drinkEvent(2), 0));
+  TEST_ASSERT_TRUE(batcher.add(drinkEvent(3), 0));
+  TEST_ASSERT_FALSE(batcher.add(drinkEvent(4), 0));
+  TEST_ASSERT_FALSE(batcher.flush());
+
+  sink.refuse = false;
+  TEST_ASSERT_TRUE(batcher.flush());
+  TEST_ASSERT_EQUAL_UINT32(3, sink.receivedFrames);
+  TEST_ASSERT_EQUAL_UINT32(3, sink.lastFrame.sequence);
+}
+
+void test_clear_drops_buffered_frames() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(185);
+  batcher.add(drinkEvent(1), 0);
+  batcher.clear();
+  batcher.poll(1000);
+  TEST_ASSERT_TRUE(batcher.flush());
+  TEST_ASSERT_EQUAL_UINT32(0, sink.receivedNotifications);
+}
+
+void test_mixed_frame_sizes_decode() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(185);
+  WaterFrame reminder = { FRAME_REMINDER, 1, 0, 2, 0, 0, 0 };
+  WaterFrame hello = { FRAME_HELLO, 2, 0, 0, 0, 0, 0 };
+  batcher.add(reminder, 0);
+  batcher.add(hello, 0);
+  batcher.add(drinkEvent(3), 0);
+  TEST_ASSERT_TRUE(batcher.flush());
+  TEST_ASSERT_EQUAL_size_t(15 + 14 + 24, sink.lastLength);
+  TEST_ASSERT_EQUAL_UINT32(3, sink.receivedFrames);
+  TEST_ASSERT_EQUAL_UINT32(0, sink.decodeErrors);
+}
+
+void test_credits_limit_events_in_flight() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(ONE_EVENT_MTU);
+  ReliableLink link(batcher, 1000, 4, PROBE_MS);
+
+  for (uint32_t sequence = 1; sequence <= 4; sequence++) TEST_ASSERT_TRUE(link.send(drinkEvent(sequence), 0));
+  TEST_ASSERT_FALSE(link.canSend());
+  TEST_ASSERT_FALSE(link.send(drinkEvent(5), 0));
+  TEST_ASSERT_EQUAL_size_t(4, link.inFlight());
+
+  // A cumulative ack frees the window up to its sequence and grants new credits
+  link.onAck(3, 8);
+  TEST_ASSERT_EQUAL_UINT32(3, link.ackedSequence());
+  TEST_ASSERT_EQUAL_size_t(1, link.inFlight());
+  TEST_ASSERT_EQUAL_UINT16(8, link.availableCredits());
+  TEST_ASSERT_TRUE(link.canSend());
+
+  // Credits 0 pauses sending even with nothing in flight
+  link.onAck(4, 0);
+  TEST_ASSERT_EQUAL_size_t(0, link.inFlight());
+  TEST_ASSERT_FALSE(link.canSend());
+}
+
+void test_stale_ack_is_counted_and_ignored() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(ONE_EVENT_MTU);
+  ReliableLink link(batcher, 1000, 16, PROBE_MS);
+  for (uint32_t sequence = 1; sequence <= 3; sequence++) link.send(drinkEvent(sequence), 0);
+
+  link.onAck(2, 16);
+  // Its credits are as old as the ack itself
+  link.onAck(1, 0);
+  TEST_ASSERT_EQUAL_UINT32(2, link.ackedSequence());
+  TEST_ASSERT_EQUAL_UINT16(16, link.availableCredits());
+  TEST_ASSERT_EQUAL_size_t(1, link.inFlight());
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().acks);
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().staleAcks);
+
+  // The current ack again only updates the credits
+  link.onAck(2, 4);
+  TEST_ASSERT_EQUAL_UINT16(4, link.availableCredits());
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().acks);
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().staleAcks);
+}
+
+void test_ack_above_the_last_event_is_ignored() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(ONE_EVENT_MTU);
+  ReliableLink link(batcher, 1000, 16, PROBE_MS);
+  // Event 12 may have reached the central before the reconnect
+  link.reset(10, 12);
+  link.send(drinkEvent(11), 0);
+
+  link.onAck(13, 0);
+  TEST_ASSERT_EQUAL_UINT32(10, link.ackedSequence());
+  TEST_ASSERT_EQUAL_UINT16(16, link.availableCredits());
+  TEST_ASSERT_EQUAL_size_t(1, link.inFlight());
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().invalidAcks);
+
+  link.onAck(12, 16);
+  TEST_ASSERT_EQUAL_UINT32(12, link.ackedSequence());
+  TEST_ASSERT_EQUAL_size_t(0, link.inFlight());
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().invalidAcks);
+}
+
+void test_zero_credits_are_probed_until_a_grant() {
+  LossyCentral central;
+  FrameBatcher batcher(central, MAX_DELAY_MS);
+  batcher.setMtu(ONE_EVENT_MTU);
+  ReliableLink link(batcher, 1000, 16, PROBE_MS);
+  link.send(drinkEvent(1), 0);
+  link.onAck(1, 0);
+
+  // The wait starts with the first poll after the grant
+  link.poll(100);
+  link.poll(100 + PROBE_MS - 1);
+  TEST_ASSERT_EQUAL_UINT32(0, central.probes);
+  link.poll(100 + PROBE_MS);
+  TEST_ASSERT_EQUAL_UINT32(1, central.probes);
+
+  // Without an answer the probe is repeated
+  link.poll(100 + 2 * PROBE_MS);
+  TEST_ASSERT_EQUAL_UINT32(2, central.probes);
+
+  link.onAck(1, 8);
+  TEST_ASSERT_TRUE(link.canSend());
+  link.poll(100 + 5 * PROBE_MS);
+  TEST_ASSERT_EQUAL_UINT32(2, central.probes);
+  TEST_ASSERT_EQUAL_UINT32(2, link.stats().creditProbes);
+}
+
+void test_new_journal_epoch_is_not_deduplicated() {
+  LossyCentral central;
+  FrameBatcher batcher(central, MAX_DELAY_MS);
+  batcher.setMtu(ONE_EVENT_MTU);
+  ReliableLink link(batcher, 1000, 16, PROBE_MS);
+  WaterFrame hello = { FRAME_HELLO, 0x1111, 0, 0, 0, 0, 0 };
+  batcher.add(hello, 0);
+  for (uint32_t sequence = 1; sequence <= 3; sequence++) link.send(drinkEvent(sequence), 0);
+  link.onAck(central.delivered, 16);
+  TEST_ASSERT_EQUAL_UINT32(3, link.ackedSequence());
+
+  // Same journal after a reconnect: a repeated event is a duplicate
+  link.reset(2, 3);
+  batcher.add(hello, 1000);
+  link.send(drinkEvent(3), 1000);
+  TEST_ASSERT_EQUAL_UINT32(1, central.duplicatesOrGaps);
+
+  // The journal was erased and counts from 1 again under a new epoch
+  link.reset(0, 0);
+  hello.sequence = 0x2222;
+  batcher.add(hello, 2000);
+  for (uint32_t sequence = 1; sequence <= 2; sequence++) link.send(drinkEvent(sequence), 2000);
+  TEST_ASSERT_EQUAL_UINT32(2, central.delivered);
+  TEST_ASSERT_EQUAL_UINT32(1, central.duplicatesOrGaps);
+  TEST_ASSERT_EQUAL_UINT32(1 + 2 + 3 + 1 + 2, central.amountSum);
+  link.onAck(central.delivered, 16);
+  TEST_ASSERT_EQUAL_UINT32(2, link.ackedSequence());
+}
+
+void test_lost_notification_is_retransmitted_after_the_timeout() {
+  LossyCentral central;
+  FrameBatcher batcher(central, MAX_DELAY_MS);
+  batcher.setMtu(ONE_EVENT_MTU);
+  ReliableLink link(batcher, 1000, 16, PROBE_MS);
+  central.lossOneIn = 1;  // The first transmission is lost
+
+  TEST_ASSERT_TRUE(link.send(drinkEvent(1), 0));
+  link.poll(999);
+  TEST_ASSERT_EQUAL_UINT32(0, link.stats().retransmitted);
+
+  central.lossOneIn = 0;
+  link.poll(1000);
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().retransmitted);
+  TEST_ASSERT_EQUAL_UINT32(1, central.delivered);
+
+  link.onAck(central.delivered, 16);
+  TEST_ASSERT_EQUAL_size_t(0, link.inFlight());
+  link.poll(5000);
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().retransmitted);
+}
+
+void test_every_event_arrives_once_over_a_lossy_link() {
+  const uint32_t EVENTS = 500;
+  LossyCentral central;
+  FrameBatcher batcher(central, MAX_DELAY_MS);
+  batcher.setMtu(123);  // Five events per notification
+  ReliableLink link(batcher, 1000, 16, PROBE_MS);
+  central.lossOneIn = 3;
+
+  uint32_t nextEvent = 1;
+  uint32_t expectedSum = 0;
+  for (uint32_t now = 0; now < 600000 && central.delivered < EVENTS; now += 10) {
+    while (nextEvent <= EVENTS && link.canSend()) {
+      WaterFrame frame = drinkEvent(nextEvent++);
+      expectedSum += frame.value;
+      link.send(frame, now);
+    }
+    link.poll(now);
+    // The app acknowledges every 50 ms
+    if (now % 50 == 0) link.onAck(central.delivered, 16);
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(EVENTS, central.delivered);
+  TEST_ASSERT_EQUAL_UINT32(expectedSum, central.amountSum);
+  TEST_ASSERT_GREATER_THAN(0, central.lost);
+  TEST_ASSERT_GREATER_THAN(0, link.stats().retransmitted);
+  TEST_ASSERT_GREATER_THAN(0, central.duplicatesOrGaps);
+}
+
+void test_reset_forgets_the_window() {
+  RefusingSink sink;
+  FrameBatcher batcher(sink, MAX_DELAY_MS);
+  batcher.setMtu(ONE_EVENT_MTU);
+  ReliableLink link(batcher, 1000, 16, PROBE_MS);
+  for (uint32_t sequence = 1; sequence <= 5; sequence++) link.send(drinkEvent(sequence), 0);
+
+  link.reset(2, 5);
+  TEST_ASSERT_EQUAL_size_t(0, link.inFlight());
+  TEST_ASSERT_EQUAL_UINT32(2, link.ackedSequence());
+  TEST_ASSERT_EQUAL_UINT16(16, link.availableCredits());
+  uint32_t sent = sink.receivedFrames;
+  link.poll(10000);
+  TEST_ASSERT_EQUAL_UINT32(sent, sink.receivedFrames);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_smallest_mtu_sends_one_event_per_notification);
+  RUN_TEST(test_large_mtu_packs_full_notifications);
+  RUN_TEST(test_partial_batch_waits_for_the_deadline);
+  RUN_TEST(test_mtu_limits);
+  RUN_TEST(test_smaller_mtu_flushes_what_no_longer_fits);
+  RUN_TEST(test_refused_notification_keeps_the_frames);
+  RUN_TEST(test_clear_drops_buffered_frames);
+  RUN_TEST(test_mixed_frame_sizes_decode);
+  RUN_TEST(test_credits_limit_events_in_flight);
+  RUN_TEST(test_stale_ack_is_counted_and_ignored);
+  RUN_TEST(test_ack_above_the_last_event_is_ignored);
+  RUN_TEST(test_zero_credits_are_probed_until_a_grant);
+  RUN_TEST(test_new_journal_epoch_is_not_deduplicated);
+  RUN_TEST(test_lost_notification_is_retransmitted_after_the_timeout);
+  RUN_TEST(test_every_event_arrives_once_over_a_lossy_link);
+  RUN_TEST(test_reset_forgets_the_window);
+  return UNITY_END();
+}
@@ -0,0 +1,533 @@
+#include <unity.h>
+#include <string.h>
+#include <DirtyRenderer.h>
+#include <RoundClip.h>
+#include <ProgressRing.h>
+#include <DisplayPower.h>
+#include <VolumeFormat.h>
+
+// The stand-in TFT_eSPI counts what the driver would push: every address
+// window costs TFT_WINDOW_OVERHEAD_BYTES plus 2 bytes per pixel. Text at
+// size 1 with a background goes out as one 6x8 window per character.
+const uint32_t CHAR_BYTES = TFT_WINDOW_OVERHEAD_BYTES + 6 * 8 * 2;
+const uint32_t FULL_SCREEN_BYTES = TFT_WINDOW_OVERHEAD_BYTES + TFT_WIDTH * TFT_HEIGHT * 2;
+
+// Rows around the center are visible across the whole text width, so
+// round clipping does not change these counts
+const int16_t CENTER_X = TFT_WIDTH / 2;
+const int16_t ROW_Y = 116;
+
+static TFT_eSPI tft;
+
+void setUp() {
+  tft.resetCounters();
+}
+
+void tearDown() {
+  setRoundClip(true);
+}
+
+void test_first_draw_pushes_only_the_text() {
+  TextElement element;
+  initElement(element, CENTER_X, ROW_Y, 1);
+  setElementText(element, "1200 ml", TFT_WHITE);
+  TEST_ASSERT_TRUE(element.dirty);
+
+  renderElements(tft, &element, 1, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32(7 * CHAR_BYTES, tft.bytesPushed);
+  TEST_ASSERT_EQUAL_UINT32(7, tft.addressWindows);
+  TEST_ASSERT_FALSE(element.dirty);
+  TEST_ASSERT_EQUAL_INT(CENTER_X - 21, element.painted.x);
+  TEST_ASSERT_EQUAL_INT(42, element.painted.w);
+}
+
+void test_unchanged_text_pushes_nothing() {
+  TextElement element;
+  initElement(element, CENTER_X, ROW_Y, 1);
+  setElementText(element, "1200 ml", TFT_WHITE);
+  renderElements(tft, &element, 1, TFT_BLACK);
+  tft.resetCounters();
+
+  setElementText(element, "1200 ml", TFT_WHITE);
+  TEST_ASSERT_FALSE(element.dirty);
+  renderElements(tft, &element, 1, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32(0, tft.bytesPushed);
+
+  // A new color alone repaints the text
+  setElementText(element, "1200 ml", TFT_RED);
+  TEST_ASSERT_TRUE(element.dirty);
+}
+
+void test_shorter_text_clears_only_the_side_strips() {
+  TextElement element;
+  initElement(element, CENTER_X, ROW_Y, 1);
+  setElementText(element, "1200 ml", TFT_WHITE);
+  renderElements(tft, &element, 1, TFT_BLACK);
+  tft.resetCounters();
+
+  // 42 px wide before, 36 px now: a 3 px strip on each side is cleared
+  setElementText(element, "950 ml", TFT_WHITE);
+  renderElements(tft, &element, 1, TFT_BLACK);
+  const uint32_t stripBytes = TFT_WINDOW_OVERHEAD_BYTES + 3 * 8 * 2;
+  TEST_ASSERT_EQUAL_UINT32(2 * stripBytes + 6 * CHAR_BYTES, tft.bytesPushed);
+  TEST_ASSERT_LESS_THAN(FULL_SCREEN_BYTES / 100, tft.bytesPushed);
+}
+
+void test_emptied_text_clears_its_box() {
+  TextElement element;
+  initElement(element, CENTER_X, ROW_Y, 1);
+  setElementText(element, "1200 ml", TFT_WHITE);
+  renderElements(tft, &element, 1, TFT_BLACK);
+  tft.resetCounters();
+
+  setElementText(element, "", TFT_WHITE);
+  renderElements(tft, &element, 1, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32(TFT_WINDOW_OVERHEAD_BYTES + 42 * 8 * 2, tft.bytesPushed);
+  TEST_ASSERT_EQUAL_INT(0, element.painted.w);
+}
+
+void test_only_dirty_elements_are_repainted() {
+  TextElement elements[3];
+  initElement(elements[0], CENTER_X, ROW_Y - 20, 1);
+  initElement(elements[1], CENTER_X, ROW_Y, 1);
+  initElement(elements[2], CENTER_X, ROW_Y + 20, 1);
+  setElementText(elements[0], "Goal", TFT_WHITE);
+  setElementText(elements[1], "1200 ml", TFT_WHITE);
+  setElementText(elements[2], "Synced", TFT_GREEN);
+  renderElements(tft, elements, 3, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32((4 + 7 + 6) * CHAR_BYTES, tft.bytesPushed);
+  tft.resetCounters();
+
+  setElementText(elements[1], "1250 ml", TFT_WHITE);
+  renderElements(tft, elements, 3, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32(7 * CHAR_BYTES, tft.bytesPushed);
+}
+
+void test_cleared_strip_redraws_an_overlapping_element() {
+  // Two lines 4 px apart overlap; clearing the wide one hits the narrow one
+  TextElement elements[2];
+  initElement(elements[0], CENTER_X, ROW_Y, 1);
+  initElement(elements[1], CENTER_X, ROW_Y + 4, 1);
+  setElementText(elements[0], "1200 ml", TFT_WHITE);
+  setElementText(elements[1], "ok", TFT_WHITE);
+  renderElements(tft, elements, 2, TFT_BLACK);
+  tft.resetCounters();
+
+  setElementText(elements[0], "", TFT_WHITE);
+  renderElements(tft, elements, 2, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32(TFT_WINDOW_OVERHEAD_BYTES + 42 * 8 * 2 + 2 * CHAR_BYTES, tft.bytesPushed);
+}
+
+void test_dirty_area_covers_old_and_new_boxes() {
+  TextElement elements[2];
+  initElement(elements[0], CENTER_X, ROW_Y, 1);
+  initElement(elements[1], CENTER_X, ROW_Y + 20, 2);
+  ElementBox area;
+  TEST_ASSERT_FALSE(dirtyArea(elements, 2, area));
+
+  setElementText(elements[0], "1200 ml", TFT_WHITE);
+  commitElements(elements, 2);
+  setElementText(elements[0], "5 ml", TFT_WHITE);
+  setElementText(elements[1], "ok", TFT_WHITE);
+  TEST_ASSERT_TRUE(dirtyArea(elements, 2, area));
+
+  // The old 42 px box and the 24x16 box of the size 2 text below it
+  TEST_ASSERT_EQUAL_INT(CENTER_X - 21, area.x);
+  TEST_ASSERT_EQUAL_INT(ROW_Y, area.y);
+  TEST_ASSERT_EQUAL_INT(42, area.w);
+  TEST_ASSERT_EQUAL_INT(20 + 16, area.h);
+}
+
+void test_invalidate_repaints_everything_with_text() {
+  TextElement elements[2];
+  initElement(elements[0], CENTER_X, ROW_Y, 1);
+  initElement(elements[1], CENTER_X, ROW_Y + 20, 1);
+  setElementText(elements[0], "1200 ml", TFT_WHITE);
+  renderElements(tft, elements, 2, TFT_BLACK);
+  tft.resetCounters();
+
+  // After a full screen fill nothing is left to clear, only text to draw
+  invalidateElements(elements, 2);
+  TEST_ASSERT_TRUE(elements[0].dirty);
+  TEST_ASSERT_FALSE(elements[1].dirty);
+  renderElements(tft, elements, 2, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32(7 * CHAR_BYTES, tft.bytesPushed);
+}
+
+static uint32_t visiblePixels() {
+  uint32_t pixels = 0;
+  for (int16_t y = 0; y < TFT_HEIGHT; y++) {
+    int16_t x0, w;
+    visibleSpan(y, x0, w);
+    pixels += w;
+  }
+  return pixels;
+}
+
+void test_visible_spans_follow_the_circle() {
+  int16_t x0, w;
+  visibleSpan(0, x0, w);
+  TEST_ASSERT_EQUAL_INT(109, x0);
+  TEST_ASSERT_EQUAL_INT(22, w);
+  visibleSpan(TFT_HEIGHT / 2, x0, w);
+  TEST_ASSERT_EQUAL_INT(0, x0);
+  TEST_ASSERT_EQUAL_INT(TFT_WIDTH, w);
+  visibleSpan(-1, x0, w);
+  TEST_ASSERT_EQUAL_INT(0, w);
+  visibleSpan(TFT_HEIGHT, x0, w);
+  TEST_ASSERT_EQUAL_INT(0, w);
+
+  for (int16_t y = 0; y < TFT_HEIGHT / 2; y++) {
+    int16_t mirrorX0, mirrorW;
+    visibleSpan(y, x0, w);
+    visibleSpan(TFT_HEIGHT - 1 - y, mirrorX0, mirrorW);
+    TEST_ASSERT_EQUAL_INT(w, mirrorW);
+    TEST_ASSERT_EQUAL_INT(TFT_WIDTH, 2 * x0 + w);
+  }
+
+  // Within 0.5% of pi/4 of the square
+  TEST_ASSERT_UINT32_WITHIN(TFT_WIDTH * TFT_HEIGHT / 200, 45239, visiblePixels());
+}
+
+void test_bands_cover_exactly_the_visible_pixels() {
+  const ElementBox rects[] = {
+    { 0, 0, TFT_WIDTH, TFT_HEIGHT },
+    { 0, 0, 60, 60 },
+    { 150, 170, 90, 70 },
+    { 100, 110, 40, 20 },
+  };
+  static uint8_t covered[TFT_HEIGHT][TFT_WIDTH];
+  for (size_t r = 0; r < sizeof(rects) / sizeof(rects[0]); r++) {
+    const ElementBox& rect = rects[r];
+    memset(covered, 0, sizeof(covered));
+
+    ElementBox band;
+    int16_t row = rect.y;
+    while (nextClipBand(rect, row, rect.h, band)) {
+      for (int16_t y = band.y; y < band.y + band.h; y++) {
+        for (int16_t x = band.x; x < band.x + band.w; x++) {
+          TEST_ASSERT_TRUE(x >= rect.x && x < rect.x + rect.w && y >= rect.y && y < rect.y + rect.h);
+          covered[y][x]++;
+        }
+      }
+    }
+
+    for (int16_t y = rect.y; y < rect.y + rect.h; y++) {
+      int16_t x0, w;
+      visibleSpan(y, x0, w);
+      for (int16_t x = rect.x; x < rect.x + rect.w; x++) {
+        bool visible = x >= x0 && x < x0 + w;
+        if (visible) TEST_ASSERT_EQUAL_UINT8(1, covered[y][x]);
+        TEST_ASSERT_TRUE(covered[y][x] <= 1);
+      }
+    }
+  }
+}
+
+void test_clipped_full_screen_fill_bytes() {
+  ElementBox screen = { 0, 0, TFT_WIDTH, TFT_HEIGHT };
+  setRoundClip(false);
+  fillClipped(tft, screen, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32(FULL_SCREEN_BYTES, tft.bytesPushed);
+
+  tft.resetCounters();
+  setRoundClip(true);
+  fillClipped(tft, screen, TFT_BLACK);
+  uint32_t visible = visiblePixels();
+  // Every visible pixel once, the merged bands add a few corner pixels
+  TEST_ASSERT_GREATER_OR_EQUAL(visible, tft.pixelsPushed);
+  TEST_ASSERT_LESS_THAN(visible + visible / 50, tft.pixelsPushed);
+  TEST_ASSERT_LESS_THAN(FULL_SCREEN_BYTES * 81 / 100, tft.bytesPushed);
+  TEST_ASSERT_EQUAL_UINT32(tft.addressWindows * TFT_WINDOW_OVERHEAD_BYTES + tft.pixelsPushed * 2, tft.bytesPushed);
+}
+
+void test_corner_fill_pushes_nothing() {
+  ElementBox corner = { 0, 0, 30, 30 };
+  fillClipped(tft, corner, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32(0, tft.bytesPushed);
+  TEST_ASSERT_EQUAL_UINT32(0, tft.addressWindows);
+}
+
+void test_center_fill_is_one_window() {
+  ElementBox center = { 80, 100, 80, 40 };
+  fillClipped(tft, center, TFT_BLACK);
+  TEST_ASSERT_EQUAL_UINT32(1, tft.addressWindows);
+  TEST_ASSERT_EQUAL_UINT32(TFT_WINDOW_OVERHEAD_BYTES + 80 * 40 * 2, tft.bytesPushed);
+}
+
+// Runs ring updates until it has caught up, returns the number of frames
+static int animateRing(ProgressRing& ring) {
+  int frames = 0;
+  ElementBox changed;
+  while (ring.needsUpdate() && frames < 100) {
+    TEST_ASSERT_TRUE(ring.update(tft, TFT_BLUE, TFT_DARKGREY, TFT_BLACK, changed));
+    TEST_ASSERT_GREATER_THAN(0, changed.w);
+    frames++;
+  }
+  return frames;
+}
+
+static void beginRing(ProgressRing& ring) {
+  ring.begin(TFT_WIDTH / 2, TFT_HEIGHT / 2, 119, 6);
+}
+
+void test_ring_steps_from_intake_and_goal() {
+  ProgressRing ring;
+  beginRing(ring);
+  ring.setVisible(true);
+  ring.setProgress(1000, 4000);
+  // 90 steps, RING_ANIMATION_STEPS per frame
+  TEST_ASSERT_EQUAL_INT(8, animateRing(ring));
+
+  // Without a goal, or with nothing drunk, the ring is empty
+  ring.setProgress(500, 0);
+  TEST_ASSERT_TRUE(ring.needsUpdate());
+  ring.setProgress(1000, 4000);
+  TEST_ASSERT_FALSE(ring.needsUpdate());
+}
+
+void test_ring_first_show_paints_track_and_fill() {
+  ProgressRing ring;
+  beginRing(ring);
+  ring.setProgress(1200, 4000);  // 108 steps
+  TEST_ASSERT_FALSE(ring.needsUpdate());
+
+  ring.setVisible(true);
+  TEST_ASSERT_EQUAL_INT(9, animateRing(ring));
+  TEST_ASSERT_FALSE(ring.needsUpdate());
+
+  // Nothing left to draw
+  ElementBox changed;
+  tft.resetCounters();
+  TEST_ASSERT_FALSE(ring.update(tft, TFT_BLUE, TFT_DARKGREY, TFT_BLACK, changed));
+  TEST_ASSERT_EQUAL_UINT32(0, tft.bytesPushed);
+  TEST_ASSERT_EQUAL_INT(0, changed.w);
+}
+
+void test_ring_change_only_draws_the_difference() {
+  ProgressRing full;
+  beginRing(full);
+  full.setVisible(true);
+  animateRing(full);
+  uint32_t fullRingBytes = tft.bytesPushed;
+
+  ProgressRing ring;
+  beginRing(ring);
+  ring.setProgress(1200, 4000);
+  ring.setVisible(true);
+  animateRing(ring);
+
+  // +250 ml of 4 L: 22 segments in two frames
+  tft.resetCounters();
+  ring.setProgress(1450, 4000);
+  TEST_ASSERT_EQUAL_INT(2, animateRing(ring));
+  TEST_ASSERT_LESS_THAN(fullRingBytes / 10, tft.bytesPushed);
+
+  // -450 ml: 40 segments back to the track color in four frames
+  tft.resetCounters();
+  ring.setProgress(1000, 4000);
+  TEST_ASSERT_EQUAL_INT(4, animateRing(ring));
+  TEST_ASSERT_LESS_THAN(fullRingBytes / 5, tft.bytesPushed);
+}
+
+void test_ring_first_segment_box() {
+  ProgressRing ring;
+  beginRing(ring);
+  ring.setVisible(true);
+  ring.setProgress(1, 360 * 4);
+  ElementBox changed;
+  ring.update(tft, TFT_BLUE, TFT_DARKGREY, TFT_BLACK, changed);
+
+  // Going over to the fill only touches the segment at 12 o'clock
+  ring.setProgress(4, 360 * 4);
+  ring.update(tft, TFT_BLUE, TFT_DARKGREY, TFT_BLACK, changed);
+  TEST_ASSERT_GREATER_OR_EQUAL(TFT_WIDTH / 2 - 1, changed.x);
+  TEST_ASSERT_LESS_OR_EQUAL(TFT_WIDTH / 2 + 3, changed.x + changed.w);
+  TEST_ASSERT_EQUAL_INT(TFT_HEIGHT / 2 - 119, changed.y);
+  TEST_ASSERT_LESS_OR_EQUAL(8, changed.h);
+}
+
+void test_hidden_ring_is_erased_once() {
+  ProgressRing ring;
+  beginRing(ring);
+  ring.setProgress(2000, 4000);
+  ring.setVisible(true);
+  animateRing(ring);
+
+  ring.setVisible(false);
+  TEST_ASSERT_EQUAL_INT(1, animateRing(ring));
+  TEST_ASSERT_FALSE(ring.needsUpdate());
+
+  // Showing it again repaints track and fill
+  ring.setVisible(true);
+  TEST_ASSERT_EQUAL_INT(15, animateRing(ring));
+}
+
+static const DisplayPowerConfig POWER_CONFIG = { 15000, 30000, 255, 40 };
+
+void test_power_dims_then_sleeps_without_a_wake() {
+  DisplayPowerPolicy policy(POWER_CONFIG);
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ON, policy.update(0));
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ON, policy.update(14999));
+  TEST_ASSERT_EQUAL_INT(DISPLAY_DIM, policy.update(15000));
+  TEST_ASSERT_EQUAL_INT(DISPLAY_DIM, policy.update(29999));
+  TEST_ASSERT_EQUAL_INT(DISPLAY_SLEEP, policy.update(30000));
+  TEST_ASSERT_EQUAL_INT(DISPLAY_SLEEP, policy.update(100000));
+  TEST_ASSERT_EQUAL_INT(DISPLAY_SLEEP, policy.state());
+}
+
+void test_power_wake_returns_to_on() {
+  DisplayPowerPolicy policy(POWER_CONFIG);
+  policy.update(20000);
+  policy.wake(20000);
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ON, policy.state());
+  TEST_ASSERT_EQUAL_INT(DISPLAY_DIM, policy.update(35000));
+
+  policy.update(60000);
+  TEST_ASSERT_EQUAL_INT(DISPLAY_SLEEP, policy.state());
+  policy.wake(61000);
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ON, policy.state());
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ON, policy.update(75999));
+}
+
+// Time is charged to the state the policy was in since the previous update
+void test_power_time_in_state() {
+  DisplayPowerPolicy policy(POWER_CONFIG);
+  for (uint32_t now = 0; now <= 40000; now += 100) policy.update(now);
+  TEST_ASSERT_EQUAL_UINT32(15000, policy.stateMs(DISPLAY_ON));
+  TEST_ASSERT_EQUAL_UINT32(15000, policy.stateMs(DISPLAY_DIM));
+  TEST_ASSERT_EQUAL_UINT32(10000, policy.stateMs(DISPLAY_SLEEP));
+
+  policy.resetStats();
+  policy.update(41000);
+  TEST_ASSERT_EQUAL_UINT32(0, policy.stateMs(DISPLAY_ON));
+  TEST_ASSERT_EQUAL_UINT32(1000, policy.stateMs(DISPLAY_SLEEP));
+}
+
+void test_power_follows_the_millis_wrap() {
+  DisplayPowerPolicy policy(POWER_CONFIG);
+  uint32_t start = 0xFFFFFFFF - 5000;
+  policy.update(start);
+  policy.wake(start);
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ON, policy.update(start + 10000));
+  TEST_ASSERT_EQUAL_INT(DISPLAY_DIM, policy.update(start + 20000));
+  TEST_ASSERT_EQUAL_INT(DISPLAY_SLEEP, policy.update(start + 30000));
+}
+
+void test_power_wake_latency_stats() {
+  DisplayPowerPolicy policy(POWER_CONFIG);
+  TEST_ASSERT_EQUAL_UINT32(0, policy.meanWakeLatencyUs());
+  policy.recordWakeLatency(9000);
+  policy.recordWakeLatency(12000);
+  policy.recordWakeLatency(3000);
+  TEST_ASSERT_EQUAL_UINT32(3, policy.wakes());
+  TEST_ASSERT_EQUAL_UINT32(8000, policy.meanWakeLatencyUs());
+  TEST_ASSERT_EQUAL_UINT32(12000, policy.maxWakeLatencyUs());
+
+  policy.resetStats();
+  TEST_ASSERT_EQUAL_UINT32(0, policy.wakes());
+  TEST_ASSERT_EQUAL_UINT32(0, policy.maxWakeLatencyUs());
+}
+
+void test_panel_waits_120_ms_between_sleep_commands() {
+  PanelSleepGuard guard;
+  TEST_ASSERT_TRUE(guard.canSleepIn(0));
+  TEST_ASSERT_TRUE(guard.canSleepOut(0));
+  TEST_ASSERT_TRUE(guard.awake(0));
+
+  guard.sleepIn(1000);
+  TEST_ASSERT_FALSE(guard.canSleepOut(1000));
+  TEST_ASSERT_FALSE(guard.canSleepOut(1119));
+  TEST_ASSERT_TRUE(guard.canSleepOut(1120));
+
+  guard.sleepOut(1120);
+  TEST_ASSERT_FALSE(guard.awake(1124));
+  TEST_ASSERT_TRUE(guard.awake(1125));
+  TEST_ASSERT_FALSE(guard.canSleepIn(1239));
+  TEST_ASSERT_TRUE(guard.canSleepIn(1240));
+
+  // Across the millis wrap
+  guard.sleepIn(0xFFFFFFF0);
+  TEST_ASSERT_FALSE(guard.canSleepOut(0x60));
+  TEST_ASSERT_TRUE(guard.canSleepOut(0x68));
+}
+
+static void assertLiters(const char* expected, int32_t ml) {
+  char text[16];
+  size_t length = formatLiters(text, sizeof(text), ml);
+  TEST_ASSERT_EQUAL_STRING(expected, text);
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), length);
+}
+
+// Rounded to the nearest 100 ml, halves away from zero
+void test_liters_round_to_a_tenth() {
+  assertLiters("0.0 L", 0);
+  assertLiters("0.0 L", 49);
+  assertLiters("0.1 L", 50);
+  assertLiters("1.2 L", 1249);
+  assertLiters("1.3 L", 1250);
+  assertLiters("2.0 L", 1999);
+  assertLiters("10.0 L", 9950);
+  assertLiters("-0.1 L", -50);
+  assertLiters("-1.3 L", -1250);
+  // Rounds to zero without a sign
+  assertLiters("0.0 L", -49);
+  assertLiters("2147483.6 L", INT32_MAX);
+  assertLiters("-2147483.6 L", INT32_MIN);
+}
+
+void test_liters_truncate_to_the_buffer() {
+  char text[8];
+  memset(text, 'x', sizeof(text));
+  TEST_ASSERT_EQUAL_size_t(3, formatLiters(text, 4, 1250));
+  TEST_ASSERT_EQUAL_STRING("1.3", text);
+  TEST_ASSERT_EQUAL_size_t(0, formatLiters(text, 1, 1250));
+  TEST_ASSERT_EQUAL_STRING("", text);
+
+  // Nothing is written without room for the terminator
+  text[0] = 'x';
+  TEST_ASSERT_EQUAL_size_t(0, formatLiters(text, 0, 1250));
+  TEST_ASSERT_EQUAL_INT('x', text[0]);
+}
+
+void test_volume_text() {
+  char text[32];
+  TEST_ASSERT_EQUAL_size_t(13, formatVolumeText(text, sizeof(text), 1250, 4000));
+  TEST_ASSERT_EQUAL_STRING("1.3 L / 4.0 L", text);
+  TEST_ASSERT_EQUAL_size_t(8, formatVolumeText(text, 9, 1250, 4000));
+  TEST_ASSERT_EQUAL_STRING("1.3 L / ", text);
+  TEST_ASSERT_EQUAL_size_t(11, formatVolumeText(text, 12, 1250, 4000));
+  TEST_ASSERT_EQUAL_STRING("1.3 L / 4.0", text);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_draw_pushes_only_the_text);
+  RUN_TEST(test_unchanged_text_pushes_nothing);
+  RUN_TEST(test_shorter_text_clears_only_the_side_strips);
+  RUN_TEST(test_emptied_text_clears_its_box);
+  RUN_TEST(test_only_dirty_elements_are_repainted);
+  RUN_TEST(test_cleared_strip_redraws_an_overlapping_element);
+  RUN_TEST(test_dirty_area_covers_old_and_new_boxes);
+  RUN_TEST(test_invalidate_repaints_everything_with_text);
+  RUN_TEST(test_visible_spans_follow_the_circle);
+  RUN_TEST(test_bands_cover_exactly_the_visible_pixels);
+  RUN_TEST(test_clipped_full_screen_fill_bytes);
+  RUN_TEST(test_corner_fill_pushes_nothing);
+  RUN_TEST(test_center_fill_is_one_window);
+  RUN_TEST(test_ring_steps_from_intake_and_goal);
+  RUN_TEST(test_ring_first_show_paints_track_and_fill);
+  RUN_TEST(test_ring_change_only_draws_the_difference);
+  RUN_TEST(test_ring_first_segment_box);
+  RUN_TEST(test_hidden_ring_is_erased_once);
+  RUN_TEST(test_power_dims_then_sleeps_without_a_wake);
+  RUN_TEST(test_power_wake_returns_to_on);
+  RUN_TEST(test_power_time_in_state);
+  RUN_TEST(test_power_follows_the_millis_wrap);
+  RUN_TEST(test_power_wake_latency_stats);
+  RUN_TEST(test_panel_waits_120_ms_between_sleep_commands);
+  RUN_TEST(test_liters_round_to_a_tenth);
+  RUN_TEST(test_liters_truncate_to_the_buffer);
+  RUN_TEST(test_volume_text);
+  return UNITY_END();
+}
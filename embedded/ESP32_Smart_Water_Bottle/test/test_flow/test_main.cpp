@@ -0,0 +1,727 @@
+#include <unity.h>
+#include <string.h>
+#include <PulseCounter.h>
+#include <PulseFlowMeter.h>
+#include <FlowCalibration.h>
+#include <DrinkSession.h>
+#include <PulseTrace.h>
+
+const uint32_t PCNT_LIMIT = 32767;
+
+void setUp() {}
+void tearDown() {}
+
+void test_accumulator_counts_across_wraps() {
+  PulseAccumulator accumulator(PCNT_LIMIT);
+  accumulator.reset(0, 100);
+  TEST_ASSERT_EQUAL_UINT32(50, accumulator.update(0, 150));
+  TEST_ASSERT_EQUAL_UINT32(0, accumulator.update(0, 150));
+
+  // The counter wrapped and the interrupt reported it
+  TEST_ASSERT_EQUAL_UINT32(PCNT_LIMIT - 150 + 20, accumulator.update(1, 20));
+  TEST_ASSERT_EQUAL_UINT32(5, accumulator.update(1, 25));
+}
+
+void test_accumulator_adds_an_unreported_wrap() {
+  PulseAccumulator accumulator(PCNT_LIMIT);
+  accumulator.reset(3, PCNT_LIMIT - 10);
+
+  // Wrapped to 5, overflow interrupt not handled yet
+  TEST_ASSERT_EQUAL_UINT32(15, accumulator.update(3, 5));
+  // Once it is handled the total is where it was, nothing counted twice
+  TEST_ASSERT_EQUAL_UINT32(0, accumulator.update(4, 5));
+  TEST_ASSERT_EQUAL_UINT32(7, accumulator.update(4, 12));
+}
+
+void test_simulated_counter_take_clears() {
+  SimulatedPulseCounter counter(100);
+  TEST_ASSERT_EQUAL_UINT32(0, counter.take());
+  counter.addPulses(30);
+  counter.addPulses(12);
+  TEST_ASSERT_EQUAL_UINT32(42, counter.take());
+  TEST_ASSERT_EQUAL_UINT32(0, counter.take());
+}
+
+void test_simulated_counter_wraps_at_the_limit() {
+  SimulatedPulseCounter counter(100);
+  counter.addPulses(99);
+  TEST_ASSERT_EQUAL_UINT32(0, counter.wraps());
+  counter.addPulses(1);
+  TEST_ASSERT_EQUAL_UINT32(1, counter.wraps());
+  TEST_ASSERT_EQUAL_UINT32(100, counter.take());
+
+  // Several wraps in one batch are each reported
+  counter.addPulses(250);
+  TEST_ASSERT_EQUAL_UINT32(3, counter.wraps());
+  TEST_ASSERT_EQUAL_UINT32(250, counter.take());
+}
+
+void test_held_overflow_event_loses_nothing() {
+  SimulatedPulseCounter counter(100);
+  counter.addPulses(90);
+  TEST_ASSERT_EQUAL_UINT32(90, counter.take());
+
+  counter.holdOverflowEvents(true);
+  counter.addPulses(30);
+  TEST_ASSERT_EQUAL_UINT32(0, counter.wraps());
+  TEST_ASSERT_EQUAL_UINT32(30, counter.take());
+
+  counter.addPulses(5);
+  TEST_ASSERT_EQUAL_UINT32(5, counter.take());
+
+  // The late interrupt must not count the wrap a second time
+  counter.holdOverflowEvents(false);
+  TEST_ASSERT_EQUAL_UINT32(1, counter.wraps());
+  TEST_ASSERT_EQUAL_UINT32(0, counter.take());
+  counter.addPulses(7);
+  TEST_ASSERT_EQUAL_UINT32(7, counter.take());
+}
+
+void test_pulse_total_over_many_wraps() {
+  SimulatedPulseCounter counter;
+  uint64_t added = 0;
+  uint64_t taken = 0;
+  uint32_t state = 1;
+  for (int i = 0; i < 20000; i++) {
+    // xorshift32, fewer than limit pulses between two takes
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    uint32_t pulses = state % PCNT_LIMIT;
+    counter.holdOverflowEvents(i % 3 == 0);
+    counter.addPulses(pulses);
+    added += pulses;
+    taken += counter.take();
+  }
+  counter.holdOverflowEvents(false);
+  taken += counter.take();
+  TEST_ASSERT_EQUAL_UINT64(added, taken);
+}
+
+// Pulses every intervalUs from startUs, returns the time of the last one
+static uint32_t addPulses(PulseFlowMeter& meter, uint32_t startUs, uint32_t intervalUs, int count) {
+  uint32_t timeUs = startUs;
+  for (int i = 0; i < count; i++) {
+    timeUs = startUs + i * intervalUs;
+    TEST_ASSERT_TRUE(meter.addPulse(timeUs));
+  }
+  return timeUs;
+}
+
+void test_meter_rate_from_intervals() {
+  PulseFlowMeter meter;
+  TEST_ASSERT_EQUAL_UINT32(0, meter.rateMilliHz(0));
+  TEST_ASSERT_FALSE(meter.flowing(0));
+
+  // One pulse has no interval yet
+  meter.addPulse(1000);
+  TEST_ASSERT_EQUAL_UINT32(0, meter.rateMilliHz(1000));
+  TEST_ASSERT_TRUE(meter.flowing(1000));
+
+  uint32_t last = addPulses(meter, 11000, 10000, 10);
+  TEST_ASSERT_EQUAL_UINT32(100000, meter.rateMilliHz(last));
+
+  // The rate follows a change within FLOW_METER_INTERVALS pulses
+  last = addPulses(meter, last + 20000, 20000, FLOW_METER_INTERVALS);
+  TEST_ASSERT_EQUAL_UINT32(50000, meter.rateMilliHz(last));
+}
+
+void test_meter_rejects_glitches() {
+  PulseFlowMeter meter;
+  uint32_t last = addPulses(meter, 0, 10000, 6);
+  TEST_ASSERT_FALSE(meter.addPulse(last + DEFAULT_PULSE_FLOW_CONFIG.minIntervalUs - 1));
+  TEST_ASSERT_EQUAL_UINT32(1, meter.rejectedPulses());
+  TEST_ASSERT_EQUAL_UINT32(last, meter.lastPulseUs());
+  TEST_ASSERT_EQUAL_UINT32(100000, meter.rateMilliHz(last));
+
+  TEST_ASSERT_TRUE(meter.addPulse(last + DEFAULT_PULSE_FLOW_CONFIG.minIntervalUs));
+}
+
+void test_meter_detects_the_gap_after_a_pour() {
+  PulseFlowMeter meter;
+  // 10 Hz, the gap limit is four mean intervals
+  uint32_t last = addPulses(meter, 0, 100000, 8);
+  TEST_ASSERT_EQUAL_UINT32(400000, meter.gapLimitUs());
+  TEST_ASSERT_TRUE(meter.flowing(last + 400000));
+  TEST_ASSERT_FALSE(meter.flowing(last + 400001));
+
+  // While the gap grows the rate drops instead of holding 10 Hz
+  TEST_ASSERT_EQUAL_UINT32(10000, meter.rateMilliHz(last + 100000));
+  TEST_ASSERT_EQUAL_UINT32(5000, meter.rateMilliHz(last + 200000));
+
+  // A pulse after the gap starts a new run without an interval
+  meter.addPulse(last + 500000);
+  TEST_ASSERT_EQUAL_UINT32(0, meter.rateMilliHz(last + 500000));
+  TEST_ASSERT_EQUAL_UINT32(DEFAULT_PULSE_FLOW_CONFIG.maxGapUs, meter.gapLimitUs());
+}
+
+void test_meter_gap_limit_is_clamped() {
+  PulseFlowMeter fast;
+  addPulses(fast, 0, 5000, 8);
+  TEST_ASSERT_EQUAL_UINT32(DEFAULT_PULSE_FLOW_CONFIG.minGapUs, fast.gapLimitUs());
+
+  PulseFlowMeter slow;
+  addPulses(slow, 0, 400000, 3);
+  TEST_ASSERT_EQUAL_UINT32(DEFAULT_PULSE_FLOW_CONFIG.maxGapUs, slow.gapLimitUs());
+}
+
+void test_meter_across_the_clock_wrap() {
+  PulseFlowMeter meter;
+  uint32_t last = addPulses(meter, UINT32_MAX - 25000, 10000, 6);
+  TEST_ASSERT_TRUE(last < 100000);
+  TEST_ASSERT_EQUAL_UINT32(100000, meter.rateMilliHz(last));
+  TEST_ASSERT_TRUE(meter.flowing(last + DEFAULT_PULSE_FLOW_CONFIG.minGapUs));
+  TEST_ASSERT_FALSE(meter.flowing(last + DEFAULT_PULSE_FLOW_CONFIG.minGapUs + 1));
+
+  // Also when the gap itself crosses the wrap
+  PulseFlowMeter late;
+  last = addPulses(late, UINT32_MAX - 50000, 10000, 5);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX - 10000, last);
+  TEST_ASSERT_TRUE(late.flowing(last + 100000));
+  TEST_ASSERT_EQUAL_UINT32(10000, late.rateMilliHz(last + 100000));
+}
+
+void test_count_rate_averages_samples() {
+  PulseCountRate rate;
+  // A single 100 ms sample with one pulse
+  TEST_ASSERT_EQUAL_UINT32(10000, rate.add(1, 100000));
+  uint32_t milliHz = 0;
+  for (size_t i = 1; i < COUNT_RATE_SAMPLES; i++) milliHz = rate.add(i % 2 == 0 ? 1 : 0, 100000);
+  TEST_ASSERT_EQUAL_UINT32(5000, milliHz);
+  // The first sample leaves the window
+  TEST_ASSERT_EQUAL_UINT32(4000, rate.add(0, 100000));
+
+  // Ten samples later only the new pulses count
+  for (size_t i = 0; i < COUNT_RATE_SAMPLES; i++) rate.add(2, 100000);
+  TEST_ASSERT_EQUAL_UINT32(20000, rate.add(2, 100000));
+
+  rate.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, rate.add(0, 100000));
+}
+
+static CalibrationTable threePointTable() {
+  CalibrationTable table = {};
+  table.version = CALIBRATION_VERSION;
+  table.count = 3;
+  table.points[0] = { 5000, 2600 };
+  table.points[1] = { 20000, 2200 };
+  table.points[2] = { 60000, 2000 };
+  return table;
+}
+
+void test_calibration_default_is_the_datasheet_constant() {
+  FlowCalibration calibration;
+  TEST_ASSERT_EQUAL_UINT32(DEFAULT_MICROLITERS_PER_PULSE, calibration.microLitersPerPulse(0));
+  TEST_ASSERT_EQUAL_UINT32(DEFAULT_MICROLITERS_PER_PULSE, calibration.microLitersPerPulse(200000));
+  TEST_ASSERT_EQUAL_UINT32(450 * DEFAULT_MICROLITERS_PER_PULSE, calibration.volumeMicroLiters(450, 7500));
+}
+
+void test_calibration_interpolates_between_points() {
+  FlowCalibration calibration;
+  TEST_ASSERT_TRUE(calibration.setTable(threePointTable()));
+  TEST_ASSERT_EQUAL_UINT32(2600, calibration.microLitersPerPulse(5000));
+  TEST_ASSERT_EQUAL_UINT32(2400, calibration.microLitersPerPulse(12500));
+  TEST_ASSERT_EQUAL_UINT32(2200, calibration.microLitersPerPulse(20000));
+  TEST_ASSERT_EQUAL_UINT32(2100, calibration.microLitersPerPulse(40000));
+  TEST_ASSERT_EQUAL_UINT32(2001, calibration.microLitersPerPulse(59999));
+  TEST_ASSERT_EQUAL_UINT32(10 * 2100, calibration.volumeMicroLiters(10, 40000));
+}
+
+void test_calibration_clamps_outside_the_table() {
+  FlowCalibration calibration;
+  calibration.setTable(threePointTable());
+  TEST_ASSERT_EQUAL_UINT32(2600, calibration.microLitersPerPulse(0));
+  TEST_ASSERT_EQUAL_UINT32(2600, calibration.microLitersPerPulse(4999));
+  TEST_ASSERT_EQUAL_UINT32(2000, calibration.microLitersPerPulse(60001));
+  TEST_ASSERT_EQUAL_UINT32(2000, calibration.microLitersPerPulse(UINT32_MAX));
+}
+
+void test_calibration_rejects_bad_tables() {
+  FlowCalibration calibration;
+  calibration.setTable(threePointTable());
+
+  CalibrationTable table = threePointTable();
+  table.version = CALIBRATION_VERSION + 1;
+  TEST_ASSERT_FALSE(calibration.setTable(table));
+
+  table = threePointTable();
+  table.count = 0;
+  TEST_ASSERT_FALSE(calibration.setTable(table));
+  table.count = CALIBRATION_MAX_POINTS + 1;
+  TEST_ASSERT_FALSE(calibration.setTable(table));
+
+  table = threePointTable();
+  table.points[1].microLitersPerPulse = 0;
+  TEST_ASSERT_FALSE(calibration.setTable(table));
+
+  table = threePointTable();
+  table.points[2].rateMilliHz = table.points[1].rateMilliHz;
+  TEST_ASSERT_FALSE(calibration.setTable(table));
+
+  // A rejected table leaves the previous one in place
+  TEST_ASSERT_EQUAL_UINT32(2400, calibration.microLitersPerPulse(12500));
+}
+
+// A steady reference pour at rateMilliHz
+static CalibrationRun steadyRun(uint32_t pulses, uint32_t referenceMl, uint32_t rateMilliHz) {
+  CalibrationRun run = {};
+  run.referenceMl = referenceMl;
+  run.addSample(pulses, (uint32_t)(pulses * 1000000ULL / rateMilliHz), rateMilliHz);
+  return run;
+}
+
+void test_fitter_merges_close_rates() {
+  CalibrationFitter fitter;
+  CalibrationTable table;
+  TEST_ASSERT_FALSE(fitter.fit(table));
+  TEST_ASSERT_FALSE(fitter.addRun(steadyRun(0, 1000, 7500)));
+
+  // 7.5 Hz and 7.67 Hz are one point, 30 Hz another
+  TEST_ASSERT_TRUE(fitter.addRun(steadyRun(1800, 3600, 30000)));
+  TEST_ASSERT_TRUE(fitter.addRun(steadyRun(450, 1000, 7500)));
+  TEST_ASSERT_TRUE(fitter.addRun(steadyRun(460, 1000, 7667)));
+  TEST_ASSERT_TRUE(fitter.fit(table));
+  TEST_ASSERT_EQUAL_UINT8(2, table.count);
+  TEST_ASSERT_EQUAL_UINT32((450 * 7500 + 460 * 7667) / 910, table.points[0].rateMilliHz);
+  TEST_ASSERT_EQUAL_UINT32(2000 * 1000 / 910, table.points[0].microLitersPerPulse);
+  TEST_ASSERT_EQUAL_UINT32(30000, table.points[1].rateMilliHz);
+  TEST_ASSERT_EQUAL_UINT32(2000, table.points[1].microLitersPerPulse);
+
+  FlowCalibration calibration;
+  TEST_ASSERT_TRUE(calibration.setTable(table));
+}
+
+void test_fitter_fits_many_rates_into_the_table() {
+  CalibrationFitter fitter;
+  // Twelve pours from 1.7 Hz to 42 Hz, further apart than the merge ratio
+  for (uint32_t i = 0; i < 12; i++) {
+    uint32_t pulses = 100 + 20 * i * i;
+    TEST_ASSERT_TRUE(fitter.addRun(steadyRun(pulses, pulses * 2 + i, pulses * 1000 / 60)));
+  }
+  CalibrationTable table;
+  TEST_ASSERT_TRUE(fitter.fit(table));
+  TEST_ASSERT_LESS_OR_EQUAL(CALIBRATION_MAX_POINTS, table.count);
+  TEST_ASSERT_GREATER_THAN(1, table.count);
+
+  FlowCalibration calibration;
+  TEST_ASSERT_TRUE(calibration.setTable(table));
+}
+
+// Volume per pulse of the simulated sensor at its true pulse rate
+static uint32_t sensorMicroLitersPerPulse(uint32_t milliHz) {
+  static FlowCalibration sensor;
+  static bool initialized = false;
+  if (!initialized) {
+    CalibrationTable table = {};
+    table.version = CALIBRATION_VERSION;
+    table.count = 3;
+    table.points[0] = { 5000, 2600 };
+    table.points[1] = { 10000, 2400 };
+    table.points[2] = { 20000, 2100 };
+    sensor.setTable(table);
+    initialized = true;
+  }
+  return sensor.microLitersPerPulse(milliHz);
+}
+
+// Pours at a steady rate through 100 ms samples with the averaged count
+// rate of the default build, like the sensor task and loop() do. Adds the
+// samples to run and returns the volume calibration measured, in ul.
+static uint64_t pourWithCountRate(uint32_t milliHz, uint32_t durationMs, const FlowCalibration& calibration,
+                                  CalibrationRun& run, uint64_t& trueUl) {
+  PulseCountRate countRate;
+  uint64_t measuredUl = 0;
+  uint64_t nextUs = 50000;
+  uint64_t intervalUs = 1000000000ULL / milliHz;
+  trueUl = 0;
+  for (uint32_t timeMs = 100; timeMs <= durationMs + 1000; timeMs += 100) {
+    uint32_t pulses = 0;
+    while (nextUs < (uint64_t)timeMs * 1000 && nextUs < (uint64_t)durationMs * 1000) {
+      nextUs += intervalUs;
+      pulses++;
+    }
+    uint32_t rate = countRate.add(pulses, 100000);
+    measuredUl += calibration.volumeMicroLiters(pulses, rate);
+    run.addSample(pulses, 100, rate);
+    trueUl += (uint64_t)pulses * sensorMicroLitersPerPulse(milliHz);
+  }
+  return measuredUl;
+}
+
+void test_count_rate_calibration_matches_its_lookup() {
+  // Reference pours of about 250 ml at three rates
+  const uint32_t rates[] = { 5000, 10000, 20000 };
+  CalibrationFitter fitter;
+  FlowCalibration datasheet;
+  for (size_t i = 0; i < 3; i++) {
+    CalibrationRun run = {};
+    uint64_t trueUl;
+    uint32_t pulses = 250000 / sensorMicroLitersPerPulse(rates[i]);
+    pourWithCountRate(rates[i], (uint32_t)(pulses * 1000000ULL / rates[i]), datasheet, run, trueUl);
+    run.referenceMl = (uint32_t)(trueUl / 1000);
+    // Keyed by the rate the lookup sees, a little low from the first
+    // second of averaging. Pulses per active sample would read 10 Hz at
+    // 5 Hz, where every other 100 ms sample is empty.
+    TEST_ASSERT_UINT32_WITHIN(rates[i] / 20, rates[i], run.rateMilliHz());
+    TEST_ASSERT_TRUE(fitter.addRun(run));
+  }
+  CalibrationTable table;
+  TEST_ASSERT_TRUE(fitter.fit(table));
+  FlowCalibration calibration;
+  TEST_ASSERT_TRUE(calibration.setTable(table));
+  TEST_ASSERT_EQUAL_UINT8(3, table.count);
+
+  // Sips of other lengths and rates, start lag included, within 1.5%
+  const uint32_t sipRates[] = { 5000, 7500, 10000, 15000, 20000 };
+  for (size_t i = 0; i < 5; i++) {
+    CalibrationRun unused = {};
+    uint64_t trueUl;
+    uint64_t measuredUl = pourWithCountRate(sipRates[i], 4000, calibration, unused, trueUl);
+    TEST_ASSERT_UINT32_WITHIN((uint32_t)(trueUl * 15 / 1000), (uint32_t)trueUl, (uint32_t)measuredUl);
+  }
+}
+
+const uint32_t SAMPLE_MS = 100;
+const uint32_t UL_PER_PULSE = 2200;
+
+// A 100 ms sample ending at timeMs
+static SessionSample flowSample(uint32_t timeMs, uint32_t pulses, uint32_t rateMilliHz, bool flowStopped = false) {
+  SessionSample sample = { timeMs, SAMPLE_MS, pulses, pulses * UL_PER_PULSE, rateMilliHz, flowStopped };
+  return sample;
+}
+
+// Replays a sip of steady pulses at milliHz, from idle, through the rate
+// source of either build. Returns the pulses that ended up in sessions.
+static uint32_t replaySteadySip(uint32_t milliHz, bool usePulseGap, uint32_t& totalPulses, uint32_t& sessions) {
+  DrinkSessionTracker tracker;
+  PulseCountRate countRate;
+  PulseFlowMeter meter;
+  DrinkSession session;
+  uint32_t inSessions = 0;
+  totalPulses = 0;
+  sessions = 0;
+
+  // Starts between two samples, lasts three seconds
+  uint64_t nextUs = 2050000;
+  uint64_t intervalUs = 1000000000ULL / milliHz;
+  for (uint32_t timeMs = SAMPLE_MS; timeMs <= 8000; timeMs += SAMPLE_MS) {
+    uint32_t pulses = 0;
+    while (nextUs < (uint64_t)timeMs * 1000 && nextUs < 5050000) {
+      meter.addPulse((uint32_t)nextUs);
+      nextUs += intervalUs;
+      pulses++;
+    }
+    totalPulses += pulses;
+    uint32_t nowUs = timeMs * 1000;
+    uint32_t rate = usePulseGap ? meter.rateMilliHz(nowUs) : countRate.add(pulses, SAMPLE_MS * 1000);
+    bool stopped = usePulseGap && meter.lastPulseUs() > 0 && !meter.flowing(nowUs);
+    if (tracker.update(flowSample(timeMs, pulses, rate, stopped), session)) {
+      inSessions += session.pulses;
+      sessions++;
+    }
+  }
+  return inSessions;
+}
+
+void test_session_keeps_every_pulse_of_a_sip_from_idle() {
+  // The averaged rate needs a few samples to reach the trickle rate, the
+  // pulses before that must still be counted
+  const uint32_t rates[] = { 5000, 7500, 10000, 15000, 25000 };
+  for (int usePulseGap = 0; usePulseGap < 2; usePulseGap++) {
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+      uint32_t total, sessions;
+      uint32_t inSessions = replaySteadySip(rates[i], usePulseGap, total, sessions);
+      TEST_ASSERT_EQUAL_UINT32(1, sessions);
+      TEST_ASSERT_EQUAL_UINT32(total, inSessions);
+    }
+  }
+}
+
+void test_session_keeps_every_pulse_of_synthetic_sips() {
+  const SipSpec sips[] = { { 1000, 3000, 12 }, { 9000, 1500, 6 }, { 15000, 6000, 20 }, { 30000, 800, 4 } };
+  for (int usePulseGap = 0; usePulseGap < 2; usePulseGap++) {
+    SipSampler sampler(sips, 4, SAMPLE_MS, UL_PER_PULSE, usePulseGap);
+    DrinkSessionTracker tracker;
+    DrinkSession session;
+    SessionSample sample;
+    uint32_t inSessions = 0;
+    uint32_t sessions = 0;
+    while (sampler.next(sample)) {
+      if (tracker.update(sample, session)) {
+        inSessions += session.pulses;
+        sessions++;
+      }
+    }
+    TEST_ASSERT_EQUAL_UINT32(4, sessions);
+    TEST_ASSERT_EQUAL_UINT32(sampler.totalPulses(), inSessions);
+  }
+}
+
+void test_peak_flow_follows_the_averaged_rate() {
+  DrinkSessionTracker tracker;
+  DrinkSession session;
+  // 30 Hz with the counts jittering between 2 and 4 pulses per sample
+  uint32_t timeMs = SAMPLE_MS;
+  for (int i = 0; i < 20; i++, timeMs += SAMPLE_MS) {
+    TEST_ASSERT_FALSE(tracker.update(flowSample(timeMs, i % 2 == 0 ? 2 : 4, 30000), session));
+  }
+  for (; !tracker.update(flowSample(timeMs, 0, 0), session); timeMs += SAMPLE_MS) {}
+
+  // 30 pulses/s of 2.2 ml, not the 5280 ml/min of a single 4 pulse sample
+  TEST_ASSERT_EQUAL_UINT32(3960, session.peakFlowMlPerMin);
+  TEST_ASSERT_EQUAL_UINT32(3960, session.meanFlowMlPerMin);
+}
+
+void test_trickle_does_not_start_a_session() {
+  DrinkSessionTracker tracker;
+  DrinkSession session;
+  // A drop every 700 ms at 1.4 Hz, for a minute
+  for (uint32_t timeMs = SAMPLE_MS; timeMs <= 60000; timeMs += SAMPLE_MS) {
+    uint32_t pulses = timeMs % 700 == 0 ? 1 : 0;
+    TEST_ASSERT_FALSE(tracker.update(flowSample(timeMs, pulses, 1400), session));
+    TEST_ASSERT_EQUAL_INT(SESSION_IDLE, tracker.state());
+  }
+
+  // A second without drops drops the held trickle, it does not join the next sip
+  uint32_t timeMs = 60000;
+  for (; timeMs < 61000; timeMs += SAMPLE_MS) tracker.update(flowSample(timeMs + SAMPLE_MS, 0, 0), session);
+  for (; timeMs < 62000; timeMs += SAMPLE_MS) tracker.update(flowSample(timeMs + SAMPLE_MS, 1, 10000), session);
+  while (!tracker.update(flowSample(timeMs += SAMPLE_MS, 0, 0), session)) {}
+  TEST_ASSERT_EQUAL_UINT32(10, session.pulses);
+  TEST_ASSERT_EQUAL_UINT32(61000, session.startMs);
+}
+
+void test_session_pauses_resumes_and_commits() {
+  DrinkSessionTracker tracker;
+  DrinkSession session;
+  uint32_t timeMs = 1000;
+  for (int i = 0; i < 10; i++) tracker.update(flowSample(timeMs += SAMPLE_MS, 1, 10000), session);
+  TEST_ASSERT_EQUAL_INT(SESSION_POURING, tracker.state());
+
+  // A pause shorter than commitGapMs continues the session
+  for (int i = 0; i < 5; i++) TEST_ASSERT_FALSE(tracker.update(flowSample(timeMs += SAMPLE_MS, 0, 0), session));
+  TEST_ASSERT_EQUAL_INT(SESSION_PAUSE, tracker.state());
+  for (int i = 0; i < 10; i++) tracker.update(flowSample(timeMs += SAMPLE_MS, 1, 10000), session);
+  uint32_t lastFlowMs = timeMs;
+
+  // commitGapMs after the last flow it is committed
+  while (!tracker.update(flowSample(timeMs += SAMPLE_MS, 0, 0), session)) {
+    TEST_ASSERT_LESS_THAN(lastFlowMs + DEFAULT_SESSION_CONFIG.commitGapMs, timeMs);
+  }
+  TEST_ASSERT_EQUAL_INT(SESSION_COMMITTED, tracker.state());
+  TEST_ASSERT_EQUAL_UINT32(lastFlowMs + DEFAULT_SESSION_CONFIG.commitGapMs, timeMs);
+  TEST_ASSERT_EQUAL_UINT32(1000, session.startMs);
+  TEST_ASSERT_EQUAL_UINT32(2500, session.durationMs);
+  TEST_ASSERT_EQUAL_UINT32(2000, session.pouringMs);
+  TEST_ASSERT_EQUAL_UINT32(20, session.pulses);
+  TEST_ASSERT_EQUAL_UINT32(20 * UL_PER_PULSE, session.volumeUl);
+  TEST_ASSERT_FALSE(session.split);
+
+  tracker.update(flowSample(timeMs += SAMPLE_MS, 0, 0), session);
+  TEST_ASSERT_EQUAL_INT(SESSION_IDLE, tracker.state());
+}
+
+void test_session_commits_when_the_pulse_gap_ends_the_flow() {
+  DrinkSessionTracker tracker;
+  DrinkSession session;
+  uint32_t timeMs = 0;
+  for (int i = 0; i < 5; i++) tracker.update(flowSample(timeMs += SAMPLE_MS, 2, 20000), session);
+  TEST_ASSERT_FALSE(tracker.update(flowSample(timeMs += SAMPLE_MS, 0, 0), session));
+  TEST_ASSERT_TRUE(tracker.update(flowSample(timeMs += SAMPLE_MS, 0, 0, true), session));
+  TEST_ASSERT_EQUAL_UINT32(10, session.pulses);
+}
+
+void test_long_flow_is_split_at_max_session() {
+  DrinkSessionTracker tracker;
+  DrinkSession session;
+  uint32_t committed = 0;
+  uint32_t splits = 0;
+  uint32_t pulses = 0;
+  uint32_t timeMs = 0;
+  // 150 s of flow, then nothing
+  for (; timeMs < 160000; ) {
+    timeMs += SAMPLE_MS;
+    bool flow = timeMs <= 150000;
+    if (!tracker.update(flowSample(timeMs, flow ? 1 : 0, flow ? 10000 : 0), session)) continue;
+    committed++;
+    pulses += session.pulses;
+    if (session.split) {
+      splits++;
+      TEST_ASSERT_EQUAL_UINT32(DEFAULT_SESSION_CONFIG.maxSessionMs, session.durationMs);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(3, committed);
+  TEST_ASSERT_EQUAL_UINT32(2, splits);
+  TEST_ASSERT_EQUAL_UINT32(1500, pulses);
+}
+
+void test_small_sessions_are_dropped() {
+  SessionConfig config = DEFAULT_SESSION_CONFIG;
+  config.minVolumeUl = 10 * UL_PER_PULSE;
+  DrinkSessionTracker tracker(config);
+  DrinkSession session;
+  uint32_t timeMs = 0;
+  for (int i = 0; i < 5; i++) tracker.update(flowSample(timeMs += SAMPLE_MS, 1, 10000), session);
+  for (int i = 0; i < 20; i++) TEST_ASSERT_FALSE(tracker.update(flowSample(timeMs += SAMPLE_MS, 0, 0), session));
+  TEST_ASSERT_EQUAL_INT(SESSION_IDLE, tracker.state());
+}
+
+// Drink mix of the synthetic days
+enum DayDrink : uint8_t { DRINK_SIP, DRINK_PAIR_FIRST, DRINK_PAIR_SECOND, DRINK_TRICKLE, DRINK_LONG_POUR };
+
+const uint32_t DRINKS_PER_DAY = 40;
+const uint32_t MAX_DAY_SESSIONS = 128;
+
+struct DayReplay {
+  uint32_t sips;
+  uint32_t sipsFound;
+  uint32_t pairs;
+  uint32_t pairsSeparate;
+  uint32_t trickleSessions;
+  uint32_t longPours;
+  uint32_t longPoursSplit;
+  uint32_t pulses;
+  uint32_t tricklePulses;
+  uint32_t pulsesInSessions;
+};
+
+// xorshift32, so every host replays the same days
+static uint32_t nextRandom(uint32_t& state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static bool sessionStartsNear(const DrinkSession* sessions, uint32_t count, uint32_t timeMs) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (sessions[i].startMs + 1000 >= timeMs && sessions[i].startMs <= timeMs + 1000) return true;
+  }
+  return false;
+}
+
+// Replays days of 40 drinks, 10 to 40 s apart: half of them single sips,
+// 35% pairs of sips 300-600 ms apart, 10% trickles at 1 Hz for 20 s and
+// 5% pours of 90 s
+static void replayDays(uint32_t days, bool usePulseGap, DayReplay& result) {
+  memset(&result, 0, sizeof(result));
+  uint32_t seed = 0x5EED1234;
+  SipSpec sips[DRINKS_PER_DAY * 2];
+  DayDrink kinds[DRINKS_PER_DAY * 2];
+  DrinkSession sessions[MAX_DAY_SESSIONS];
+
+  for (uint32_t day = 0; day < days; day++) {
+    size_t count = 0;
+    uint32_t timeMs = 5000;
+    for (uint32_t i = 0; i < DRINKS_PER_DAY; i++) {
+      timeMs += 10000 + nextRandom(seed) % 30000;
+      uint32_t pick = nextRandom(seed) % 20;
+      if (pick < 10) {
+        sips[count] = { timeMs, 1500 + nextRandom(seed) % 3000, 15 + nextRandom(seed) % 25 };
+        kinds[count++] = DRINK_SIP;
+      } else if (pick < 17) {
+        uint32_t firstMs = 1500 + nextRandom(seed) % 2000;
+        sips[count] = { timeMs, firstMs, 20 };
+        kinds[count++] = DRINK_PAIR_FIRST;
+        sips[count] = { timeMs + firstMs + 300 + nextRandom(seed) % 300, 1500, 20 };
+        kinds[count++] = DRINK_PAIR_SECOND;
+      } else if (pick < 19) {
+        sips[count] = { timeMs, 20000, 1 };
+        kinds[count++] = DRINK_TRICKLE;
+      } else {
+        sips[count] = { timeMs, 90000, 30 };
+        kinds[count++] = DRINK_LONG_POUR;
+      }
+      timeMs = sips[count - 1].startMs + sips[count - 1].durationMs;
+    }
+
+    SipSampler sampler(sips, count, SAMPLE_MS, UL_PER_PULSE, usePulseGap);
+    DrinkSessionTracker tracker;
+    SessionSample sample;
+    DrinkSession session;
+    uint32_t sessionCount = 0;
+    size_t current = 0;
+    while (sampler.next(sample)) {
+      // Every pulse of a sample comes from the sip that covers it
+      while (current < count && sample.timeMs > sips[current].startMs + sips[current].durationMs + SAMPLE_MS) current++;
+      if (current < count && kinds[current] == DRINK_TRICKLE) result.tricklePulses += sample.pulses;
+      if (!tracker.update(sample, session)) continue;
+      TEST_ASSERT_LESS_THAN(MAX_DAY_SESSIONS, sessionCount);
+      sessions[sessionCount++] = session;
+      result.pulsesInSessions += session.pulses;
+    }
+    result.pulses += sampler.totalPulses();
+
+    for (size_t i = 0; i < count; i++) {
+      const SipSpec& sip = sips[i];
+      if (kinds[i] == DRINK_SIP || kinds[i] == DRINK_PAIR_FIRST) {
+        result.sips++;
+        if (sessionStartsNear(sessions, sessionCount, sip.startMs)) result.sipsFound++;
+      }
+      if (kinds[i] == DRINK_PAIR_SECOND) {
+        result.pairs++;
+        if (sessionStartsNear(sessions, sessionCount, sip.startMs)) result.pairsSeparate++;
+      }
+      uint32_t overlapping = 0;
+      bool split = false;
+      for (uint32_t j = 0; j < sessionCount; j++) {
+        if (sessions[j].startMs + 500 < sip.startMs || sessions[j].startMs >= sip.startMs + sip.durationMs) continue;
+        overlapping++;
+        split = split || sessions[j].split;
+      }
+      if (kinds[i] == DRINK_TRICKLE && overlapping > 0) result.trickleSessions++;
+      if (kinds[i] == DRINK_LONG_POUR) {
+        result.longPours++;
+        if (overlapping == 2 && split) result.longPoursSplit++;
+      }
+    }
+  }
+}
+
+void test_sessions_over_synthetic_days() {
+  for (int usePulseGap = 0; usePulseGap < 2; usePulseGap++) {
+    DayReplay result;
+    replayDays(1000, usePulseGap, result);
+    // No drink is missed, no trickle starts one, every 90 s pour is split once
+    TEST_ASSERT_EQUAL_UINT32(result.sips, result.sipsFound);
+    TEST_ASSERT_EQUAL_UINT32(0, result.trickleSessions);
+    TEST_ASSERT_EQUAL_UINT32(result.longPours, result.longPoursSplit);
+    // Only the trickles stay outside the sessions
+    TEST_ASSERT_EQUAL_UINT32(result.pulses - result.tricklePulses, result.pulsesInSessions);
+    // Only the pulse gap can tell the sips of a pair apart
+    if (usePulseGap) TEST_ASSERT_TRUE(result.pairsSeparate * 100 >= result.pairs * 99);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_accumulator_counts_across_wraps);
+  RUN_TEST(test_accumulator_adds_an_unreported_wrap);
+  RUN_TEST(test_simulated_counter_take_clears);
+  RUN_TEST(test_simulated_counter_wraps_at_the_limit);
+  RUN_TEST(test_held_overflow_event_loses_nothing);
+  RUN_TEST(test_pulse_total_over_many_wraps);
+  RUN_TEST(test_meter_rate_from_intervals);
+  RUN_TEST(test_meter_rejects_glitches);
+  RUN_TEST(test_meter_detects_the_gap_after_a_pour);
+  RUN_TEST(test_meter_gap_limit_is_clamped);
+  RUN_TEST(test_meter_across_the_clock_wrap);
+  RUN_TEST(test_count_rate_averages_samples);
+  RUN_TEST(test_calibration_default_is_the_datasheet_constant);
+  RUN_TEST(test_calibration_interpolates_between_points);
+  RUN_TEST(test_calibration_clamps_outside_the_table);
+  RUN_TEST(test_calibration_rejects_bad_tables);
+  RUN_TEST(test_fitter_merges_close_rates);
+  RUN_TEST(test_fitter_fits_many_rates_into_the_table);
+  RUN_TEST(test_count_rate_calibration_matches_its_lookup);
+  RUN_TEST(test_session_keeps_every_pulse_of_a_sip_from_idle);
+  RUN_TEST(test_session_keeps_every_pulse_of_synthetic_sips);
+  RUN_TEST(test_peak_flow_follows_the_averaged_rate);
+  RUN_TEST(test_trickle_does_not_start_a_session);
+  RUN_TEST(test_session_pauses_resumes_and_commits);
+  RUN_TEST(test_session_commits_when_the_pulse_gap_ends_the_flow);
+  RUN_TEST(test_long_flow_is_split_at_max_session);
+  RUN_TEST(test_small_sessions_are_dropped);
+  RUN_TEST(test_sessions_over_synthetic_days);
+  return UNITY_END();
+}
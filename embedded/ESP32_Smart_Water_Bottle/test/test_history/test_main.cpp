@@ -0,0 +1,215 @@
+#include <unity.h>
+#include <string.h>
+#include <HistoryCodec.h>
+
+const uint64_t T0 = 1751356800000ULL;
+
+void setUp() {}
+void tearDown() {}
+
+void test_varint_round_trip() {
+  const uint64_t values[] = { 0, 1, 127, 128, 16383, 16384, 0xFFFFFFFFULL, UINT64_MAX };
+  const size_t lengths[] = { 1, 1, 1, 2, 2, 3, 5, 10 };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    uint8_t buffer[10];
+    TEST_ASSERT_EQUAL_size_t(lengths[i], writeVarint(buffer, sizeof(buffer), values[i]));
+    uint64_t decoded;
+    TEST_ASSERT_EQUAL_size_t(lengths[i], readVarint(buffer, lengths[i], decoded));
+    TEST_ASSERT_EQUAL_UINT64(values[i], decoded);
+
+    // One byte short on either side fails instead of cutting the value
+    TEST_ASSERT_EQUAL_size_t(0, writeVarint(buffer, lengths[i] - 1, values[i]));
+    TEST_ASSERT_EQUAL_size_t(0, readVarint(buffer, lengths[i] - 1, decoded));
+  }
+}
+
+void test_zigzag() {
+  TEST_ASSERT_EQUAL_UINT64(0, zigzagEncode(0));
+  TEST_ASSERT_EQUAL_UINT64(1, zigzagEncode(-1));
+  TEST_ASSERT_EQUAL_UINT64(2, zigzagEncode(1));
+  TEST_ASSERT_EQUAL_UINT64(3, zigzagEncode(-2));
+
+  const int64_t values[] = { 0, -1, 1, -600000, 600000, INT64_MIN, INT64_MAX };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    TEST_ASSERT_TRUE(zigzagDecode(zigzagEncode(values[i])) == values[i]);
+  }
+}
+
+void test_chunk_round_trip_with_negative_deltas() {
+  // Sequence gaps, and timestamps going back after the clock was set again
+  const HistoryRecord input[] = {
+    { 40, T0, 250, 3200, 6000, 4700 },
+    { 41, T0 + 180000, 90, 900, 7200, 6000 },
+    { 45, T0 - 3600000, 0, 0, 0, 0 },
+    { 46, T0 - 3599999, 65535, 0xFFFFFFFF, 65535, 65535 },
+    { 1000, T0 + 86400000ULL * 30, 120, 2400, 3000, 3000 },
+  };
+  const size_t count = sizeof(input) / sizeof(input[0]);
+
+  uint8_t chunk[244];
+  HistoryChunkWriter writer;
+  writer.begin(chunk, sizeof(chunk));
+  for (size_t i = 0; i < count; i++) TEST_ASSERT_TRUE(writer.add(input[i]));
+  size_t length = writer.finish(1000);
+  TEST_ASSERT_EQUAL_UINT8(count, writer.count());
+
+  WaterFrame header;
+  TEST_ASSERT_TRUE(readWaterFrameHeader(chunk, length, header));
+  TEST_ASSERT_EQUAL_UINT8(FRAME_HISTORY_CHUNK, header.type);
+  TEST_ASSERT_EQUAL_UINT32(40, header.sequence);
+
+  HistoryRecord output[8];
+  size_t decoded = 0;
+  TEST_ASSERT_TRUE(decodeHistoryChunk(chunk, length, output, 8, decoded));
+  TEST_ASSERT_EQUAL_size_t(count, decoded);
+  for (size_t i = 0; i < count; i++) {
+    TEST_ASSERT_EQUAL_UINT32(input[i].sequence, output[i].sequence);
+    TEST_ASSERT_EQUAL_UINT64(input[i].timestampMs, output[i].timestampMs);
+    TEST_ASSERT_EQUAL_UINT16(input[i].amountMl, output[i].amountMl);
+    TEST_ASSERT_EQUAL_UINT32(input[i].durationMs, output[i].durationMs);
+    TEST_ASSERT_EQUAL_UINT16(input[i].peakFlowMlPerMin, output[i].peakFlowMlPerMin);
+    TEST_ASSERT_EQUAL_UINT16(input[i].meanFlowMlPerMin, output[i].meanFlowMlPerMin);
+  }
+}
+
+void test_consecutive_sips_take_few_bytes() {
+  uint8_t chunk[244];
+  HistoryChunkWriter writer;
+  writer.begin(chunk, sizeof(chunk));
+  for (uint32_t i = 0; i < 10; i++) {
+    HistoryRecord record = { 1 + i, T0 + i * 300000, 150, 3000, 5000, 3600 };
+    TEST_ASSERT_TRUE(writer.add(record));
+  }
+  // 2 bytes each for the amount and the details of the first record, then
+  // 1 + 3 bytes of deltas and the same 8 bytes per further record
+  TEST_ASSERT_EQUAL_size_t(HISTORY_CHUNK_HEADER_SIZE + 8 + 9 * 12, writer.finish(10));
+}
+
+void test_capacity_edges() {
+  HistoryRecord first = { 1, T0, 200, 0, 0, 0 };     // 5 bytes
+  HistoryRecord second = { 2, T0 + 1, 5, 0, 0, 0 };  // 6 bytes
+
+  // Exactly room for the first record
+  uint8_t chunk[64];
+  HistoryChunkWriter writer;
+  writer.begin(chunk, HISTORY_CHUNK_HEADER_SIZE + 5);
+  TEST_ASSERT_TRUE(writer.add(first));
+  TEST_ASSERT_FALSE(writer.add(second));
+  TEST_ASSERT_EQUAL_size_t(HISTORY_CHUNK_HEADER_SIZE + 5, writer.finish(2));
+
+  // One byte short of the second record, which must not be half written
+  writer.begin(chunk, HISTORY_CHUNK_HEADER_SIZE + 5 + 5);
+  TEST_ASSERT_TRUE(writer.add(first));
+  TEST_ASSERT_FALSE(writer.add(second));
+  TEST_ASSERT_EQUAL_UINT8(1, writer.count());
+  size_t length = writer.finish(2);
+  TEST_ASSERT_EQUAL_size_t(HISTORY_CHUNK_HEADER_SIZE + 5, length);
+
+  HistoryRecord output[2];
+  size_t decoded = 0;
+  TEST_ASSERT_TRUE(decodeHistoryChunk(chunk, length, output, 2, decoded));
+  TEST_ASSERT_EQUAL_size_t(1, decoded);
+
+  // Exactly room for both
+  writer.begin(chunk, HISTORY_CHUNK_HEADER_SIZE + 5 + 6);
+  TEST_ASSERT_TRUE(writer.add(first));
+  TEST_ASSERT_TRUE(writer.add(second));
+  TEST_ASSERT_EQUAL_size_t(HISTORY_CHUNK_HEADER_SIZE + 11, writer.finish(2));
+}
+
+void test_record_count_limit() {
+  static uint8_t chunk[2048];
+  HistoryChunkWriter writer;
+  writer.begin(chunk, sizeof(chunk));
+  for (uint32_t i = 0; i < HISTORY_CHUNK_MAX_RECORDS; i++) {
+    HistoryRecord record = { 1 + i, T0 + i, 1, 0, 0, 0 };
+    TEST_ASSERT_TRUE(writer.add(record));
+  }
+  HistoryRecord extra = { 1000, T0, 1, 0, 0, 0 };
+  TEST_ASSERT_FALSE(writer.add(extra));
+
+  static HistoryRecord output[HISTORY_CHUNK_MAX_RECORDS];
+  size_t decoded = 0;
+  size_t length = writer.finish(1000);
+  TEST_ASSERT_TRUE(decodeHistoryChunk(chunk, length, output, HISTORY_CHUNK_MAX_RECORDS, decoded));
+  TEST_ASSERT_EQUAL_size_t(HISTORY_CHUNK_MAX_RECORDS, decoded);
+  TEST_ASSERT_EQUAL_UINT32(HISTORY_CHUNK_MAX_RECORDS, output[HISTORY_CHUNK_MAX_RECORDS - 1].sequence);
+
+  // The caller's array must hold every record of the chunk
+  TEST_ASSERT_FALSE(decodeHistoryChunk(chunk, length, output, HISTORY_CHUNK_MAX_RECORDS - 1, decoded));
+}
+
+void test_end_of_history_marker() {
+  uint8_t chunk[32];
+  HistoryChunkWriter writer;
+  writer.begin(chunk, sizeof(chunk));
+  size_t length = writer.finish(77);
+  TEST_ASSERT_EQUAL_size_t(HISTORY_CHUNK_HEADER_SIZE, length);
+
+  WaterFrame header;
+  TEST_ASSERT_TRUE(readWaterFrameHeader(chunk, length, header));
+  TEST_ASSERT_EQUAL_UINT32(77, header.sequence);
+
+  HistoryRecord output[1];
+  size_t decoded = 1;
+  TEST_ASSERT_TRUE(decodeHistoryChunk(chunk, length, output, 1, decoded));
+  TEST_ASSERT_EQUAL_size_t(0, decoded);
+}
+
+void test_rejects_malformed_chunks() {
+  uint8_t chunk[64];
+  HistoryChunkWriter writer;
+  writer.begin(chunk, sizeof(chunk));
+  HistoryRecord first = { 1, T0, 300, 2000, 9000, 9000 };
+  HistoryRecord second = { 2, T0 + 60000, 300, 2000, 9000, 9000 };
+  writer.add(first);
+  writer.add(second);
+  size_t length = writer.finish(2);
+
+  HistoryRecord output[4];
+  size_t decoded;
+  for (size_t cut = 0; cut < length; cut++) {
+    TEST_ASSERT_FALSE(decodeHistoryChunk(chunk, cut, output, 4, decoded));
+  }
+
+  // Trailing bytes after the last record
+  chunk[length] = 0;
+  TEST_ASSERT_FALSE(decodeHistoryChunk(chunk, length + 1, output, 4, decoded));
+
+  // A frame of another type
+  chunk[1] = FRAME_DRINK_EVENT;
+  TEST_ASSERT_FALSE(decodeHistoryChunk(chunk, length, output, 4, decoded));
+  chunk[1] = FRAME_HISTORY_CHUNK;
+
+  // An amount above 16 bits: 0x10000 as the first record's varint
+  uint8_t wide[HISTORY_CHUNK_HEADER_SIZE + 3];
+  memcpy(wide, chunk, WATER_FRAME_HEADER_SIZE);
+  wide[WATER_FRAME_HEADER_SIZE] = 1;
+  wide[HISTORY_CHUNK_HEADER_SIZE] = 0x80;
+  wide[HISTORY_CHUNK_HEADER_SIZE + 1] = 0x80;
+  wide[HISTORY_CHUNK_HEADER_SIZE + 2] = 0x04;
+  TEST_ASSERT_FALSE(decodeHistoryChunk(wide, sizeof(wide), output, 4, decoded));
+
+  // A peak flow above 16 bits after an amount and duration of 1
+  uint8_t fast[HISTORY_CHUNK_HEADER_SIZE + 6];
+  memcpy(fast, wide, HISTORY_CHUNK_HEADER_SIZE);
+  const uint8_t details[] = { 0x01, 0x01, 0x80, 0x80, 0x04, 0x01 };
+  memcpy(fast + HISTORY_CHUNK_HEADER_SIZE, details, sizeof(details));
+  TEST_ASSERT_FALSE(decodeHistoryChunk(fast, sizeof(fast), output, 4, decoded));
+  fast[HISTORY_CHUNK_HEADER_SIZE + 4] = 0x03;
+  TEST_ASSERT_TRUE(decodeHistoryChunk(fast, sizeof(fast), output, 4, decoded));
+  TEST_ASSERT_EQUAL_UINT16(0xC000, output[0].peakFlowMlPerMin);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_varint_round_trip);
+  RUN_TEST(test_zigzag);
+  RUN_TEST(test_chunk_round_trip_with_negative_deltas);
+  RUN_TEST(test_consecutive_sips_take_few_bytes);
+  RUN_TEST(test_capacity_edges);
+  RUN_TEST(test_record_count_limit);
+  RUN_TEST(test_end_of_history_marker);
+  RUN_TEST(test_rejects_malformed_chunks);
+  return UNITY_END();
+}
@@ -0,0 +1,329 @@
+#include <unity.h>
+#include <DrinkJournal.h>
+
+// 8 record slots per sector after the 16 byte header
+const size_t SECTOR_SIZE = 256;
+const size_t SECTORS = 4;
+const uint64_t T0 = 1751356800000ULL;
+const uint32_t EPOCH = 0x5EED0001;
+
+void setUp() {}
+void tearDown() {}
+
+static void appendEvents(DrinkJournal& journal, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    TEST_ASSERT_TRUE(journal.append(T0 + i * 1000, (uint16_t)(100 + i)));
+  }
+}
+
+// Sequences of every record after afterSequence, in the order read
+static size_t readSequences(DrinkJournal& journal, uint32_t afterSequence, uint32_t* out, size_t capacity) {
+  JournalRecord records[4];
+  size_t total = 0;
+  for (;;) {
+    size_t count = journal.readAfter(afterSequence, records, 4);
+    if (count == 0) return total;
+    for (size_t i = 0; i < count && total < capacity; i++) out[total++] = records[i].sequence;
+    afterSequence = records[count - 1].sequence;
+  }
+}
+
+void test_records_survive_a_reboot() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+
+  JournalRecord record = {};
+  record.timestampMs = T0;
+  record.amountMl = 250;
+  record.durationMs = 3200;
+  record.peakFlowMlPerMin = 6000;
+  record.meanFlowMlPerMin = 4700;
+  TEST_ASSERT_TRUE(journal.append(record));
+  TEST_ASSERT_EQUAL_UINT32(1, record.sequence);
+  appendEvents(journal, 11);
+
+  DrinkJournal rebooted(flash);
+  TEST_ASSERT_TRUE(rebooted.begin(EPOCH));
+  TEST_ASSERT_EQUAL_UINT32(12, rebooted.lastSequence());
+  TEST_ASSERT_EQUAL_UINT32(12, rebooted.pendingCount());
+
+  JournalRecord read[1];
+  TEST_ASSERT_EQUAL_size_t(1, rebooted.readAfter(0, read, 1));
+  TEST_ASSERT_EQUAL_UINT32(1, read[0].sequence);
+  TEST_ASSERT_EQUAL_UINT64(T0, read[0].timestampMs);
+  TEST_ASSERT_EQUAL_UINT16(250, read[0].amountMl);
+  TEST_ASSERT_EQUAL_UINT32(3200, read[0].durationMs);
+  TEST_ASSERT_EQUAL_UINT16(6000, read[0].peakFlowMlPerMin);
+  TEST_ASSERT_EQUAL_UINT16(4700, read[0].meanFlowMlPerMin);
+
+  uint32_t sequences[16];
+  TEST_ASSERT_EQUAL_size_t(12, readSequences(rebooted, 0, sequences, 16));
+  for (uint32_t i = 0; i < 12; i++) TEST_ASSERT_EQUAL_UINT32(i + 1, sequences[i]);
+}
+
+void test_torn_record_is_skipped_after_reboot() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+  appendEvents(journal, 3);
+
+  // Power cut halfway through the fourth record
+  flash.failNextWriteAfter(10);
+  TEST_ASSERT_FALSE(journal.append(T0, 400));
+
+  DrinkJournal rebooted(flash);
+  TEST_ASSERT_TRUE(rebooted.begin(EPOCH));
+  TEST_ASSERT_EQUAL_UINT32(1, rebooted.stats().tornRecords);
+  TEST_ASSERT_EQUAL_UINT32(3, rebooted.lastSequence());
+
+  // Appending continues after the torn slot
+  uint32_t sequence = 0;
+  TEST_ASSERT_TRUE(rebooted.append(T0, 500, &sequence));
+  TEST_ASSERT_EQUAL_UINT32(4, sequence);
+
+  uint32_t sequences[8];
+  TEST_ASSERT_EQUAL_size_t(4, readSequences(rebooted, 0, sequences, 8));
+  TEST_ASSERT_EQUAL_UINT32(3, sequences[2]);
+  TEST_ASSERT_EQUAL_UINT32(4, sequences[3]);
+}
+
+void test_torn_sector_header_is_erased_again() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+  appendEvents(journal, 8);
+
+  // The ninth record opens the next sector, its header write is cut
+  flash.failNextWriteAfter(6);
+  TEST_ASSERT_FALSE(journal.append(T0, 900));
+
+  DrinkJournal rebooted(flash);
+  TEST_ASSERT_TRUE(rebooted.begin(EPOCH));
+  TEST_ASSERT_EQUAL_UINT32(8, rebooted.lastSequence());
+  appendEvents(rebooted, 2);
+
+  DrinkJournal again(flash);
+  TEST_ASSERT_TRUE(again.begin(EPOCH));
+  uint32_t sequences[16];
+  TEST_ASSERT_EQUAL_size_t(10, readSequences(again, 0, sequences, 16));
+  TEST_ASSERT_EQUAL_UINT32(10, sequences[9]);
+}
+
+void test_acknowledgement_survives_a_reboot() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+  appendEvents(journal, 5);
+  TEST_ASSERT_TRUE(journal.acknowledge(3));
+
+  DrinkJournal rebooted(flash);
+  TEST_ASSERT_TRUE(rebooted.begin(EPOCH));
+  TEST_ASSERT_EQUAL_UINT32(3, rebooted.acknowledgedSequence());
+  TEST_ASSERT_EQUAL_UINT32(2, rebooted.pendingCount());
+
+  // The drain resumes after the acknowledged sequence
+  uint32_t sequences[8];
+  TEST_ASSERT_EQUAL_size_t(2, readSequences(rebooted, rebooted.acknowledgedSequence(), sequences, 8));
+  TEST_ASSERT_EQUAL_UINT32(4, sequences[0]);
+  TEST_ASSERT_EQUAL_UINT32(5, sequences[1]);
+
+  // Acknowledgements never move back or past the last event
+  TEST_ASSERT_TRUE(rebooted.acknowledge(2));
+  TEST_ASSERT_EQUAL_UINT32(3, rebooted.acknowledgedSequence());
+  TEST_ASSERT_TRUE(rebooted.acknowledge(99));
+  TEST_ASSERT_EQUAL_UINT32(5, rebooted.acknowledgedSequence());
+}
+
+void test_torn_acknowledgement_replays_the_events() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+  appendEvents(journal, 5);
+  TEST_ASSERT_TRUE(journal.acknowledge(2));
+
+  flash.failNextWriteAfter(12);
+  TEST_ASSERT_FALSE(journal.acknowledge(5));
+
+  // Events whose acknowledgement was lost are delivered again
+  DrinkJournal rebooted(flash);
+  TEST_ASSERT_TRUE(rebooted.begin(EPOCH));
+  TEST_ASSERT_EQUAL_UINT32(2, rebooted.acknowledgedSequence());
+  uint32_t sequences[8];
+  TEST_ASSERT_EQUAL_size_t(3, readSequences(rebooted, rebooted.acknowledgedSequence(), sequences, 8));
+  TEST_ASSERT_EQUAL_UINT32(3, sequences[0]);
+}
+
+void test_acknowledgement_checkpoint_outlives_its_sector() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+
+  // Acknowledge everything, then wrap the ring so the sector holding the
+  // acknowledgement record is erased
+  appendEvents(journal, 4);
+  TEST_ASSERT_TRUE(journal.acknowledge(4));
+  for (uint32_t i = 0; i < 30; i++) {
+    TEST_ASSERT_TRUE(journal.append(T0, 100));
+    TEST_ASSERT_TRUE(journal.acknowledge(journal.lastSequence()));
+  }
+  TEST_ASSERT_GREATER_THAN(0, flash.eraseCount(0));
+
+  DrinkJournal rebooted(flash);
+  TEST_ASSERT_TRUE(rebooted.begin(EPOCH));
+  TEST_ASSERT_EQUAL_UINT32(34, rebooted.lastSequence());
+  TEST_ASSERT_EQUAL_UINT32(34, rebooted.acknowledgedSequence());
+  TEST_ASSERT_EQUAL_UINT32(0, rebooted.stats().droppedRecords);
+}
+
+void test_full_ring_drops_the_oldest_events() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+
+  // 32 slots in the ring; the 33rd event reuses the first sector
+  appendEvents(journal, 33);
+  TEST_ASSERT_EQUAL_UINT32(8, journal.stats().droppedRecords);
+  TEST_ASSERT_EQUAL_UINT32(8, journal.acknowledgedSequence());
+
+  uint32_t sequences[40];
+  size_t count = readSequences(journal, journal.acknowledgedSequence(), sequences, 40);
+  TEST_ASSERT_EQUAL_size_t(25, count);
+  TEST_ASSERT_EQUAL_UINT32(9, sequences[0]);
+  TEST_ASSERT_EQUAL_UINT32(33, sequences[count - 1]);
+}
+
+void test_erases_spread_over_the_ring() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+  for (uint32_t i = 0; i < 8 * SECTORS * 10; i++) {
+    TEST_ASSERT_TRUE(journal.append(T0, 100));
+    TEST_ASSERT_TRUE(journal.acknowledge(journal.lastSequence()));
+  }
+
+  uint32_t least = UINT32_MAX;
+  uint32_t most = 0;
+  for (size_t sector = 0; sector < SECTORS; sector++) {
+    if (flash.eraseCount(sector) < least) least = flash.eraseCount(sector);
+    if (flash.eraseCount(sector) > most) most = flash.eraseCount(sector);
+  }
+  TEST_ASSERT_GREATER_THAN(0, least);
+  TEST_ASSERT_LESS_OR_EQUAL(least + 1, most);
+}
+
+void test_epoch_survives_a_reboot_and_changes_on_erased_flash() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+  TEST_ASSERT_EQUAL_UINT32(EPOCH, journal.epoch());
+  appendEvents(journal, 20);
+
+  // An existing journal keeps its epoch, whatever the caller passes
+  DrinkJournal rebooted(flash);
+  TEST_ASSERT_TRUE(rebooted.begin(EPOCH + 1));
+  TEST_ASSERT_EQUAL_UINT32(EPOCH, rebooted.epoch());
+
+  // Erased flash starts over at sequence 1 with the new epoch
+  RamFlashStore erased(SECTOR_SIZE, SECTORS);
+  DrinkJournal fresh(erased);
+  TEST_ASSERT_TRUE(fresh.begin(EPOCH + 1));
+  appendEvents(fresh, 1);
+  TEST_ASSERT_EQUAL_UINT32(1, fresh.lastSequence());
+  DrinkJournal freshRebooted(erased);
+  TEST_ASSERT_TRUE(freshRebooted.begin(EPOCH + 2));
+  TEST_ASSERT_EQUAL_UINT32(EPOCH + 1, freshRebooted.epoch());
+}
+
+static bool appendUnsynced(DrinkJournal& journal, uint64_t bootClockMs, uint16_t amountMl) {
+  JournalRecord record = {};
+  record.timestampMs = bootClockMs;
+  record.amountMl = amountMl;
+  record.unsynced = true;
+  return journal.append(record);
+}
+
+void test_unsynced_events_are_rebased_on_the_first_sync() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+  TEST_ASSERT_TRUE(appendUnsynced(journal, 5000, 100));
+  TEST_ASSERT_TRUE(appendUnsynced(journal, 9000, 200));
+
+  // No wall-clock time is made up while the offset is unknown
+  JournalRecord read[4];
+  TEST_ASSERT_EQUAL_size_t(2, journal.readAfter(0, read, 4));
+  TEST_ASSERT_EQUAL_UINT64(0, read[0].timestampMs);
+  TEST_ASSERT_TRUE(read[0].unsynced);
+
+  TEST_ASSERT_TRUE(journal.rebaseUnsynced((int64_t)T0));
+  TEST_ASSERT_TRUE(journal.append(T0 + 20000, 300));
+
+  DrinkJournal rebooted(flash);
+  TEST_ASSERT_TRUE(rebooted.begin(EPOCH));
+  TEST_ASSERT_EQUAL_UINT32(3, rebooted.lastSequence());
+  TEST_ASSERT_EQUAL_size_t(3, rebooted.readAfter(0, read, 4));
+  TEST_ASSERT_EQUAL_UINT64(T0 + 5000, read[0].timestampMs);
+  TEST_ASSERT_EQUAL_UINT64(T0 + 9000, read[1].timestampMs);
+  TEST_ASSERT_EQUAL_UINT64(T0 + 20000, read[2].timestampMs);
+  TEST_ASSERT_FALSE(read[0].unsynced);
+  TEST_ASSERT_FALSE(read[2].unsynced);
+}
+
+void test_unsynced_events_lose_their_time_on_a_cold_boot() {
+  RamFlashStore flash(SECTOR_SIZE, SECTORS);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+  TEST_ASSERT_TRUE(appendUnsynced(journal, 5000, 100));
+  TEST_ASSERT_TRUE(journal.rebaseUnsynced((int64_t)T0));
+  TEST_ASSERT_TRUE(appendUnsynced(journal, 3000, 200));
+
+  // The boot clock restarted, a later sync must not date the old event
+  DrinkJournal rebooted(flash);
+  TEST_ASSERT_TRUE(rebooted.begin(EPOCH));
+  TEST_ASSERT_TRUE(rebooted.abandonUnsynced());
+  TEST_ASSERT_TRUE(appendUnsynced(rebooted, 4000, 300));
+  TEST_ASSERT_TRUE(rebooted.rebaseUnsynced((int64_t)(T0 + 60000)));
+  // Nothing left to rebase
+  TEST_ASSERT_TRUE(rebooted.abandonUnsynced());
+
+  DrinkJournal again(flash);
+  TEST_ASSERT_TRUE(again.begin(EPOCH));
+  JournalRecord read[4];
+  TEST_ASSERT_EQUAL_size_t(3, again.readAfter(0, read, 4));
+  TEST_ASSERT_EQUAL_UINT64(T0 + 5000, read[0].timestampMs);
+  TEST_ASSERT_EQUAL_UINT64(0, read[1].timestampMs);
+  TEST_ASSERT_TRUE(read[1].unsynced);
+  TEST_ASSERT_EQUAL_UINT64(T0 + 64000, read[2].timestampMs);
+}
+
+void test_partition_holds_ten_thousand_events() {
+  // The journal partition from partitions.csv
+  RamFlashStore flash(4096, 0x50000 / 4096);
+  DrinkJournal journal(flash);
+  TEST_ASSERT_TRUE(journal.begin(EPOCH));
+
+  // With an acknowledgement every new sector starts with its checkpoint
+  TEST_ASSERT_TRUE(journal.append(T0, 150));
+  TEST_ASSERT_TRUE(journal.acknowledge(1));
+  appendEvents(journal, 10000);
+  TEST_ASSERT_EQUAL_UINT32(0, journal.stats().droppedRecords);
+  TEST_ASSERT_EQUAL_UINT32(10000, journal.pendingCount());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_records_survive_a_reboot);
+  RUN_TEST(test_torn_record_is_skipped_after_reboot);
+  RUN_TEST(test_torn_sector_header_is_erased_again);
+  RUN_TEST(test_acknowledgement_survives_a_reboot);
+  RUN_TEST(test_torn_acknowledgement_replays_the_events);
+  RUN_TEST(test_acknowledgement_checkpoint_outlives_its_sector);
+  RUN_TEST(test_full_ring_drops_the_oldest_events);
+  RUN_TEST(test_erases_spread_over_the_ring);
+  RUN_TEST(test_epoch_survives_a_reboot_and_changes_on_erased_flash);
+  RUN_TEST(test_unsynced_events_are_rebased_on_the_first_sync);
+  RUN_TEST(test_unsynced_events_lose_their_time_on_a_cold_boot);
+  RUN_TEST(test_partition_holds_ten_thousand_events);
+  return UNITY_END();
+}
@@ -0,0 +1,240 @@
+#include <unity.h>
+#include <string.h>
+#include <PowerPolicy.h>
+#include <EnergyLedger.h>
+#include <DisplayPower.h>
+
+const uint32_t HOUR_MS = 60UL * 60 * 1000;
+const uint64_t HOUR_US = 3600000000ULL;
+const uint64_t SECOND_US = 1000000;
+
+static const PowerConfig CONFIG = { 10000, HOUR_MS };
+
+void setUp() {}
+void tearDown() {}
+
+void test_activity_holds_active() {
+  PowerPolicy policy(CONFIG);
+  TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, policy.state());
+  TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, policy.update(9999, false, true));
+  TEST_ASSERT_EQUAL_INT(POWER_IDLE, policy.update(10000, false, true));
+
+  policy.noteActivity(15000);
+  TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, policy.state());
+  TEST_ASSERT_EQUAL_UINT32(4000, policy.idleMs(19000));
+  TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, policy.update(24999, false, true));
+  TEST_ASSERT_EQUAL_INT(POWER_IDLE, policy.update(25000, false, true));
+}
+
+void test_deep_sleep_after_idle_timeout() {
+  PowerPolicy policy(CONFIG);
+  TEST_ASSERT_EQUAL_INT(POWER_IDLE, policy.update(HOUR_MS - 1, false, true));
+  TEST_ASSERT_EQUAL_INT(POWER_DEEP_SLEEP, policy.update(HOUR_MS, false, true));
+  // Activity from deep sleep, e.g. the flow wake-up, starts over
+  policy.noteActivity(HOUR_MS + 500);
+  TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, policy.update(HOUR_MS + 600, false, true));
+}
+
+// A central keeps the bottle out of deep sleep, so does a build that
+// cannot wake from it
+void test_deep_sleep_needs_disconnect_and_a_wake_source() {
+  PowerPolicy policy(CONFIG);
+  TEST_ASSERT_EQUAL_INT(POWER_IDLE, policy.update(2 * HOUR_MS, true, true));
+  TEST_ASSERT_EQUAL_INT(POWER_IDLE, policy.update(2 * HOUR_MS, false, false));
+  TEST_ASSERT_EQUAL_INT(POWER_DEEP_SLEEP, policy.update(2 * HOUR_MS, false, true));
+  TEST_ASSERT_EQUAL_INT(POWER_IDLE, policy.update(2 * HOUR_MS, true, true));
+}
+
+void test_policy_follows_the_millis_wrap() {
+  PowerPolicy policy(CONFIG);
+  uint32_t start = 0xFFFFFFFF - 3000;
+  policy.noteActivity(start);
+  TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, policy.update(start + 9999, false, true));
+  TEST_ASSERT_EQUAL_INT(POWER_IDLE, policy.update(start + 10000, false, true));
+  TEST_ASSERT_EQUAL_INT(POWER_DEEP_SLEEP, policy.update(start + HOUR_MS, false, true));
+}
+
+void test_ledger_counts_time_and_transitions() {
+  PowerLedger ledger;
+  ledger.reset();
+  ledger.add(POWER_ACTIVE, 100);
+  ledger.add(POWER_ACTIVE, 100);
+  ledger.add(POWER_IDLE, 300);
+  ledger.add(POWER_ACTIVE, 50);
+  ledger.add(POWER_DEEP_SLEEP, 1000);
+  TEST_ASSERT_EQUAL_UINT32(250, (uint32_t)ledger.stateMs[POWER_ACTIVE]);
+  TEST_ASSERT_EQUAL_UINT32(300, (uint32_t)ledger.stateMs[POWER_IDLE]);
+  TEST_ASSERT_EQUAL_UINT32(1000, (uint32_t)ledger.stateMs[POWER_DEEP_SLEEP]);
+  TEST_ASSERT_EQUAL_UINT32(1550, (uint32_t)ledger.totalMs());
+  TEST_ASSERT_EQUAL_UINT32(3, ledger.transitions);
+  TEST_ASSERT_EQUAL_INT(POWER_DEEP_SLEEP, ledger.lastState);
+
+  ledger.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)ledger.totalMs());
+  TEST_ASSERT_EQUAL_UINT32(0, ledger.transitions);
+}
+
+void test_ledger_empty_is_zero() {
+  PowerLedger ledger;
+  ledger.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, ledger.dutyCyclePermille(LIGHT_SLEEP_POWER_MODEL));
+  TEST_ASSERT_EQUAL_UINT32(0, ledger.averageMicroAmps(LIGHT_SLEEP_POWER_MODEL));
+}
+
+// 1 h active, 1 h idle, 2 h deep sleep
+static PowerLedger mixedDay() {
+  PowerLedger ledger;
+  ledger.reset();
+  ledger.add(POWER_ACTIVE, HOUR_MS);
+  ledger.add(POWER_IDLE, HOUR_MS);
+  ledger.add(POWER_DEEP_SLEEP, 2 * HOUR_MS);
+  return ledger;
+}
+
+void test_duty_cycle_permille() {
+  PowerLedger ledger = mixedDay();
+  // Idle is awake 2% of the time with light sleep, all of it without
+  TEST_ASSERT_EQUAL_UINT32((1000 + 20) / 4, ledger.dutyCyclePermille(LIGHT_SLEEP_POWER_MODEL));
+  TEST_ASSERT_EQUAL_UINT32((1000 + 1000) / 4, ledger.dutyCyclePermille(STOCK_CORE_POWER_MODEL));
+}
+
+void test_average_micro_amps() {
+  PowerLedger ledger = mixedDay();
+  // Idle draws 20 mA for 2% and 0.8 mA for 98% of the time: 1,184 uA
+  TEST_ASSERT_EQUAL_UINT32((45000 + 1184 + 2 * 10) / 4, ledger.averageMicroAmps(LIGHT_SLEEP_POWER_MODEL));
+  TEST_ASSERT_EQUAL_UINT32((45000 + 20000 + 2 * 10) / 4, ledger.averageMicroAmps(STOCK_CORE_POWER_MODEL));
+
+  // A month of idle keeps the 64 bit charge from overflowing
+  PowerLedger month;
+  month.reset();
+  for (int day = 0; day < 31; day++) month.add(POWER_IDLE, 24 * HOUR_MS);
+  TEST_ASSERT_EQUAL_UINT32(20000, month.averageMicroAmps(STOCK_CORE_POWER_MODEL));
+  TEST_ASSERT_EQUAL_UINT32(20, month.dutyCyclePermille(LIGHT_SLEEP_POWER_MODEL));
+}
+
+void test_energy_begin_starts_in_state_zero() {
+  EnergyLedger ledger;
+  ledger.begin(5 * SECOND_US);
+  for (size_t i = 0; i < ENERGY_SUBSYSTEMS; i++) {
+    TEST_ASSERT_EQUAL_UINT8(0, ledger.state((EnergySubsystem)i));
+    TEST_ASSERT_EQUAL_UINT32(0, ledger.transitions((EnergySubsystem)i));
+    TEST_ASSERT_EQUAL_UINT32(0, ledger.averageMicroAmps((EnergySubsystem)i));
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)ledger.elapsedUs());
+}
+
+// Every state change closes the interval of the previous state
+void test_energy_time_in_state() {
+  EnergyLedger ledger;
+  ledger.begin(0);
+  ledger.setState(ENERGY_RADIO, RADIO_ADVERTISING, 1 * SECOND_US);
+  ledger.setState(ENERGY_RADIO, RADIO_CONNECTED, 3 * SECOND_US);
+  // The same state again and states beyond the table change nothing
+  ledger.setState(ENERGY_RADIO, RADIO_CONNECTED, 4 * SECOND_US);
+  ledger.setState(ENERGY_RADIO, ENERGY_MAX_STATES, 5 * SECOND_US);
+  ledger.update(10 * SECOND_US);
+
+  TEST_ASSERT_EQUAL_UINT64(1 * SECOND_US, ledger.stateUs(ENERGY_RADIO, RADIO_OFF));
+  TEST_ASSERT_EQUAL_UINT64(2 * SECOND_US, ledger.stateUs(ENERGY_RADIO, RADIO_ADVERTISING));
+  TEST_ASSERT_EQUAL_UINT64(7 * SECOND_US, ledger.stateUs(ENERGY_RADIO, RADIO_CONNECTED));
+  TEST_ASSERT_EQUAL_UINT32(2, ledger.transitions(ENERGY_RADIO));
+  TEST_ASSERT_EQUAL_UINT8(RADIO_CONNECTED, ledger.state(ENERGY_RADIO));
+  TEST_ASSERT_EQUAL_UINT64(10 * SECOND_US, ledger.elapsedUs());
+  // The other subsystems stayed in state 0 the whole time
+  TEST_ASSERT_EQUAL_UINT64(10 * SECOND_US, ledger.stateUs(ENERGY_CPU, CPU_IDLE));
+}
+
+// A timestamp before the end of the charged time charges nothing, and a
+// state change then starts where the charged time ends
+void test_energy_ignores_time_going_back() {
+  EnergyLedger ledger;
+  ledger.begin(0);
+  ledger.update(10 * SECOND_US);
+  ledger.update(8 * SECOND_US);
+  ledger.setState(ENERGY_SENSOR, SENSOR_FLOWING, 9 * SECOND_US);
+  ledger.update(12 * SECOND_US);
+  TEST_ASSERT_EQUAL_UINT64(10 * SECOND_US, ledger.stateUs(ENERGY_SENSOR, SENSOR_NO_FLOW));
+  TEST_ASSERT_EQUAL_UINT64(2 * SECOND_US, ledger.stateUs(ENERGY_SENSOR, SENSOR_FLOWING));
+  TEST_ASSERT_EQUAL_UINT64(12 * SECOND_US, ledger.elapsedUs());
+}
+
+void test_energy_micro_amp_hours() {
+  EnergyLedger ledger;
+  ledger.begin(0);
+  // Display on for half an hour and dimmed for the other half
+  ledger.setState(ENERGY_DISPLAY, DISPLAY_DIM, HOUR_US / 2);
+  ledger.setState(ENERGY_CPU, CPU_BUSY, HOUR_US / 4);
+  ledger.update(HOUR_US);
+
+  TEST_ASSERT_EQUAL_UINT64((25000 + 6000) / 2, ledger.microAmpHours(ENERGY_DISPLAY));
+  TEST_ASSERT_EQUAL_UINT32((25000 + 6000) / 2, ledger.averageMicroAmps(ENERGY_DISPLAY));
+  TEST_ASSERT_EQUAL_UINT64((10000 + 3 * 40000) / 4, ledger.microAmpHours(ENERGY_CPU));
+  TEST_ASSERT_EQUAL_UINT64(0, ledger.microAmpHours(ENERGY_RADIO));
+
+  // Over two hours the charge doubles and the average stays
+  ledger.update(2 * HOUR_US);
+  TEST_ASSERT_EQUAL_UINT64(15500 + 6000, ledger.microAmpHours(ENERGY_DISPLAY));
+  TEST_ASSERT_EQUAL_UINT32((15500 + 6000) / 2, ledger.averageMicroAmps(ENERGY_DISPLAY));
+}
+
+// Interrupt time is charged on top of the state current
+void test_energy_isr_time() {
+  EnergyLedger ledger;
+  ledger.begin(0);
+  for (int i = 0; i < 3600; i++) ledger.addIsrTime(ENERGY_SENSOR, 1000);
+  ledger.update(HOUR_US);
+  TEST_ASSERT_EQUAL_UINT64(3600 * 1000, ledger.isrUs(ENERGY_SENSOR));
+  // 3.6 s at 40 mA is 40 uAh
+  TEST_ASSERT_EQUAL_UINT64(15000 + 40, ledger.microAmpHours(ENERGY_SENSOR));
+  TEST_ASSERT_EQUAL_UINT32(15000 + 40, ledger.averageMicroAmps(ENERGY_SENSOR));
+}
+
+void test_energy_without_backlight_control() {
+  EnergyLedger ledger(withoutBacklightControl(DEFAULT_ENERGY_PROFILE));
+  ledger.begin(0);
+  ledger.setState(ENERGY_DISPLAY, DISPLAY_DIM, 0);
+  ledger.setState(ENERGY_DISPLAY, DISPLAY_SLEEP, HOUR_US / 2);
+  ledger.update(HOUR_US);
+  TEST_ASSERT_EQUAL_UINT64((25000 + 50) / 2, ledger.microAmpHours(ENERGY_DISPLAY));
+}
+
+void test_energy_report() {
+  EnergyLedger ledger;
+  ledger.begin(0);
+  ledger.setState(ENERGY_RADIO, RADIO_ADVERTISING, 0);
+  ledger.addIsrTime(ENERGY_SENSOR, 12000);
+  ledger.update(HOUR_US);
+
+  char report[320];
+  size_t length = formatEnergyReport(ledger, report, sizeof(report));
+  const char* expected =
+      "{\"uptimeS\":3600,\"mAhPerHour\":{\"radio\":8.00,\"display\":25.00,\"cpu\":10.00,\"sensor\":15.00},"
+      "\"totalMAhPerHour\":58.00,\"stateS\":{\"radio\":[0,3600,0],\"display\":[3600,0,0],\"cpu\":[3600,0,0],"
+      "\"sensor\":[3600,0,0]},\"isrMs\":{\"sensor\":12}}";
+  TEST_ASSERT_EQUAL_STRING(expected, report);
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), length);
+
+  // A report that does not fit is not cut off but left out
+  TEST_ASSERT_EQUAL_size_t(0, formatEnergyReport(ledger, report, length));
+  TEST_ASSERT_EQUAL_STRING("", report);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_activity_holds_active);
+  RUN_TEST(test_deep_sleep_after_idle_timeout);
+  RUN_TEST(test_deep_sleep_needs_disconnect_and_a_wake_source);
+  RUN_TEST(test_policy_follows_the_millis_wrap);
+  RUN_TEST(test_ledger_counts_time_and_transitions);
+  RUN_TEST(test_ledger_empty_is_zero);
+  RUN_TEST(test_duty_cycle_permille);
+  RUN_TEST(test_average_micro_amps);
+  RUN_TEST(test_energy_begin_starts_in_state_zero);
+  RUN_TEST(test_energy_time_in_state);
+  RUN_TEST(test_energy_ignores_time_going_back);
+  RUN_TEST(test_energy_micro_amp_hours);
+  RUN_TEST(test_energy_isr_time);
+  RUN_TEST(test_energy_without_backlight_control);
+  RUN_TEST(test_energy_report);
+  return UNITY_END();
+}
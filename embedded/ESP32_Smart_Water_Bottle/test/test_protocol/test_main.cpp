@@ -0,0 +1,132 @@
+#include <unity.h>
+#include <WaterProtocol.h>
+
+void setUp() {}
+void tearDown() {}
+
+static const uint8_t ALL_TYPES[] = {
+  FRAME_HELLO, FRAME_DRINK_EVENT, FRAME_SYNC_REQUEST, FRAME_SYNC_CONFIRM, FRAME_REMINDER,
+  FRAME_WATER_GOAL, FRAME_CURRENT_WATER, FRAME_ACK, FRAME_HISTORY_REQUEST, FRAME_CALIBRATE,
+  FRAME_CALIBRATION_RUN, FRAME_CALIBRATION_STORED, FRAME_CREDIT_PROBE,
+};
+
+void test_frame_sizes() {
+  TEST_ASSERT_EQUAL_size_t(14, waterFrameSize(FRAME_HELLO));
+  TEST_ASSERT_EQUAL_size_t(15, waterFrameSize(FRAME_REMINDER));
+  TEST_ASSERT_EQUAL_size_t(24, waterFrameSize(FRAME_DRINK_EVENT));
+  // History chunks have a variable length and no fixed frame size
+  TEST_ASSERT_EQUAL_size_t(0, waterFrameSize(FRAME_HISTORY_CHUNK));
+  TEST_ASSERT_EQUAL_size_t(0, waterFrameSize(0x7F));
+}
+
+void test_drink_event_layout() {
+  WaterFrame frame = { FRAME_DRINK_EVENT, 0x04030201, 0x0C0B0A0908070605ULL, 0x0E0D, 0x1211100F, 0x1413, 0x1615 };
+  uint8_t buffer[WATER_FRAME_MAX_SIZE];
+  TEST_ASSERT_EQUAL_size_t(24, encodeWaterFrame(frame, buffer, sizeof(buffer)));
+
+  const uint8_t expected[24] = { WATER_PROTOCOL_VERSION, FRAME_DRINK_EVENT, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                 13, 14, 15, 16, 17, 18, 19, 20, 21, 22 };
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buffer, sizeof(expected));
+}
+
+void test_round_trip_every_type() {
+  for (size_t i = 0; i < sizeof(ALL_TYPES); i++) {
+    uint8_t type = ALL_TYPES[i];
+    size_t payload = waterFrameSize(type) - WATER_FRAME_HEADER_SIZE;
+    WaterFrame frame = { type, (uint32_t)(4000000000UL + i), 1751356800123ULL, (uint16_t)(payload == 1 ? 2 : 65535),
+                         4000000000UL, 9000, 5400 };
+
+    uint8_t buffer[WATER_FRAME_MAX_SIZE];
+    size_t size = encodeWaterFrame(frame, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_size_t(waterFrameSize(type), size);
+    TEST_ASSERT_TRUE(isBinaryFrame(buffer, size));
+
+    WaterFrame decoded;
+    TEST_ASSERT_EQUAL_size_t(size, decodeWaterFrame(buffer, size, decoded));
+    TEST_ASSERT_EQUAL_UINT8(type, decoded.type);
+    TEST_ASSERT_EQUAL_UINT32(frame.sequence, decoded.sequence);
+    TEST_ASSERT_EQUAL_UINT64(frame.timestampMs, decoded.timestampMs);
+    TEST_ASSERT_EQUAL_UINT16(payload == 0 ? 0 : frame.value, decoded.value);
+
+    // Session details only travel in drink events
+    bool details = type == FRAME_DRINK_EVENT;
+    TEST_ASSERT_EQUAL_UINT32(details ? frame.durationMs : 0, decoded.durationMs);
+    TEST_ASSERT_EQUAL_UINT16(details ? frame.peakFlowMlPerMin : 0, decoded.peakFlowMlPerMin);
+    TEST_ASSERT_EQUAL_UINT16(details ? frame.meanFlowMlPerMin : 0, decoded.meanFlowMlPerMin);
+  }
+}
+
+void test_concatenated_frames() {
+  WaterFrame frames[3] = {
+    { FRAME_WATER_GOAL, 1, 0, 2500, 0, 0, 0 },
+    { FRAME_REMINDER, 2, 0, 1, 0, 0, 0 },
+    { FRAME_ACK, 3, 0, 16, 0, 0, 0 },
+  };
+  uint8_t buffer[3 * WATER_FRAME_MAX_SIZE];
+  size_t length = 0;
+  for (int i = 0; i < 3; i++) length += encodeWaterFrame(frames[i], buffer + length, sizeof(buffer) - length);
+
+  size_t offset = 0;
+  for (int i = 0; i < 3; i++) {
+    WaterFrame decoded;
+    size_t consumed = decodeWaterFrame(buffer + offset, length - offset, decoded);
+    TEST_ASSERT_EQUAL_size_t(waterFrameSize(frames[i].type), consumed);
+    TEST_ASSERT_EQUAL_UINT8(frames[i].type, decoded.type);
+    TEST_ASSERT_EQUAL_UINT16(frames[i].value, decoded.value);
+    offset += consumed;
+  }
+  TEST_ASSERT_EQUAL_size_t(length, offset);
+}
+
+void test_json_is_not_binary() {
+  const uint8_t json[] = "{\"syncConfirmed\":true}";
+  WaterFrame decoded;
+  TEST_ASSERT_FALSE(isBinaryFrame(json, sizeof(json) - 1));
+  TEST_ASSERT_FALSE(isBinaryFrame(json, 0));
+  TEST_ASSERT_EQUAL_size_t(0, decodeWaterFrame(json, sizeof(json) - 1, decoded));
+}
+
+void test_rejects_bad_frames() {
+  WaterFrame frame = { FRAME_DRINK_EVENT, 7, 1751356800000ULL, 250, 0, 0, 0 };
+  uint8_t buffer[WATER_FRAME_MAX_SIZE];
+  size_t size = encodeWaterFrame(frame, buffer, sizeof(buffer));
+  WaterFrame decoded;
+
+  // Every truncation, down to an incomplete header
+  for (size_t length = 0; length < size; length++) {
+    TEST_ASSERT_EQUAL_size_t(0, decodeWaterFrame(buffer, length, decoded));
+  }
+
+  // Neither a newer version nor version 1, whose drink events had no details
+  buffer[0] = WATER_PROTOCOL_VERSION + 1;
+  TEST_ASSERT_EQUAL_size_t(0, decodeWaterFrame(buffer, size, decoded));
+  buffer[0] = 1;
+  TEST_ASSERT_EQUAL_size_t(0, decodeWaterFrame(buffer, size, decoded));
+  buffer[0] = WATER_PROTOCOL_VERSION;
+
+  buffer[1] = 0x7F;
+  TEST_ASSERT_EQUAL_size_t(0, decodeWaterFrame(buffer, size, decoded));
+  buffer[1] = FRAME_HISTORY_CHUNK;
+  TEST_ASSERT_EQUAL_size_t(0, decodeWaterFrame(buffer, size, decoded));
+}
+
+void test_encode_rejects_small_buffer_and_unknown_type() {
+  uint8_t buffer[WATER_FRAME_MAX_SIZE];
+  WaterFrame frame = { FRAME_DRINK_EVENT, 1, 0, 100, 0, 0, 0 };
+  TEST_ASSERT_EQUAL_size_t(0, encodeWaterFrame(frame, buffer, WATER_FRAME_MAX_SIZE - 1));
+
+  frame.type = 0x7F;
+  TEST_ASSERT_EQUAL_size_t(0, encodeWaterFrame(frame, buffer, sizeof(buffer)));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_sizes);
+  RUN_TEST(test_drink_event_layout);
+  RUN_TEST(test_round_trip_every_type);
+  RUN_TEST(test_concatenated_frames);
+  RUN_TEST(test_json_is_not_binary);
+  RUN_TEST(test_rejects_bad_frames);
+  RUN_TEST(test_encode_rejects_small_buffer_and_unknown_type);
+  return UNITY_END();
+}